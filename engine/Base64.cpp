@@ -21,13 +21,22 @@
 
 #include "yateclass.h"
 
+#include <string.h>
+
+// The compiler must accept SSSE3 and AVX2 intrinsics in functions targeting them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define BASE64_SIMD
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
 using namespace TelEngine;
 
 // Padding char
 #define PADDING_CHAR '='
 
 static String s_eoln = "\r\n";
-static String s_ignore = "=\r\n\t ";
 
 // Base64 alphabet
 // See RFC 4648 Table 1
@@ -54,85 +63,422 @@ static unsigned char s_ato64[256] = {
 };
 #undef IC
 
+
 // Check in the translation table if 'ch' is a valid Base64 char
-static inline bool valid(char ch)
+static inline bool valid(unsigned char ch)
 {
-    return s_ato64[(unsigned char)ch] < 64;
+    return s_ato64[ch] < 64;
 }
 
-// Check if 'ch' should be ignored
-// Check in the translation table if 'ch' is a valid Base64 char
-// Return -1 to ignore it, 1 to accept it, 0 on error
-static inline int validLiberal(char ch)
+// Check if 'ch' is ignored when decoding with liberal rules
+static inline bool ignored(unsigned char ch)
 {
-    for (unsigned int i = 0; i < s_ignore.length(); i++)
-	if (s_ignore.at(i) == ch)
-	    return -1;
-    return valid(ch) ? 1 : 0;
+    return ch == PADDING_CHAR || ch == '\r' || ch == '\n' || ch == '\t' || ch == ' ';
 }
 
-// Add end of line to dest and increase index if lines is non 0 and end
-// if line was reached
-static inline void addEoln(String& dest, unsigned int& idx,
-	unsigned int& lines, unsigned int& crtLine, unsigned int lineLen)
+// Retrieve the value of a hexadecimal digit, -1 if invalid
+static inline int hexNibble(char c)
 {
-    if (!(lines && crtLine == lineLen))
-	return;
-    char* d = (char*)dest.c_str();
-    d[idx++] = s_eoln[0];
-    d[idx++] = s_eoln[1];
-    crtLine = 0;
-    lines--;
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    return -1;
 }
 
-// Add an encoded Base64 char to a destination string after clearing
-// the bits 6 and 7. Increase the string's index
-// Add end of line to dest and increase index if lines is non 0 and end
-// if line was reached
-static inline void addEnc(String& dest, unsigned int& idx, unsigned char ch,
-	unsigned int& lines, unsigned int& crtLine, unsigned int lineLen)
+// Check the CPU for the vector instructions used by the codecs
+static int cpuSimd()
 {
-    ((char*)dest.c_str())[idx++] = s_alphabet[ch & 0x3f];
-    crtLine++;
-    addEoln(dest,idx,lines,crtLine,lineLen);
+#ifdef BASE64_SIMD
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    if (!__get_cpuid(1,&a,&b,&c,&d) || !(c & (1 << 9)))
+	return Base64::SimdNone;
+    // AVX2 also needs the OS to save the YMM registers
+    if (__get_cpuid_max(0,0) < 7 || !(c & (1 << 27)))
+	return Base64::SimdSsse3;
+    unsigned int xcrLo = 0, xcrHi = 0;
+    __asm__ ("xgetbv" : "=a" (xcrLo), "=d" (xcrHi) : "c" (0));
+    if ((xcrLo & 6) != 6)
+	return Base64::SimdSsse3;
+    __cpuid_count(7,0,a,b,c,d);
+    return (b & (1 << 5)) ? Base64::SimdAvx2 : Base64::SimdSsse3;
+#else
+    return Base64::SimdNone;
+#endif
 }
 
-// Add a decoded char buffer to a destination buffer and increase the index
-// Len must be is 2,3,4
-static inline bool addDec(DataBlock& dest, unsigned int& idx,
-	unsigned char* dec, unsigned int len)
+int Base64::s_simd = cpuSimd();
+
+int Base64::simd(int level)
 {
-    switch (len) {
-	case 0:
-	    return true;
-	case 2:
-	case 3:
-	case 4:
+    int cpu = cpuSimd();
+    if (level < SimdNone)
+	level = SimdNone;
+    s_simd = (level < cpu) ? level : cpu;
+    return s_simd;
+}
+
+#ifdef BASE64_SIMD
+// Encode 12 byte groups into 16 chars, read 16 bytes at a time
+__attribute__((target("ssse3")))
+static unsigned int encSsse3(char* d, const unsigned char* s, unsigned int len)
+{
+    const __m128i shuf = _mm_setr_epi8(1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+    const __m128i lut = _mm_setr_epi8('a' - 26,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,
+	'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'+' - 62,'/' - 63,'A',0,0);
+    unsigned int done = 0;
+    for (; len - done >= 16; done += 12, d += 16) {
+	__m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + done)),shuf);
+	// Move each 6 bit value to its own byte
+	__m128i hi = _mm_mulhi_epu16(_mm_and_si128(in,_mm_set1_epi32(0x0fc0fc00)),
+	    _mm_set1_epi32(0x04000040));
+	__m128i lo = _mm_mullo_epi16(_mm_and_si128(in,_mm_set1_epi32(0x003f03f0)),
+	    _mm_set1_epi32(0x01000010));
+	__m128i idx = _mm_or_si128(hi,lo);
+	// Select the offset of each alphabet range
+	__m128i r = _mm_subs_epu8(idx,_mm_set1_epi8(51));
+	r = _mm_or_si128(r,_mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26),idx),_mm_set1_epi8(13)));
+	_mm_storeu_si128((__m128i*)d,_mm_add_epi8(idx,_mm_shuffle_epi8(lut,r)));
+    }
+    return done;
+}
+
+// Encode 24 byte groups into 32 chars, 12 bytes in each 128 bit lane
+__attribute__((target("avx2")))
+static unsigned int encAvx2(char* d, const unsigned char* s, unsigned int len)
+{
+    const __m256i shuf = _mm256_setr_epi8(1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10,
+	1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+    const __m256i lut = _mm256_setr_epi8('a' - 26,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,
+	'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'+' - 62,'/' - 63,'A',0,0,
+	'a' - 26,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,
+	'0' - 52,'0' - 52,'0' - 52,'0' - 52,'0' - 52,'+' - 62,'/' - 63,'A',0,0);
+    unsigned int done = 0;
+    for (; len - done >= 28; done += 24, d += 32) {
+	__m256i in = _mm256_inserti128_si256(
+	    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(s + done))),
+	    _mm_loadu_si128((const __m128i*)(s + done + 12)),1);
+	in = _mm256_shuffle_epi8(in,shuf);
+	__m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(in,_mm256_set1_epi32(0x0fc0fc00)),
+	    _mm256_set1_epi32(0x04000040));
+	__m256i lo = _mm256_mullo_epi16(_mm256_and_si256(in,_mm256_set1_epi32(0x003f03f0)),
+	    _mm256_set1_epi32(0x01000010));
+	__m256i idx = _mm256_or_si256(hi,lo);
+	__m256i r = _mm256_subs_epu8(idx,_mm256_set1_epi8(51));
+	r = _mm256_or_si256(r,_mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26),idx),
+	    _mm256_set1_epi8(13)));
+	_mm256_storeu_si256((__m256i*)d,_mm256_add_epi8(idx,_mm256_shuffle_epi8(lut,r)));
+    }
+    return done;
+}
+
+// Decode 16 char groups into 12 bytes, stop at the first group with an invalid char
+// Each group stores 16 bytes so the destination must have room for len / 4 * 3
+__attribute__((target("ssse3")))
+static unsigned int decSsse3(unsigned char* d, const unsigned char* s, unsigned int len)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+	0x11,0x11,0x13,0x1a,0x1b,0x1b,0x1b,0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+	0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0);
+    const __m128i pack = _mm_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    unsigned int done = 0;
+    for (; len - done >= 24; done += 16, d += 12) {
+	__m128i in = _mm_loadu_si128((const __m128i*)(s + done));
+	__m128i hi = _mm_and_si128(_mm_srli_epi32(in,4),nibble);
+	__m128i bad = _mm_and_si128(_mm_shuffle_epi8(lutLo,_mm_and_si128(in,nibble)),
+	    _mm_shuffle_epi8(lutHi,hi));
+	if (_mm_movemask_epi8(_mm_cmpgt_epi8(bad,_mm_setzero_si128())))
+	    break;
+	// Translate to 6 bit values, '/' shares the high nibble of '+'
+	__m128i roll = _mm_shuffle_epi8(lutRoll,_mm_add_epi8(_mm_cmpeq_epi8(in,_mm_set1_epi8('/')),hi));
+	__m128i v = _mm_maddubs_epi16(_mm_add_epi8(in,roll),_mm_set1_epi32(0x01400140));
+	v = _mm_madd_epi16(v,_mm_set1_epi32(0x00011000));
+	_mm_storeu_si128((__m128i*)d,_mm_shuffle_epi8(v,pack));
+    }
+    return done;
+}
+
+// Decode 32 char groups into 24 bytes, stores 32 bytes like decSsse3() stores 16
+__attribute__((target("avx2")))
+static unsigned int decAvx2(unsigned char* d, const unsigned char* s, unsigned int len)
+{
+    const __m256i lutLo = _mm256_setr_epi8(0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+	0x11,0x11,0x13,0x1a,0x1b,0x1b,0x1b,0x1a,
+	0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+	0x11,0x11,0x13,0x1a,0x1b,0x1b,0x1b,0x1a);
+    const __m256i lutHi = _mm256_setr_epi8(0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+	0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,
+	0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+	0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0,
+	0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0);
+    const __m256i pack = _mm256_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1,
+	2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+    const __m256i lanes = _mm256_setr_epi32(0,1,2,4,5,6,7,7);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    unsigned int done = 0;
+    for (; len - done >= 44; done += 32, d += 24) {
+	__m256i in = _mm256_loadu_si256((const __m256i*)(s + done));
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi32(in,4),nibble);
+	__m256i bad = _mm256_and_si256(_mm256_shuffle_epi8(lutLo,_mm256_and_si256(in,nibble)),
+	    _mm256_shuffle_epi8(lutHi,hi));
+	if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(bad,_mm256_setzero_si256())))
 	    break;
-	default:
+	__m256i roll = _mm256_shuffle_epi8(lutRoll,
+	    _mm256_add_epi8(_mm256_cmpeq_epi8(in,_mm256_set1_epi8('/')),hi));
+	__m256i v = _mm256_maddubs_epi16(_mm256_add_epi8(in,roll),_mm256_set1_epi32(0x01400140));
+	v = _mm256_madd_epi16(v,_mm256_set1_epi32(0x00011000));
+	v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v,pack),lanes);
+	_mm256_storeu_si256((__m256i*)d,v);
+    }
+    return done;
+}
+
+// Encode 16 bytes into 32 hexadecimal digits
+__attribute__((target("ssse3")))
+static unsigned int hexEncSsse3(char* d, const unsigned char* s, unsigned int len, const char* hex)
+{
+    const __m128i lut = _mm_loadu_si128((const __m128i*)hex);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    unsigned int done = 0;
+    for (; len - done >= 16; done += 16, d += 32) {
+	__m128i in = _mm_loadu_si128((const __m128i*)(s + done));
+	__m128i hi = _mm_shuffle_epi8(lut,_mm_and_si128(_mm_srli_epi16(in,4),nibble));
+	__m128i lo = _mm_shuffle_epi8(lut,_mm_and_si128(in,nibble));
+	_mm_storeu_si128((__m128i*)d,_mm_unpacklo_epi8(hi,lo));
+	_mm_storeu_si128((__m128i*)(d + 16),_mm_unpackhi_epi8(hi,lo));
+    }
+    return done;
+}
+
+// Encode 32 bytes into 64 hexadecimal digits
+__attribute__((target("avx2")))
+static unsigned int hexEncAvx2(char* d, const unsigned char* s, unsigned int len, const char* hex)
+{
+    const __m128i lut128 = _mm_loadu_si128((const __m128i*)hex);
+    const __m256i lut = _mm256_inserti128_si256(_mm256_castsi128_si256(lut128),lut128,1);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    unsigned int done = 0;
+    for (; len - done >= 32; done += 32, d += 64) {
+	__m256i in = _mm256_loadu_si256((const __m256i*)(s + done));
+	__m256i hi = _mm256_shuffle_epi8(lut,_mm256_and_si256(_mm256_srli_epi16(in,4),nibble));
+	__m256i lo = _mm256_shuffle_epi8(lut,_mm256_and_si256(in,nibble));
+	// Unpacking works inside lanes, put the halves back in order
+	__m256i a = _mm256_unpacklo_epi8(hi,lo);
+	__m256i b = _mm256_unpackhi_epi8(hi,lo);
+	_mm256_storeu_si256((__m256i*)d,_mm256_permute2x128_si256(a,b,0x20));
+	_mm256_storeu_si256((__m256i*)(d + 32),_mm256_permute2x128_si256(a,b,0x31));
+    }
+    return done;
+}
+
+// Translate 16 hexadecimal digits to their values, set all bits of ok for valid ones
+__attribute__((target("ssse3")))
+static inline __m128i hexValues(__m128i c, __m128i& ok)
+{
+    __m128i dg = _mm_sub_epi8(c,_mm_set1_epi8('0'));
+    __m128i isDg = _mm_cmpeq_epi8(_mm_min_epu8(dg,_mm_set1_epi8(9)),dg);
+    __m128i lt = _mm_sub_epi8(_mm_or_si128(c,_mm_set1_epi8(0x20)),_mm_set1_epi8('a'));
+    __m128i isLt = _mm_cmpeq_epi8(_mm_min_epu8(lt,_mm_set1_epi8(5)),lt);
+    ok = _mm_or_si128(isDg,isLt);
+    return _mm_or_si128(_mm_and_si128(isDg,dg),
+	_mm_and_si128(isLt,_mm_add_epi8(lt,_mm_set1_epi8(10))));
+}
+
+// Decode 32 hexadecimal digits into 16 bytes, stop at the first group with an invalid digit
+__attribute__((target("ssse3")))
+static unsigned int hexDecSsse3(unsigned char* d, const char* s, unsigned int len)
+{
+    const __m128i mul = _mm_set1_epi16(0x0110);
+    unsigned int done = 0;
+    for (; len - done >= 32; done += 32, d += 16) {
+	__m128i okA, okB;
+	__m128i a = hexValues(_mm_loadu_si128((const __m128i*)(s + done)),okA);
+	__m128i b = hexValues(_mm_loadu_si128((const __m128i*)(s + done + 16)),okB);
+	if (_mm_movemask_epi8(_mm_and_si128(okA,okB)) != 0xffff)
+	    break;
+	a = _mm_maddubs_epi16(a,mul);
+	b = _mm_maddubs_epi16(b,mul);
+	_mm_storeu_si128((__m128i*)d,_mm_packus_epi16(a,b));
+    }
+    return done;
+}
+
+// Translate 32 hexadecimal digits to their values, set all bits of ok for valid ones
+__attribute__((target("avx2")))
+static inline __m256i hexValues(__m256i c, __m256i& ok)
+{
+    __m256i dg = _mm256_sub_epi8(c,_mm256_set1_epi8('0'));
+    __m256i isDg = _mm256_cmpeq_epi8(_mm256_min_epu8(dg,_mm256_set1_epi8(9)),dg);
+    __m256i lt = _mm256_sub_epi8(_mm256_or_si256(c,_mm256_set1_epi8(0x20)),_mm256_set1_epi8('a'));
+    __m256i isLt = _mm256_cmpeq_epi8(_mm256_min_epu8(lt,_mm256_set1_epi8(5)),lt);
+    ok = _mm256_or_si256(isDg,isLt);
+    return _mm256_or_si256(_mm256_and_si256(isDg,dg),
+	_mm256_and_si256(isLt,_mm256_add_epi8(lt,_mm256_set1_epi8(10))));
+}
+
+// Decode 64 hexadecimal digits into 32 bytes
+__attribute__((target("avx2")))
+static unsigned int hexDecAvx2(unsigned char* d, const char* s, unsigned int len)
+{
+    const __m256i mul = _mm256_set1_epi16(0x0110);
+    unsigned int done = 0;
+    for (; len - done >= 64; done += 64, d += 32) {
+	__m256i okA, okB;
+	__m256i a = hexValues(_mm256_loadu_si256((const __m256i*)(s + done)),okA);
+	__m256i b = hexValues(_mm256_loadu_si256((const __m256i*)(s + done + 32)),okB);
+	if (_mm256_movemask_epi8(_mm256_and_si256(okA,okB)) != -1)
+	    break;
+	a = _mm256_maddubs_epi16(a,mul);
+	b = _mm256_maddubs_epi16(b,mul);
+	// Packing works inside lanes, put the quarters back in order
+	_mm256_storeu_si256((__m256i*)d,_mm256_permute4x64_epi64(_mm256_packus_epi16(a,b),0xd8));
+    }
+    return done;
+}
+#endif
+
+// Encode full 3 byte groups, len must be a multiple of 3
+static void encodeGroups(char* d, const unsigned char* s, unsigned int len)
+{
+#ifdef BASE64_SIMD
+    unsigned int n = 0;
+    if (Base64::simd() >= Base64::SimdAvx2)
+	n = encAvx2(d,s,len);
+    if (Base64::simd() >= Base64::SimdSsse3)
+	n += encSsse3(d + n / 3 * 4,s + n,len - n);
+    d += n / 3 * 4;
+    s += n;
+    len -= n;
+#endif
+    // Encode each 3 bytes chunk from source to 4 bytes Base64 destination
+    // 1: s_alphabet[bits 2-7 from s[i]]
+    // 2: s_alphabet[bits 0,1 from s[i] + bits 4-7 from s[i+1]]
+    // 3: s_alphabet[bits 0-3 from s[i+1] + bits 6,7 from s[i+2]]
+    // 4: s_alphabet[bits 0-5 from s[i+2]]
+    for (; len >= 3; len -= 3, s += 3) {
+	*d++ = s_alphabet[s[0] >> 2];
+	*d++ = s_alphabet[(s[0] << 4 | s[1] >> 4) & 0x3f];
+	*d++ = s_alphabet[(s[1] << 2 | s[2] >> 6) & 0x3f];
+	*d++ = s_alphabet[s[2] & 0x3f];
+    }
+}
+
+// Encode the last 1 or 2 bytes to 4 chars with padding
+static void encodeRest(char* d, const unsigned char* s, unsigned int rest)
+{
+    *d++ = s_alphabet[s[0] >> 2];
+    if (rest == 1) {
+	*d++ = s_alphabet[(s[0] << 4) & 0x3f];
+	*d++ = PADDING_CHAR;
+    }
+    else {
+	*d++ = s_alphabet[(s[0] << 4 | s[1] >> 4) & 0x3f];
+	*d++ = s_alphabet[(s[1] << 2) & 0x3f];
+    }
+    *d = PADDING_CHAR;
+}
+
+// Decode full 4 char groups, stop at the first group with a char not in the alphabet
+// The destination must have room for len / 4 * 3 bytes
+// Return the number of chars decoded
+static unsigned int decodeGroups(unsigned char* d, const unsigned char* s, unsigned int len)
+{
+    unsigned int n = 0;
+#ifdef BASE64_SIMD
+    if (Base64::simd() >= Base64::SimdAvx2)
+	n = decAvx2(d,s,len);
+    if (Base64::simd() >= Base64::SimdSsse3)
+	n += decSsse3(d + n / 4 * 3,s + n,len - n);
+    d += n / 4 * 3;
+#endif
+    // Translate each byte and build 3 destination bytes from 4 6-bit Base64 chars
+    // 1: bits 0-5 from dec[0] + bits 4,5 from dec[1]
+    // 2: bits 0-3 from dec[1] + bits 2-5 from dec[2]
+    // 3: bits 0,1 from dec[2] + bits 0-5 from dec[3]
+    for (; len - n >= 4; n += 4) {
+	unsigned char a = s_ato64[s[n]];
+	unsigned char b = s_ato64[s[n+1]];
+	unsigned char c = s_ato64[s[n+2]];
+	unsigned char e = s_ato64[s[n+3]];
+	if ((a | b | c | e) & 0xc0)
+	    break;
+	*d++ = a << 2 | b >> 4;
+	*d++ = b << 4 | c >> 2;
+	*d++ = c << 6 | e;
+    }
+    return n;
+}
+
+// Decode Base64 text into a buffer with room for all the full groups it holds
+// The values of an incomplete group are kept in dec/iDec between calls
+// Return false and set pos to the first char not accepted
+static bool decodeText(unsigned char*& d, const unsigned char* s, unsigned int len,
+	unsigned char* dec, unsigned int& iDec, bool liberal, unsigned int& pos)
+{
+    for (unsigned int i = 0; i < len; i++) {
+	// Runs of alphabet chars are decoded in bulk, the rest one by one
+	if (!iDec) {
+	    unsigned int n = decodeGroups(d,s + i,(len - i) & ~3u);
+	    d += n / 4 * 3;
+	    i += n;
+	    if (i >= len)
+		break;
+	}
+	unsigned char c = s[i];
+	if (valid(c)) {
+	    dec[iDec++] = s_ato64[c];
+	    if (iDec == 4) {
+		*d++ = dec[0] << 2 | dec[1] >> 4;
+		*d++ = dec[1] << 4 | dec[2] >> 2;
+		*d++ = dec[2] << 6 | dec[3];
+		iDec = 0;
+	    }
+	}
+	else if (!(liberal && ignored(c))) {
+	    pos = i;
 	    return false;
+	}
     }
-    unsigned char* d = dest.data(idx,--len);
-    if (!d)
-	return false;
-    idx += len;
-    switch (len) {
-	case 3:
-	    *d++ = dec[0] << 2 | dec[1] >> 4;
-	    *d++ = dec[1] << 4 | dec[2] >> 2;
-	    *d = dec[2] << 6 | dec[3];
+    return true;
+}
+
+// Decode the last incomplete group of 2 or 3 chars to 1 or 2 bytes
+// Return false if the group has bits not fitting in the bytes
+static bool decodeRest(unsigned char*& d, const unsigned char* dec, unsigned int iDec)
+{
+    switch (iDec) {
+	case 0:
 	    return true;
 	case 2:
 	    *d++ = dec[0] << 2 | dec[1] >> 4;
-	    *d = dec[1] << 4 | dec[2] >> 2;
-	    return !(dec[2] & 0x03);
-	case 1:
-	    *d = dec[0] << 2 | dec[1] >> 4;
 	    return !(dec[1] & 0x0f);
+	case 3:
+	    *d++ = dec[0] << 2 | dec[1] >> 4;
+	    *d++ = dec[1] << 4 | dec[2] >> 2;
+	    return !(dec[2] & 0x03);
     }
     return false;
 }
 
+// Grow a data block and return a pointer to the added bytes
+static unsigned char* grow(DataBlock& dest, unsigned int len)
+{
+    unsigned int old = dest.length();
+    if (old) {
+	DataBlock tmp(0,len);
+	dest.append(tmp);
+    }
+    else
+	dest.assign(0,len);
+    return (unsigned char*)dest.data(old,len);
+}
+
 // Encode this buffer to a destination string
 void Base64::encode(String& dest, unsigned int lineLen, bool lineAtEnd)
 {
@@ -140,14 +486,11 @@ void Base64::encode(String& dest, unsigned int lineLen, bool lineAtEnd)
     if (!length())
 	return;
 
-    unsigned char* s = (unsigned char*)data();  // Source buffer
+    const unsigned char* s = (const unsigned char*)data(); // Source buffer
     unsigned int rest = length() % 3;           // The number of bytes that will need padding
     unsigned int full = length() - rest;        // The number of bytes in source that will
                                                 //  be processed in 3-byte chunks
-    unsigned int i = 0;                         // Source index
     unsigned int lines = 0;                     // Number of lines
-    unsigned int crtLine = 0;                   // Index in current line
-    unsigned int iDest = 0;                     // Destination index
     unsigned int len = full / 3 * 4 + (rest ? 4 : 0); // Destination length, without EOLNs
 
     // Calculate how many lines we need (except for the last one)
@@ -162,28 +505,17 @@ void Base64::encode(String& dest, unsigned int lineLen, bool lineAtEnd)
 	"Encoding %u bytes (full=%u rest=%u) to %u bytes lines=%u",
 	length(),full,rest,dest.length(),lines);
 
-    // Encode each 3 bytes chunk from source to 4 bytes Base64 destination
-    // 1: s_alphabet[bits 2-7 from s[i]]
-    // 2: s_alphabet[bits 0,1 from s[i] + bits 4-7 from s[i+1]]
-    // 3: s_alphabet[bits 0-3 from s[i+1] + bits 6,7 from s[i+2]]
-    // 4: s_alphabet[bits 0-5 from s[i+2]]
-    for (; i < full; i += 3) {
-	addEnc(dest,iDest,s[i] >> 2,lines,crtLine,lineLen);
-	addEnc(dest,iDest,s[i] << 4 | s[i+1] >> 4,lines,crtLine,lineLen);
-	addEnc(dest,iDest,s[i+1] << 2 | s[i+2] >> 6,lines,crtLine,lineLen);
-	addEnc(dest,iDest,s[i+2],lines,crtLine,lineLen);
-    }
-    // Encode rest (can be 1 or 2) to 4 bytes destination
-    // 1: 2 chars + 2 padding, 2: 3 chars + 1 padding
-    // Don't add the final padding char: destination was filled with it
-    if (rest) {
-	addEnc(dest,iDest,s[i] >> 2,lines,crtLine,lineLen);
-	if (rest == 1)
-	    addEnc(dest,iDest,s[i] << 4,lines,crtLine,lineLen);
-	else {
-	    addEnc(dest,iDest,s[i] << 4 | s[i+1] >> 4,lines,crtLine,lineLen);
-	    addEnc(dest,iDest,s[i+1] << 2,lines,crtLine,lineLen);
-	}
+    char* d = (char*)dest.c_str();
+    encodeGroups(d,s,full);
+    if (rest)
+	encodeRest(d + full / 3 * 4,s + full,rest);
+    // Spread the lines starting from the last one so each is moved only once
+    for (unsigned int i = lines; i; i--) {
+	unsigned int from = i * lineLen;
+	char* to = d + from + i * s_eoln.length();
+	::memmove(to,d + from,(i == lines) ? len - from : lineLen);
+	to[-2] = s_eoln[0];
+	to[-1] = s_eoln[1];
     }
     // Add final end of line ?
     if (lineAtEnd)
@@ -195,96 +527,198 @@ bool Base64::decode(DataBlock& dest, bool liberal)
 {
     dest.clear();
 
-    // Calculate the number of alphabet characters
-    unsigned int full = 0;
-    unsigned int rest = 0;
-    unsigned char* src = (unsigned char*)data();
-    if (liberal)
-	for (unsigned int i = 0; i < length(); i++) {
-	    int res = validLiberal(src[i]);
-	    if (!res) {
-		Debug("Base64",DebugInfo,"Got invalid char 0x%x at pos %u [%p]",src[i],i,this);
-		return false;
-	    }
-	    if (res > 0)
-		full++;
-	}
-    else {
-	full = length();
-	// Skip padding chars from end
-	for (; full; full--)
-	   if (src[full-1] != PADDING_CHAR)
-		break;
-    }
-    // rest MUST be 0, 2 or 3
+    // Skip padding chars (and ignored chars if liberal) from end
+    const unsigned char* src = (const unsigned char*)data();
+    unsigned int len = length();
+    for (; len; len--)
+	if (liberal ? !ignored(src[len-1]) : (src[len-1] != PADDING_CHAR))
+	    break;
+    // Size the buffer as if there are no ignored chars, it is truncated if found
     // rest is 1: can't build an 8-bit ascii char from a 6-bit Base64 char
-    rest = full % 4;
-    full -= rest;
-    if (!(full || rest) || rest == 1) {
+    unsigned int rest = len % 4;
+    unsigned int full = len - rest;
+    if (!len || (rest == 1 && !liberal)) {
 	Debug("Base64",DebugInfo,"Got invalid length %u [%p]",length(),this);
 	return false;
     }
-    dest.assign(0,full / 4 * 3 + (rest ? rest - 1 : 0));
+    unsigned int size = full / 4 * 3 + (rest ? rest - 1 : 0);
+    unsigned char* d = grow(dest,size);
+    unsigned char* start = d;
 
     DDebug("Base64",DebugAll,"Decoding %u bytes (full=%u rest=%u) to %u bytes",
 	length(),full,rest,dest.length());
 
-    unsigned int iDest = 0;
     unsigned char dec[4];
-    if (!liberal) {
-	#define GET_DEC(a) \
-	    if (valid(src[i+a])) \
-		dec[a] = s_ato64[src[i+a]]; \
-	    else { \
-		Debug("Base64",DebugInfo,"Got invalid char 0x%x at pos %u [%p]", \
-		    src[i+a],i+a,this); \
-		return false; \
-	    }
-	unsigned int i = 0;
-	// Decode each 4 bytes chunk from source
-	// Translate each byte and build 3 destination bytes from 4 6-bit Base64 chars
-	// 1: bits 0-5 from dec[0] + bits 4,5 from dec[1]
-	// 2: bits 0-3 from dec[1] + bits 2-5 from dec[2]
-	// 3: bits 0,1 from dec[2] + bits 0-5 from dec[3]
-	for (; i < full; i += 4) {
-	    GET_DEC(0)
-	    GET_DEC(1)
-	    GET_DEC(2)
-	    GET_DEC(3)
-	    addDec(dest,iDest,dec,4);
-	}
-	// Process the rest
-	// 2: 1 destination byte. 3: 2 bytes in destination
-	if (rest) {
-	    GET_DEC(0)
-	    GET_DEC(1)
-	    if (rest == 3) {
-		GET_DEC(2)
-	    }
-	}
-	#undef GET_DEC
+    unsigned int iDec = 0;
+    unsigned int pos = 0;
+    if (!decodeText(d,src,len,dec,iDec,liberal,pos)) {
+	Debug("Base64",DebugInfo,"Got invalid char 0x%x at pos %u [%p]",src[pos],pos,this);
+	dest.clear();
+	return false;
     }
-    else {
-	unsigned int iDec = 0;
-	for (unsigned int i = 0; i < length(); i++, src++) {
-	    int res = validLiberal(*src);
-	    if (!res) {
-		Debug("Base64",DebugInfo,"Got invalid char 0x%x at pos %u [%p]",*src,i,this);
-		return false;
-	    }
-	    if (res < 0)
-		continue;
-	    dec[iDec++] = s_ato64[*src];
-	    if (iDec == 4) {
-		addDec(dest,iDest,dec,4);
-		iDec = 0;
-	    }
-	}
+    if (iDec == 1 || (d == start && !iDec)) {
+	Debug("Base64",DebugInfo,"Got invalid length %u [%p]",length(),this);
+	dest.clear();
+	return false;
     }
-    if (addDec(dest,iDest,dec,rest))
+    bool ok = decodeRest(d,dec,iDec);
+    if ((unsigned int)(d - start) < size)
+	dest.truncate(d - start);
+    if (ok)
 	return true;
     Debug("Base64",DebugInfo,"Got garbage bits at end, probably truncated");
     return false;
 }
 
+// Encode a chunk of data, keep the bytes not making a full group
+void Base64::encodeChunk(String& dest, const void* buf, unsigned int len, bool final)
+{
+    const unsigned char* s = (const unsigned char*)buf;
+    if (!s)
+	len = 0;
+    // Complete the group kept from the previous chunk
+    unsigned char grp[3];
+    unsigned int n = length();
+    if (n)
+	::memcpy(grp,data(),n);
+    for (; n && n < 3 && len; len--)
+	grp[n++] = *s++;
+    unsigned int rest = len % 3;
+    unsigned int full = len - rest;
+    bool group = (n == 3);
+    if (!group && n) {
+	// Out of data before completing the kept group
+	rest = n;
+	s = grp;
+    }
+    else
+	s += full;
+    unsigned int out = (group ? 4 : 0) + full / 3 * 4 + ((final && rest) ? 4 : 0);
+    if (out) {
+	String tmp;
+	String& str = dest.null() ? dest : tmp;
+	str.assign(PADDING_CHAR,out);
+	char* d = (char*)str.c_str();
+	if (group) {
+	    encodeGroups(d,grp,3);
+	    d += 4;
+	}
+	encodeGroups(d,s - full,full);
+	if (final && rest)
+	    encodeRest(d + full / 3 * 4,s,rest);
+	if (&str != &dest)
+	    dest << tmp;
+    }
+    if (final || !rest)
+	clear();
+    else
+	assign((void*)s,rest);
+}
+
+// Decode a chunk of Base64 text, keep the chars not making a full group
+bool Base64::decodeChunk(DataBlock& dest, const void* buf, unsigned int len, bool final, bool liberal)
+{
+    const unsigned char* s = (const unsigned char*)buf;
+    if (!s)
+	len = 0;
+    // Restore the incomplete group and the padding state of the previous chunk
+    unsigned char dec[4];
+    unsigned int iDec = 0;
+    bool pad = false;
+    const unsigned char* kept = (const unsigned char*)data();
+    for (unsigned int i = 0; i < length(); i++) {
+	if (kept[i] == PADDING_CHAR)
+	    pad = true;
+	else
+	    dec[iDec++] = s_ato64[kept[i]];
+    }
+    clear();
+    if (!liberal && len) {
+	// Padding may be followed only by more padding
+	const unsigned char* p = (const unsigned char*)::memchr(s,PADDING_CHAR,len);
+	unsigned int n = p ? p - s : len;
+	bool ok = !(pad && n);
+	for (unsigned int i = n; ok && i < len; i++)
+	    ok = (s[i] == PADDING_CHAR);
+	if (!ok) {
+	    Debug("Base64",DebugInfo,"Got data after padding [%p]",this);
+	    return false;
+	}
+	pad = pad || (n < len);
+	len = n;
+    }
+    unsigned int old = dest.length();
+    unsigned int size = (iDec + len) / 4 * 3 + 2;
+    unsigned char* d = grow(dest,size);
+    unsigned char* start = d;
+    unsigned int pos = 0;
+    bool ok = decodeText(d,s,len,dec,iDec,liberal,pos);
+    if (!ok)
+	Debug("Base64",DebugInfo,"Got invalid char 0x%x at pos %u [%p]",s[pos],pos,this);
+    else if (final) {
+	if (iDec == 1) {
+	    Debug("Base64",DebugInfo,"Got invalid length [%p]",this);
+	    ok = false;
+	}
+	else if (!decodeRest(d,dec,iDec)) {
+	    Debug("Base64",DebugInfo,"Got garbage bits at end, probably truncated");
+	    ok = false;
+	}
+    }
+    else if (iDec || pad) {
+	// Keep the chars of the incomplete group for the next chunk
+	unsigned char* k = grow(*this,iDec + (pad ? 1 : 0));
+	for (unsigned int i = 0; i < iDec; i++)
+	    k[i] = s_alphabet[dec[i]];
+	if (pad)
+	    k[iDec] = PADDING_CHAR;
+    }
+    dest.truncate(old + (d - start));
+    return ok;
+}
+
+// Encode binary data to hexadecimal digits
+void Base64::hexEncode(char* dest, const void* src, unsigned int len, bool upCase)
+{
+    const char* hex = upCase ? "0123456789ABCDEF" : "0123456789abcdef";
+    const unsigned char* s = (const unsigned char*)src;
+#ifdef BASE64_SIMD
+    unsigned int n = 0;
+    if (s_simd >= SimdAvx2)
+	n = hexEncAvx2(dest,s,len,hex);
+    if (s_simd >= SimdSsse3)
+	n += hexEncSsse3(dest + 2 * n,s + n,len - n,hex);
+    dest += 2 * n;
+    s += n;
+    len -= n;
+#endif
+    for (; len; len--) {
+	unsigned char c = *s++;
+	*dest++ = hex[c >> 4];
+	*dest++ = hex[c & 0x0f];
+    }
+}
+
+// Decode hexadecimal digits to binary data
+unsigned int Base64::hexDecode(void* dest, const char* src, unsigned int len)
+{
+    unsigned char* d = (unsigned char*)dest;
+    len &= ~1u;
+    unsigned int n = 0;
+#ifdef BASE64_SIMD
+    if (s_simd >= SimdAvx2)
+	n = hexDecAvx2(d,src,len);
+    if (s_simd >= SimdSsse3)
+	n += hexDecSsse3(d + n / 2,src + n,len - n);
+#endif
+    for (; n < len; n += 2) {
+	int hi = hexNibble(src[n]);
+	int lo = hexNibble(src[n+1]);
+	if (hi < 0 || lo < 0)
+	    break;
+	d[n / 2] = (hi << 4) | lo;
+    }
+    return n / 2;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
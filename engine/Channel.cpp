@@ -482,7 +482,9 @@ void Channel::initChan()
 #endif
     m_driver->m_total++;
     m_driver->m_chanCount++;
+    WLock chanLock(m_driver->m_chanLock);
     m_driver->channels().append(this);
+    chanLock.drop();
     m_driver->changed();
 }
 
@@ -493,7 +495,10 @@ void Channel::dropChan()
     m_driver->lock();
     if (!m_driver)
 	Debug(DebugFail,"Driver lost in dropChan! [%p]",this);
-    if (m_driver->channels().remove(this,false)) {
+    m_driver->m_chanLock.writeLock();
+    bool removed = (0 != m_driver->channels().remove(this,false));
+    m_driver->m_chanLock.unlock();
+    if (removed) {
 	if (m_driver->m_chanCount > 0)
 	    m_driver->m_chanCount--;
 	m_driver->changed();
@@ -1363,7 +1368,7 @@ bool Module::filterDebug(const String& item) const
 
 Driver::Driver(const char* name, const char* type)
     : Module(name,type),
-      m_init(false), m_varchan(true),
+      m_init(false), m_varchan(true), m_chanLock("DriverChannels"),
       m_routing(0), m_routed(0), m_total(0),
       m_nextid(0), m_timeout(0),
       m_maxroute(0), m_maxchans(0), m_chanCount(0),
@@ -1501,9 +1506,9 @@ bool Driver::received(Message &msg, int id)
     if (!dest.startsWith(m_prefix))
 	return false;
 
-    lock();
+    RLock chanLock(m_chanLock);
     RefPointer<Channel> chan = find(dest);
-    unlock();
+    chanLock.drop();
     if (!chan) {
 	DDebug(this,DebugMild,"Could not find channel '%s'",dest.c_str());
 	return false;
@@ -19,6 +19,8 @@
 
 #include "yatengine.h"
 
+#include <string.h>
+
 using namespace TelEngine;
 
 // Compress the input buffer, flush all data,
@@ -99,4 +101,59 @@ int Compressor::decompress(const void* buf, unsigned int len, DataBlock& dest)
     return ret;
 }
 
+// Move as much pending output as fits in the destination buffer
+static int takePending(DataBlock& pending, void* dest, unsigned int destLen)
+{
+    unsigned int n = pending.length();
+    if (n > destLen)
+	n = destLen;
+    if (n) {
+	::memcpy(dest,pending.data(),n);
+	pending.cut(-(int)n);
+    }
+    return n;
+}
+
+// Compress into a caller buffer, keep what does not fit for next calls.
+// Implementations writing directly into the buffer should override it
+int Compressor::compressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen)
+{
+    if (!(dest && destLen)) {
+	len = 0;
+	return -1;
+    }
+    if (buf && len && !m_compPending.length()) {
+	int wr = compress(buf,len,m_compPending);
+	if (wr < 0) {
+	    len = 0;
+	    return wr;
+	}
+	len = wr;
+    }
+    else
+	len = 0;
+    return takePending(m_compPending,dest,destLen);
+}
+
+// Decompress into a caller buffer, keep what does not fit for next calls.
+// Implementations writing directly into the buffer should override it
+int Compressor::decompressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen)
+{
+    if (!(dest && destLen)) {
+	len = 0;
+	return -1;
+    }
+    if (buf && len && !m_decompPending.length()) {
+	int wr = decompress(buf,len,m_decompPending);
+	if (wr < 0) {
+	    len = 0;
+	    return wr;
+	}
+	len = wr;
+    }
+    else
+	len = 0;
+    return takePending(m_decompPending,dest,destLen);
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
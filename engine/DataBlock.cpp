@@ -400,11 +400,19 @@ bool DataBlock::unHexify(const char* data, unsigned int len, char sep)
 	return true;
 
     char* buf = (char*)::malloc(n);
+    if (!sep) {
+	bool ok = (Base64::hexDecode(buf,data,len) == n);
+	if (ok)
+	    assign(buf,n,false);
+	else
+	    ::free(buf);
+	return ok;
+    }
     unsigned int iBuf = 0;
-    for (unsigned int i = 0; i < len; i += (sep ? 3 : 2)) {
+    for (unsigned int i = 0; i < len; i += 3) {
 	signed char c1 = hexDecode(data[i]);
 	signed char c2 = hexDecode(data[i+1]);
-	if (c1 == -1 || c2 == -1 || (sep && (iBuf != n - 1) && (sep != data[i+2])))
+	if (c1 == -1 || c2 == -1 || ((iBuf != n - 1) && (sep != data[i+2])))
 	    break;
 	buf[iBuf++] = (c1 << 4) | c2;
     }
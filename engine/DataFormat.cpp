@@ -1198,10 +1198,12 @@ bool DataTranslator::synchronize(DataSource* source)
     return true;
 }
 
-Mutex DataTranslator::s_mutex(true,"DataTranslator");
+RWLock DataTranslator::s_mutex("DataTranslator");
 ObjList DataTranslator::s_factories;
 unsigned int DataTranslator::s_maxChain = 3;
 static ObjList s_compose;
+// Set while s_compose holds factories, written only with the write lock held
+static volatile bool s_composePending = false;
 static SimpleFactory s_sFactory(s_simpleCaps,"g711");
 static SimpleFactory s_sFactory16k(s_simpleCaps16k,"g711wb");
 static SimpleFactory s_sFactory32k(s_simpleCaps32k,"g711uwb");
@@ -1222,15 +1224,21 @@ void DataTranslator::install(TranslatorFactory* factory)
 {
     if (!factory)
 	return;
-    Lock lock(s_mutex);
+    WLock lock(s_mutex);
     if (s_factories.find(factory))
 	return;
     s_factories.append(factory)->setDelete(false);
     s_compose.append(factory)->setDelete(false);
+    s_composePending = true;
 }
 
 void DataTranslator::compose()
 {
+    // quick check without locking, factories are rarely installed
+    if (!s_composePending)
+	return;
+    WLock lock(s_mutex);
+    s_composePending = false;
     for (;;) {
 	TranslatorFactory* factory = static_cast<TranslatorFactory*>(s_compose.remove(false));
 	if (!factory)
@@ -1248,7 +1256,7 @@ void DataTranslator::compose(TranslatorFactory* factory)
 	caps ? caps->dest->name : "");
     if ((!caps) || (factory->length() >= s_maxChain))
 	return;
-    Lock lock(s_mutex);
+    WLock lock(s_mutex);
     // now see if we can build some conversion chains with this factory
     ListIterator iter(s_factories);
     while (TranslatorFactory* f2 = static_cast<TranslatorFactory*>(iter.get())) {
@@ -1327,7 +1335,7 @@ void DataTranslator::uninstall(TranslatorFactory* factory)
 {
     if (!factory)
 	return;
-    s_mutex.lock();
+    s_mutex.writeLock();
     s_compose.remove(factory,false);
     s_factories.remove(factory,false);
     // notify chained factories about the removal
@@ -1342,8 +1350,8 @@ ObjList* DataTranslator::srcFormats(const DataFormat& dFormat, int maxCost, unsi
     const FormatInfo* fi = dFormat.getInfo();
     if (!fi)
 	return lst;
-    s_mutex.lock();
     compose();
+    s_mutex.readLock();
     ObjList* l = s_factories.skipNull();
     for (; l; l=l->skipNext()) {
 	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
@@ -1371,8 +1379,8 @@ ObjList* DataTranslator::destFormats(const DataFormat& sFormat, int maxCost, uns
     const FormatInfo* fi = sFormat.getInfo();
     if (!fi)
 	return lst;
-    s_mutex.lock();
     compose();
+    s_mutex.readLock();
     ObjList* l = s_factories.skipNull();
     for (; l; l=l->skipNext()) {
 	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
@@ -1424,7 +1432,7 @@ ObjList* DataTranslator::allFormats(const ObjList* formats, bool existing, bool
     if (!formats)
 	return 0;
     ObjList* lst = 0;
-    s_mutex.lock();
+    // no lock held here, mergeOne() locks for reading in canConvert()
     compose();
     const ObjList* fmts;
     if (existing) {
@@ -1457,7 +1465,6 @@ ObjList* DataTranslator::allFormats(const ObjList* formats, bool existing, bool
 	for (flist* l = s_flist; l; l = l->next)
 	    mergeOne(lst,formats,fmto,l->info,sameRate,sameChans);
     }
-    s_mutex.unlock();
     return lst;
 }
 
@@ -1479,8 +1486,8 @@ bool DataTranslator::canConvert(const DataFormat& fmt1, const DataFormat& fmt2)
     const FormatInfo* fi2 = fmt2.getInfo();
     if (!(fi1 && fi2))
 	return false;
-    Lock lock(s_mutex);
     compose();
+    RLock lock(s_mutex);
     return canConvert(fi1,fi2);
 }
 
@@ -1512,8 +1519,8 @@ int DataTranslator::cost(const DataFormat& sFormat, const DataFormat& dFormat)
     const FormatInfo* dest = dFormat.getInfo();
     if (!(src && dest))
 	return c;
-    s_mutex.lock();
     compose();
+    s_mutex.readLock();
     ObjList* l = s_factories.skipNull();
     for (; l; l=l->skipNext()) {
 	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
@@ -1540,8 +1547,8 @@ DataTranslator* DataTranslator::create(const DataFormat& sFormat, const DataForm
     bool counting = getObjCounting();
     NamedCounter* saved = Thread::getCurrentObjCounter(counting);
 
-    s_mutex.lock();
     compose();
+    s_mutex.readLock();
     ObjList *l = s_factories.skipNull();
     for (; l; l=l->skipNext()) {
 	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
@@ -359,6 +359,7 @@ public:
     virtual bool received(Message &msg);
     static void objects(String& retVal, bool details);
     static int objects(String& str);
+    static void mutexes(String& retVal, bool details);
 };
 
 class EngineHelp : public MessageHandler
@@ -491,6 +492,32 @@ void EngineStatusHandler::objects(String& retVal, bool details)
     retVal << "\r\n";
 }
 
+void EngineStatusHandler::mutexes(String& retVal, bool details)
+{
+    ObjList stats;
+    unsigned int n = Lockable::profilingStats(stats);
+    retVal << "name=mutexes,type=system";
+    retVal << ",format=Type|Locks|Contended|Failed|Wait|MaxWait|Hold|MaxHold";
+    retVal << ";enabled=" << Lockable::profiling();
+    retVal << ",count=" << n;
+    if (details) {
+	char sep = ';';
+	for (ObjList* l = stats.skipNull(); l; l = l->skipNext()) {
+	    const NamedList* nl = static_cast<const NamedList*>(l->get());
+	    retVal << sep << *nl << "=" << nl->getValue(YSTRING("type"));
+	    retVal << "|" << nl->getValue(YSTRING("locks"));
+	    retVal << "|" << nl->getValue(YSTRING("contended"));
+	    retVal << "|" << nl->getValue(YSTRING("failed"));
+	    retVal << "|" << nl->getValue(YSTRING("wait"));
+	    retVal << "|" << nl->getValue(YSTRING("maxwait"));
+	    retVal << "|" << nl->getValue(YSTRING("hold"));
+	    retVal << "|" << nl->getValue(YSTRING("maxhold"));
+	    sep = ',';
+	}
+    }
+    retVal << "\r\n";
+}
+
 bool EngineStatusHandler::received(Message &msg)
 {
     bool details = msg.getBoolValue("details",true);
@@ -512,6 +539,10 @@ bool EngineStatusHandler::received(Message &msg)
 		objects(msg.retValue(),details);
 	    return true;
 	}
+	if (sel == YSTRING("mutexes")) {
+	    mutexes(msg.retValue(),details);
+	    return true;
+	}
 	return false;
     }
     msg.retValue() << "name=engine,type=system";
@@ -544,6 +575,18 @@ bool EngineStatusHandler::received(Message &msg)
     locks = Semaphore::locks();
     if (locks >= 0)
 	msg.retValue() << ",waiting=" << locks;
+    if (Lockable::profiling()) {
+	uint64_t contended = 0;
+	uint64_t wait = 0;
+	ObjList stats;
+	Lockable::profilingStats(stats);
+	for (ObjList* l = stats.skipNull(); l; l = l->skipNext()) {
+	    const NamedList* nl = static_cast<const NamedList*>(l->get());
+	    contended += nl->getInt64Value(YSTRING("contended"));
+	    wait += nl->getInt64Value(YSTRING("wait"));
+	}
+	msg.retValue() << ",lockcontended=" << contended << ",lockwait=" << wait;
+    }
     msg.retValue() << ",acceptcalls=" << lookup(Engine::accept(),Engine::getCallAcceptStates());
     msg.retValue() << ",congestion=" << Engine::getCongestion();
     if (details) {
@@ -612,6 +655,8 @@ static const char s_evtsOpt[] = "  events [clear] [type]\r\n";
 static const char s_evtsMsg[] = "Show or clear events or alarms collected since the engine startup\r\n";
 static const char s_logvOpt[] = "  logview\r\n";
 static const char s_logvMsg[] = "Show log of engine startup and initialization process\r\n";
+static const char s_mtxOpt[] = "  mutex {stats [count]|reset|profile [on|off]}\r\n";
+static const char s_mtxMsg[] = "Show or control lock contention statistics of named mutexes and semaphores\r\n";
 
 // get the base name of a module file
 static String moduleBase(const String& fname)
@@ -710,6 +755,61 @@ void completeModule(String& ret, const String& part, ObjList& mods, bool reload,
 #endif
 }
 
+// sort lock statistics by total wait time, highest first
+static int lockStatsCompare(const void* a, const void* b)
+{
+    u_int64_t wa = (*(const NamedList**)a)->getInt64Value(YSTRING("wait"));
+    u_int64_t wb = (*(const NamedList**)b)->getInt64Value(YSTRING("wait"));
+    if (wa == wb)
+	return 0;
+    return (wa > wb) ? -1 : 1;
+}
+
+// handle the lock profiling commands
+static bool mutexCommand(String& retVal, String& line)
+{
+    if (line.startSkip("profile")) {
+	if (line)
+	    Lockable::enableProfiling(line.toBoolean(Lockable::profiling()));
+	retVal << "Lock profiling is " << (Lockable::profiling() ? "enabled" : "disabled") << "\r\n";
+	return true;
+    }
+    if (line == YSTRING("reset")) {
+	Lockable::resetProfiling();
+	retVal << "Lock profiling statistics cleared\r\n";
+	return true;
+    }
+    if (!(line.startSkip("stats") || line.null()))
+	return false;
+    int max = line.toInteger(0);
+    ObjList stats;
+    unsigned int n = Lockable::profilingStats(stats);
+    retVal << "Lock profiling: " << (Lockable::profiling() ? "enabled" : "disabled");
+    retVal << ", names: " << n << "\r\n";
+    if (!n)
+	return true;
+    const NamedList** arr = new const NamedList*[n];
+    n = 0;
+    for (ObjList* l = stats.skipNull(); l; l = l->skipNext())
+	arr[n++] = static_cast<const NamedList*>(l->get());
+    ::qsort(arr,n,sizeof(const NamedList*),lockStatsCompare);
+    if (max > 0 && (unsigned int)max < n)
+	n = max;
+    retVal << "Name                             Type      Locks       Contended   Failed   Wait(us)      MaxWait    Hold(us)      MaxHold\r\n";
+    for (unsigned int i = 0; i < n; i++) {
+	const NamedList& s = *arr[i];
+	String tmp;
+	tmp.printf(256,"%-32s %-9s %-11s %-11s %-8s %-13s %-10s %-13s %s\r\n",
+	    s.c_str(),s.getValue(YSTRING("type")),s.getValue(YSTRING("locks")),
+	    s.getValue(YSTRING("contended")),s.getValue(YSTRING("failed")),
+	    s.getValue(YSTRING("wait")),s.getValue(YSTRING("maxwait")),
+	    s.getValue(YSTRING("hold"),"-"),s.getValue(YSTRING("maxhold"),"-"));
+	retVal << tmp;
+    }
+    delete[] arr;
+    return true;
+}
+
 // perform command line completion
 void EngineCommand::doCompletion(Message &msg, const String& partLine, const String& partWord)
 {
@@ -717,10 +817,21 @@ void EngineCommand::doCompletion(Message &msg, const String& partLine, const Str
 	completeOne(msg.retValue(),"module",partWord);
 	completeOne(msg.retValue(),"events",partWord);
 	completeOne(msg.retValue(),"logview",partWord);
+	completeOne(msg.retValue(),"mutex",partWord);
     }
     else if (partLine == YSTRING("status")) {
 	completeOne(msg.retValue(),"engine",partWord);
 	completeOne(msg.retValue(),"objects",partWord);
+	completeOne(msg.retValue(),"mutexes",partWord);
+    }
+    else if (partLine == YSTRING("mutex")) {
+	completeOne(msg.retValue(),"stats",partWord);
+	completeOne(msg.retValue(),"reset",partWord);
+	completeOne(msg.retValue(),"profile",partWord);
+    }
+    else if (partLine == YSTRING("mutex profile")) {
+	completeOne(msg.retValue(),"on",partWord);
+	completeOne(msg.retValue(),"off",partWord);
     }
     else if (partLine == YSTRING("status objects")) {
 	for (ObjList* l = getObjCounters().skipNull();l;l = l->skipNext())
@@ -818,6 +929,8 @@ bool EngineCommand::received(Message &msg)
 	    (msg.retValue() = "Events: ") << cnt << "\r\n";
 	    return true;
 	}
+	if (line.startSkip("mutex"))
+	    return mutexCommand(msg.retValue(),line);
 	return false;
     }
 
@@ -885,7 +998,7 @@ bool EngineHelp::received(Message &msg)
     const char* opts = (s_nounload ? s_cmdsOptNoUnload : s_cmdsOpt);
     String line = msg.getValue("line");
     if (line.null()) {
-	msg.retValue() << opts << s_evtsOpt << s_logvOpt;
+	msg.retValue() << opts << s_evtsOpt << s_logvOpt << s_mtxOpt;
 	return false;
     }
     if (line == YSTRING("module"))
@@ -894,6 +1007,8 @@ bool EngineHelp::received(Message &msg)
 	msg.retValue() << s_evtsOpt << s_evtsMsg;
     else if (line == YSTRING("logview"))
 	msg.retValue() << s_logvOpt << s_logvMsg;
+    else if (line == YSTRING("mutex"))
+	msg.retValue() << s_mtxOpt << s_mtxMsg;
     else
 	return false;
     return true;
@@ -1337,9 +1452,8 @@ bool SLib::unload(bool unloadNow)
 
 void SharedVars::get(const String& name, String& rval)
 {
-    lock();
+    RLock mylock(this);
     rval = m_vars.getValue(name,rval);
-    unlock();
 }
 
 void SharedVars::set(const String& name, const char* val)
@@ -1351,7 +1465,7 @@ void SharedVars::set(const String& name, const char* val)
 
 bool SharedVars::create(const String& name, const char* val)
 {
-    Lock mylock(this);
+    WLock mylock(this);
     if (m_vars.getParam(name))
 	return false;
     m_vars.addParam(name,val);
@@ -1367,13 +1481,13 @@ void SharedVars::clear(const String& name)
 
 bool SharedVars::exists(const String& name)
 {
-    Lock mylock(this);
+    RLock mylock(this);
     return m_vars.getParam(name) != 0;
 }
 
 unsigned int SharedVars::inc(const String& name, unsigned int wrap)
 {
-    Lock mylock(this);
+    WLock mylock(this);
     unsigned int val = m_vars.getIntValue(name);
     if (wrap)
 	val = val % (wrap + 1);
@@ -1386,7 +1500,7 @@ unsigned int SharedVars::inc(const String& name, unsigned int wrap)
 
 unsigned int SharedVars::dec(const String& name, unsigned int wrap)
 {
-    Lock mylock(this);
+    WLock mylock(this);
     unsigned int val = m_vars.getIntValue(name);
     if (wrap)
 	val = val ? ((val - 1) % (wrap + 1)) : wrap;
@@ -1492,6 +1606,8 @@ int Engine::engineInit()
     s_maxmsgage = s_cfg.getIntValue("general","maxmsgage",s_maxmsgage,0,5000);
     s_maxqueued = s_cfg.getIntValue("general","maxqueued",s_maxqueued,0,10000);
     s_maxevents = s_cfg.getIntValue("general","maxevents",s_maxevents,0,1000);
+    if (s_cfg.getBoolValue("general","lockprofile"))
+	Lockable::enableProfiling();
     s_restarts = s_cfg.getIntValue("general","restarts");
     m_dispatcher.warnTime(1000*(u_int64_t)s_cfg.getIntValue("general","warntime"));
     extraPath(clientMode() ? "client" : "server");
@@ -2304,6 +2420,7 @@ void Engine::initLibrary(const String& line, String* output)
 			    ENGINE_SET_VAL_BREAK('s',s_lateabrt,true);
 			    ENGINE_INSTR_BREAK('m',setLockableWait());
 			    ENGINE_INSTR_BREAK('d',Lockable::enableSafety());
+			    ENGINE_INSTR_BREAK('p',Lockable::enableProfiling());
 			    default:
 				unkArgs.append("-D" + String(*pc)," ");
 			}
@@ -2393,6 +2510,7 @@ static void usage(bool client, FILE* f)
 "     a            Abort if bugs are encountered\n"
 "     m            Attempt to debug mutex deadlocks\n"
 "     d            Enable locking debugging and safety features\n"
+"     p            Enable lock contention profiling\n"
 #ifdef RTLD_GLOBAL
 "     l            Try to keep module symbols local\n"
 #endif
@@ -2637,6 +2755,9 @@ int Engine::main(int argc, const char** argv, const char** env, RunMode mode, En
 				case 'd':
 				    Lockable::enableSafety();
 				    break;
+				case 'p':
+				    Lockable::enableProfiling();
+				    break;
 #ifdef RTLD_GLOBAL
 				case 'l':
 				    s_localsymbol = true;
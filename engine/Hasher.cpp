@@ -22,8 +22,37 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
 using namespace TelEngine;
 
+// Check the CPU for the SHA extensions and the SSE4.1 instructions used with them
+static bool cpuShaExtensions()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    if (__get_cpuid_max(0,0) < 7)
+	return false;
+    __cpuid(1,a,b,c,d);
+    if (!(c & (1 << 19)))
+	return false;
+    __cpuid_count(7,0,a,b,c,d);
+    return 0 != (b & (1 << 29));
+#else
+    return false;
+#endif
+}
+
+bool Hasher::s_shaExtensions = cpuShaExtensions();
+
+bool Hasher::shaExtensions(bool enable)
+{
+    s_shaExtensions = enable && cpuShaExtensions();
+    return s_shaExtensions;
+}
+
 Hasher::~Hasher()
 {
 }
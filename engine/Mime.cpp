@@ -20,8 +20,62 @@
 #include <stdlib.h>
 #include "yatemime.h"
 
+namespace TelEngine {
+
+// Block of MIME data shared by the bodies built from it
+class MimeData : public RefObject
+{
+public:
+    inline MimeData(const char* buf, int len)
+	: m_data((void*)buf,len)
+	{ }
+    inline const char* data() const
+	{ return (const char*)m_data.data(); }
+private:
+    DataBlock m_data;
+};
+
+}; // namespace TelEngine
+
 using namespace TelEngine;
 
+#ifdef _WINDOWS
+#define MIME_BARRIER() MemoryBarrier()
+#define MIME_CAS(var,old,val) (::InterlockedCompareExchange((LONG volatile*)&(var),(LONG)(val),(LONG)(old)) == (LONG)(old))
+#else
+#define MIME_BARRIER() __sync_synchronize()
+#define MIME_CAS(var,old,val) __sync_bool_compare_and_swap(&(var),(old),(val))
+#endif
+
+// States of the parameters text of a header line
+enum {
+    ParamsParsed = 0,
+    ParamsText,
+    ParamsBusy
+};
+
+// Kinds of bodies built from data
+enum {
+    BodyBinary,
+    BodySdp,
+    BodyLines,
+    BodyString,
+    BodyMultipart
+};
+
+// Claim the parameters text of a header line, wait while another thread uses it
+// Return false if the parameters were parsed meanwhile
+static bool claimParams(volatile int& state)
+{
+    for (;;) {
+	if (MIME_CAS(state,ParamsText,ParamsBusy))
+	    return true;
+	if (state == ParamsParsed)
+	    return false;
+	Thread::yield();
+    }
+}
+
 // Utility function, checks if a character is a folded line continuation
 static bool isContinuationBlank(char c)
 {
@@ -32,7 +86,7 @@ static bool isContinuationBlank(char c)
  * MimeHeaderLine
  */
 MimeHeaderLine::MimeHeaderLine(const char* name, const String& value, char sep)
-    : NamedString(name), m_separator(sep ? sep : ';')
+    : NamedString(name), m_separator(sep ? sep : ';'), m_lazy(ParamsParsed)
 {
     if (value.null())
 	return;
@@ -44,6 +98,45 @@ MimeHeaderLine::MimeHeaderLine(const char* name, const String& value, char sep)
     }
     assign(value,sp);
     trimBlanks();
+    // Most parameters are never looked at, split them when first needed
+    m_rawParams.assign(value.c_str() + sp,value.length() - sp);
+    m_lazy = ParamsText;
+}
+
+MimeHeaderLine::MimeHeaderLine(const MimeHeaderLine& original, const char* newName)
+    : NamedString(newName ? newName : original.name().c_str(),original),
+      m_separator(original.separator()), m_lazy(ParamsParsed)
+{
+    XDebug(DebugAll,"MimeHeaderLine::MimeHeaderLine(%p '%s') [%p]",&original,name().c_str(),this);
+    if (original.m_lazy && claimParams(original.m_lazy)) {
+	// copy the text if still not parsed, the list is empty until then
+	m_rawParams = original.m_rawParams;
+	m_lazy = ParamsText;
+	MIME_BARRIER();
+	original.m_lazy = ParamsText;
+	return;
+    }
+    const ObjList* l = &original.m_params;
+    for (; l; l = l->next()) {
+	const NamedString* t = static_cast<const NamedString*>(l->get());
+	if (t)
+	    m_params.append(new NamedString(t->name(),*t));
+    }
+}
+
+MimeHeaderLine::~MimeHeaderLine()
+{
+    XDebug(DebugAll,"MimeHeaderLine::~MimeHeaderLine() [%p]",this);
+}
+
+// Split the parameters text once, it starts with a separator
+// Other threads using the same header line wait for it
+void MimeHeaderLine::parseParams() const
+{
+    if (!claimParams(m_lazy))
+	return;
+    const String& value = m_rawParams;
+    int sp = 0;
     while (sp < (int)value.length()) {
 	int ep = findSep(value,m_separator,sp+1);
 	if (ep <= sp)
@@ -69,24 +162,10 @@ MimeHeaderLine::MimeHeaderLine(const char* name, const String& value, char sep)
 	}
 	sp = ep;
     }
-}
-
-MimeHeaderLine::MimeHeaderLine(const MimeHeaderLine& original, const char* newName)
-    : NamedString(newName ? newName : original.name().c_str(),original),
-      m_separator(original.separator())
-{
-    XDebug(DebugAll,"MimeHeaderLine::MimeHeaderLine(%p '%s') [%p]",&original,name().c_str(),this);
-    const ObjList* l = &original.params();
-    for (; l; l = l->next()) {
-	const NamedString* t = static_cast<const NamedString*>(l->get());
-	if (t)
-	    m_params.append(new NamedString(t->name(),*t));
-    }
-}
-
-MimeHeaderLine::~MimeHeaderLine()
-{
-    XDebug(DebugAll,"MimeHeaderLine::~MimeHeaderLine() [%p]",this);
+    m_rawParams.clear();
+    // readers not waiting must see the complete list before the flag
+    MIME_BARRIER();
+    m_lazy = ParamsParsed;
 }
 
 void* MimeHeaderLine::getObject(const String& name) const
@@ -106,7 +185,7 @@ void MimeHeaderLine::buildLine(String& line, bool header) const
     if (header)
 	line << name() << ": ";
     line << *this;
-    const ObjList* p = &m_params;
+    const ObjList* p = &params();
     for (; p; p = p->next()) {
 	NamedString* s = static_cast<NamedString*>(p->get());
 	if (s) {
@@ -121,7 +200,7 @@ const NamedString* MimeHeaderLine::getParam(const char* name) const
 {
     if (!(name && *name))
 	return 0;
-    const ObjList* l = &m_params;
+    const ObjList* l = &params();
     for (; l; l = l->next()) {
 	const NamedString* t = static_cast<const NamedString*>(l->get());
 	if (t && (t->name() &= name))
@@ -132,6 +211,7 @@ const NamedString* MimeHeaderLine::getParam(const char* name) const
 
 void MimeHeaderLine::setParam(const char* name, const char* value)
 {
+    params();
     ObjList* p = m_params.find(name);
     if (p)
 	*static_cast<NamedString*>(p->get()) = value;
@@ -141,6 +221,7 @@ void MimeHeaderLine::setParam(const char* name, const char* value)
 
 void MimeHeaderLine::delParam(const char* name)
 {
+    params();
     ObjList* p = m_params.find(name);
     if (p)
 	p->remove();
@@ -330,7 +411,7 @@ void MimeAuthLine::buildLine(String& line, bool header) const
     if (header)
 	line << name() << ": ";
     line << *this;
-    const ObjList* p = &m_params;
+    const ObjList* p = &params();
     for (bool first = true; p; p = p->next()) {
 	NamedString* s = static_cast<NamedString*>(p->get());
 	if (s) {
@@ -352,7 +433,8 @@ void MimeAuthLine::buildLine(String& line, bool header) const
 YCLASSIMP(MimeBody,GenObject)
 
 MimeBody::MimeBody(const String& type)
-    : m_type("Content-Type",type)
+    : m_type("Content-Type",type),
+      m_raw(0), m_rawBuf(0), m_rawLen(0), m_rawLock(0), m_parsing(false)
 {
     m_type.toLower();
     DDebug(DebugAll,"MimeBody::MimeBody('%s') [%p]",m_type.c_str(),this);
@@ -361,7 +443,8 @@ MimeBody::MimeBody(const String& type)
 // Build from header line
 // Make sure the name of the header line is correct
 MimeBody::MimeBody(const MimeHeaderLine& type)
-    : m_type(type,"Content-Type")
+    : m_type(type,"Content-Type"),
+      m_raw(0), m_rawBuf(0), m_rawLen(0), m_rawLock(0), m_parsing(false)
 {
     m_type.toLower();
     DDebug(DebugAll,"MimeBody::MimeBody('%s','%s') [%p]",
@@ -371,6 +454,8 @@ MimeBody::MimeBody(const MimeHeaderLine& type)
 MimeBody::~MimeBody()
 {
     DDebug(DebugAll,"MimeBody::~MimeBody() '%s' [%p]",m_type.c_str(),this);
+    TelEngine::destruct(m_raw);
+    delete m_rawLock;
 }
 
 // Find the first (sub)body matching the given type
@@ -432,38 +517,135 @@ const NamedString* MimeBody::getParam(const char* name, const char* header) cons
 
 const DataBlock& MimeBody::getBody() const
 {
-    if (m_body.null())
+    if (m_body.null()) {
+	checkContent();
 	buildBody();
+    }
     return m_body;
 }
 
-// Method to build a MIME body from a type and data buffer
-MimeBody* MimeBody::build(const char* buf, int len, const MimeHeaderLine& type)
+void MimeBody::parseContent(const char* buf, int len)
+{
+}
+
+// Parse the kept data once, other threads using the same body wait for it
+// Accessors called while parsing in the same thread must not recurse
+void MimeBody::parseRaw() const
+{
+    // the lock is created before the data is set and lives as long as the body
+    Lock lock(m_rawLock);
+    if (m_parsing || !m_raw)
+	return;
+    XDebug(DebugAll,"MimeBody::parseRaw() '%s' %d bytes [%p]",m_type.c_str(),m_rawLen,this);
+    m_parsing = true;
+    const_cast<MimeBody*>(this)->parseContent(m_rawBuf,m_rawLen);
+    m_parsing = false;
+    MimeData* data = m_raw;
+    // readers not locking must see the complete content before the view is released
+    MIME_BARRIER();
+    m_raw = 0;
+    m_rawBuf = 0;
+    m_rawLen = 0;
+    lock.drop();
+    TelEngine::destruct(data);
+}
+
+// Keep a view into shared data to be parsed on first access
+void MimeBody::setContent(MimeData* data, const char* buf, int len)
+{
+    if (!(data && data->ref()))
+	return;
+    TelEngine::destruct(m_raw);
+    if (!m_rawLock)
+	m_rawLock = new Mutex(true,"MimeBody");
+    MIME_BARRIER();
+    m_raw = data;
+    m_rawBuf = buf;
+    m_rawLen = len;
+}
+
+bool MimeBody::shareContent(const MimeBody& original)
+{
+    if (!original.m_raw)
+	return false;
+    // the original may be parsed by another thread right now
+    Lock lock(original.m_rawLock);
+    if (!original.m_raw)
+	return false;
+    setContent(original.m_raw,original.m_rawBuf,original.m_rawLen);
+    return true;
+}
+
+// Find the kind of body to build for a content type
+// Remove exactly 1 leading CRLF from the data of types not parsing it
+static int bodyKind(const MimeHeaderLine& type, const char*& buf, int& len)
 {
-    DDebug(DebugAll,"MimeBody::build(%p,%d,'%s')",buf,len,type.c_str());
-    if ((len <= 0) || !buf)
-	return 0;
     String what = type;
     what.toLower();
     if (what == YSTRING("application/sdp"))
-	return new MimeSdpBody(type,buf,len);
+	return BodySdp;
     if ((what == YSTRING("application/dtmf-relay")) || (what == YSTRING("message/sipfrag")))
-	return new MimeLinesBody(type,buf,len);
+	return BodyLines;
     if (what.startsWith("text/") || (what == YSTRING("application/dtmf")))
-	return new MimeStringBody(type,buf,len);
+	return BodyString;
     if (what.startsWith("multipart/"))
-	return new MimeMultipartBody(type,buf,len);
+	return BodyMultipart;
     // Remove any spurious leading CRLF
     if (len >= 2 && buf[0] == '\r' && buf[1] == '\n') {
 	len -= 2;
-	if (!len)
-	    return 0;
 	buf += 2;
     }
     if ((what.length() >=7) && what.endsWith("+xml"))
-	return new MimeStringBody(type,buf,len);
-    // Create a default binary body
-    return new MimeBinaryBody(type,buf,len);
+	return BodyString;
+    return BodyBinary;
+}
+
+// Method to build a MIME body from a type and data buffer
+MimeBody* MimeBody::build(const char* buf, int len, const MimeHeaderLine& type)
+{
+    DDebug(DebugAll,"MimeBody::build(%p,%d,'%s')",buf,len,type.c_str());
+    if ((len <= 0) || !buf)
+	return 0;
+    // Binary bodies hold a copy of their data anyway
+    const char* b = buf;
+    int l = len;
+    if (bodyKind(type,b,l) == BodyBinary)
+	return l ? new MimeBinaryBody(type,b,l) : 0;
+    MimeData* data = new MimeData(buf,len);
+    MimeBody* body = build(data,data->data(),len,type);
+    TelEngine::destruct(data);
+    return body;
+}
+
+// Build a body keeping a view into shared data
+MimeBody* MimeBody::build(MimeData* data, const char* buf, int len, const MimeHeaderLine& type)
+{
+    if ((len <= 0) || !buf)
+	return 0;
+    MimeBody* body = 0;
+    switch (bodyKind(type,buf,len)) {
+	case BodySdp:
+	    body = new MimeSdpBody(type,0,0);
+	    break;
+	case BodyLines:
+	    body = new MimeLinesBody(type,0,0);
+	    break;
+	case BodyString:
+	    if (!len)
+		return 0;
+	    body = new MimeStringBody(type,0,0);
+	    break;
+	case BodyMultipart:
+	    {
+		MimeMultipartBody* multi = new MimeMultipartBody(type,0,0);
+		multi->parse(data,buf,len);
+		return multi;
+	    }
+	default:
+	    return len ? new MimeBinaryBody(type,buf,len) : 0;
+    }
+    body->setContent(data,buf,len);
+    return body;
 }
 
 String* MimeBody::getUnfoldedLine(const char*& buf, int& len)
@@ -699,6 +881,17 @@ static void finalizeBoundary(const char*& buf, int& len, bool& last, const char*
 // Parse a data buffer and append any valid body to this multipart
 // Ignore prolog, epilog and invalid bodies
 void MimeMultipartBody::parse(const char* buf, int len)
+{
+    if (!(buf && len > 0))
+	return;
+    // Keep one copy of the data, enclosed bodies hold views into it
+    MimeData* data = new MimeData(buf,len);
+    parse(data,data->data(),len);
+    TelEngine::destruct(data);
+}
+
+// Split shared data in enclosed bodies
+void MimeMultipartBody::parse(MimeData* data, const char* buf, int len)
 {
     DDebug(DebugAll,"MimeMultipartBody::parse(%p,%d,'%s') [%p]",
 	buf,len,getType().c_str(),this);
@@ -782,7 +975,7 @@ void MimeMultipartBody::parse(const char* buf, int len)
 	}
 	// 'start' is now pointing to the enclosed body's content
 	// Append body to list and move extra headers to it
-	MimeBody* body = cType ? MimeBody::build(start,l,*cType) : 0;
+	MimeBody* body = cType ? MimeBody::build(data,start,l,*cType) : 0;
 	if (!body) {
 	    DDebug(DebugNote,
 		"Failed to build enclosed body (length=%d)%s [%p]",
@@ -909,6 +1102,9 @@ MimeSdpBody::MimeSdpBody(const MimeSdpBody& original)
     : MimeBody(original.getType()),
       m_lineAppend(&m_lines), m_hash(original.m_hash), m_hashing(false)
 {
+    // Lines not parsed yet are shared with the original
+    if (shareContent(original))
+	return;
     const ObjList* l = &original.m_lines;
     for (; l; l = l->next()) {
     	const NamedString* t = static_cast<NamedString*>(l->get());
@@ -945,7 +1141,7 @@ const NamedString* MimeSdpBody::getLine(const char* name) const
 {
     if (!(name && *name))
 	return 0;
-    const ObjList* l = &m_lines;
+    const ObjList* l = &lines();
     for (; l; l = l->next()) {
     	const NamedString* t = static_cast<NamedString*>(l->get());
         if (t && (t->name() &= name))
@@ -958,7 +1154,7 @@ const NamedString* MimeSdpBody::getNextLine(const NamedString* line) const
 {
     if (!line)
 	return 0;
-    const ObjList* l = m_lines.find(line);
+    const ObjList* l = lines().find(line);
     if (!l)
 	return 0;
     l = l->next();
@@ -972,6 +1168,7 @@ const NamedString* MimeSdpBody::getNextLine(const NamedString* line) const
 
 NamedString* MimeSdpBody::addLine(const char* name, const char* value)
 {
+    checkContent();
     if (m_hashing)
 	m_hash = String::hash(value,String::hash(name,m_hash));
     NamedString* line = new NamedString(name,value);
@@ -979,6 +1176,11 @@ NamedString* MimeSdpBody::addLine(const char* name, const char* value)
     return line;
 }
 
+void MimeSdpBody::parseContent(const char* buf, int len)
+{
+    buildLines(buf,len);
+}
+
 // Build the lines from a data buffer
 void MimeSdpBody::buildLines(const char* buf, int len)
 {
@@ -1047,8 +1249,10 @@ MimeStringBody::MimeStringBody(const MimeHeaderLine& type, const char* buf, int
 }
 
 MimeStringBody::MimeStringBody(const MimeStringBody& original)
-    : MimeBody(original.getType()), m_text(original.m_text)
+    : MimeBody(original.getType())
 {
+    if (!shareContent(original))
+	m_text = original.m_text;
 }
 
 MimeStringBody::~MimeStringBody()
@@ -1061,6 +1265,11 @@ void MimeStringBody::buildBody() const
     m_body.assign((void*)m_text.c_str(),m_text.length());
 }
 
+void MimeStringBody::parseContent(const char* buf, int len)
+{
+    m_text.assign(buf,len);
+}
+
 MimeBody* MimeStringBody::clone() const
 {
     return new MimeStringBody(*this);
@@ -1089,6 +1298,8 @@ MimeLinesBody::MimeLinesBody(const MimeHeaderLine& type, const char* buf, int le
 MimeLinesBody::MimeLinesBody(const MimeLinesBody& original)
     : MimeBody(original.getType())
 {
+    if (shareContent(original))
+	return;
     const ObjList* l = &original.m_lines;
     for (; l; l = l->next()) {
     	const String* s = static_cast<String*>(l->get());
@@ -1120,4 +1331,10 @@ MimeBody* MimeLinesBody::clone() const
     return new MimeLinesBody(*this);
 }
 
+void MimeLinesBody::parseContent(const char* buf, int len)
+{
+    while (len > 0)
+	m_lines.append(getUnfoldedLine(buf,len));
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
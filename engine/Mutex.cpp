@@ -19,10 +19,16 @@
 
 #include "yateclass.h"
 
+#include <string.h>
+#include <stdlib.h>
+
 #ifdef _WINDOWS
 
 typedef HANDLE HMUTEX;
 typedef HANDLE HSEMAPHORE;
+typedef CRITICAL_SECTION HRWMUTEX;
+typedef CONDITION_VARIABLE HCOND;
+typedef DWORD HTHREADID;
 
 #else
 
@@ -43,6 +49,9 @@ extern int pthread_mutexattr_settype(pthread_mutexattr_t *__attr, int __kind) __
 
 typedef pthread_mutex_t HMUTEX;
 typedef sem_t HSEMAPHORE;
+typedef pthread_mutex_t HRWMUTEX;
+typedef pthread_cond_t HCOND;
+typedef pthread_t HTHREADID;
 
 #endif /* ! _WINDOWS */
 
@@ -53,8 +62,71 @@ typedef sem_t HSEMAPHORE;
 #define MUTEX_STATIC_UNSAFE false
 #endif
 
+// Maximum number of distinct lockable names tracked by the profiler
+#define PROF_PAGE_SIZE 64
+#define PROF_PAGES 32
+#define PROF_SLOTS (PROF_PAGE_SIZE * PROF_PAGES)
+
+// Read lock owners kept in the lock itself before allocating a list
+#define RW_INLINE_READERS 4
+
+// Counters may be updated by several threads at once (foreign threads share a block)
+#ifdef _WINDOWS
+#define PROF_ADD(var,val) ::InterlockedExchangeAdd64((LONGLONG volatile*)&(var),(LONGLONG)(val))
+#define PROF_CAS(var,old,val) (::InterlockedCompareExchange64((LONGLONG volatile*)&(var),(LONGLONG)(val),(LONGLONG)(old)) == (LONGLONG)(old))
+#define PROF_CAS_PTR(var,old,val) (::InterlockedCompareExchangePointer((PVOID volatile*)&(var),(val),(old)) == (old))
+#else
+#define PROF_ADD(var,val) __sync_fetch_and_add(&(var),(val))
+#define PROF_CAS(var,old,val) __sync_bool_compare_and_swap(&(var),(old),(val))
+#define PROF_CAS_PTR(var,old,val) __sync_bool_compare_and_swap(&(var),(old),(val))
+#endif
+
 namespace TelEngine {
 
+// Lock profiling counters for one lockable name
+struct LockCounters {
+    volatile u_int64_t locks;
+    volatile u_int64_t contended;
+    volatile u_int64_t failed;
+    volatile u_int64_t waitTotal;
+    volatile u_int64_t waitMax;
+    volatile u_int64_t holdTotal;
+    volatile u_int64_t holdMax;
+};
+
+// Per thread block of lock profiling counters, indexed by name slot
+// Blocks are never freed, they are recycled when their thread terminates
+class LockProfile {
+public:
+    enum Type {
+	ProfMutex = 0,
+	ProfSemaphore,
+	ProfRWLock,
+    };
+    LockProfile();
+    LockCounters* counters(int slot);
+    void add(LockCounters* dest, int count) const;
+    void reset();
+    static LockCounters* current(Thread* thr, int slot);
+    static void release(Thread* thr);
+    static void collect(LockCounters* dest, int count);
+    static void resetAll();
+    static int slot(const char* name, int type);
+    static void wait(LockCounters* c, u_int64_t usec);
+    static void hold(LockCounters* c, u_int64_t usec);
+    static void setMax(volatile u_int64_t& var, u_int64_t usec);
+    static LockProfile* s_first;
+    static LockProfile s_foreign;
+    static const char* s_names[PROF_SLOTS];
+    static unsigned char s_type[PROF_SLOTS];
+    static int s_hash[2 * PROF_SLOTS];
+    static int s_count;
+private:
+    LockCounters* volatile m_pages[PROF_PAGES];
+    LockProfile* m_next;
+    bool m_inUse;
+};
+
 class MutexPrivate {
 public:
     MutexPrivate(bool recursive, const char* name);
@@ -76,6 +148,7 @@ public:
     static volatile int s_count;
     static volatile int s_locks;
 private:
+    bool acquire(long maxwait, bool warn);
     HMUTEX m_mutex;
     int m_refcount;
     volatile unsigned int m_locked;
@@ -83,6 +156,8 @@ private:
     bool m_recursive;
     const char* m_name;
     const char* m_owner;
+    int m_profSlot;
+    u_int64_t m_lockTime;
 };
 
 class SemaphorePrivate {
@@ -102,11 +177,58 @@ public:
     static volatile int s_count;
     static volatile int s_locks;
 private:
+    bool acquire(long maxwait, bool warn);
     HSEMAPHORE m_semaphore;
     int m_refcount;
     volatile unsigned int m_waiting;
     unsigned int m_maxcount;
     const char* m_name;
+    int m_profSlot;
+};
+
+class RWLockPrivate {
+public:
+    RWLockPrivate(const char* name);
+    ~RWLockPrivate();
+    inline void ref()
+	{ ++m_refcount; }
+    inline void deref()
+	{ if (!--m_refcount) delete this; }
+    inline const char* name() const
+	{ return m_name; }
+    bool locked() const
+	{ return m_readers || m_writers; }
+    bool writeLocked() const
+	{ return m_writers > 0; }
+    bool lock(long maxwait, bool write);
+    bool unlock();
+    static volatile int s_count;
+private:
+    bool isWriter() const;
+    int findReader(HTHREADID id) const;
+    void addReader(HTHREADID id, int idx);
+    void delReader(int idx);
+    bool waitCond(HCOND& cond, u_int64_t until);
+    HRWMUTEX m_mutex;
+    HCOND m_readCond;
+    HCOND m_writeCond;
+    HTHREADID m_writer;
+    int m_refcount;
+    volatile unsigned int m_readers;
+    volatile unsigned int m_writers;
+    volatile unsigned int m_waitingWriters;
+    const char* m_name;
+    int m_profSlot;
+    u_int64_t m_lockTime;
+    // threads holding read locks and how many times each, lets nested readers bypass waiting writers
+    struct Reader {
+	HTHREADID id;
+	unsigned int count;
+    };
+    Reader m_inlineReaders[RW_INLINE_READERS];
+    Reader* m_readerList;
+    unsigned int m_readerCount;
+    unsigned int m_readerAlloc;
 };
 
 class GlobalMutex {
@@ -129,12 +251,27 @@ static GlobalMutex s_global;
 static unsigned long s_maxwait = 0;
 static bool s_unsafe = MUTEX_STATIC_UNSAFE;
 static bool s_safety = false;
+static bool s_profiling = false;
+
+static const TokenDict s_profTypes[] = {
+    { "mutex", LockProfile::ProfMutex },
+    { "semaphore", LockProfile::ProfSemaphore },
+    { "rwlock", LockProfile::ProfRWLock },
+    { 0, 0 }
+};
 
 volatile int MutexPrivate::s_count = 0;
 volatile int MutexPrivate::s_locks = 0;
 volatile int SemaphorePrivate::s_count = 0;
 volatile int SemaphorePrivate::s_locks = 0;
+volatile int RWLockPrivate::s_count = 0;
 bool GlobalMutex::s_init = true;
+LockProfile* LockProfile::s_first = 0;
+LockProfile LockProfile::s_foreign;
+const char* LockProfile::s_names[PROF_SLOTS];
+unsigned char LockProfile::s_type[PROF_SLOTS];
+int LockProfile::s_hash[2 * PROF_SLOTS];
+int LockProfile::s_count = 0;
 
 // WARNING!!!
 // No debug messages are allowed in mutexes since the debug output itself
@@ -185,9 +322,169 @@ void GlobalMutex::unlock()
 }
 
 
+LockProfile::LockProfile()
+    : m_next(0), m_inUse(false)
+{
+    for (int i = 0; i < PROF_PAGES; i++)
+	m_pages[i] = 0;
+}
+
+// Retrieve the counters of a slot, allocate the page holding them if needed
+LockCounters* LockProfile::counters(int slot)
+{
+    if (slot < 0 || slot >= PROF_SLOTS)
+	return 0;
+    LockCounters* volatile& page = m_pages[slot / PROF_PAGE_SIZE];
+    if (!page) {
+	LockCounters* p = new LockCounters[PROF_PAGE_SIZE];
+	::memset(p,0,PROF_PAGE_SIZE * sizeof(LockCounters));
+	// another thread sharing the block may have published a page first
+	if (!PROF_CAS_PTR(page,(LockCounters*)0,p))
+	    delete[] p;
+    }
+    return page + (slot % PROF_PAGE_SIZE);
+}
+
+// Add the counters of this block to an array indexed by slot
+void LockProfile::add(LockCounters* dest, int count) const
+{
+    for (int i = 0; i < count; i++) {
+	const LockCounters* page = m_pages[i / PROF_PAGE_SIZE];
+	if (!page) {
+	    i += PROF_PAGE_SIZE - 1 - (i % PROF_PAGE_SIZE);
+	    continue;
+	}
+	const LockCounters& c = page[i % PROF_PAGE_SIZE];
+	LockCounters& d = dest[i];
+	d.locks += c.locks;
+	d.contended += c.contended;
+	d.failed += c.failed;
+	d.waitTotal += c.waitTotal;
+	if (d.waitMax < c.waitMax)
+	    d.waitMax = c.waitMax;
+	d.holdTotal += c.holdTotal;
+	if (d.holdMax < c.holdMax)
+	    d.holdMax = c.holdMax;
+    }
+}
+
+void LockProfile::reset()
+{
+    for (int i = 0; i < PROF_PAGES; i++)
+	if (m_pages[i])
+	    ::memset(m_pages[i],0,PROF_PAGE_SIZE * sizeof(LockCounters));
+}
+
+// Merge the counters of all threads, must be called with global mutex locked
+void LockProfile::collect(LockCounters* dest, int count)
+{
+    s_foreign.add(dest,count);
+    for (LockProfile* p = s_first; p; p = p->m_next)
+	p->add(dest,count);
+}
+
+// Clear the counters of all threads, must be called with global mutex locked
+void LockProfile::resetAll()
+{
+    s_foreign.reset();
+    for (LockProfile* p = s_first; p; p = p->m_next)
+	p->reset();
+}
+
+// Retrieve the counters of a slot for the current thread
+// Threads not created by us share a common block so their counters are approximate
+LockCounters* LockProfile::current(Thread* thr, int slot)
+{
+    if (!thr)
+	return s_foreign.counters(slot);
+    LockProfile* p = thr->m_lockProfile;
+    if (!p) {
+	GlobalMutex::lock();
+	for (p = s_first; p; p = p->m_next) {
+	    if (!p->m_inUse)
+		break;
+	}
+	if (!p) {
+	    p = new LockProfile;
+	    p->m_next = s_first;
+	    s_first = p;
+	}
+	p->m_inUse = true;
+	GlobalMutex::unlock();
+	thr->m_lockProfile = p;
+    }
+    return p->counters(slot);
+}
+
+// Give back the block of a terminating thread so it can be reused
+void LockProfile::release(Thread* thr)
+{
+    LockProfile* p = thr->m_lockProfile;
+    if (!p)
+	return;
+    thr->m_lockProfile = 0;
+    GlobalMutex::lock();
+    p->m_inUse = false;
+    GlobalMutex::unlock();
+}
+
+// Find or allocate the slot of a lockable name, last slot collects overflows
+int LockProfile::slot(const char* name, int type)
+{
+    unsigned int h = type;
+    for (const char* s = name; *s; s++)
+	h = (h << 5) + h + (unsigned char)*s;
+    GlobalMutex::lock();
+    int idx = -1;
+    for (unsigned int n = 0; n < 2 * PROF_SLOTS; n++) {
+	int& e = s_hash[(h + n) % (2 * PROF_SLOTS)];
+	if (!e) {
+	    if (s_count >= PROF_SLOTS - 1)
+		break;
+	    idx = s_count++;
+	    s_names[idx] = ::strdup(name);
+	    s_type[idx] = type;
+	    e = idx + 1;
+	    break;
+	}
+	if (s_type[e - 1] == type && !::strcmp(s_names[e - 1],name)) {
+	    idx = e - 1;
+	    break;
+	}
+    }
+    if (idx < 0) {
+	idx = PROF_SLOTS - 1;
+	if (!s_names[idx])
+	    s_names[idx] = "(overflow)";
+    }
+    GlobalMutex::unlock();
+    return idx;
+}
+
+void LockProfile::wait(LockCounters* c, u_int64_t usec)
+{
+    PROF_ADD(c->contended,1);
+    PROF_ADD(c->waitTotal,usec);
+    setMax(c->waitMax,usec);
+}
+
+void LockProfile::hold(LockCounters* c, u_int64_t usec)
+{
+    PROF_ADD(c->holdTotal,usec);
+    setMax(c->holdMax,usec);
+}
+
+void LockProfile::setMax(volatile u_int64_t& var, u_int64_t usec)
+{
+    u_int64_t old = var;
+    while (old < usec && !PROF_CAS(var,old,usec))
+	old = var;
+}
+
+
 MutexPrivate::MutexPrivate(bool recursive, const char* name)
     : m_refcount(1), m_locked(0), m_waiting(0), m_recursive(recursive),
-      m_name(name), m_owner(0)
+      m_name(name), m_owner(0), m_profSlot(-1), m_lockTime(0)
 {
     GlobalMutex::lock();
     s_count++;
@@ -257,6 +554,64 @@ bool MutexPrivate::lock(long maxwait)
 	m_waiting++;
 	GlobalMutex::unlock();
     }
+    LockCounters* prof = 0;
+    u_int64_t now = 0;
+    if (s_profiling && !s_unsafe) {
+	if (m_profSlot < 0)
+	    m_profSlot = LockProfile::slot(m_name,LockProfile::ProfMutex);
+	prof = LockProfile::current(thr,m_profSlot);
+    }
+    if (prof) {
+	// try first without waiting so we know if the mutex is contended
+	rval = acquire(0,false);
+	if (!rval && maxwait) {
+	    u_int64_t start = Time::now();
+	    rval = acquire(maxwait,warn);
+	    now = Time::now();
+	    LockProfile::wait(prof,now - start);
+	}
+	else if (!maxwait && !rval)
+	    PROF_ADD(prof->contended,1);
+	if (rval) {
+	    PROF_ADD(prof->locks,1);
+	    if (!now)
+		now = Time::now();
+	}
+	else
+	    PROF_ADD(prof->failed,1);
+    }
+    else
+	rval = acquire(maxwait,warn);
+    if (safety) {
+	GlobalMutex::lock();
+	m_waiting--;
+    }
+    if (thr)
+	thr->m_locking = false;
+    if (rval) {
+	if (safety)
+	    s_locks++;
+	if (!m_locked++)
+	    m_lockTime = now;
+	if (thr) {
+	    thr->m_locks++;
+	    m_owner = thr->name();
+	}
+	else
+	    m_owner = 0;
+    }
+    if (safety)
+	GlobalMutex::unlock();
+    if (warn && !rval)
+	Debug(DebugFail,"Thread '%s' could not lock mutex '%s' owned by '%s' waited by %u others for %lu usec!",
+	    Thread::currentName(),m_name,m_owner,m_waiting,maxwait);
+    return rval;
+}
+
+// Platform specific mutex acquisition
+bool MutexPrivate::acquire(long maxwait, bool warn)
+{
+    bool rval = false;
 #ifdef _WINDOWS
     DWORD ms = 0;
     if (maxwait < 0)
@@ -297,28 +652,6 @@ bool MutexPrivate::lock(long maxwait)
 #endif // HAVE_TIMEDLOCK
     }
 #endif // _WINDOWS
-    if (safety) {
-	GlobalMutex::lock();
-	m_waiting--;
-    }
-    if (thr)
-	thr->m_locking = false;
-    if (rval) {
-	if (safety)
-	    s_locks++;
-	m_locked++;
-	if (thr) {
-	    thr->m_locks++;
-	    m_owner = thr->name();
-	}
-	else
-	    m_owner = 0;
-    }
-    if (safety)
-	GlobalMutex::unlock();
-    if (warn && !rval)
-	Debug(DebugFail,"Thread '%s' could not lock mutex '%s' owned by '%s' waited by %u others for %lu usec!",
-	    Thread::currentName(),m_name,m_owner,m_waiting,maxwait);
     return rval;
 }
 
@@ -339,6 +672,14 @@ bool MutexPrivate::unlock()
 		Debug(DebugFail,"MutexPrivate '%s' unlocked by '%s' but owned by '%s' [%p]",
 		    m_name,tname,m_owner,this);
 	    m_owner = 0;
+	    if (m_lockTime) {
+		if (s_profiling) {
+		    LockCounters* prof = LockProfile::current(thr,m_profSlot);
+		    if (prof)
+			LockProfile::hold(prof,Time::now() - m_lockTime);
+		}
+		m_lockTime = 0;
+	    }
 	}
 	if (safety) {
 	    int locks = --s_locks;
@@ -368,7 +709,7 @@ bool MutexPrivate::unlock()
 SemaphorePrivate::SemaphorePrivate(unsigned int maxcount, const char* name,
     unsigned int initialCount)
     : m_refcount(1), m_waiting(0), m_maxcount(maxcount),
-      m_name(name)
+      m_name(name), m_profSlot(-1)
 {
     if (initialCount > m_maxcount)
 	initialCount = m_maxcount;
@@ -417,6 +758,54 @@ bool SemaphorePrivate::lock(long maxwait)
 	m_waiting++;
 	GlobalMutex::unlock();
     }
+    LockCounters* prof = 0;
+    if (s_profiling && !s_unsafe) {
+	if (m_profSlot < 0)
+	    m_profSlot = LockProfile::slot(m_name,LockProfile::ProfSemaphore);
+	prof = LockProfile::current(thr,m_profSlot);
+    }
+    if (prof) {
+	// try first without waiting so we know if we had to block
+	rval = acquire(0,false);
+	if (!rval && maxwait) {
+	    u_int64_t start = Time::now();
+	    rval = acquire(maxwait,warn);
+	    LockProfile::wait(prof,Time::now() - start);
+	}
+	else if (!maxwait && !rval)
+	    PROF_ADD(prof->contended,1);
+	if (rval)
+	    PROF_ADD(prof->locks,1);
+	else
+	    PROF_ADD(prof->failed,1);
+    }
+    else
+	rval = acquire(maxwait,warn);
+    if (safety) {
+	GlobalMutex::lock();
+	int locks = --s_locks;
+	if (locks < 0) {
+	    // this is very very bad - abort right now
+	    abortOnBug(true);
+	    s_locks = 0;
+	    Debug(DebugFail,"SemaphorePrivate::locks() is %d [%p]",locks,this);
+	}
+	m_waiting--;
+    }
+    if (thr)
+	thr->m_locking = false;
+    if (safety)
+	GlobalMutex::unlock();
+    if (warn && !rval)
+	Debug(DebugFail,"Thread '%s' could not lock semaphore '%s' waited by %u others for %lu usec!",
+	    Thread::currentName(),m_name,m_waiting,maxwait);
+    return rval;
+}
+
+// Platform specific semaphore acquisition
+bool SemaphorePrivate::acquire(long maxwait, bool warn)
+{
+    bool rval = false;
 #ifdef _WINDOWS
     DWORD ms = 0;
     if (maxwait < 0)
@@ -457,24 +846,6 @@ bool SemaphorePrivate::lock(long maxwait)
 #endif // HAVE_TIMEDWAIT
     }
 #endif // _WINDOWS
-    if (safety) {
-	GlobalMutex::lock();
-	int locks = --s_locks;
-	if (locks < 0) {
-	    // this is very very bad - abort right now
-	    abortOnBug(true);
-	    s_locks = 0;
-	    Debug(DebugFail,"SemaphorePrivate::locks() is %d [%p]",locks,this);
-	}
-	m_waiting--;
-    }
-    if (thr)
-	thr->m_locking = false;
-    if (safety)
-	GlobalMutex::unlock();
-    if (warn && !rval)
-	Debug(DebugFail,"Thread '%s' could not lock semaphore '%s' waited by %u others for %lu usec!",
-	    Thread::currentName(),m_name,m_waiting,maxwait);
     return rval;
 }
 
@@ -498,6 +869,293 @@ bool SemaphorePrivate::unlock()
 }
 
 
+RWLockPrivate::RWLockPrivate(const char* name)
+    : m_refcount(1), m_readers(0), m_writers(0), m_waitingWriters(0),
+      m_name(name), m_profSlot(-1), m_lockTime(0),
+      m_readerList(m_inlineReaders), m_readerCount(0), m_readerAlloc(RW_INLINE_READERS)
+{
+    GlobalMutex::lock();
+    s_count++;
+#ifdef _WINDOWS
+    ::InitializeCriticalSection(&m_mutex);
+    ::InitializeConditionVariable(&m_readCond);
+    ::InitializeConditionVariable(&m_writeCond);
+#else
+    ::pthread_mutex_init(&m_mutex,0);
+    ::pthread_cond_init(&m_readCond,0);
+    ::pthread_cond_init(&m_writeCond,0);
+#endif
+    GlobalMutex::unlock();
+}
+
+RWLockPrivate::~RWLockPrivate()
+{
+    GlobalMutex::lock();
+    s_count--;
+#ifdef _WINDOWS
+    ::DeleteCriticalSection(&m_mutex);
+#else
+    ::pthread_cond_destroy(&m_writeCond);
+    ::pthread_cond_destroy(&m_readCond);
+    ::pthread_mutex_destroy(&m_mutex);
+#endif
+    GlobalMutex::unlock();
+    if (m_readers || m_writers || m_waitingWriters)
+	Debug(DebugFail,"RWLockPrivate '%s' destroyed with %u readers, %u writer locks, %u waiting [%p]",
+	    m_name,m_readers,m_writers,m_waitingWriters,this);
+    if (m_readerList != m_inlineReaders)
+	::free(m_readerList);
+}
+
+// Platform wrappers for the internal lock and condition primitives
+static inline void rwLock(HRWMUTEX& mtx)
+{
+#ifdef _WINDOWS
+    ::EnterCriticalSection(&mtx);
+#else
+    ::pthread_mutex_lock(&mtx);
+#endif
+}
+
+static inline void rwUnlock(HRWMUTEX& mtx)
+{
+#ifdef _WINDOWS
+    ::LeaveCriticalSection(&mtx);
+#else
+    ::pthread_mutex_unlock(&mtx);
+#endif
+}
+
+static inline void rwWakeOne(HCOND& cond)
+{
+#ifdef _WINDOWS
+    ::WakeConditionVariable(&cond);
+#else
+    ::pthread_cond_signal(&cond);
+#endif
+}
+
+static inline void rwWakeAll(HCOND& cond)
+{
+#ifdef _WINDOWS
+    ::WakeAllConditionVariable(&cond);
+#else
+    ::pthread_cond_broadcast(&cond);
+#endif
+}
+
+// Check if the current thread holds the write lock, internal mutex must be locked
+bool RWLockPrivate::isWriter() const
+{
+    if (!m_writers)
+	return false;
+#ifdef _WINDOWS
+    return m_writer == ::GetCurrentThreadId();
+#else
+    return ::pthread_equal(m_writer,::pthread_self());
+#endif
+}
+
+// Find the read lock entry of a thread, internal mutex must be locked
+int RWLockPrivate::findReader(HTHREADID id) const
+{
+    for (unsigned int i = 0; i < m_readerCount; i++) {
+#ifdef _WINDOWS
+	if (m_readerList[i].id == id)
+#else
+	if (::pthread_equal(m_readerList[i].id,id))
+#endif
+	    return i;
+    }
+    return -1;
+}
+
+// Count one more read lock of a thread, internal mutex must be locked
+void RWLockPrivate::addReader(HTHREADID id, int idx)
+{
+    if (idx >= 0) {
+	m_readerList[idx].count++;
+	return;
+    }
+    if (m_readerCount >= m_readerAlloc) {
+	unsigned int alloc = 2 * m_readerAlloc;
+	Reader* list = (Reader*)::malloc(alloc * sizeof(Reader));
+	if (!list)
+	    return;
+	::memcpy(list,m_readerList,m_readerCount * sizeof(Reader));
+	if (m_readerList != m_inlineReaders)
+	    ::free(m_readerList);
+	m_readerList = list;
+	m_readerAlloc = alloc;
+    }
+    m_readerList[m_readerCount].id = id;
+    m_readerList[m_readerCount].count = 1;
+    m_readerCount++;
+}
+
+// Count one less read lock of a thread, internal mutex must be locked
+void RWLockPrivate::delReader(int idx)
+{
+    if (idx < 0 || --m_readerList[idx].count)
+	return;
+    if ((unsigned int)idx != --m_readerCount)
+	m_readerList[idx] = m_readerList[m_readerCount];
+}
+
+// Wait on a condition until signaled or absolute time reached, zero waits forever
+bool RWLockPrivate::waitCond(HCOND& cond, u_int64_t until)
+{
+#ifdef _WINDOWS
+    DWORD ms = INFINITE;
+    if (until) {
+	u_int64_t now = Time::now();
+	ms = (until > now) ? (DWORD)((until - now + 999) / 1000) : 0;
+    }
+    return ::SleepConditionVariableCS(&cond,&m_mutex,ms) != 0;
+#else
+    if (!until)
+	return !::pthread_cond_wait(&cond,&m_mutex);
+    struct timeval tv;
+    struct timespec ts;
+    Time::toTimeval(&tv,until);
+    ts.tv_sec = tv.tv_sec;
+    ts.tv_nsec = 1000 * tv.tv_usec;
+    return !::pthread_cond_timedwait(&cond,&m_mutex,&ts);
+#endif
+}
+
+bool RWLockPrivate::lock(long maxwait, bool write)
+{
+    if (s_unsafe)
+	return true;
+    bool warn = false;
+    if (s_maxwait && (maxwait < 0)) {
+	maxwait = (long)s_maxwait;
+	warn = true;
+    }
+    Thread* thr = Thread::current();
+#ifdef _WINDOWS
+    HTHREADID self = ::GetCurrentThreadId();
+#else
+    HTHREADID self = ::pthread_self();
+#endif
+    LockCounters* prof = 0;
+    if (s_profiling) {
+	if (m_profSlot < 0)
+	    m_profSlot = LockProfile::slot(m_name,LockProfile::ProfRWLock);
+	prof = LockProfile::current(thr,m_profSlot);
+    }
+    u_int64_t start = 0;
+    u_int64_t until = 0;
+    bool rval = true;
+    rwLock(m_mutex);
+    if (isWriter())
+	// the writer can lock again for either reading or writing
+	m_writers++;
+    else {
+	// readers already holding this lock don't yield to waiting writers
+	int reader = write ? -1 : findReader(self);
+	if (write)
+	    m_waitingWriters++;
+	while (write ? (m_writers || m_readers) : (m_writers || (m_waitingWriters && reader < 0))) {
+	    if (!start) {
+		start = Time::now();
+		if (maxwait > 0)
+		    until = start + maxwait;
+		if (thr)
+		    thr->m_locking = true;
+	    }
+	    if (!maxwait || (until && (Time::now() >= until))) {
+		rval = false;
+		break;
+	    }
+	    waitCond(write ? m_writeCond : m_readCond,until);
+	}
+	if (write) {
+	    m_waitingWriters--;
+	    if (rval) {
+		m_writers = 1;
+		m_writer = self;
+		// only the write hold time is known, readers share the lock
+		if (prof)
+		    m_lockTime = Time::now();
+	    }
+	    else if (!(m_waitingWriters || m_writers))
+		// we may have been blocking readers
+		rwWakeAll(m_readCond);
+	}
+	else if (rval) {
+	    m_readers++;
+	    addReader(self,reader);
+	}
+    }
+    rwUnlock(m_mutex);
+    if (thr) {
+	thr->m_locking = false;
+	if (rval)
+	    thr->m_locks++;
+    }
+    if (prof) {
+	if (start)
+	    LockProfile::wait(prof,Time::now() - start);
+	if (rval)
+	    PROF_ADD(prof->locks,1);
+	else
+	    PROF_ADD(prof->failed,1);
+    }
+    if (warn && !rval)
+	Debug(DebugFail,"Thread '%s' could not %s lock '%s' for %lu usec!",
+	    Thread::currentName(),(write ? "write" : "read"),m_name,maxwait);
+    return rval;
+}
+
+bool RWLockPrivate::unlock()
+{
+    if (s_unsafe)
+	return true;
+    bool ok = true;
+    u_int64_t held = 0;
+    rwLock(m_mutex);
+    if (isWriter()) {
+	if (!--m_writers) {
+	    if (m_lockTime) {
+		held = Time::now() - m_lockTime;
+		m_lockTime = 0;
+	    }
+	    if (m_waitingWriters)
+		rwWakeOne(m_writeCond);
+	    // readers holding other read locks may proceed even with writers waiting
+	    rwWakeAll(m_readCond);
+	}
+    }
+    else if (m_readers) {
+#ifdef _WINDOWS
+	delReader(findReader(::GetCurrentThreadId()));
+#else
+	delReader(findReader(::pthread_self()));
+#endif
+	if (!--m_readers && m_waitingWriters)
+	    rwWakeOne(m_writeCond);
+    }
+    else
+	ok = false;
+    rwUnlock(m_mutex);
+    if (ok) {
+	Thread* thr = Thread::current();
+	if (thr)
+	    thr->m_locks--;
+	if (held && s_profiling) {
+	    LockCounters* prof = LockProfile::current(thr,m_profSlot);
+	    if (prof)
+		LockProfile::hold(prof,held);
+	}
+    }
+    else
+	Debug(DebugFail,"RWLockPrivate::unlock called on unlocked '%s' [%p]",m_name,this);
+    return ok;
+}
+
+
 Lockable::~Lockable()
 {
 }
@@ -545,6 +1203,66 @@ unsigned long Lockable::wait()
     return s_maxwait;
 }
 
+void Lockable::enableProfiling(bool enable)
+{
+    s_profiling = enable;
+}
+
+bool Lockable::profiling()
+{
+    return s_profiling;
+}
+
+unsigned int Lockable::profilingStats(ObjList& dest)
+{
+    GlobalMutex::lock();
+    int count = LockProfile::s_count;
+    if (LockProfile::s_names[PROF_SLOTS - 1])
+	count = PROF_SLOTS;
+    LockCounters* sum = 0;
+    if (count) {
+	sum = new LockCounters[count];
+	::memset(sum,0,count * sizeof(LockCounters));
+	LockProfile::collect(sum,count);
+    }
+    GlobalMutex::unlock();
+    unsigned int n = 0;
+    for (int i = 0; i < count; i++) {
+	const char* name = LockProfile::s_names[i];
+	const LockCounters& c = sum[i];
+	if (!(name && (c.locks || c.failed)))
+	    continue;
+	NamedList* nl = new NamedList(name);
+	nl->addParam("type",lookup(LockProfile::s_type[i],s_profTypes));
+	nl->addParam("locks",String(c.locks));
+	nl->addParam("contended",String(c.contended));
+	nl->addParam("failed",String(c.failed));
+	nl->addParam("wait",String(c.waitTotal));
+	nl->addParam("maxwait",String(c.waitMax));
+	if (LockProfile::s_type[i] != LockProfile::ProfSemaphore) {
+	    nl->addParam("hold",String(c.holdTotal));
+	    nl->addParam("maxhold",String(c.holdMax));
+	}
+	dest.append(nl);
+	n++;
+    }
+    delete[] sum;
+    return n;
+}
+
+void Lockable::resetProfiling()
+{
+    GlobalMutex::lock();
+    LockProfile::resetAll();
+    GlobalMutex::unlock();
+}
+
+void Lockable::profilingDone(Thread* thread)
+{
+    if (thread)
+	LockProfile::release(thread);
+}
+
 
 Mutex::Mutex(bool recursive, const char* name)
     : m_private(0)
@@ -728,6 +1446,79 @@ bool Semaphore::efficientTimedLock()
 }
 
 
+RWLock::RWLock(const char* name)
+    : m_private(0)
+{
+    if (!name)
+	name = "?";
+    m_private = new RWLockPrivate(name);
+}
+
+RWLock::RWLock(const RWLock& original)
+    : Lockable(),
+      m_private(original.privDataCopy())
+{
+}
+
+RWLock::~RWLock()
+{
+    RWLockPrivate* priv = m_private;
+    m_private = 0;
+    if (priv)
+	priv->deref();
+}
+
+RWLock& RWLock::operator=(const RWLock& original)
+{
+    RWLockPrivate* priv = m_private;
+    m_private = original.privDataCopy();
+    if (priv)
+	priv->deref();
+    return *this;
+}
+
+RWLockPrivate* RWLock::privDataCopy() const
+{
+    if (m_private)
+	m_private->ref();
+    return m_private;
+}
+
+bool RWLock::lock(long maxwait)
+{
+    return m_private && m_private->lock(maxwait,true);
+}
+
+bool RWLock::readLock(long maxwait)
+{
+    return m_private && m_private->lock(maxwait,false);
+}
+
+bool RWLock::writeLock(long maxwait)
+{
+    return m_private && m_private->lock(maxwait,true);
+}
+
+bool RWLock::unlock()
+{
+    return m_private && m_private->unlock();
+}
+
+bool RWLock::locked() const
+{
+    return m_private && m_private->locked();
+}
+
+bool RWLock::writeLocked() const
+{
+    return m_private && m_private->writeLocked();
+}
+
+int RWLock::count()
+{
+    return RWLockPrivate::s_count;
+}
+
 bool Lock2::lock(Mutex* mx1, Mutex* mx2, long maxwait)
 {
     // if we got only one mutex it must be mx1
@@ -0,0 +1,535 @@
+/**
+ * PrefixTable.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Prefix trie for fast matching of anchored patterns
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "yateclass.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+// Maximum number of characters of a pattern inserted in the trie
+#define MAX_PREFIX 128
+// Maximum number of trie paths a single pattern may expand into
+#define MAX_EXPAND 256
+
+namespace { // anonymous
+
+using namespace TelEngine;
+
+// Trie node, siblings are kept sorted by character
+struct PrefixNode
+{
+    u_int32_t child;
+    u_int32_t next;
+    u_int32_t term;
+    unsigned char chr;
+};
+
+// Entry terminating at a trie node, chained in increasing entry order
+struct PrefixTerm
+{
+    u_int32_t entry;
+    u_int32_t next;
+    bool exact;
+};
+
+class PrefixEntry : public Regexp
+{
+public:
+    inline PrefixEntry(const char* value, bool extended, bool insensitive,
+	GenObject* data, bool prefix, bool exact)
+	: m_data(data), m_prefix(prefix), m_exact(exact), m_verify(true)
+	{
+	    setFlags(extended,insensitive);
+	    assign(value);
+	}
+    virtual ~PrefixEntry()
+	{ TelEngine::destruct(m_data); }
+    // Full match of the entry, does not use the trie
+    bool check(const char* str) const;
+    GenObject* m_data;
+    bool m_prefix;
+    bool m_exact;
+    // A hit in the trie must be confirmed by the regexp
+    bool m_verify;
+};
+
+}; // anonymous namespace
+
+using namespace TelEngine;
+
+bool PrefixEntry::check(const char* str) const
+{
+    if (!m_prefix)
+	return Regexp::matches(str);
+    unsigned int len = length();
+    if (isCaseInsensitive()) {
+	if (::strncasecmp(str,safe(),len))
+	    return false;
+    }
+    else if (::strncmp(str,safe(),len))
+	return false;
+    return !(m_exact && str[len]);
+}
+
+// Grow an array of POD items, keeps at least one free item
+static void* growArray(void* data, unsigned int count, unsigned int& alloc, unsigned int size)
+{
+    if (count < alloc)
+	return data;
+    unsigned int n = alloc ? 2 * alloc : 16;
+    void* tmp = ::realloc(data,n * size);
+    if (!tmp) {
+	Debug("PrefixTable",DebugFail,"Failed to allocate %u bytes",n * size);
+	return data;
+    }
+    alloc = n;
+    return tmp;
+}
+
+// Add a character to a set if not already present, also the other case if requested
+static void addChar(String& set, unsigned char c, bool insensitive)
+{
+    if (set.find((char)c) < 0)
+	set += (char)c;
+    if (insensitive && isalpha(c)) {
+	c = islower(c) ? toupper(c) : tolower(c);
+	if (set.find((char)c) < 0)
+	    set += (char)c;
+    }
+}
+
+// Parse a simple bracket expression, return pointer after it or NULL if not supported
+static const char* parseClass(const char* s, String& set, bool insensitive)
+{
+    const char* p = s + 1;
+    // negated sets and character classes are not expanded
+    if (*p == '^')
+	return 0;
+    bool first = true;
+    while (*p && (first || *p != ']')) {
+	if (*p == '[')
+	    return 0;
+	unsigned char c1 = (unsigned char)*p++;
+	if (*p == '-' && p[1] && p[1] != ']') {
+	    unsigned char c2 = (unsigned char)p[1];
+	    p += 2;
+	    if (c2 < c1)
+		return 0;
+	    for (unsigned int c = c1; c <= c2; c++)
+		addChar(set,(unsigned char)c,insensitive);
+	}
+	else
+	    addChar(set,c1,insensitive);
+	first = false;
+    }
+    if (*p != ']')
+	return 0;
+    return p + 1;
+}
+
+// Split an anchored pattern in sets of characters, one per position
+// Returns number of sets or -1 if the pattern has no usable anchored prefix
+// complete is set if the sets describe the whole pattern, exact if it's anchored at end
+static int parsePattern(const char* pat, bool extended, bool insensitive,
+    String* sets, bool& complete, bool& exact)
+{
+    complete = false;
+    exact = false;
+    if (!pat || (*pat != '^'))
+	return -1;
+    // alternation can make any branch optional
+    if (extended ? ::strchr(pat,'|') : ::strstr(pat,"\\|"))
+	return -1;
+    unsigned int combos = 1;
+    int n = 0;
+    const char* s = pat + 1;
+    while (n < MAX_PREFIX) {
+	char c = *s;
+	if (!c) {
+	    complete = true;
+	    break;
+	}
+	if (c == '$' && !s[1]) {
+	    complete = exact = true;
+	    break;
+	}
+	// a trailing .* matches anything
+	if (c == '.' && s[1] == '*' && (!s[2] || (s[2] == '$' && !s[3]))) {
+	    complete = true;
+	    break;
+	}
+	String set;
+	const char* next = 0;
+	if (c == '[')
+	    next = parseClass(s,set,insensitive);
+	else if (c == '\\') {
+	    c = s[1];
+	    if (c && ::strchr(extended ? "\\.[]*^$+?(){}|" : "\\.[]*^$",c)) {
+		addChar(set,c,insensitive);
+		next = s + 2;
+	    }
+	}
+	else if (!::strchr(extended ? ".[\\()*+?{|^$" : ".[\\*^$",c)) {
+	    addChar(set,c,insensitive);
+	    next = s + 1;
+	}
+	if (!next)
+	    break;
+	// a quantified atom may be missing or repeated, stop before it
+	if (*next == '*')
+	    break;
+	if (extended) {
+	    if (*next && ::strchr("+?{",*next))
+		break;
+	}
+	else if (next[0] == '\\' && next[1] && ::strchr("+?{",next[1]))
+	    break;
+	if (combos * set.length() > MAX_EXPAND)
+	    break;
+	combos *= set.length();
+	sets[n++] = set;
+	s = next;
+    }
+    return n;
+}
+
+
+PrefixTable::PrefixTable(bool extended, bool insensitive)
+    : m_extended(extended), m_insensitive(insensitive),
+      m_entries(0), m_count(0), m_alloc(0),
+      m_nodes(0), m_nodeCount(0), m_nodeAlloc(0),
+      m_terms(0), m_termCount(0), m_termAlloc(0),
+      m_others(0), m_otherCount(0), m_otherAlloc(0)
+{
+}
+
+PrefixTable::~PrefixTable()
+{
+    clear();
+}
+
+void PrefixTable::clear()
+{
+    for (unsigned int i = 0; i < m_count; i++)
+	TelEngine::destruct(m_entries[i]);
+    ::free(m_entries);
+    ::free(m_nodes);
+    ::free(m_terms);
+    ::free(m_others);
+    m_entries = 0;
+    m_nodes = m_terms = 0;
+    m_others = 0;
+    m_count = m_alloc = 0;
+    m_nodeCount = m_nodeAlloc = 0;
+    m_termCount = m_termAlloc = 0;
+    m_otherCount = m_otherAlloc = 0;
+}
+
+unsigned int PrefixTable::append(GenObject* entry)
+{
+    m_entries = (GenObject**)growArray(m_entries,m_count,m_alloc,sizeof(GenObject*));
+    m_entries[m_count] = entry;
+    return m_count++;
+}
+
+unsigned int PrefixTable::newNode(unsigned char chr)
+{
+    m_nodes = growArray(m_nodes,m_nodeCount,m_nodeAlloc,sizeof(PrefixNode));
+    PrefixNode& n = static_cast<PrefixNode*>(m_nodes)[m_nodeCount];
+    n.child = n.next = n.term = 0;
+    n.chr = chr;
+    return m_nodeCount++;
+}
+
+// Insert one literal path in the trie and terminate it with an entry
+void PrefixTable::insert(const char* prefix, unsigned int len, unsigned int index, bool exact)
+{
+    if (!m_nodeCount)
+	newNode(0);
+    if (!m_termCount) {
+	// term 0 is never used so zero can mean end of chain
+	m_terms = growArray(m_terms,m_termCount,m_termAlloc,sizeof(PrefixTerm));
+	m_termCount++;
+    }
+    unsigned int node = 0;
+    for (unsigned int i = 0; i < len; i++) {
+	unsigned char c = (unsigned char)prefix[i];
+	PrefixNode* nodes = static_cast<PrefixNode*>(m_nodes);
+	unsigned int prev = 0;
+	unsigned int child = nodes[node].child;
+	while (child && nodes[child].chr < c) {
+	    prev = child;
+	    child = nodes[child].next;
+	}
+	if (!(child && nodes[child].chr == c)) {
+	    unsigned int n = newNode(c);
+	    nodes = static_cast<PrefixNode*>(m_nodes);
+	    nodes[n].next = child;
+	    if (prev)
+		nodes[prev].next = n;
+	    else
+		nodes[node].child = n;
+	    child = n;
+	}
+	node = child;
+    }
+    PrefixNode* nodes = static_cast<PrefixNode*>(m_nodes);
+    PrefixTerm* terms = static_cast<PrefixTerm*>(m_terms);
+    unsigned int last = 0;
+    for (unsigned int t = nodes[node].term; t; t = terms[t].next) {
+	if (terms[t].entry == index)
+	    return;
+	last = t;
+    }
+    m_terms = growArray(m_terms,m_termCount,m_termAlloc,sizeof(PrefixTerm));
+    terms = static_cast<PrefixTerm*>(m_terms);
+    PrefixTerm& t = terms[m_termCount];
+    t.entry = index;
+    t.next = 0;
+    t.exact = exact;
+    if (last)
+	terms[last].next = m_termCount;
+    else
+	nodes[node].term = m_termCount;
+    m_termCount++;
+}
+
+unsigned int PrefixTable::add(const char* pattern, GenObject* data)
+{
+    PrefixEntry* e = new PrefixEntry(pattern,m_extended,m_insensitive,data,false,false);
+    // compile now, lookups may run concurrently and must not modify the entry
+    if (!e->compile())
+	Debug("PrefixTable",DebugMild,"Invalid pattern '%s' [%p]",e->c_str(),this);
+    unsigned int index = append(e);
+    String sets[MAX_PREFIX];
+    bool complete = false;
+    bool exact = false;
+    int n = parsePattern(pattern,m_extended,m_insensitive,sets,complete,exact);
+    if (n < 0 || (!n && !complete)) {
+	// nothing to index, the regexp is always tried
+	m_others = (unsigned int*)growArray(m_others,m_otherCount,m_otherAlloc,sizeof(unsigned int));
+	m_others[m_otherCount++] = index;
+	XDebug("PrefixTable",DebugAll,"Pattern #%u '%s' not indexed [%p]",index,e->c_str(),this);
+	return index;
+    }
+    e->m_verify = !complete;
+    // insert all combinations of characters from the sets
+    unsigned int pos[MAX_PREFIX];
+    char buf[MAX_PREFIX];
+    for (int i = 0; i < n; i++)
+	pos[i] = 0;
+    for (;;) {
+	for (int i = 0; i < n; i++)
+	    buf[i] = sets[i].at(pos[i]);
+	insert(buf,n,index,exact);
+	int i = n - 1;
+	for (; i >= 0; i--) {
+	    if (++pos[i] < sets[i].length())
+		break;
+	    pos[i] = 0;
+	}
+	if (i < 0)
+	    break;
+    }
+    XDebug("PrefixTable",DebugAll,"Pattern #%u '%s' indexed %d chars%s [%p]",
+	index,e->c_str(),n,(complete ? "" : ", verified"),this);
+    return index;
+}
+
+unsigned int PrefixTable::addPrefix(const char* prefix, GenObject* data, bool exact)
+{
+    PrefixEntry* e = new PrefixEntry(prefix,m_extended,m_insensitive,data,true,exact);
+    e->m_verify = false;
+    unsigned int index = append(e);
+    unsigned int len = e->length();
+    if (!m_insensitive) {
+	insert(e->safe(),len,index,exact);
+	return index;
+    }
+    // case insensitive, expand letters up to the limit and verify the rest
+    unsigned int combos = 1;
+    unsigned int n = 0;
+    String sets[MAX_PREFIX];
+    for (; n < len && n < MAX_PREFIX; n++) {
+	addChar(sets[n],(unsigned char)e->at(n),true);
+	if (combos * sets[n].length() > MAX_EXPAND)
+	    break;
+	combos *= sets[n].length();
+    }
+    if (n < len) {
+	e->m_verify = true;
+	exact = false;
+    }
+    unsigned int pos[MAX_PREFIX];
+    char buf[MAX_PREFIX];
+    for (unsigned int i = 0; i < n; i++)
+	pos[i] = 0;
+    for (;;) {
+	for (unsigned int i = 0; i < n; i++)
+	    buf[i] = sets[i].at(pos[i]);
+	insert(buf,n,index,exact);
+	int i = n - 1;
+	for (; i >= 0; i--) {
+	    if (++pos[i] < sets[i].length())
+		break;
+	    pos[i] = 0;
+	}
+	if (i < 0)
+	    break;
+    }
+    return index;
+}
+
+const String& PrefixTable::pattern(unsigned int index) const
+{
+    if (index >= m_count)
+	return String::empty();
+    return *static_cast<const PrefixEntry*>(m_entries[index]);
+}
+
+GenObject* PrefixTable::data(unsigned int index) const
+{
+    if (index >= m_count)
+	return 0;
+    return static_cast<const PrefixEntry*>(m_entries[index])->m_data;
+}
+
+bool PrefixTable::matches(unsigned int index, const char* str) const
+{
+    if (index >= m_count)
+	return false;
+    return static_cast<const PrefixEntry*>(m_entries[index])->check(c_safe(str));
+}
+
+// Confirm a candidate returned by the trie or from the unindexed list
+bool PrefixTable::check(unsigned int index, const char* str) const
+{
+    const PrefixEntry* e = static_cast<const PrefixEntry*>(m_entries[index]);
+    return !e->m_verify || e->check(str);
+}
+
+int PrefixTable::candidate(const char* str, int after) const
+{
+    str = c_safe(str);
+    int best = -1;
+    if (m_nodeCount) {
+	const PrefixNode* nodes = static_cast<const PrefixNode*>(m_nodes);
+	const PrefixTerm* terms = static_cast<const PrefixTerm*>(m_terms);
+	const unsigned char* s = (const unsigned char*)str;
+	unsigned int node = 0;
+	for (;;) {
+	    for (unsigned int t = nodes[node].term; t; t = terms[t].next) {
+		int e = terms[t].entry;
+		if (e <= after)
+		    continue;
+		if (terms[t].exact && *s)
+		    continue;
+		// terms are sorted so this is the lowest on this node
+		if (best < 0 || e < best)
+		    best = e;
+		break;
+	    }
+	    if (!*s)
+		break;
+	    unsigned int c = nodes[node].child;
+	    while (c && nodes[c].chr < *s)
+		c = nodes[c].next;
+	    if (!(c && nodes[c].chr == *s))
+		break;
+	    node = c;
+	    s++;
+	}
+    }
+    if (m_otherCount && ((int)m_others[m_otherCount - 1] > after)) {
+	// binary search the first unindexed entry after the requested one
+	unsigned int lo = 0;
+	unsigned int hi = m_otherCount - 1;
+	while (lo < hi) {
+	    unsigned int mid = (lo + hi) / 2;
+	    if ((int)m_others[mid] > after)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+	int e = m_others[lo];
+	if (best < 0 || e < best)
+	    best = e;
+    }
+    return best;
+}
+
+int PrefixTable::find(const char* str, int after) const
+{
+    str = c_safe(str);
+    for (;;) {
+	after = candidate(str,after);
+	if (after < 0 || check(after,str))
+	    return after;
+    }
+}
+
+int PrefixTable::longest(const char* str) const
+{
+    str = c_safe(str);
+    int best = -1;
+    bool depth = false;
+    if (m_nodeCount) {
+	const PrefixNode* nodes = static_cast<const PrefixNode*>(m_nodes);
+	const PrefixTerm* terms = static_cast<const PrefixTerm*>(m_terms);
+	const unsigned char* s = (const unsigned char*)str;
+	unsigned int node = 0;
+	for (;;) {
+	    for (unsigned int t = nodes[node].term; t; t = terms[t].next) {
+		if (terms[t].exact && *s)
+		    continue;
+		if (check(terms[t].entry,str)) {
+		    // deeper match always wins, on same node the lowest index
+		    best = terms[t].entry;
+		    depth = (s != (const unsigned char*)str);
+		    break;
+		}
+	    }
+	    if (!*s)
+		break;
+	    unsigned int c = nodes[node].child;
+	    while (c && nodes[c].chr < *s)
+		c = nodes[c].next;
+	    if (!(c && nodes[c].chr == *s))
+		break;
+	    node = c;
+	    s++;
+	}
+	if (depth)
+	    return best;
+    }
+    // zero length prefix, compare with unindexed entries
+    for (unsigned int i = 0; i < m_otherCount; i++) {
+	int e = m_others[i];
+	if (best >= 0 && e > best)
+	    break;
+	if (check(e,str))
+	    return e;
+    }
+    return best;
+}
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 #include <regex.h>
 
 namespace TelEngine {
@@ -135,6 +136,31 @@ static inline char hexEncode(char nib)
     return hex[nib & 0x0f];
 }
 
+// Write the decimal representation of an unsigned number, no sprintf overhead
+static inline void decEncode(char* buf, uint64_t value)
+{
+    char tmp[20];
+    unsigned int n = 0;
+    do {
+	tmp[n++] = '0' + (char)(value % 10);
+	value /= 10;
+    } while (value);
+    while (n)
+	*buf++ = tmp[--n];
+    *buf = '\0';
+}
+
+// Write the decimal representation of a signed number
+static inline void decEncode(char* buf, int64_t value)
+{
+    if (value < 0) {
+	*buf++ = '-';
+	decEncode(buf,(uint64_t)0 - (uint64_t)value);
+    }
+    else
+	decEncode(buf,(uint64_t)value);
+}
+
 
 void UChar::encode()
 {
@@ -352,7 +378,7 @@ String::String(int32_t value)
 {
     XDebug(DebugAll,"String::String(%d) [%p]",value,this);
     char buf[16];
-    ::sprintf(buf,"%d",value);
+    decEncode(buf,(int64_t)value);
     m_string = ::strdup(buf);
     if (!m_string)
 	Debug("String",DebugFail,"strdup() returned NULL!");
@@ -364,7 +390,7 @@ String::String(int64_t value)
 {
     XDebug(DebugAll,"String::String(" FMT64 ") [%p]",value,this);
     char buf[24];
-    ::sprintf(buf,FMT64,value);
+    decEncode(buf,(int64_t)value);
     m_string = ::strdup(buf);
     if (!m_string)
 	Debug("String",DebugFail,"strdup() returned NULL!");
@@ -376,7 +402,7 @@ String::String(uint32_t value)
 {
     XDebug(DebugAll,"String::String(%u) [%p]",value,this);
     char buf[16];
-    ::sprintf(buf,"%u",value);
+    decEncode(buf,(uint64_t)value);
     m_string = ::strdup(buf);
     if (!m_string)
 	Debug("String",DebugFail,"strdup() returned NULL!");
@@ -388,7 +414,7 @@ String::String(uint64_t value)
 {
     XDebug(DebugAll,"String::String(" FMT64U ") [%p]",value,this);
     char buf[24];
-    ::sprintf(buf,FMT64U,value);
+    decEncode(buf,(uint64_t)value);
     m_string = ::strdup(buf);
     if (!m_string)
 	Debug("String",DebugFail,"strdup() returned NULL!");
@@ -512,16 +538,20 @@ String& String::hexify(void* data, unsigned int len, char sep, bool upCase)
 	char* data = (char*) ::malloc(repeat+1);
 	if (data) {
 	    char* d = data;
-	    while (len--) {
-		unsigned char c = *s++;
-		*d++ = hex[(c >> 4) & 0x0f];
-		*d++ = hex[c & 0x0f];
-		if (sep)
+	    if (sep) {
+		while (len--) {
+		    unsigned char c = *s++;
+		    *d++ = hex[(c >> 4) & 0x0f];
+		    *d++ = hex[c & 0x0f];
 		    *d++ = sep;
-	    }
-	    // wrote one too many - go back...
-	    if (sep)
+		}
+		// wrote one too many - go back...
 		d--;
+	    }
+	    else {
+		Base64::hexEncode(d,s,len,upCase);
+		d += repeat;
+	    }
 	    *d = '\0';
 	    char* odata = m_string;
 	    m_string = data;
@@ -769,28 +799,28 @@ String& String::operator=(char value)
 String& String::operator=(int32_t value)
 {
     char buf[16];
-    ::sprintf(buf,"%d",value);
+    decEncode(buf,(int64_t)value);
     return operator=(buf);
 }
 
 String& String::operator=(uint32_t value)
 {
     char buf[16];
-    ::sprintf(buf,"%u",value);
+    decEncode(buf,(uint64_t)value);
     return operator=(buf);
 }
 
 String& String::operator=(int64_t value)
 {
     char buf[24];
-    ::sprintf(buf,FMT64,value);
+    decEncode(buf,(int64_t)value);
     return operator=(buf);
 }
 
 String& String::operator=(uint64_t value)
 {
     char buf[24];
-    ::sprintf(buf,FMT64U,value);
+    decEncode(buf,(uint64_t)value);
     return operator=(buf);
 }
 
@@ -810,28 +840,28 @@ String& String::operator+=(char value)
 String& String::operator+=(int32_t value)
 {
     char buf[16];
-    ::sprintf(buf,"%d",value);
+    decEncode(buf,(int64_t)value);
     return operator+=(buf);
 }
 
 String& String::operator+=(uint32_t value)
 {
     char buf[16];
-    ::sprintf(buf,"%u",value);
+    decEncode(buf,(uint64_t)value);
     return operator+=(buf);
 }
 
 String& String::operator+=(int64_t value)
 {
     char buf[24];
-    ::sprintf(buf,FMT64,value);
+    decEncode(buf,(int64_t)value);
     return operator+=(buf);
 }
 
 String& String::operator+=(uint64_t value)
 {
     char buf[24];
-    ::sprintf(buf,FMT64U,value);
+    decEncode(buf,(uint64_t)value);
     return operator+=(buf);
 }
 
@@ -1731,14 +1761,815 @@ const String* String::atom(const String*& str, const char* val)
 }
 
 
+// Lazy DFA used by Regexp when no subexpression matches are requested
+// Patterns using features it doesn't implement are left to regexec()
+
+// Maximum number of NFA states built for one expression
+#define RX_MAX_NFA 4096
+// Maximum number of DFA states cached for one expression
+#define RX_MAX_DFA 1024
+
+#ifdef _WINDOWS
+#define RX_BARRIER() MemoryBarrier()
+#else
+#define RX_BARRIER() __sync_synchronize()
+#endif
+
+namespace { // anonymous
+
+// Parse tree node
+struct RxNode
+{
+    enum Type {
+	Empty,
+	Set,
+	Cat,
+	Alt,
+	Rep,
+	Begin,
+	End,
+    };
+    int type;
+    RxNode* left;
+    RxNode* right;
+    int set;
+    int min;
+    int max;
+};
+
+// NFA state
+struct RxState
+{
+    enum Type {
+	Char,
+	Split,
+	Begin,
+	End,
+	Match,
+    };
+    int type;
+    int out;
+    int out1;
+    int set;
+};
+
+// DFA state, transitions are filled in lazily and never change once set
+struct RxDfaState
+{
+    RxDfaState** next;
+    int* kernel;
+    int count;
+    unsigned int hash;
+    RxDfaState* chain;
+    bool begin;
+    bool match;
+    bool endMatch;
+};
+
+// Recursive descent parser for the POSIX basic and extended syntax
+class RxParser
+{
+public:
+    RxParser(const char* pattern, bool extended, bool icase);
+    ~RxParser();
+    RxNode* parse();
+    unsigned char* m_sets;
+    int m_setCount;
+private:
+    RxNode* node(int type, RxNode* left = 0, RxNode* right = 0);
+    int newSet();
+    void setChar(int set, unsigned char c);
+    void foldSet(int set);
+    inline bool isAlt() const
+	{ return m_ext ? (*m_pos == '|') : (m_pos[0] == '\\' && m_pos[1] == '|'); }
+    inline bool isGroupEnd() const
+	{ return m_ext ? (*m_pos == ')') : (m_pos[0] == '\\' && m_pos[1] == ')'); }
+    RxNode* alt();
+    RxNode* concat();
+    RxNode* piece(bool& start);
+    RxNode* atom(bool start);
+    RxNode* literal(unsigned char c);
+    RxNode* bracket();
+    bool interval(int& min, int& max);
+    const char* m_pos;
+    bool m_ext;
+    bool m_icase;
+    int m_depth;
+    RxNode* m_nodes;
+    int m_nodeCount;
+    int m_nodeMax;
+    int m_setMax;
+};
+
+class RegexpDfa
+{
+public:
+    ~RegexpDfa();
+    static RegexpDfa* build(const char* pattern, int flags);
+    // Returns 1 on match, 0 on mismatch, negative if regexec() must be used
+    int matches(const char* value) const;
+private:
+    RegexpDfa();
+    int compile(const RxNode* n, int next);
+    int addState(int type, int out, int out1 = -1, int set = -1);
+    void closure(int state, bool atBegin, bool atEnd) const;
+    RxDfaState* makeState(bool begin) const;
+    RxDfaState* step(RxDfaState* s, unsigned int cls) const;
+    RxState* m_states;
+    int m_count;
+    int m_max;
+    int m_start;
+    unsigned char* m_sets;
+    unsigned char m_classes[256];
+    unsigned char m_classRep[256];
+    unsigned int m_classCount;
+    RxDfaState* m_begin;
+    // everything below is changed only while holding s_dfaMutex
+    mutable RxDfaState* m_hash[64];
+    mutable int m_dfaCount;
+    mutable bool m_full;
+    mutable int* m_stack;
+    mutable int* m_work;
+    mutable int m_workCount;
+    mutable unsigned int* m_marks;
+    mutable unsigned int m_mark;
+};
+
+}; // anonymous namespace
+
+static Mutex s_dfaMutex(false,"RegexpDfa");
+
+RxParser::RxParser(const char* pattern, bool extended, bool icase)
+    : m_sets(0), m_setCount(0),
+      m_pos(pattern), m_ext(extended), m_icase(icase), m_depth(0),
+      m_nodes(0), m_nodeCount(0), m_nodeMax(0), m_setMax(0)
+{
+    int len = ::strlen(pattern);
+    // each character produces at most one atom, one repeat and one concatenation
+    m_nodeMax = 3 * len + 4;
+    m_nodes = new RxNode[m_nodeMax];
+    m_setMax = len + 1;
+    m_sets = new unsigned char[32 * m_setMax];
+}
+
+RxParser::~RxParser()
+{
+    delete[] m_nodes;
+    delete[] m_sets;
+}
+
+RxNode* RxParser::node(int type, RxNode* left, RxNode* right)
+{
+    if (m_nodeCount >= m_nodeMax)
+	return 0;
+    RxNode* n = m_nodes + m_nodeCount++;
+    n->type = type;
+    n->left = left;
+    n->right = right;
+    n->set = -1;
+    n->min = n->max = 0;
+    return n;
+}
+
+int RxParser::newSet()
+{
+    if (m_setCount >= m_setMax)
+	return -1;
+    ::memset(m_sets + 32 * m_setCount,0,32);
+    return m_setCount++;
+}
+
+void RxParser::setChar(int set, unsigned char c)
+{
+    m_sets[32 * set + (c >> 3)] |= (1 << (c & 7));
+}
+
+// Case insensitive matching tests the upper case of the input like glibc, the pattern is upper cased too
+void RxParser::foldSet(int set)
+{
+    if (!m_icase)
+	return;
+    unsigned char* bits = m_sets + 32 * set;
+    unsigned char tmp[32];
+    ::memset(tmp,0,sizeof(tmp));
+    for (int c = 1; c < 256; c++) {
+	int u = ::toupper(c);
+	if ((bits[u >> 3] >> (u & 7)) & 1)
+	    tmp[c >> 3] |= (1 << (c & 7));
+    }
+    ::memcpy(bits,tmp,sizeof(tmp));
+}
+
+RxNode* RxParser::parse()
+{
+    RxNode* n = alt();
+    // anything left means an unmatched closing parenthesis
+    if (!n || *m_pos)
+	return 0;
+    return n;
+}
+
+RxNode* RxParser::alt()
+{
+    RxNode* n = concat();
+    while (n && isAlt()) {
+	m_pos += m_ext ? 1 : 2;
+	RxNode* r = concat();
+	if (!r)
+	    return 0;
+	n = node(RxNode::Alt,n,r);
+    }
+    return n;
+}
+
+RxNode* RxParser::concat()
+{
+    RxNode* n = node(RxNode::Empty);
+    bool start = true;
+    while (n && *m_pos && !isAlt() && !isGroupEnd()) {
+	RxNode* p = piece(start);
+	if (!p)
+	    return 0;
+	n = node(RxNode::Cat,n,p);
+    }
+    return n;
+}
+
+RxNode* RxParser::piece(bool& start)
+{
+    RxNode* a = atom(start);
+    if (!a)
+	return 0;
+    if (RxNode::Begin == a->type) {
+	// in basic syntax a '*' following the initial anchor is literal
+	if (m_ext && *m_pos && ::strchr("*+?{",*m_pos))
+	    return 0;
+	// a repeated anchor is ambiguous in basic syntax, leave it to regexec
+	if (!m_ext && *m_pos == '^')
+	    return 0;
+	return a;
+    }
+    start = false;
+    for (;;) {
+	int min = 0;
+	int max = -1;
+	if (*m_pos == '*')
+	    m_pos++;
+	else if (m_ext) {
+	    if (*m_pos == '+') {
+		m_pos++;
+		min = 1;
+	    }
+	    else if (*m_pos == '?') {
+		m_pos++;
+		max = 1;
+	    }
+	    else if (*m_pos == '{') {
+		m_pos++;
+		if (!interval(min,max))
+		    return 0;
+	    }
+	    else
+		break;
+	}
+	else if (m_pos[0] == '\\' && m_pos[1] == '+') {
+	    m_pos += 2;
+	    min = 1;
+	}
+	else if (m_pos[0] == '\\' && m_pos[1] == '?') {
+	    m_pos += 2;
+	    max = 1;
+	}
+	else if (m_pos[0] == '\\' && m_pos[1] == '{') {
+	    m_pos += 2;
+	    if (!interval(min,max))
+		return 0;
+	}
+	else
+	    break;
+	if (RxNode::End == a->type)
+	    return 0;
+	RxNode* r = node(RxNode::Rep,a);
+	if (!r)
+	    return 0;
+	r->min = min;
+	r->max = max;
+	a = r;
+    }
+    return a;
+}
+
+// Parse a {min,max} interval, the opening brace was already skipped
+bool RxParser::interval(int& min, int& max)
+{
+    if (!::isdigit(*m_pos))
+	return false;
+    min = 0;
+    while (::isdigit(*m_pos) && min <= 255)
+	min = 10 * min + (*m_pos++ - '0');
+    max = min;
+    if (*m_pos == ',') {
+	m_pos++;
+	max = -1;
+	if (::isdigit(*m_pos)) {
+	    max = 0;
+	    while (::isdigit(*m_pos) && max <= 255)
+		max = 10 * max + (*m_pos++ - '0');
+	}
+    }
+    if (min > 255 || max > 255 || (max >= 0 && max < min))
+	return false;
+    if (m_ext) {
+	if (*m_pos != '}')
+	    return false;
+	m_pos++;
+    }
+    else {
+	if (m_pos[0] != '\\' || m_pos[1] != '}')
+	    return false;
+	m_pos += 2;
+    }
+    return true;
+}
+
+RxNode* RxParser::literal(unsigned char c)
+{
+    int set = newSet();
+    if (set < 0)
+	return 0;
+    setChar(set,m_icase ? ::toupper(c) : c);
+    foldSet(set);
+    RxNode* n = node(RxNode::Set);
+    if (n)
+	n->set = set;
+    return n;
+}
+
+RxNode* RxParser::atom(bool start)
+{
+    unsigned char c = (unsigned char)*m_pos;
+    switch (c) {
+	case '.':
+	    {
+		m_pos++;
+		int set = newSet();
+		if (set < 0)
+		    return 0;
+		::memset(m_sets + 32 * set,0xff,32);
+		m_sets[32 * set] &= 0xfe;
+		RxNode* n = node(RxNode::Set);
+		if (n)
+		    n->set = set;
+		return n;
+	    }
+	case '[':
+	    m_pos++;
+	    return bracket();
+	case '^':
+	    if (m_ext || start) {
+		m_pos++;
+		return node(RxNode::Begin);
+	    }
+	    break;
+	case '$':
+	    m_pos++;
+	    if (m_ext || !*m_pos || isAlt() || isGroupEnd())
+		return node(RxNode::End);
+	    return literal(c);
+	case '*':
+	    // a leading star is literal in basic syntax
+	    if (m_ext || !start)
+		return 0;
+	    break;
+	case '\\':
+	    c = (unsigned char)m_pos[1];
+	    if (!m_ext && c == '(') {
+		m_pos += 2;
+		m_depth++;
+		RxNode* n = alt();
+		if (!(n && isGroupEnd()))
+		    return 0;
+		m_pos += 2;
+		m_depth--;
+		return n;
+	    }
+	    // back references, GNU word operators and escaped operators in odd places
+	    if (!c || ::isalnum(c) || (!m_ext && ::strchr("{}+?|()",c)))
+		return 0;
+	    m_pos += 2;
+	    return literal(c);
+	default:
+	    if (m_ext) {
+		if (c == '(') {
+		    m_pos++;
+		    m_depth++;
+		    RxNode* n = alt();
+		    if (!(n && *m_pos == ')'))
+			return 0;
+		    m_pos++;
+		    m_depth--;
+		    return n;
+		}
+		if (::strchr(")|+?{}",c))
+		    return 0;
+	    }
+    }
+    m_pos++;
+    return literal(c);
+}
+
+// Parse a bracket expression, the opening bracket was already skipped
+RxNode* RxParser::bracket()
+{
+    int set = newSet();
+    if (set < 0)
+	return 0;
+    bool neg = false;
+    if (*m_pos == '^') {
+	neg = true;
+	m_pos++;
+    }
+    bool first = true;
+    for (;;) {
+	unsigned char c = (unsigned char)*m_pos;
+	if (!c)
+	    return 0;
+	if (c == ']' && !first) {
+	    m_pos++;
+	    break;
+	}
+	first = false;
+	if (c == '[') {
+	    if (m_pos[1] == '=' || m_pos[1] == '.')
+		return 0;
+	    if (m_pos[1] == ':') {
+		const char* name = m_pos + 2;
+		const char* end = ::strstr(name,":]");
+		if (!end)
+		    return 0;
+		String cls(name,end - name);
+		int (*func)(int) = 0;
+		if (cls == YSTRING("digit"))
+		    func = ::isdigit;
+		else if (cls == YSTRING("alpha"))
+		    func = ::isalpha;
+		else if (cls == YSTRING("alnum"))
+		    func = ::isalnum;
+		else if (cls == YSTRING("upper"))
+		    func = m_icase ? ::isalpha : ::isupper;
+		else if (cls == YSTRING("lower"))
+		    func = m_icase ? ::isalpha : ::islower;
+		else if (cls == YSTRING("space"))
+		    func = ::isspace;
+		else if (cls == YSTRING("xdigit"))
+		    func = ::isxdigit;
+		else if (cls == YSTRING("punct"))
+		    func = ::ispunct;
+		else if (cls == YSTRING("print"))
+		    func = ::isprint;
+		else if (cls == YSTRING("graph"))
+		    func = ::isgraph;
+		else if (cls == YSTRING("cntrl"))
+		    func = ::iscntrl;
+		else if (cls == YSTRING("blank"))
+		    func = ::isblank;
+		else
+		    return 0;
+		for (int i = 1; i < 256; i++)
+		    if (func(i))
+			setChar(set,i);
+		m_pos = end + 2;
+		continue;
+	    }
+	}
+	m_pos++;
+	if (m_icase)
+	    c = ::toupper(c);
+	if (m_pos[0] == '-' && m_pos[1] && m_pos[1] != ']') {
+	    unsigned char hi = (unsigned char)m_pos[1];
+	    if (m_icase)
+		hi = ::toupper(hi);
+	    if (hi == '[' || hi < c)
+		return 0;
+	    m_pos += 2;
+	    for (unsigned int i = c; i <= hi; i++)
+		setChar(set,i);
+	}
+	else
+	    setChar(set,c);
+    }
+    if (neg) {
+	unsigned char* bits = m_sets + 32 * set;
+	for (int i = 0; i < 32; i++)
+	    bits[i] = ~bits[i];
+	bits[0] &= 0xfe;
+    }
+    foldSet(set);
+    RxNode* n = node(RxNode::Set);
+    if (n)
+	n->set = set;
+    return n;
+}
+
+
+RegexpDfa::RegexpDfa()
+    : m_states(0), m_count(0), m_max(0), m_start(-1), m_sets(0),
+      m_classCount(0), m_begin(0),
+      m_dfaCount(0), m_full(false),
+      m_stack(0), m_work(0), m_workCount(0), m_marks(0), m_mark(0)
+{
+    ::memset(m_hash,0,sizeof(m_hash));
+}
+
+RegexpDfa::~RegexpDfa()
+{
+    for (unsigned int i = 0; i < 64; i++) {
+	while (RxDfaState* s = m_hash[i]) {
+	    m_hash[i] = s->chain;
+	    ::free(s);
+	}
+    }
+    delete[] m_states;
+    delete[] m_sets;
+    delete[] m_stack;
+    delete[] m_work;
+    delete[] m_marks;
+}
+
+RegexpDfa* RegexpDfa::build(const char* pattern, int flags)
+{
+    if (TelEngine::null(pattern))
+	return 0;
+    RxParser parser(pattern,0 != (flags & REG_EXTENDED),0 != (flags & REG_ICASE));
+    RxNode* root = parser.parse();
+    if (!root)
+	return 0;
+    RegexpDfa* dfa = new RegexpDfa;
+    dfa->m_max = RX_MAX_NFA;
+    dfa->m_states = new RxState[RX_MAX_NFA];
+    int match = dfa->addState(RxState::Match,-1);
+    dfa->m_start = dfa->compile(root,match);
+    if (dfa->m_start < 0) {
+	delete dfa;
+	return 0;
+    }
+    // take ownership of the character sets
+    dfa->m_sets = parser.m_sets;
+    parser.m_sets = 0;
+    // split the bytes in classes that all the sets treat the same way
+    ::memset(dfa->m_classes,0,sizeof(dfa->m_classes));
+    unsigned int classes = 1;
+    for (int s = 0; s < parser.m_setCount; s++) {
+	const unsigned char* bits = dfa->m_sets + 32 * s;
+	int map[512];
+	for (int i = 0; i < 512; i++)
+	    map[i] = -1;
+	unsigned int n = 0;
+	for (int c = 0; c < 256; c++) {
+	    int key = 2 * dfa->m_classes[c] + ((bits[c >> 3] >> (c & 7)) & 1);
+	    if (map[key] < 0)
+		map[key] = n++;
+	    dfa->m_classes[c] = map[key];
+	}
+	classes = n;
+    }
+    dfa->m_classCount = classes;
+    for (int c = 255; c >= 0; c--)
+	dfa->m_classRep[dfa->m_classes[c]] = c;
+    dfa->m_stack = new int[dfa->m_count];
+    // room for a closure and the end of input closure computed after it
+    dfa->m_work = new int[2 * dfa->m_count];
+    dfa->m_marks = new unsigned int[dfa->m_count];
+    ::memset(dfa->m_marks,0,dfa->m_count * sizeof(unsigned int));
+    // the initial state is the only one where '^' can match
+    dfa->m_mark++;
+    dfa->m_workCount = 0;
+    dfa->closure(dfa->m_start,true,false);
+    dfa->m_begin = dfa->makeState(true);
+    if (!dfa->m_begin) {
+	delete dfa;
+	return 0;
+    }
+    XDebug(DebugAll,"RegexpDfa built '%s' with %d states, %u classes",
+	pattern,dfa->m_count,classes);
+    return dfa;
+}
+
+int RegexpDfa::addState(int type, int out, int out1, int set)
+{
+    if (m_count >= m_max)
+	return -1;
+    RxState& s = m_states[m_count];
+    s.type = type;
+    s.out = out;
+    s.out1 = out1;
+    s.set = set;
+    return m_count++;
+}
+
+// Compile a parse tree into NFA states, working backwards from the continuation
+int RegexpDfa::compile(const RxNode* n, int next)
+{
+    if (next < 0)
+	return -1;
+    switch (n->type) {
+	case RxNode::Empty:
+	    return next;
+	case RxNode::Set:
+	    return addState(RxState::Char,next,-1,n->set);
+	case RxNode::Begin:
+	    return addState(RxState::Begin,next);
+	case RxNode::End:
+	    return addState(RxState::End,next);
+	case RxNode::Cat:
+	    return compile(n->left,compile(n->right,next));
+	case RxNode::Alt:
+	    {
+		int a = compile(n->left,next);
+		int b = compile(n->right,next);
+		if (a < 0 || b < 0)
+		    return -1;
+		return addState(RxState::Split,a,b);
+	    }
+	case RxNode::Rep:
+	    {
+		int cur = next;
+		if (n->max < 0) {
+		    int loop = addState(RxState::Split,-1,next);
+		    if (loop < 0)
+			return -1;
+		    int body = compile(n->left,loop);
+		    if (body < 0)
+			return -1;
+		    m_states[loop].out = body;
+		    cur = loop;
+		}
+		else {
+		    for (int i = n->min; i < n->max && cur >= 0; i++) {
+			int body = compile(n->left,cur);
+			if (body < 0)
+			    return -1;
+			cur = addState(RxState::Split,body,next);
+		    }
+		}
+		for (int i = 0; i < n->min && cur >= 0; i++)
+		    cur = compile(n->left,cur);
+		return cur;
+	    }
+    }
+    return -1;
+}
+
+// Add to the work list the states that consume input or finish the match
+void RegexpDfa::closure(int state, bool atBegin, bool atEnd) const
+{
+#define RX_PUSH(n) if (m_marks[n] != m_mark) { m_marks[n] = m_mark; m_stack[sp++] = n; }
+    int sp = 0;
+    RX_PUSH(state);
+    while (sp) {
+	int i = m_stack[--sp];
+	const RxState& s = m_states[i];
+	switch (s.type) {
+	    case RxState::Split:
+		RX_PUSH(s.out1);
+		RX_PUSH(s.out);
+		break;
+	    case RxState::Begin:
+		if (atBegin)
+		    RX_PUSH(s.out);
+		break;
+	    case RxState::End:
+		if (atEnd) {
+		    RX_PUSH(s.out);
+		    break;
+		}
+		// fall through
+	    default:
+		m_work[m_workCount++] = i;
+	}
+    }
+#undef RX_PUSH
+}
+
+static int rxCompare(const void* a, const void* b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+// Find or create the DFA state for the current work list
+RxDfaState* RegexpDfa::makeState(bool begin) const
+{
+    ::qsort(m_work,m_workCount,sizeof(int),rxCompare);
+    unsigned int hash = begin ? 1 : 0;
+    for (int i = 0; i < m_workCount; i++)
+	hash = hash * 31 + m_work[i];
+    RxDfaState** bucket = m_hash + (hash % 64);
+    for (RxDfaState* s = *bucket; s; s = s->chain) {
+	if (s->hash == hash && s->begin == begin && s->count == m_workCount
+	    && !::memcmp(s->kernel,m_work,m_workCount * sizeof(int)))
+	    return s;
+    }
+    if (m_dfaCount >= RX_MAX_DFA) {
+	m_full = true;
+	return 0;
+    }
+    unsigned int size = sizeof(RxDfaState) + m_classCount * sizeof(RxDfaState*)
+	+ m_workCount * sizeof(int);
+    RxDfaState* s = (RxDfaState*)::calloc(1,size);
+    if (!s) {
+	m_full = true;
+	return 0;
+    }
+    s->next = (RxDfaState**)(s + 1);
+    s->kernel = (int*)(s->next + m_classCount);
+    s->count = m_workCount;
+    ::memcpy(s->kernel,m_work,m_workCount * sizeof(int));
+    s->hash = hash;
+    s->begin = begin;
+    for (int i = 0; i < m_workCount; i++) {
+	if (RxState::Match == m_states[m_work[i]].type) {
+	    s->match = true;
+	    break;
+	}
+    }
+    s->endMatch = s->match;
+    if (!s->match) {
+	// check if the pending '$' anchors lead to a match at end of input
+	m_mark++;
+	int save = m_workCount;
+	for (int i = 0; i < save; i++) {
+	    const RxState& st = m_states[m_work[i]];
+	    if (RxState::End == st.type)
+		closure(st.out,begin,true);
+	}
+	for (int i = save; i < m_workCount; i++) {
+	    if (RxState::Match == m_states[m_work[i]].type) {
+		s->endMatch = true;
+		break;
+	    }
+	}
+	m_workCount = save;
+    }
+    s->chain = *bucket;
+    *bucket = s;
+    m_dfaCount++;
+    return s;
+}
+
+// Compute a transition, the search restarts at each position as regexec() does
+RxDfaState* RegexpDfa::step(RxDfaState* s, unsigned int cls) const
+{
+    Lock lck(s_dfaMutex);
+    RxDfaState* n = s->next[cls];
+    if (n || m_full)
+	return n;
+    unsigned char c = m_classRep[cls];
+    m_mark++;
+    m_workCount = 0;
+    for (int i = 0; i < s->count; i++) {
+	const RxState& st = m_states[s->kernel[i]];
+	if (RxState::Char == st.type && ((m_sets[32 * st.set + (c >> 3)] >> (c & 7)) & 1))
+	    closure(st.out,false,false);
+    }
+    closure(m_start,false,false);
+    n = makeState(false);
+    if (n) {
+	// make sure the new state is visible before it can be reached
+	RX_BARRIER();
+	s->next[cls] = n;
+    }
+    return n;
+}
+
+int RegexpDfa::matches(const char* value) const
+{
+    RxDfaState* s = m_begin;
+    for (const unsigned char* p = (const unsigned char*)value; *p; p++) {
+	if (s->match)
+	    return 1;
+	// nothing left that could match, not even by restarting the search
+	if (!s->count)
+	    return 0;
+	unsigned int cls = m_classes[*p];
+	RxDfaState* n = s->next[cls];
+	if (!n) {
+	    n = step(s,cls);
+	    if (!n)
+		return -1;
+	}
+	s = n;
+    }
+    return s->endMatch ? 1 : 0;
+}
+
 Regexp::Regexp()
-    : m_regexp(0), m_compile(true), m_flags(0)
+    : m_regexp(0), m_dfa(0), m_compile(true), m_flags(0)
 {
     XDebug(DebugAll,"Regexp::Regexp() [%p]",this);
 }
 
 Regexp::Regexp(const char* value, bool extended, bool insensitive)
-    : String(value), m_regexp(0), m_compile(true), m_flags(0)
+    : String(value), m_regexp(0), m_dfa(0), m_compile(true), m_flags(0)
 {
     XDebug(DebugAll,"Regexp::Regexp(\"%s\",%d,%d) [%p]",
 	value,extended,insensitive,this);
@@ -1747,7 +2578,7 @@ Regexp::Regexp(const char* value, bool extended, bool insensitive)
 }
 
 Regexp::Regexp(const Regexp& value)
-    : String(value.c_str()), m_regexp(0), m_compile(true), m_flags(value.m_flags)
+    : String(value.c_str()), m_regexp(0), m_dfa(0), m_compile(true), m_flags(value.m_flags)
 {
     XDebug(DebugAll,"Regexp::Regexp(%p) [%p]",&value,this);
 }
@@ -1764,6 +2595,11 @@ bool Regexp::matches(const char* value, StringMatchPrivate* matchlist) const
 	value = "";
     if (!compile())
 	return false;
+    if (m_dfa && !matchlist) {
+	int ok = static_cast<const RegexpDfa*>(m_dfa)->matches(value);
+	if (ok >= 0)
+	    return (ok > 0);
+    }
     int mm = matchlist ? MAX_MATCH : 0;
     regmatch_t *mt = matchlist ? (matchlist->rmatch)+1 : 0;
     return !::regexec((regex_t *)m_regexp,value,mm,mt,0);
@@ -1795,8 +2631,10 @@ bool Regexp::doCompile() const
 	    ::regfree(data);
 	    ::free(data);
 	}
-	else
+	else {
 	    m_regexp = (void *)data;
+	    m_dfa = RegexpDfa::build(c_str(),m_flags);
+	}
     }
     return (m_regexp != 0);
 }
@@ -1804,6 +2642,10 @@ bool Regexp::doCompile() const
 void Regexp::cleanup()
 {
     XDebug(DebugInfo,"Regexp::cleanup()");
+    if (m_dfa) {
+	delete static_cast<RegexpDfa*>(m_dfa);
+	m_dfa = 0;
+    }
     if (m_regexp) {
 	regex_t *data = (regex_t *)m_regexp;
 	m_regexp = 0;
@@ -564,7 +564,7 @@ Runnable::~Runnable()
 }
 
 Thread::Thread(const char* name, Priority prio)
-    : m_private(0), m_locks(0), m_locking(false)
+    : m_private(0), m_locks(0), m_locking(false), m_lockProfile(0)
 {
 #ifdef DEBUG
     Debugger debug("Thread::Thread","(\"%s\",%d) [%p]",name,prio,this);
@@ -573,7 +573,7 @@ Thread::Thread(const char* name, Priority prio)
 }
 
 Thread::Thread(const char *name, const char* prio)
-    : m_private(0), m_locks(0), m_locking(false)
+    : m_private(0), m_locks(0), m_locking(false), m_lockProfile(0)
 {
 #ifdef DEBUG
     Debugger debug("Thread::Thread","(\"%s\",\"%s\") [%p]",name,prio,this);
@@ -586,6 +586,7 @@ Thread::~Thread()
     DDebug(DebugAll,"Thread::~Thread() [%p]",this);
     if (m_private)
 	m_private->pubdestroy();
+    Lockable::profilingDone(this);
 }
 
 bool Thread::error() const
@@ -19,12 +19,17 @@
 
 #include "yateclass.h"
 
+#include <string.h>
+#include <ctype.h>
+
 using namespace TelEngine;
 
 static const String s_jabber("jabber");
 static const String s_xmpp("xmpp");
 static const String s_tel("tel");
 
+bool URI::s_fastParse = true;
+
 URI::URI()
     : m_parsed(false)
 {
@@ -84,6 +89,156 @@ void URI::changed()
     String::changed();
 }
 
+// Skip the characters in the C locale whitespace class
+static inline int uriSpaces(const char* s, int i)
+{
+    while (::isspace((unsigned char)s[i]))
+	i++;
+    return i;
+}
+
+// Single pass equivalent of the description regular expressions
+// Returns true and the description and address spans if one was found
+static bool uriDesc(const char* s, int& dPos, int& dLen, int& aPos, int& aLen)
+{
+    int i = uriSpaces(s,0);
+    if (s[i] == '"') {
+	// "description" address
+	const char* q = ::strchr(s + i + 1,'"');
+	if (q && (q - s) > i + 1) {
+	    dPos = i + 1;
+	    dLen = q - s - dPos;
+	    aPos = uriSpaces(s,q - s + 1);
+	    aLen = ::strlen(s + aPos);
+	    return true;
+	}
+    }
+    // description <address
+    const char* l = ::strchr(s,'<');
+    if (!l || !l[1] || l[1] == '>')
+	return false;
+    int end = l - s;
+    while (end > i && ::isspace((unsigned char)s[end - 1]))
+	end--;
+    if (end <= i)
+	return false;
+    dPos = i;
+    dLen = end - i;
+    aPos = l - s + 1;
+    const char* g = ::strchr(l + 1,'>');
+    aLen = g ? (g - l - 1) : ::strlen(l + 1);
+    return true;
+}
+
+// Single pass equivalent of the <address> regular expression
+static bool uriAngled(const char* s, int& aPos, int& aLen)
+{
+    for (const char* l = ::strchr(s,'<'); l; l = ::strchr(l + 1,'<')) {
+	const char* g = ::strchr(l + 1,'>');
+	if (!g)
+	    return false;
+	if (g > l + 1) {
+	    aPos = l - s + 1;
+	    aLen = g - l - 1;
+	    return true;
+	}
+    }
+    return false;
+}
+
+static inline bool uriHostChar(unsigned char c)
+{
+    return ::isalnum(c) || c == '.' || c == '_' || c == '+' || c == '-';
+}
+
+static inline bool uriHexChar(unsigned char c)
+{
+    return ::isxdigit(c) || c == '.' || c == ':';
+}
+
+// Length of a [user@] part starting at s, zero if there is none
+static int uriUserLen(const char* s)
+{
+    int i = 0;
+    for (;; i++) {
+	unsigned char c = (unsigned char)s[i];
+	if (!c || c == '@' || ::isspace(c) || ::iscntrl(c))
+	    break;
+    }
+    return (i && s[i] == '@') ? i + 1 : 0;
+}
+
+// Length of a host name or [IPv6] literal starting at s, zero if invalid
+static int uriHostLen(const char* s)
+{
+    int i = 0;
+    if (s[0] == '[') {
+	for (i = 1; uriHexChar((unsigned char)s[i]); i++)
+	    ;
+	return (i > 1 && s[i] == ']') ? i + 1 : 0;
+    }
+    while (uriHostChar((unsigned char)s[i]))
+	i++;
+    return i;
+}
+
+// Length of a :port part starting at s, zero if there is none
+static int uriPortLen(const char* s)
+{
+    if (s[0] != ':')
+	return 0;
+    int i = 1;
+    while (::isdigit((unsigned char)s[i]))
+	i++;
+    return (i > 1) ? i : 0;
+}
+
+// Single pass equivalent of the address regular expression
+// Each optional part of [proto:][//][user@]host[:port] is tried from longest
+//  to shortest, the longest overall match wins like in a POSIX regexec()
+// Fills offsets and lengths of protocol, user, host and port, returns end of match
+static int uriAddress(const char* s, int* pos, int* len)
+{
+    int proto = 0;
+    if (::isalpha((unsigned char)s[0])) {
+	int i = 1;
+	while (::isalnum((unsigned char)s[i]))
+	    i++;
+	if (i > 1 && s[i] == ':')
+	    proto = i + 1;
+    }
+    int best = -1;
+    for (int p = proto; p >= 0; p -= (p ? p : 1)) {
+	int slashes = 0;
+	while (slashes < 2 && s[p + slashes] == '/')
+	    slashes++;
+	for (int sl = slashes; sl >= 0; sl--) {
+	    int u = p + sl;
+	    int user = uriUserLen(s + u);
+	    for (int ul = user; ul >= 0; ul -= (ul ? ul : 1)) {
+		int h = u + ul;
+		int host = uriHostLen(s + h);
+		if (!host)
+		    continue;
+		int port = uriPortLen(s + h + host);
+		int end = h + host + port;
+		if (end <= best)
+		    continue;
+		best = end;
+		pos[0] = 0;
+		len[0] = p;
+		pos[1] = u;
+		len[1] = ul;
+		pos[2] = h;
+		len[2] = host;
+		pos[3] = h + host;
+		len[3] = port;
+	    }
+	}
+    }
+    return best;
+}
+
 void URI::parse() const
 {
     if (m_parsed)
@@ -91,7 +246,40 @@ void URI::parse() const
     DDebug("URI",DebugAll,"parsing '%s' [%p]",c_str(),this);
     m_port = 0;
     m_desc.clear();
+    if (s_fastParse)
+	parseFast();
+    else
+	parseRegexp();
+    m_parsed = true;
+}
+
+// Hand written scanner, produces the same results as the regular expressions
+void URI::parseFast() const
+{
+    String tmp(*this);
+    int pos[4];
+    int len[4];
+    if (uriDesc(tmp.safe(),pos[0],len[0],pos[1],len[1])) {
+	m_desc.assign(tmp.c_str() + pos[0],len[0]);
+	tmp = tmp.substr(pos[1],len[1]);
+	*const_cast<URI*>(this) = tmp;
+	DDebug("URI",DebugAll,"new value='%s' [%p]",c_str(),this);
+    }
+    if (uriAngled(tmp.safe(),pos[0],len[0])) {
+	tmp = tmp.substr(pos[0],len[0]);
+	*const_cast<URI*>(this) = tmp;
+	DDebug("URI",DebugAll,"new value='%s' [%p]",c_str(),this);
+    }
+    int end = uriAddress(tmp.safe(),pos,len);
+    if (end < 0 || !setParts(tmp.substr(pos[0],len[0] - (len[0] ? 1 : 0)),
+	    tmp.substr(pos[1],len[1] - (len[1] ? 1 : 0)),tmp.substr(pos[2],len[2]),
+	    tmp.substr(pos[3],len[3]),tmp.substr(end)))
+	clearParts();
+}
 
+// Original parser built on regular expressions
+void URI::parseRegexp() const
+{
     // the compiler generates wrong code so use the temporary
     String tmp(*this);
     bool hasDesc = false;
@@ -122,43 +310,55 @@ void URI::parse() const
     // [proto:][//][user@]hostname[:port][/path][;params][?params][&params]
 
     static const Regexp r4("^\\([[:alpha:]][[:alnum:]]\\+:\\)\\?/\\?/\\?\\([^[:space:][:cntrl:]@]\\+@\\)\\?\\([[:alnum:]._+-]\\+\\|[[][[:xdigit:].:]\\+[]]\\)\\(:[0-9]\\+\\)\\?");
-    // hack: use while only so we could break out of it
-    while (tmp.matches(r4)) {
-	int errptr = -1;
-	m_proto = tmp.matchString(1).toLower();
-	m_proto = m_proto.substr(0,m_proto.length()-1);
-	m_user = tmp.matchString(2);
-	m_user = m_user.substr(0,m_user.length()-1);
-	if (m_proto && s_jabber != m_proto && s_xmpp != m_proto) {
-	    m_user = m_user.uriUnescape(&errptr);
-	    if (errptr >= 0)
-		break;
-	}
-	m_host = tmp.matchString(3).uriUnescape(&errptr).toLower();
-	if (errptr >= 0)
-	    break;
-	if (m_user.null() && (s_tel == m_proto)) {
-	    m_user = m_host;
-	    m_host.clear();
-	}
-	if (m_host[0] == '[')
-	    m_host = m_host.substr(1,m_host.length()-2);
-	String p = tmp.matchString(4);
-	p >> ":" >> m_port;
-	DDebug("URI",DebugAll,"desc='%s' proto='%s' user='%s' host='%s' port=%d [%p]",
-	    m_desc.c_str(), m_proto.c_str(), m_user.c_str(), m_host.c_str(), m_port, this);
+    if (tmp.matches(r4)) {
+	String proto = tmp.matchString(1);
+	String user = tmp.matchString(2);
 	int index = (tmp.matchLength(4) > 0) ? 4 : 3;
-	m_extra = tmp.substr(tmp.matchOffset(index) + tmp.matchLength(index));
-	m_parsed = true;
-	return;
+	if (setParts(proto.substr(0,proto.length() - 1),user.substr(0,user.length() - 1),
+		tmp.matchString(3),tmp.matchString(4),
+		tmp.substr(tmp.matchOffset(index) + tmp.matchLength(index))))
+	    return;
+    }
+    clearParts();
+}
+
+bool URI::setParts(const String& proto, const String& user, const String& host,
+    const String& port, const String& extra) const
+{
+    int errptr = -1;
+    m_proto = proto;
+    m_proto.toLower();
+    m_user = user;
+    if (m_proto && s_jabber != m_proto && s_xmpp != m_proto) {
+	m_user = m_user.uriUnescape(&errptr);
+	if (errptr >= 0)
+	    return false;
+    }
+    m_host = host.uriUnescape(&errptr).toLower();
+    if (errptr >= 0)
+	return false;
+    if (m_user.null() && (s_tel == m_proto)) {
+	m_user = m_host;
+	m_host.clear();
     }
-    // parsing failed - clear all fields but still mark as parsed
+    if (m_host[0] == '[')
+	m_host = m_host.substr(1,m_host.length()-2);
+    String p = port;
+    p >> ":" >> m_port;
+    DDebug("URI",DebugAll,"desc='%s' proto='%s' user='%s' host='%s' port=%d [%p]",
+	m_desc.c_str(), m_proto.c_str(), m_user.c_str(), m_host.c_str(), m_port, this);
+    m_extra = extra;
+    return true;
+}
+
+// parsing failed - clear all fields but still mark as parsed
+void URI::clearParts() const
+{
     m_desc.clear();
     m_proto.clear();
     m_user.clear();
     m_host.clear();
     m_extra.clear();
-    m_parsed = true;
 }
 
 /* vi: set ts=8 sw=4 sts=4 noet: */
@@ -19,6 +19,7 @@
 
 #include <yatexml.h>
 #include <string.h>
+#include <stdlib.h>
 
 using namespace TelEngine;
 
@@ -53,21 +54,419 @@ const char* replace(char replace, const XmlEscape* esc)
     return 0;
 }
 
-// XmlEscape a string or replace it if found in a list of restrictions
-static inline void addAuth(String& buf, const String& comp, const String& value,
-    bool esc, const String* auth)
+// Escape replacements indexed by character, built from XmlSaxParser::s_escape
+class XmlEscapeTable
+{
+public:
+    inline XmlEscapeTable() {
+	    ::memset(m_value,0,sizeof(m_value));
+	    ::memset(m_length,0,sizeof(m_length));
+	    for (const XmlEscape* esc = XmlSaxParser::s_escape; esc->value; esc++) {
+		m_value[(unsigned char)esc->replace] = esc->value;
+		m_length[(unsigned char)esc->replace] = ::strlen(esc->value);
+	    }
+	}
+    const char* m_value[256];
+    unsigned char m_length[256];
+};
+
+static const XmlEscapeTable s_escapeTable;
+
+// Growable buffer used to build the string representation of XML objects in one pass
+class XmlOutput
+{
+public:
+    inline XmlOutput()
+	: m_buf(0), m_length(0), m_size(0)
+	{}
+    inline ~XmlOutput()
+	{ ::free(m_buf); }
+    inline void append(const char* str, unsigned int len) {
+	    if (!len)
+		return;
+	    if (m_length + len > m_size && !grow(len))
+		return;
+	    ::memcpy(m_buf + m_length,str,len);
+	    m_length += len;
+	}
+    inline void append(const String& str)
+	{ append(str.c_str(),str.length()); }
+    inline void append(const char* str)
+	{ if (str) append(str,::strlen(str)); }
+    inline XmlOutput& operator<<(const String& str)
+	{ append(str); return *this; }
+    inline XmlOutput& operator<<(const char* str)
+	{ append(str); return *this; }
+    // Append text escaping the characters having a replacement
+    void escape(const String& text);
+    // Escape a string or replace it if found in a list of restrictions
+    void addAuth(const String& comp, const String& value, bool esc, const String* auth);
+    // Append the buffer to a string
+    inline void flush(String& dump) {
+	    if (m_length)
+		dump.append(m_buf,m_length);
+	    m_length = 0;
+	}
+private:
+    bool grow(unsigned int len);
+    char* m_buf;
+    unsigned int m_length;
+    unsigned int m_size;
+};
+
+// Make room for len more bytes, double the buffer to keep appends linear
+bool XmlOutput::grow(unsigned int len)
+{
+    unsigned int size = m_size ? m_size : 256;
+    while (size < m_length + len)
+	size <<= 1;
+    char* buf = (char*)::realloc(m_buf,size);
+    if (!buf) {
+	Debug("XmlOutput",DebugFail,"realloc(%u) returned NULL!",size);
+	return false;
+    }
+    m_buf = buf;
+    m_size = size;
+    return true;
+}
+
+// Append text escaping the characters having a replacement
+void XmlOutput::escape(const String& text)
+{
+    const char* str = text.c_str();
+    if (!str)
+	return;
+    const char* run = str;
+    for (; *str; str++) {
+	unsigned char c = (unsigned char)*str;
+	if (!s_escapeTable.m_value[c])
+	    continue;
+	append(run,str - run);
+	append(s_escapeTable.m_value[c],s_escapeTable.m_length[c]);
+	run = str + 1;
+    }
+    append(run,str - run);
+}
+
+// Escape a string or replace it if found in a list of restrictions
+void XmlOutput::addAuth(const String& comp, const String& value, bool esc, const String* auth)
 {
     if (auth) {
 	for (; !auth->null(); auth++)
 	    if (*auth == comp) {
-		buf << "***";
+		append("***",3);
 		return;
 	    }
     }
     if (esc)
-	XmlSaxParser::escape(buf,value);
+	escape(value);
     else
-	buf << value;
+	append(value);
+}
+
+static void dumpElement(XmlOutput& out, const XmlElement& xml, bool esc, const String& indent,
+    const String& origIndent, bool completeOnly, const String* auth);
+
+// Obtain string representation of a list of xml children
+static void dumpChildren(XmlOutput& out, const ObjList& children, bool esc,
+    const String& indent, const String& origIndent, bool completeOnly,
+    const String* auth, const XmlElement* parent)
+{
+    for (ObjList* ob = children.skipNull(); ob; ob = ob->skipNext()) {
+	XmlChild* obj = static_cast<XmlChild*>(ob->get());
+	if (obj->xmlElement())
+	    dumpElement(out,*obj->xmlElement(),esc,indent,origIndent,completeOnly,auth);
+	else if (obj->xmlText()) {
+	    out << indent;
+	    if (auth)
+		out.addAuth(parent ? parent->toString() : String::empty(),
+		    obj->xmlText()->getText(),esc,auth);
+	    else if (esc)
+		out.escape(obj->xmlText()->getText());
+	    else
+		out << obj->xmlText()->getText();
+	}
+	else if (obj->xmlCData())
+	    out << indent << "<![CDATA[" << obj->xmlCData()->getCData() << "]]>";
+	else if (obj->xmlComment())
+	    out << indent << "<!--" << obj->xmlComment()->getComment() << "-->";
+	else if (obj->xmlDeclaration()) {
+	    String tmp;
+	    obj->xmlDeclaration()->toString(tmp,esc);
+	    out << tmp;
+	}
+	else if (obj->xmlDoctype()) {
+	    String tmp;
+	    obj->xmlDoctype()->toString(tmp,origIndent);
+	    out << tmp;
+	}
+	else
+	    Debug(DebugStub,"XmlFragment::toString() unhandled element type!");
+    }
+}
+
+// Obtain string representation of an xml element
+static void dumpElement(XmlOutput& out, const XmlElement& xml, bool esc, const String& indent,
+    const String& origIndent, bool completeOnly, const String* auth)
+{
+    if (!xml.completed() && completeOnly)
+	return;
+    const NamedList& attrs = xml.attributes();
+    out << indent << "<" << attrs;
+    unsigned int n = attrs.length();
+    for (unsigned int i = 0; i < n; i++) {
+	NamedString* ns = attrs.getParam(i);
+	if (!ns)
+	    continue;
+	out << " " << ns->name() << "=\"";
+	out.addAuth(ns->name(),*ns,esc,auth);
+	out << "\"";
+    }
+    // Content kept as received is written unchanged unless some data must be hidden
+    const String* content = auth ? 0 : xml.rawContent();
+    if (content) {
+	out << ">" << *content;
+	if (xml.completed())
+	    out << "</" << xml.getName() << ">";
+	return;
+    }
+    ObjList* first = xml.getChildren().skipNull();
+    if (!first) {
+	out << (xml.completed() ? "/>" : ">");
+	return;
+    }
+    out << ">";
+    // Avoid adding text on new line when text is the only child
+    XmlText* text = first->skipNext() ? 0 : static_cast<XmlChild*>(first->get())->xmlText();
+    if (!text) {
+	if (origIndent)
+	    dumpChildren(out,xml.getChildren(),esc,indent + origIndent,origIndent,completeOnly,auth,&xml);
+	else
+	    dumpChildren(out,xml.getChildren(),esc,indent,origIndent,completeOnly,auth,&xml);
+    }
+    else
+	dumpChildren(out,xml.getChildren(),esc,String::empty(),origIndent,completeOnly,auth,&xml);
+    if (xml.completed())
+	out << (!text ? indent : String::empty()) << "</" << xml.getName() << ">";
+}
+
+
+// Maximum element nesting accepted in content kept as received
+#define XML_CONTENT_DEPTH 32
+// Maximum number of element attributes accepted in content kept as received
+#define XML_CONTENT_ATTRS 16
+
+// Check a name at buffer start. It must be followed by some other character
+// Return name length, 0 if incomplete, -1 if invalid
+static int checkName(const char* buf, unsigned int len)
+{
+    if (!len)
+	return 0;
+    if (buf[0] == ':' || !XmlSaxParser::checkFirstNameCharacter(buf[0]))
+	return -1;
+    unsigned int i = 1;
+    while (i < len && XmlSaxParser::checkNameCharacter(buf[i]))
+	i++;
+    return (i < len) ? (int)i : 0;
+}
+
+// Check an entity or character reference at buffer start
+// Accept only the references unescaped by the parser
+// Return reference length, 0 if incomplete, -1 if invalid
+static int checkReference(const char* buf, unsigned int len)
+{
+    unsigned int i = 1;
+    if (i < len && buf[i] == '#') {
+	unsigned int base = 10;
+	if (++i < len && buf[i] == 'x') {
+	    base = 16;
+	    i++;
+	}
+	unsigned int start = i;
+	unsigned int val = 0;
+	for (; i < len && buf[i] != ';'; i++) {
+	    char c = buf[i];
+	    unsigned int d = base;
+	    if (c >= '0' && c <= '9')
+		d = c - '0';
+	    else if (c >= 'a' && c <= 'f')
+		d = c - 'a' + 10;
+	    else if (c >= 'A' && c <= 'F')
+		d = c - 'A' + 10;
+	    if (d >= base || i - start >= (base == 10 ? 3 : 6))
+		return -1;
+	    val = val * base + d;
+	}
+	if (i >= len)
+	    return 0;
+	// Decimal references are unescaped to a single byte
+	if (i == start || (base == 10 && val > 255) || val > 0x10ffff ||
+	    (val >= 0xd800 && val < 0xe000) || val == 0xfffe || val == 0xffff ||
+	    (val < 0x20 && val != 0x09 && val != 0x0a && val != 0x0d))
+	    return -1;
+	return i + 1;
+    }
+    for (; i < len && buf[i] != ';'; i++)
+	if (i > 5)
+	    return -1;
+    if (i >= len)
+	return 0;
+    for (const XmlEscape* esc = XmlSaxParser::s_escape; esc->value; esc++)
+	if (!::strncmp(buf,esc->value,i + 1) && !esc->value[i + 1])
+	    return i + 1;
+    return -1;
+}
+
+// Check a character in text or attribute value, skip references
+// Return the number of characters checked, 0 if incomplete, -1 if invalid
+static inline int checkChar(const char* buf, unsigned int len)
+{
+    char c = buf[0];
+    if (c == '&')
+	return checkReference(buf,len);
+    if (c == '<' || c == '>' || !XmlSaxParser::checkDataChar(c))
+	return -1;
+    return 1;
+}
+
+// Add the namespace prefix of a name to a list if not already there
+static void addPrefix(ObjList& prefixes, const char* name, unsigned int len)
+{
+    const char* colon = (const char*)::memchr(name,':',len);
+    if (!colon)
+	return;
+    String prefix(name,colon - name);
+    if (prefix != YSTRING("xml") && prefix != XmlElement::s_ns && !prefixes.find(prefix))
+	prefixes.append(new String(prefix));
+}
+
+// Check element content at buffer start, stop at the element end tag
+// Collect the namespace prefixes used in content
+// Accept only well formed text, elements and CDATA sections
+// Return content length, -1 if incomplete, -2 if not accepted
+static int checkContent(const char* buf, unsigned int len, const String& tag,
+    ObjList& prefixes)
+{
+    const char* names[XML_CONTENT_DEPTH];
+    unsigned int nameLen[XML_CONTENT_DEPTH];
+    unsigned int depth = 0;
+    unsigned int i = 0;
+    while (i < len) {
+	if (buf[i] != '<') {
+	    int n = checkChar(buf + i,len - i);
+	    if (n <= 0)
+		return n ? -2 : -1;
+	    i += n;
+	    continue;
+	}
+	const char* s = buf + i;
+	unsigned int rest = len - i;
+	if (rest < 2)
+	    return -1;
+	if (s[1] == '!') {
+	    // CDATA section. Leave comments and declarations to the parser
+	    if (::strncmp(s,"<![CDATA[",rest < 9 ? rest : 9))
+		return -2;
+	    if (rest < 9)
+		return -1;
+	    const char* end = ::strstr(s + 9,"]]>");
+	    if (!end || (unsigned int)(end - s) >= rest)
+		return -1;
+	    for (const char* c = s + 9; c < end; c++)
+		if (!XmlSaxParser::checkDataChar(*c))
+		    return -2;
+	    i += end - s + 3;
+	    continue;
+	}
+	if (s[1] == '?')
+	    return -2;
+	if (s[1] == '/') {
+	    int n = checkName(s + 2,rest - 2);
+	    if (n <= 0)
+		return n ? -2 : -1;
+	    unsigned int j = n + 2;
+	    while (j < rest && XmlSaxParser::blank(s[j]))
+		j++;
+	    if (j >= rest)
+		return -1;
+	    if (s[j] != '>')
+		return -2;
+	    if (!depth)
+		return ((unsigned int)n == tag.length() && !::strncmp(s + 2,tag,n)) ? (int)i : -2;
+	    depth--;
+	    if ((unsigned int)n != nameLen[depth] || ::strncmp(s + 2,names[depth],n))
+		return -2;
+	    i += j + 1;
+	    continue;
+	}
+	// Element start tag
+	int n = checkName(s + 1,rest - 1);
+	if (n <= 0)
+	    return n ? -2 : -1;
+	addPrefix(prefixes,s + 1,n);
+	const char* attrs[XML_CONTENT_ATTRS];
+	unsigned int attrLen[XML_CONTENT_ATTRS];
+	unsigned int count = 0;
+	bool empty = false;
+	unsigned int j = n + 1;
+	while (true) {
+	    unsigned int blanks = j;
+	    while (j < rest && XmlSaxParser::blank(s[j]))
+		j++;
+	    if (j >= rest)
+		return -1;
+	    if (s[j] == '>')
+		break;
+	    if (s[j] == '/') {
+		if (++j >= rest)
+		    return -1;
+		if (s[j] != '>')
+		    return -2;
+		empty = true;
+		break;
+	    }
+	    // Attributes must be separated by blanks and have unique names
+	    if (j == blanks || count == XML_CONTENT_ATTRS)
+		return -2;
+	    int a = checkName(s + j,rest - j);
+	    if (a <= 0)
+		return a ? -2 : -1;
+	    for (unsigned int k = 0; k < count; k++)
+		if (attrLen[k] == (unsigned int)a && !::strncmp(attrs[k],s + j,a))
+		    return -2;
+	    attrs[count] = s + j;
+	    attrLen[count++] = a;
+	    addPrefix(prefixes,s + j,a);
+	    for (j += a; j < rest && XmlSaxParser::blank(s[j]); j++)
+		;
+	    if (j < rest && s[j] != '=')
+		return -2;
+	    for (j++; j < rest && XmlSaxParser::blank(s[j]); j++)
+		;
+	    if (j >= rest)
+		return -1;
+	    char sep = s[j++];
+	    if (sep != '\'' && sep != '\"')
+		return -2;
+	    while (j < rest && s[j] != sep) {
+		int c = checkChar(s + j,rest - j);
+		if (c <= 0)
+		    return c ? -2 : -1;
+		j += c;
+	    }
+	    if (j >= rest)
+		return -1;
+	    j++;
+	}
+	i += j + 1;
+	if (empty)
+	    continue;
+	if (depth == XML_CONTENT_DEPTH)
+	    return -2;
+	names[depth] = s + 1;
+	nameLen[depth++] = n;
+    }
+    return -1;
 }
 
 
@@ -107,7 +506,7 @@ const XmlEscape XmlSaxParser::s_escape[] = {
 
 XmlSaxParser::XmlSaxParser(const char* name)
     : m_offset(0), m_row(1), m_column(1), m_error(NoError),
-    m_parsed(""), m_unparsed(None)
+    m_bufPos(0), m_bufChecked(0), m_parsed(""), m_unparsed(None)
 {
     debugName(name);
 }
@@ -129,15 +528,33 @@ bool XmlSaxParser::parse(const char* text)
     XDebug(this,DebugAll,"XmlSaxParser::parse(%s) unparsed=%u%s buf=%s [%p]",
 	text,unparsed(),tmp.safe(),m_buf.safe(),this);
 #endif
-    char car;
     setError(NoError);
-    String auxData;
+    unsigned int len = m_buf.length();
     m_buf << text;
-    if (m_buf.lenUtf8() == -1) {
+    m_offset += m_buf.length() - len;
+    // Data validated by a previous call ends on a character boundary
+    //  so only the newly appended part needs to be checked
+    if (String::lenUtf8(m_buf.c_str() + m_bufChecked) == -1) {
 	//FIXME this should not be here in case we have a different encoding
 	DDebug(this,DebugNote,"Request to parse invalid utf-8 data [%p]",this);
 	return setError(Incomplete);
     }
+    m_bufChecked = m_buf.length();
+    bool ok = parseBuffer();
+    // Drop consumed data once instead of on each parsed object
+    if (m_bufPos) {
+	m_buf = m_buf.substr(m_bufPos);
+	m_bufPos = 0;
+    }
+    m_bufChecked = m_buf.length();
+    return ok;
+}
+
+// Parse the data accumulated in buffer
+bool XmlSaxParser::parseBuffer()
+{
+    char car;
+    String auxData;
     if (unparsed()) {
 	if (unparsed() != Text) {
 	    if (!auxParse())
@@ -149,8 +566,8 @@ bool XmlSaxParser::parse(const char* text)
 	setUnparsed(None);
     }
     unsigned int len = 0;
-    while (m_buf.at(len) && !error()) {
-	car = m_buf.at(len);
+    while (bufAt(len) && !error()) {
+	car = bufAt(len);
 	if (car != '<' ) { // We have a new child check what it is
 	    if (car == '>' || !checkDataChar(car)) {
 		Debug(this,DebugNote,"XML text contains unescaped '%c' character [%p]",
@@ -161,51 +578,51 @@ bool XmlSaxParser::parse(const char* text)
 	    continue;
 	}
 	if (len > 0) {
-	    auxData << m_buf.substr(0,len);
+	    auxData << bufSubstr(0,len);
 	}
 	if (auxData.c_str()) {  // We have an end of tag or another child is riseing
 	    if (!processText(auxData))
 		return false;
-	    m_buf = m_buf.substr(len);
+	    bufSkip(len);
 	    len = 0;
 	    auxData = "";
 	}
-	char auxCar = m_buf.at(1);
+	char auxCar = bufAt(1);
 	if (!auxCar)
 	    return setError(Incomplete);
 	if (auxCar == '?') {
-	    m_buf = m_buf.substr(2);
+	    bufSkip(2);
 	    if (!parseInstruction())
 		return false;
 	    continue;
 	}
 	if (auxCar == '!') {
-	    m_buf = m_buf.substr(2);
+	    bufSkip(2);
 	    if (!parseSpecial())
 		return false;
 	    continue;
 	}
 	if (auxCar == '/') {
-	    m_buf = m_buf.substr(2);
+	    bufSkip(2);
 	    if (!parseEndTag())
 		return false;
 	    continue;
 	}
 	// If we are here mens that we have a element
 	// process an xml element
-	m_buf = m_buf.substr(1);
+	bufSkip(1);
 	if (!parseElement())
 	    return false;
     }
     // Incomplete text
-    if ((unparsed() == None || unparsed() == Text) && (auxData || m_buf)) {
+    if ((unparsed() == None || unparsed() == Text) && (auxData || bufLength())) {
 	if (!auxData)
-	    m_parsed.assign(m_buf);
+	    m_parsed.assign(bufData(),bufLength());
 	else {
-	    auxData << m_buf;
+	    auxData.append(bufData(),bufLength());
 	    m_parsed.assign(auxData);
 	}
-	m_buf = "";
+	bufSet(String::empty());
 	setUnparsed(Text);
 	return setError(Incomplete);
     }
@@ -213,7 +630,7 @@ bool XmlSaxParser::parse(const char* text)
 	DDebug(this,DebugNote,"Got error while parsing %s [%p]",getError(),this);
 	return false;
     }
-    m_buf = "";
+    bufSet(String::empty());
     resetParsed();
     setUnparsed(None);
     return true;
@@ -271,22 +688,22 @@ bool XmlSaxParser::parseEndTag()
 	    setUnparsed(EndTag);
 	return false;
     }
-    if (!aux || m_buf.at(0) == '/') { // The end tag has attributes or contains / char at the end of name
+    if (!aux || bufAt(0) == '/') { // The end tag has attributes or contains / char at the end of name
 	setError(ReadingEndTag);
 	Debug(this,DebugNote,"Got bad end tag </%s/> [%p]",name->c_str(),this);
 	setUnparsed(EndTag);
-	m_buf = *name + m_buf;
+	bufSet(*name + bufData());
 	return false;
     }
     resetError();
     endElement(*name);
     if (error()) {
 	setUnparsed(EndTag);
-	m_buf = *name + ">";
+	bufSet(*name + ">");
 	TelEngine::destruct(name);
 	return false;
     }
-    m_buf = m_buf.substr(1);
+    bufSkip(1);
     TelEngine::destruct(name);
     return true;
 }
@@ -294,9 +711,9 @@ bool XmlSaxParser::parseEndTag()
 // Parse an instruction form the main buffer
 bool XmlSaxParser::parseInstruction()
 {
-    XDebug(this,DebugAll,"XmlSaxParser::parseInstruction() buf len=%u [%p]",m_buf.length(),this);
+    XDebug(this,DebugAll,"XmlSaxParser::parseInstruction() buf len=%u [%p]",bufLength(),this);
     setUnparsed(Instruction);
-    if (!m_buf.c_str())
+    if (!bufLength())
 	return setError(Incomplete);
     // extract the name
     String name;
@@ -305,12 +722,12 @@ bool XmlSaxParser::parseInstruction()
     if (!m_parsed) {
 	bool nameComplete = false;
 	bool endDecl = false;
-	while (0 != (c = m_buf.at(len))) {
+	while (0 != (c = bufAt(len))) {
 	    nameComplete = blank(c);
 	    if (!nameComplete) {
 		// Check for instruction end: '?>'
 		if (c == '?') {
-		    char next = m_buf.at(len + 1);
+		    char next = bufAt(len + 1);
 		    if (!next)
 			return setError(Incomplete);
 		    if (next == '>') {
@@ -335,14 +752,14 @@ bool XmlSaxParser::parseInstruction()
 	    if (!endDecl)
 		return setError(Incomplete);
 	    // Remove instruction end from buffer
-	    m_buf = m_buf.substr(2);
+	    bufSkip(2);
 	    Debug(this,DebugNote,"Instruction with empty name [%p]",this);
 	    return setError(InvalidElementName);
 	}
 	if (!nameComplete)
 	    return setError(Incomplete);
-	name = m_buf.substr(0,len);
-	m_buf = m_buf.substr(!endDecl ? len : len + 2);
+	name = bufSubstr(0,len);
+	bufSkip(!endDecl ? len : len + 2);
 	if (name == YSTRING("xml")) {
 	    if (!endDecl)
 		return parseDeclaration();
@@ -365,7 +782,7 @@ bool XmlSaxParser::parseInstruction()
     // Retrieve instruction content
     skipBlanks();
     len = 0;
-    while (0 != (c = m_buf.at(len))) {
+    while (0 != (c = bufAt(len))) {
 	if (c != '?') {
 	    if (c == 0x0c) {
 		setError(Unknown);
@@ -376,13 +793,13 @@ bool XmlSaxParser::parseInstruction()
 	    len++;
 	    continue;
 	}
-	char ch = m_buf.at(len + 1);
+	char ch = bufAt(len + 1);
 	if (!ch)
 	    break;
 	if (ch == '>') { // end of instruction
-	    NamedString inst(name,m_buf.substr(0,len));
+	    NamedString inst(name,bufSubstr(0,len));
 	    // Parsed instruction: remove instruction end from buffer and reset parsed
-	    m_buf = m_buf.substr(len + 2);
+	    bufSkip(len + 2);
 	    resetParsed();
 	    resetError();
 	    setUnparsed(None);
@@ -399,9 +816,9 @@ bool XmlSaxParser::parseInstruction()
 // Parse a declaration form the main buffer
 bool XmlSaxParser::parseDeclaration()
 {
-    XDebug(this,DebugAll,"XmlSaxParser::parseDeclaration() buf len=%u [%p]",m_buf.length(),this);
+    XDebug(this,DebugAll,"XmlSaxParser::parseDeclaration() buf len=%u [%p]",bufLength(),this);
     setUnparsed(Declaration);
-    if (!m_buf.c_str())
+    if (!bufLength())
 	return setError(Incomplete);
     NamedList dc("xml");
     if (m_parsed.count()) {
@@ -411,8 +828,8 @@ bool XmlSaxParser::parseDeclaration()
     char c;
     skipBlanks();
     int len = 0;
-    while (m_buf.at(len)) {
-	c = m_buf.at(len);
+    while (bufAt(len)) {
+	c = bufAt(len);
 	if (c != '?') {
 	    skipBlanks();
 	    NamedString* s = getAttribute();
@@ -429,7 +846,7 @@ bool XmlSaxParser::parseDeclaration()
 		return setError(DeclarationParse);
 	    }
 	    dc.addParam(s);
-	    char ch = m_buf.at(len);
+	    char ch = bufAt(len);
 	    if (ch && !blank(ch) && ch != '?') {
 		Debug(this,DebugNote,"No blanks between attributes in declaration [%p]",this);
 		return setError(DeclarationParse);
@@ -437,15 +854,15 @@ bool XmlSaxParser::parseDeclaration()
 	    skipBlanks();
 	    continue;
 	}
-	if (!m_buf.at(++len))
+	if (!bufAt(++len))
 	    break;
-	char ch = m_buf.at(len);
+	char ch = bufAt(len);
 	if (ch == '>') { // end of declaration
 	    // Parsed declaration: remove declaration end from buffer and reset parsed
 	    resetError();
 	    resetParsed();
 	    setUnparsed(None);
-	    m_buf = m_buf.substr(len + 1);
+	    bufSkip(len + 1);
 	    gotDeclaration(dc);
 	    return error() == NoError;
 	}
@@ -460,7 +877,7 @@ bool XmlSaxParser::parseDeclaration()
 // Parse a CData section form the main buffer
 bool XmlSaxParser::parseCData()
 {
-    if (!m_buf.c_str()) {
+    if (!bufLength()) {
 	setUnparsed(CData);
 	setError(Incomplete);
 	return false;
@@ -472,28 +889,27 @@ bool XmlSaxParser::parseCData()
     }
     char c;
     int len = 0;
-    while (m_buf.at(len)) {
-	c = m_buf.at(len);
+    while (bufAt(len)) {
+	c = bufAt(len);
 	if (c != ']') {
 	    len ++;
 	    continue;
 	}
-	if (m_buf.substr(++len,2) == "]>") { // End of CData section
-	    cdata += m_buf.substr(0,len - 1);
+	if (bufSubstr(++len,2) == "]>") { // End of CData section
+	    cdata += bufSubstr(0,len - 1);
 	    resetError();
 	    gotCdata(cdata);
 	    resetParsed();
 	    if (error())
 		return false;
-	    m_buf = m_buf.substr(len + 2);
+	    bufSkip(len + 2);
 	    return true;
 	}
     }
-    cdata += m_buf;
-    m_buf = "";
+    cdata.append(bufData(),bufLength());
     setUnparsed(CData);
     int length = cdata.length();
-    m_buf << cdata.substr(length - 2);
+    bufSet(cdata.substr(length - 2));
     if (length > 1)
 	m_parsed.assign(cdata.substr(0,length - 2));
     setError(Incomplete);
@@ -503,34 +919,34 @@ bool XmlSaxParser::parseCData()
 // Helper method to classify the Xml objects starting with "<!" sequence
 bool XmlSaxParser::parseSpecial()
 {
-    if (m_buf.length() < 2) {
+    if (bufLength() < 2) {
 	setUnparsed(Special);
 	return setError(Incomplete);
     }
-    if (m_buf.startsWith("--")) {
-	m_buf = m_buf.substr(2);
+    if (!::strncmp(bufData(),"--",2)) {
+	bufSkip(2);
 	if (!parseComment())
 	    return false;
 	return true;
     }
-    if (m_buf.length() < 7) {
+    if (bufLength() < 7) {
 	setUnparsed(Special);
 	return setError(Incomplete);
     }
-    if (m_buf.startsWith("[CDATA[")) {
-	m_buf = m_buf.substr(7);
+    if (!::strncmp(bufData(),"[CDATA[",7)) {
+	bufSkip(7);
 	if (!parseCData())
 	    return false;
 	return true;
     }
-    if (m_buf.startsWith("DOCTYPE")) {
-	m_buf = m_buf.substr(7);
+    if (!::strncmp(bufData(),"DOCTYPE",7)) {
+	bufSkip(7);
 	if (!parseDoctype())
 	    return false;
 	return true;
     }
     Debug(this,DebugNote,"Can't parse unknown special starting with '%s' [%p]",
-	m_buf.c_str(),this);
+	bufData(),this);
     setError(Unknown);
     return false;
 }
@@ -546,8 +962,8 @@ bool XmlSaxParser::parseComment()
     }
     char c;
     int len = 0;
-    while (m_buf.at(len)) {
-	c = m_buf.at(len);
+    while (bufAt(len)) {
+	c = bufAt(len);
 	if (c != '-') {
 	    if (c == 0x0c) {
 		Debug(this,DebugNote,"Xml comment with unaccepted character '%c' [%p]",c,this);
@@ -556,9 +972,9 @@ bool XmlSaxParser::parseComment()
 	    len++;
 	    continue;
 	}
-	if (m_buf.at(len + 1) == '-' && m_buf.at(len + 2) == '>') { // End of comment
-	    comment << m_buf.substr(0,len);
-	    m_buf = m_buf.substr(len + 3);
+	if (bufAt(len + 1) == '-' && bufAt(len + 2) == '>') { // End of comment
+	    comment << bufSubstr(0,len);
+	    bufSkip(len + 3);
 #ifdef DEBUG
 	    if (comment.at(0) == '-' || comment.at(comment.length() - 1) == '-')
 		DDebug(this,DebugInfo,"Comment starts or ends with '-' character [%p]",this);
@@ -574,11 +990,11 @@ bool XmlSaxParser::parseComment()
 	len++;
     }
     // If we are here we haven't detect the end of comment
-    comment << m_buf;
+    comment.append(bufData(),bufLength());
     int length = comment.length();
     // Keep the last 2 charaters in buffer because if the input buffer ends
     // between "--" and ">"
-    m_buf = comment.substr(length - 2);
+    bufSet(comment.substr(length - 2));
     setUnparsed(Comment);
     if (length > 1)
 	m_parsed.assign(comment.substr(0,length - 2));
@@ -588,8 +1004,8 @@ bool XmlSaxParser::parseComment()
 // Parse an element form the main buffer
 bool XmlSaxParser::parseElement()
 {
-    XDebug(this,DebugAll,"XmlSaxParser::parseElement() buf len=%u [%p]",m_buf.length(),this);
-    if (!m_buf.c_str()) {
+    XDebug(this,DebugAll,"XmlSaxParser::parseElement() buf len=%u [%p]",bufLength(),this);
+    if (!bufLength()) {
 	setUnparsed(Element);
 	return setError(Incomplete);
     }
@@ -615,38 +1031,25 @@ bool XmlSaxParser::parseElement()
     }
     if (empty) { // empty flag means that the element does not have attributes
 	// check if the element is empty
-	bool aux = m_buf.at(0) == '/';
-	if (!processElement(m_parsed,aux))
-	    return false;
-	if (aux)
-	    m_buf = m_buf.substr(2); // go back where we were
-	else
-	    m_buf = m_buf.substr(1); // go back where we were
-	return true;
+	bool aux = bufAt(0) == '/';
+	return processElement(m_parsed,aux,aux ? 2 : 1);
     }
     char c;
     skipBlanks();
     int len = 0;
-    while (m_buf.at(len)) {
-	c = m_buf.at(len);
+    while (bufAt(len)) {
+	c = bufAt(len);
 	if (c == '/' || c == '>') { // end of element declaration
-	    if (c == '>') {
-		if (!processElement(m_parsed,false))
-		    return false;
-		m_buf = m_buf.substr(1);
-		return true;
-	    }
-	    if (!m_buf.at(++len))
+	    if (c == '>')
+		return processElement(m_parsed,false,1);
+	    if (!bufAt(++len))
 		break;
-	    char ch = m_buf.at(len);
+	    char ch = bufAt(len);
 	    if (ch != '>') {
 		Debug(this,DebugNote,"Element attribute name contains '/' character [%p]",this);
 		return setError(ReadingAttributes);
 	    }
-	    if (!processElement(m_parsed,true))
-		return false;
-	    m_buf = m_buf.substr(len + 1);
-	    return true;
+	    return processElement(m_parsed,true,len + 1);
 	}
 	NamedString* ns = getAttribute();
 	if (!ns) { // Attribute is invalid
@@ -662,7 +1065,7 @@ bool XmlSaxParser::parseElement()
 	XDebug(this,DebugAll,"Parser adding attribute %s='%s' to '%s' [%p]",
 	    ns->name().c_str(),ns->c_str(),m_parsed.c_str(),this);
 	m_parsed.setParam(ns);
-	char ch = m_buf.at(len);
+	char ch = bufAt(len);
 	if (ch && !blank(ch) && (ch != '/' && ch != '>')) {
 	    Debug(this,DebugNote,"Element without blanks between attributes [%p]",this);
 	    return setError(NotWellFormed);
@@ -676,44 +1079,44 @@ bool XmlSaxParser::parseElement()
 // Parse a doctype form the main buffer
 bool XmlSaxParser::parseDoctype()
 {
-    if (!m_buf.c_str()) {
+    if (!bufLength()) {
 	setUnparsed(Doctype);
 	setError(Incomplete);
 	return false;
     }
     unsigned int len = 0;
     skipBlanks();
-    while (m_buf.at(len) && !blank(m_buf.at(len)))
+    while (bufAt(len) && !blank(bufAt(len)))
 	len++;
     // Use a while() to break to the end
-    while (m_buf.at(len)) {
-	while (m_buf.at(len) && blank(m_buf.at(len)))
+    while (bufAt(len)) {
+	while (bufAt(len) && blank(bufAt(len)))
 	    len++;
-	if (len >= m_buf.length())
+	if (len >= bufLength())
 	   break;
-	if (m_buf[len++] == '[') {
-	    while (len < m_buf.length()) {
-		if (m_buf[len] != ']') {
+	if (bufAt(len++) == '[') {
+	    while (len < bufLength()) {
+		if (bufAt(len) != ']') {
 		    len ++;
 		    continue;
 		}
-		if (m_buf.at(++len) != '>')
+		if (bufAt(++len) != '>')
 		    continue;
-		gotDoctype(m_buf.substr(0,len));
+		gotDoctype(bufSubstr(0,len));
 		resetParsed();
-		m_buf = m_buf.substr(len + 1);
+		bufSkip(len + 1);
 		return true;
 	    }
 	    break;
 	}
-	while (len < m_buf.length()) {
-	    if (m_buf[len] != '>') {
+	while (len < bufLength()) {
+	    if (bufAt(len) != '>') {
 		len++;
 		continue;
 	    }
-	    gotDoctype(m_buf.substr(0,len));
+	    gotDoctype(bufSubstr(0,len));
 	    resetParsed();
-	    m_buf = m_buf.substr(len + 1);
+	    bufSkip(len + 1);
 	    return true;
 	}
 	break;
@@ -729,31 +1132,31 @@ String* XmlSaxParser::extractName(bool& empty)
     unsigned int len = 0;
     bool ok = false;
     empty = false;
-    while (len < m_buf.length()) {
-	char c = m_buf[len];
+    while (len < bufLength()) {
+	char c = bufAt(len);
 	if (blank(c)) {
-	    if (checkFirstNameCharacter(m_buf[0])) {
+	    if (checkFirstNameCharacter(bufAt(0))) {
 		ok = true;
 		break;
 	    }
 	    Debug(this,DebugNote,"Element tag starting with invalid char %c [%p]",
-		m_buf[0],this);
+		bufAt(0),this);
 	    setError(ReadElementName);
 	    return 0;
 	}
 	if (c == '/' || c == '>') { // end of element declaration
 	    if (c == '>') {
-		if (checkFirstNameCharacter(m_buf[0])) {
+		if (checkFirstNameCharacter(bufAt(0))) {
 		    empty = true;
 		    ok = true;
 		    break;
 		}
 		Debug(this,DebugNote,"Element tag starting with invalid char %c [%p]",
-		    m_buf[0],this);
+		    bufAt(0),this);
 		setError(ReadElementName);
 		return 0;
 	    }
-	    char ch = m_buf.at(len + 1);
+	    char ch = bufAt(len + 1);
 	    if (!ch)
 		break;
 	    if (ch != '>') {
@@ -761,13 +1164,13 @@ String* XmlSaxParser::extractName(bool& empty)
 		setError(ReadElementName);
 		return 0;
 	    }
-	    if (checkFirstNameCharacter(m_buf[0])) {
+	    if (checkFirstNameCharacter(bufAt(0))) {
 		empty = true;
 		ok = true;
 		break;
 	    }
 	    Debug(this,DebugNote,"Element tag starting with invalid char %c [%p]",
-		m_buf[0],this);
+		bufAt(0),this);
 	    setError(ReadElementName);
 	    return 0;
 	}
@@ -780,12 +1183,12 @@ String* XmlSaxParser::extractName(bool& empty)
 	}
     }
     if (ok) {
-	String* name = new String(m_buf.substr(0,len));
-	m_buf = m_buf.substr(len);
+	String* name = new String(bufSubstr(0,len));
+	bufSkip(len);
 	if (!empty) {
 	    skipBlanks();
-	    empty = (m_buf && m_buf[0] == '>') ||
-		(m_buf.length() > 1 && m_buf[0] == '/' && m_buf[1] == '>');
+	    empty = (bufAt(0) == '>') ||
+		(bufLength() > 1 && bufAt(0) == '/' && bufAt(1) == '>');
 	}
 	return name;
     }
@@ -801,11 +1204,11 @@ NamedString* XmlSaxParser::getAttribute()
     char c,sep = 0;
     unsigned int len = 0;
 
-    while (len < m_buf.length()) { // Circle until we find attribute value startup character (["]|['])
-	c = m_buf[len];
+    while (len < bufLength()) { // Circle until we find attribute value startup character (["]|['])
+	c = bufAt(len);
 	if (blank(c) || c == '=') {
 	    if (!name.c_str())
-		name = m_buf.substr(0,len);
+		name = bufSubstr(0,len);
 	    len++;
 	    continue;
 	}
@@ -839,8 +1242,8 @@ NamedString* XmlSaxParser::getAttribute()
     }
     int pos = ++len;
 
-    while (len < m_buf.length()) {
-	c = m_buf[len];
+    while (len < bufLength()) {
+	c = bufAt(len);
 	if (c != sep && !badCharacter(c)) {
 	    len ++;
 	    continue;
@@ -851,8 +1254,8 @@ NamedString* XmlSaxParser::getAttribute()
 	    setError(ReadingAttributes);
 	    return 0;
 	}
-	NamedString* ns = new NamedString(name,m_buf.substr(pos,len - pos));
-	m_buf = m_buf.substr(len + 1);
+	NamedString* ns = new NamedString(name,bufSubstr(pos,len - pos));
+	bufSkip(len + 1);
 	// End of attribute value
 	unEscape(*ns);
 	if (error()) {
@@ -874,6 +1277,8 @@ void XmlSaxParser::reset()
     m_column = 1;
     m_error = NoError;
     m_buf.clear();
+    m_bufPos = 0;
+    m_bufChecked = 0;
     resetParsed();
     m_unparsed = None;
 }
@@ -902,10 +1307,10 @@ bool XmlSaxParser::checkNameCharacter(unsigned char ch)
 void XmlSaxParser::skipBlanks()
 {
     unsigned int len = 0;
-    while (len < m_buf.length() && blank(m_buf[len]))
+    while (len < bufLength() && blank(bufAt(len)))
 	len++;
     if (len != 0)
-	m_buf = m_buf.substr(len);
+	bufSkip(len);
 }
 
 // Obtain a char from an ascii decimal char declaration
@@ -1026,18 +1431,9 @@ bool XmlSaxParser::validTag(const String& buf)
 // XmlEscape the given text
 void XmlSaxParser::escape(String& buf, const String& text)
 {
-    const char* str = text.c_str();
-    if (!str)
-	return;
-    char c;
-    while ((c = *str++)) {
-	const char* rep = replace(c,XmlSaxParser::s_escape);
-	if (!rep) {
-	    buf += c;
-	    continue;
-	}
-	buf += rep;
-    }
+    XmlOutput out;
+    out.escape(text);
+    out.flush(buf);
 }
 
 // Calls gotElement(). Reset parsed if ok
@@ -1051,6 +1447,18 @@ bool XmlSaxParser::processElement(NamedList& list, bool empty)
     return false;
 }
 
+// Consume the end of start tag and call gotElement()
+// Restore the tag end on failure: the element is processed again with more data
+bool XmlSaxParser::processElement(NamedList& list, bool empty, unsigned int tagEnd)
+{
+    unsigned int pos = m_bufPos;
+    bufSkip(tagEnd);
+    if (processElement(list,empty))
+	return true;
+    m_bufPos = pos;
+    return false;
+}
+
 // Calls gotText() and reset parsed on success
 bool XmlSaxParser::processText(String& text)
 {
@@ -1232,6 +1640,46 @@ void XmlDomParser::endElement(const String& name)
     m_current = static_cast<XmlElement*>(m_current->getParent());
 }
 
+// Append an element keeping its content as received
+bool XmlDomParser::keepContent(const NamedList& element, unsigned int maxWait)
+{
+    ObjList prefixes;
+    int len = checkContent(bufData(),bufLength(),element,prefixes);
+    if (len == -1) {
+	if (bufLength() >= maxWait)
+	    return false;
+	// Wait for more data: the element is processed again
+	setUnparsed(Element);
+	setError(Incomplete);
+	return true;
+    }
+    if (len < 0)
+	return false;
+    XmlDomParser::gotElement(element,false);
+    if (error())
+	return true;
+    // Declare the namespace prefixes declared by parents:
+    //  the element is kept or sent without its parents
+    const String& tag = element;
+    addPrefix(prefixes,tag.c_str(),tag.length());
+    for (unsigned int i = 0; i < element.length(); i++) {
+	const NamedString* ns = element.getParam(i);
+	if (ns)
+	    addPrefix(prefixes,ns->name().c_str(),ns->name().length());
+    }
+    for (ObjList* o = prefixes.skipNull(); o; o = o->skipNext()) {
+	String attr(XmlElement::s_nsPrefix + o->get()->toString());
+	if (m_current->getAttribute(attr))
+	    continue;
+	const String* ns = m_current->xmlnsAttribute(attr);
+	if (ns)
+	    m_current->setAttribute(attr,*ns);
+    }
+    m_current->setRawContent(bufData(),len);
+    bufSkip(len);
+    return true;
+}
+
 // Reset this parser
 void XmlDomParser::reset()
 {
@@ -1404,33 +1852,9 @@ void XmlFragment::toString(String& dump, bool escape, const String& indent,
     const String& origIndent, bool completeOnly, const String* auth,
     const XmlElement* parent) const
 {
-    ObjList* ob = m_list.skipNull();
-    if (!ob)
-	return;
-    ObjList buffers;
-    for (;ob;ob = ob->skipNext()) {
-	String* s = new String;
-	XmlChild* obj = static_cast<XmlChild*>(ob->get());
-	if (obj->xmlElement())
-	    obj->xmlElement()->toString(*s,escape,indent,origIndent,completeOnly,auth);
-	else if (obj->xmlText())
-	    obj->xmlText()->toString(*s,escape,indent,auth,parent);
-	else if (obj->xmlCData())
-	    obj->xmlCData()->toString(*s,indent);
-	else if (obj->xmlComment())
-	    obj->xmlComment()->toString(*s,indent);
-	else if (obj->xmlDeclaration())
-	    obj->xmlDeclaration()->toString(*s,escape);
-	else if (obj->xmlDoctype())
-	    obj->xmlDoctype()->toString(*s,origIndent);
-	else
-	    Debug(DebugStub,"XmlFragment::toString() unhandled element type!");
-	if (!TelEngine::null(s))
-	    buffers.append(s);
-	else
-	    TelEngine::destruct(s);
-    }
-    dump.append(buffers);
+    XmlOutput out;
+    dumpChildren(out,m_list,escape,indent,origIndent,completeOnly,auth,parent);
+    out.flush(dump);
 }
 
 // Find a completed xml element in a list
@@ -1693,7 +2117,7 @@ XmlChild::XmlChild()
 XmlElement::XmlElement(const NamedList& element, bool empty, XmlParent* parent)
     : m_element(element), m_prefixed(0),
     m_parent(0), m_inheritedNs(0),
-    m_empty(empty), m_complete(empty)
+    m_empty(empty), m_complete(empty), m_content(0)
 {
     XDebug(DebugAll,"XmlElement::XmlElement(%s,%u,%p) [%p]",
 	element.c_str(),empty,parent,this);
@@ -1706,7 +2130,8 @@ XmlElement::XmlElement(const XmlElement& el)
     : m_children(el.m_children),
     m_element(el.getElement()), m_prefixed(0),
     m_parent(0), m_inheritedNs(0),
-    m_empty(el.empty()), m_complete(el.completed())
+    m_empty(el.empty()), m_complete(el.completed()),
+    m_content(el.m_content ? new String(*el.m_content) : 0)
 {
     setPrefixed();
     setInheritedNs(&el,true);
@@ -1716,7 +2141,7 @@ XmlElement::XmlElement(const XmlElement& el)
 XmlElement::XmlElement(const char* name, bool complete)
     : m_element(name), m_prefixed(0),
     m_parent(0), m_inheritedNs(0),
-    m_empty(true), m_complete(complete)
+    m_empty(true), m_complete(complete), m_content(0)
 {
     setPrefixed();
     XDebug(DebugAll,"XmlElement::XmlElement(%s) [%p]",
@@ -1727,7 +2152,7 @@ XmlElement::XmlElement(const char* name, bool complete)
 XmlElement::XmlElement(const char* name, const char* value, bool complete)
     : m_element(name), m_prefixed(0),
     m_parent(0), m_inheritedNs(0),
-    m_empty(true), m_complete(complete)
+    m_empty(true), m_complete(complete), m_content(0)
 {
     setPrefixed();
     addText(value);
@@ -1740,6 +2165,7 @@ XmlElement::~XmlElement()
 {
     setInheritedNs();
     TelEngine::destruct(m_prefixed);
+    TelEngine::destruct(m_content);
     XDebug(DebugAll,"XmlElement::~XmlElement() ( %s| %p )",
 	m_element.c_str(),this);
 }
@@ -1815,9 +2241,8 @@ const String& XmlElement::getText() const
 
 XmlChild* XmlElement::getFirstChild()
 {
-    if (!m_children.getChildren().skipNull())
-	return 0;
-    return static_cast<XmlChild*>(m_children.getChildren().skipNull()->get());
+    ObjList* o = getChildren().skipNull();
+    return o ? static_cast<XmlChild*>(o->get()) : 0;
 }
 
 XmlText* XmlElement::setText(const char* text)
@@ -1868,6 +2293,8 @@ XmlSaxParser::Error XmlElement::addChild(XmlChild* child)
 	return XmlSaxParser::NoError;
     // TODO: Check if a child element's attribute names are unique in the new context
     //       See http://www.w3.org/TR/xml-names/ Section 6.3
+    if (m_content)
+	parseContent();
     XmlSaxParser::Error err = m_children.addChild(child);
     if (err == XmlSaxParser::NoError)
 	child->setParent(this);
@@ -1877,9 +2304,30 @@ XmlSaxParser::Error XmlElement::addChild(XmlChild* child)
 // Remove a child
 XmlChild* XmlElement::removeChild(XmlChild* child, bool delObj)
 {
+    if (m_content)
+	parseContent();
     return m_children.removeChild(child,delObj);
 }
 
+// Keep the content as received instead of building children
+void XmlElement::setRawContent(const char* data, unsigned int len)
+{
+    clearChildren();
+    m_content = new String(data,len);
+}
+
+// Build children from the content kept as received
+void XmlElement::parseContent() const
+{
+    String* content = m_content;
+    m_content = 0;
+    XmlDomParser parser(const_cast<XmlElement*>(this),false);
+    if (!(parser.parse(*content) || parser.completeText()))
+	Debug(DebugMild,"XmlElement(%s) failed to parse content: %s [%p]",
+	    tag(),parser.getError(),this);
+    TelEngine::destruct(content);
+}
+
 // Set this element's parent. Update inherited namespaces
 void XmlElement::setParent(XmlParent* parent)
 {
@@ -1902,36 +2350,9 @@ void XmlElement::toString(String& dump, bool esc, const String& indent,
 {
     XDebug(DebugAll,"XmlElement(%s) toString(%u,%s,%s,%u,%p) complete=%u [%p]",
 	tag(),esc,indent.c_str(),origIndent.c_str(),completeOnly,auth,m_complete,this);
-    if (!m_complete && completeOnly)
-	return;
-    String auxDump;
-    auxDump << indent << "<" << m_element;
-    int n = m_element.count();
-    for (int i = 0; i < n; i++) {
-	NamedString* ns = m_element.getParam(i);
-	if (!ns)
-	    continue;
-	auxDump << " " << ns->name() << "=\"";
-	addAuth(auxDump,ns->name(),*ns,esc,auth);
-	auxDump << "\"";
-    }
-    int m = getChildren().count();
-    if (m_complete && !m)
-	auxDump << "/";
-    auxDump << ">";
-    if (m) {
-	// Avoid adding text on new line when text is the only child
-	XmlText* text = 0;
-	if (m == 1)
-	    text = static_cast<XmlChild*>(getChildren().skipNull()->get())->xmlText();
-	if (!text)
-	    m_children.toString(auxDump,esc,indent + origIndent,origIndent,completeOnly,auth,this);
-	else
-	    text->toString(auxDump,esc,String::empty(),auth,this);
-	if (m_complete)
-	    auxDump << (!text ? indent : String::empty()) << "</" << getName() << ">";
-    }
-    dump << auxDump;
+    XmlOutput out;
+    dumpElement(out,*this,esc,indent,origIndent,completeOnly,auth);
+    out.flush(dump);
 }
 
 // Copy element attributes to a list of parameters
@@ -2195,13 +2616,15 @@ XmlText::~XmlText()
 void XmlText::toString(String& dump, bool esc, const String& indent,
     const String* auth, const XmlElement* parent) const
 {
-    dump << indent;
+    XmlOutput out;
+    out << indent;
     if (auth)
-	addAuth(dump,parent ? parent->toString() : String::empty(),m_text,esc,auth);
+	out.addAuth(parent ? parent->toString() : String::empty(),m_text,esc,auth);
     else if (esc)
-        XmlSaxParser::escape(dump,m_text);
+	out.escape(m_text);
     else
-	dump << m_text;
+	out << m_text;
+    out.flush(dump);
 }
 
 bool XmlText::onlySpaces()
@@ -367,4 +367,20 @@ const unsigned char* MD5::rawDigest()
     return m_bin;
 }
 
+bool MD5::digestBatch(unsigned char* out, unsigned int count,
+    const void* const* bufs, const unsigned int* lens)
+{
+    if (count && !(out && bufs && lens))
+	return false;
+    MD5_CTX ctx;
+    for (unsigned int i = 0; i < count; i++, out += MD5_HASHBYTES) {
+	if (lens[i] && !bufs[i])
+	    return false;
+	MD5_Init(&ctx);
+	MD5_Update(&ctx,(unsigned char const*)bufs[i],lens[i]);
+	MD5_Final(out,&ctx);
+    }
+    return true;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
@@ -28,6 +28,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+// The compiler must accept SHA intrinsics in functions targeting them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SHA1_EXTENSIONS
+#include <immintrin.h>
+#endif
+
 #if (defined(WORDS_BIGENDIAN) || defined(BIGENDIAN))
 #define be32_to_cpu(x) (x) /* Nothing */
 #define cpu_to_be32(x) (x)
@@ -121,6 +128,83 @@ static void sha1_transform(u_int32_t *state, const u_int8_t *in)
     memset (block32, 0x00, sizeof block32);
 }
 
+#ifdef SHA1_EXTENSIONS
+/* Four rounds with the CPU SHA extensions, scheduling the message words of later rounds */
+#define SHA1_ROUNDS4(ea,eb,m0,m1,m2,m3,f) \
+    ea = _mm_sha1nexte_epu32(ea,m0); eb = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1,m0); abcd = _mm_sha1rnds4_epu32(abcd,ea,f); \
+    m3 = _mm_sha1msg1_epu32(m3,m0); m2 = _mm_xor_si128(m2,m0);
+
+/* Hash consecutive 512-bit blocks with the CPU SHA extensions */
+__attribute__((target("sha,sse4.1")))
+static void sha1_transform_ext(u_int32_t *state, const u_int8_t *in, unsigned int blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state),0x1b);
+    __m128i e0 = _mm_set_epi32(state[4],0,0,0);
+    __m128i e1, m0, m1, m2, m3;
+
+    for (; blocks; blocks--, in += 64) {
+	__m128i abcdSave = abcd;
+	__m128i eSave = e0;
+	/* Rounds 0-15 load the message, the schedule starts gradually */
+	m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in),mask);
+	e0 = _mm_add_epi32(e0,m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd,e0,0);
+	m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)),mask);
+	e1 = _mm_sha1nexte_epu32(e1,m1);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd,e1,0);
+	m0 = _mm_sha1msg1_epu32(m0,m1);
+	m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)),mask);
+	e0 = _mm_sha1nexte_epu32(e0,m2);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd,e0,0);
+	m1 = _mm_sha1msg1_epu32(m1,m2);
+	m0 = _mm_xor_si128(m0,m2);
+	m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)),mask);
+	SHA1_ROUNDS4(e1,e0,m3,m0,m1,m2,0);
+	/* Rounds 16-79, the last groups schedule words that are not used */
+	SHA1_ROUNDS4(e0,e1,m0,m1,m2,m3,0);
+	SHA1_ROUNDS4(e1,e0,m1,m2,m3,m0,1);
+	SHA1_ROUNDS4(e0,e1,m2,m3,m0,m1,1);
+	SHA1_ROUNDS4(e1,e0,m3,m0,m1,m2,1);
+	SHA1_ROUNDS4(e0,e1,m0,m1,m2,m3,1);
+	SHA1_ROUNDS4(e1,e0,m1,m2,m3,m0,1);
+	SHA1_ROUNDS4(e0,e1,m2,m3,m0,m1,2);
+	SHA1_ROUNDS4(e1,e0,m3,m0,m1,m2,2);
+	SHA1_ROUNDS4(e0,e1,m0,m1,m2,m3,2);
+	SHA1_ROUNDS4(e1,e0,m1,m2,m3,m0,2);
+	SHA1_ROUNDS4(e0,e1,m2,m3,m0,m1,2);
+	SHA1_ROUNDS4(e1,e0,m3,m0,m1,m2,3);
+	SHA1_ROUNDS4(e0,e1,m0,m1,m2,m3,3);
+	SHA1_ROUNDS4(e1,e0,m1,m2,m3,m0,3);
+	SHA1_ROUNDS4(e0,e1,m2,m3,m0,m1,3);
+	SHA1_ROUNDS4(e1,e0,m3,m0,m1,m2,3);
+	/* Add this block to the state */
+	e0 = _mm_sha1nexte_epu32(e0,eSave);
+	abcd = _mm_add_epi32(abcd,abcdSave);
+    }
+    _mm_storeu_si128((__m128i*)state,_mm_shuffle_epi32(abcd,0x1b));
+    state[4] = _mm_extract_epi32(e0,3);
+}
+#endif
+
+/* Hash consecutive 512-bit blocks with the best available implementation */
+static inline void sha1_blocks(u_int32_t *state, const u_int8_t *in, unsigned int blocks)
+{
+#ifdef SHA1_EXTENSIONS
+    if (TelEngine::Hasher::shaExtensions()) {
+	if (blocks)
+	    sha1_transform_ext(state, in, blocks);
+	return;
+    }
+#endif
+    for (; blocks; blocks--, in += 64)
+	sha1_transform(state, in);
+}
+
 static void sha1_init(sha1_ctx *sctx)
 {
     static const sha1_ctx initstate = {
@@ -141,10 +225,9 @@ static void sha1_update(sha1_ctx *sctx, const u_int8_t *data, unsigned int len)
 
     if ((j + len) > 63) {
 	memcpy(&sctx->buffer[j], data, (i = 64-j));
-	sha1_transform(sctx->state, sctx->buffer);
-	for ( ; i + 63 < len; i += 64) {
-	    sha1_transform(sctx->state, &data[i]);
-	}
+	sha1_blocks(sctx->state, sctx->buffer, 1);
+	sha1_blocks(sctx->state, &data[i], (len - i) / 64);
+	i += (len - i) & ~63U;
 	j = 0;
     }
     else i = 0;
@@ -289,6 +372,41 @@ const unsigned char* SHA1::rawDigest()
     return m_bin;
 }
 
+bool SHA1::rawDigestWith(unsigned char* out, const void* buf, unsigned int len,
+    const void* buf2, unsigned int len2) const
+{
+    if (!(out && m_hex.null()) || (len && !buf) || (len2 && !buf2))
+	return false;
+    // work on a copy on stack, the HMAC pads are reused for each packet
+    sha1_ctx ctx;
+    if (m_private)
+	::memcpy(&ctx,m_private,sizeof(ctx));
+    else
+	sha1_init(&ctx);
+    if (len)
+	sha1_update(&ctx,(const u_int8_t*)buf,len);
+    if (len2)
+	sha1_update(&ctx,(const u_int8_t*)buf2,len2);
+    sha1_final(&ctx,(u_int8_t*)out);
+    return true;
+}
+
+bool SHA1::digestBatch(unsigned char* out, unsigned int count,
+    const void* const* bufs, const unsigned int* lens)
+{
+    if (count && !(out && bufs && lens))
+	return false;
+    sha1_ctx ctx;
+    for (unsigned int i = 0; i < count; i++, out += SHA1_DIGEST_SIZE) {
+	if (lens[i] && !bufs[i])
+	    return false;
+	sha1_init(&ctx);
+	sha1_update(&ctx,(const u_int8_t*)bufs[i],lens[i]);
+	sha1_final(&ctx,(u_int8_t*)out);
+    }
+    return true;
+}
+
 // NIST FIPS 186-2 change notice 1 PRF with 160 bit SHA1 function G(t,c)
 bool SHA1::fips186prf(DataBlock& out, const DataBlock& seed, unsigned int len)
 {
@@ -26,6 +26,13 @@
 #include <string.h>
 #include <stdlib.h>
 
+// The compiler must accept SHA intrinsics in functions targeting them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SHA256_EXTENSIONS
+#include <immintrin.h>
+#endif
+
 #define GET_UINT32(n,b,i)                       \
 {                                               \
     (n) = ( (uint32_t) (b)[(i)    ] << 24 )       \
@@ -196,6 +203,117 @@ static void sha256_process( context_sha256_t *ctx, const uint8_t data[64] )
   ctx->state[7] += H;
 }
 
+#ifdef SHA256_EXTENSIONS
+static const uint32_t sha256_k[64] =
+  {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+  };
+
+/* Four rounds with the CPU SHA extensions, scheduling the message words of later rounds */
+#define SHA256_ROUNDS4(m0,m1,m2,m3,t)                   \
+{                                                       \
+  msg = _mm_add_epi32( m0, _mm_loadu_si128( (const __m128i*) (sha256_k + t) ) ); \
+  state1 = _mm_sha256rnds2_epu32( state1, state0, msg ); \
+  tmp = _mm_alignr_epi8( m0, m3, 4 );                   \
+  m1 = _mm_sha256msg2_epu32( _mm_add_epi32( m1, tmp ), m0 ); \
+  msg = _mm_shuffle_epi32( msg, 0x0E );                 \
+  state0 = _mm_sha256rnds2_epu32( state0, state1, msg ); \
+  m3 = _mm_sha256msg1_epu32( m3, m0 );                  \
+}
+
+/* Two rounds on the low and high halves of a message block plus constants */
+#define SHA256_ROUNDS2(m,t)                             \
+{                                                       \
+  msg = _mm_add_epi32( m, _mm_loadu_si128( (const __m128i*) (sha256_k + t) ) ); \
+  state1 = _mm_sha256rnds2_epu32( state1, state0, msg ); \
+  msg = _mm_shuffle_epi32( msg, 0x0E );                 \
+  state0 = _mm_sha256rnds2_epu32( state0, state1, msg ); \
+}
+
+/* Process consecutive 64 byte blocks with the CPU SHA extensions */
+__attribute__((target("sha,sse4.1")))
+static void sha256_process_ext( uint32_t state[8], const uint8_t *data, uint32_t blocks )
+{
+  const __m128i mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+  __m128i state0, state1, msg, tmp, m0, m1, m2, m3;
+
+  /* state is kept as ABEF and CDGH */
+  tmp = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*) state ), 0xB1 );
+  state1 = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*) (state + 4) ), 0x1B );
+  state0 = _mm_alignr_epi8( tmp, state1, 8 );
+  state1 = _mm_blend_epi16( state1, tmp, 0xF0 );
+
+  for( ; blocks; blocks--, data += 64 )
+    {
+      __m128i save0 = state0;
+      __m128i save1 = state1;
+
+      m0 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) data ), mask );
+      SHA256_ROUNDS2( m0, 0 );
+      m1 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) (data + 16) ), mask );
+      SHA256_ROUNDS2( m1, 4 );
+      m0 = _mm_sha256msg1_epu32( m0, m1 );
+      m2 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) (data + 32) ), mask );
+      SHA256_ROUNDS2( m2, 8 );
+      m1 = _mm_sha256msg1_epu32( m1, m2 );
+      m3 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*) (data + 48) ), mask );
+      /* the last groups schedule words that are not used */
+      SHA256_ROUNDS4( m3, m0, m1, m2, 12 );
+      SHA256_ROUNDS4( m0, m1, m2, m3, 16 );
+      SHA256_ROUNDS4( m1, m2, m3, m0, 20 );
+      SHA256_ROUNDS4( m2, m3, m0, m1, 24 );
+      SHA256_ROUNDS4( m3, m0, m1, m2, 28 );
+      SHA256_ROUNDS4( m0, m1, m2, m3, 32 );
+      SHA256_ROUNDS4( m1, m2, m3, m0, 36 );
+      SHA256_ROUNDS4( m2, m3, m0, m1, 40 );
+      SHA256_ROUNDS4( m3, m0, m1, m2, 44 );
+      SHA256_ROUNDS4( m0, m1, m2, m3, 48 );
+      SHA256_ROUNDS4( m1, m2, m3, m0, 52 );
+      SHA256_ROUNDS4( m2, m3, m0, m1, 56 );
+      SHA256_ROUNDS2( m3, 60 );
+
+      state0 = _mm_add_epi32( state0, save0 );
+      state1 = _mm_add_epi32( state1, save1 );
+    }
+
+  /* back to ABCD and EFGH */
+  tmp = _mm_shuffle_epi32( state0, 0x1B );
+  state1 = _mm_shuffle_epi32( state1, 0xB1 );
+  _mm_storeu_si128( (__m128i*) state, _mm_blend_epi16( tmp, state1, 0xF0 ) );
+  _mm_storeu_si128( (__m128i*) (state + 4), _mm_alignr_epi8( state1, tmp, 8 ) );
+}
+#endif
+
+/* Process consecutive 64 byte blocks with the best available implementation */
+static inline void sha256_blocks( context_sha256_t *ctx, const uint8_t *data, uint32_t blocks )
+{
+#ifdef SHA256_EXTENSIONS
+  if( TelEngine::Hasher::shaExtensions() )
+    {
+      if( blocks )
+	sha256_process_ext( ctx->state, data, blocks );
+      return;
+    }
+#endif
+  for( ; blocks; blocks--, data += 64 )
+    sha256_process( ctx, data );
+}
+
 static void sha256_update( context_sha256_t *ctx, const uint8_t *input, uint32_t length )
 {
   uint32_t left, fill;
@@ -215,17 +333,17 @@ static void sha256_update( context_sha256_t *ctx, const uint8_t *input, uint32_t
     {
       memcpy( (void *) (ctx->buffer + left),
 	      (void *) input, fill );
-      sha256_process( ctx, ctx->buffer );
+      sha256_blocks( ctx, ctx->buffer, 1 );
       length -= fill;
       input  += fill;
       left = 0;
     }
 
-  while( length >= 64 )
+  if( length >= 64 )
     {
-      sha256_process( ctx, input );
-      length -= 64;
-      input  += 64;
+      sha256_blocks( ctx, input, length / 64 );
+      input  += length & ~63U;
+      length &= 63;
     }
 
   if( length )
@@ -370,4 +488,20 @@ const unsigned char* SHA256::rawDigest()
     return m_bin;
 }
 
+bool SHA256::digestBatch(unsigned char* out, unsigned int count,
+    const void* const* bufs, const unsigned int* lens)
+{
+    if (count && !(out && bufs && lens))
+	return false;
+    context_sha256_t ctx;
+    for (unsigned int i = 0; i < count; i++, out += 32) {
+	if (lens[i] && !bufs[i])
+	    return false;
+	sha256_starts(&ctx);
+	sha256_update(&ctx,(const uint8_t*)bufs[i],lens[i]);
+	sha256_finish(&ctx,(uint8_t*)out);
+    }
+    return true;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
@@ -22,8 +22,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <errno.h>
+#define JB_STREAM_EPOLL
+#endif
+
+#ifndef _WINDOWS
+#include <unistd.h>
+#endif
+
 using namespace TelEngine;
 
+// Maximum interval (in milliseconds) a process set waits for requests
+// The set checks if its thread was cancelled after it
+#define JB_PROCESS_WAIT 500
+
+#ifdef JB_STREAM_EPOLL
+// Socket events retrieved at once by a receive set
+#define JB_POLL_EVENTS 64
+// Interval (in milliseconds) to check receive set streams waiting to be armed in the poller
+#define JB_POLL_CHECK 50
+#endif
+
+
+// Retrieve the number of online processors, 0 if unknown
+static unsigned int cpuCount()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int)n : 1;
+#else
+    return 0;
+#endif
+}
 
 static unsigned int fixValue(const NamedList& p, const char* param,
     unsigned int defVal, unsigned int min, unsigned int max, bool zero = false)
@@ -915,7 +947,7 @@ JBEngine::JBEngine(const char* name)
     m_pingInterval(JB_PING_INTERVAL), m_pingTimeout(JB_PING_TIMEOUT),
     m_idleTimeout(0), m_pptTimeoutC2s(0), m_pptTimeout(0),
     m_streamReadBuffer(JB_STREAMBUF), m_maxIncompleteXml(XMPP_MAX_INCOMPLETEXML),
-    m_redirectMax(JB_REDIRECT_COUNT),
+    m_rawStanzas(false), m_redirectMax(JB_REDIRECT_COUNT),
     m_hasClientTls(true), m_printXml(0), m_initialized(false)
 {
     debugName(name);
@@ -950,6 +982,7 @@ void JBEngine::initialize(const NamedList& params)
 	JB_STREAMBUF,JB_STREAMBUF_MIN,(unsigned int)-1);
     m_maxIncompleteXml = fixValue(params,"stream_parsermaxbuffer",
 	XMPP_MAX_INCOMPLETEXML,1024,(unsigned int)-1);
+    m_rawStanzas = params.getBoolValue("stream_rawstanzas");
     m_restartMax = fixValue(params,"stream_restartcount",
 	JB_RESTART_COUNT,JB_RESTART_COUNT_MIN,JB_RESTART_COUNT_MAX);
     m_restartUpdInterval = fixValue(params,"stream_restartupdateinterval",
@@ -1095,6 +1128,24 @@ ObjList* JBEngine::findClientStreams(bool in, const JabberID& jid, int flags)
     return result;
 }
 
+// Queue a stanza built once on many streams
+// Process sets are woken once by the first stream queued on them
+unsigned int JBEngine::sendStanza(XmlElementShared* xml, const ObjList& streams)
+{
+    ObjList* o = streams.skipNull();
+    if (!o)
+	return 0;
+    // A single stream is sent from the calling thread
+    bool send = !o->skipNext();
+    unsigned int n = 0;
+    for (; o; o = o->skipNext()) {
+	JBStream* stream = static_cast<JBStream*>(o->get());
+	if (stream->sendStanza(xml,send))
+	    n++;
+    }
+    return n;
+}
+
 // Find all c2s streams whose local or remote bare jid matches a given one and
 //  their resource is found in the given list
 ObjList* JBEngine::findClientStreams(bool in, const JabberID& jid, const ObjList& resources,
@@ -1130,6 +1181,47 @@ ObjList* JBEngine::findClientStreams(bool in, const JabberID& jid, const ObjList
     return result;
 }
 
+// Find all c2s streams matching a list of jids in a single pass
+ObjList* JBEngine::findClientStreams(bool in, const ObjList& jids, int flags)
+{
+    if (!jids.skipNull())
+	return 0;
+    RefPointer<JBStreamSetList> list;
+    getStreamList(list,JBStream::c2s);
+    if (!list)
+	return 0;
+    ObjList* result = 0;
+    ObjList* last = 0;
+    list->lock();
+    for (ObjList* o = list->sets().skipNull(); o; o = o->skipNext()) {
+	JBStreamSet* set = static_cast<JBStreamSet*>(o->get());
+	for (ObjList* s = set->clients().skipNull(); s; s = s->skipNext()) {
+	    JBClientStream* stream = static_cast<JBClientStream*>(s->get());
+	    // Ignore destroying streams
+	    if (stream->incoming() != in || stream->state() == JBStream::Destroy)
+		continue;
+	    Lock lock(stream);
+	    if (!stream->flag(flags))
+		continue;
+	    const JabberID& sid = in ? stream->remote() : stream->local();
+	    for (ObjList* j = jids.skipNull(); j; j = j->skipNext()) {
+		const JabberID& jid = *static_cast<JabberID*>(j->get());
+		if (jid.resource() ? (sid != jid) : (sid.bare() != jid.bare()))
+		    continue;
+		if (stream->ref()) {
+		    if (!result)
+			last = result = new ObjList;
+		    last = last->append(stream);
+		}
+		break;
+	    }
+	}
+    }
+    list->unlock();
+    list = 0;
+    return result;
+}
+
 // Find a c2s stream by its local or remote jid
 JBClientStream* JBEngine::findClientStream(bool in, const JabberID& jid)
 {
@@ -1851,6 +1943,7 @@ JBClusterStream* JBEvent::clusterStream()
 XmlElement* JBEvent::releaseXml(bool del)
 {
     m_child = 0;
+    m_decodeText = false;
     if (del) {
 	TelEngine::destruct(m_element);
 	return 0;
@@ -1966,7 +2059,19 @@ bool JBEvent::init(JBStream* stream, XmlElement* element,
 	m_to = m_element->getAttribute("to");
     m_id = m_element->getAttribute("id");
 
-    // Decode some data
+    // Decode some data now unless the content was kept unparsed
+    m_decodeText = true;
+    if (!m_element->rawContent())
+	decodeText();
+    return bRet;
+}
+
+// Decode the text of the received element
+void JBEvent::decodeText() const
+{
+    m_decodeText = false;
+    if (!m_element)
+	return;
     int t = XMPPUtils::tag(*m_element);
     switch (t) {
 	case XmlTag::Message:
@@ -1982,7 +2087,6 @@ bool JBEvent::init(JBStream* stream, XmlElement* element,
 	default:
 	    XMPPUtils::decodeError(m_element,m_text,m_text);
     }
-    return bRet;
 }
 
 
@@ -2144,6 +2248,137 @@ void JBStreamSet::stop()
 /*
  * JBStreamSetProcessor
  */
+JBStreamSetProcessor::JBStreamSetProcessor(JBStreamSetList* owner)
+    : JBStreamSet(owner),
+    m_readyMutex(false,"JBStreamSetProcessor"),
+    m_wake(1,"JBStreamSetProcessor",0),
+    m_readyLast(&m_ready),
+    m_heap(0), m_heapLen(0), m_heapSize(0)
+{
+}
+
+JBStreamSetProcessor::~JBStreamSetProcessor()
+{
+    delete[] m_heap;
+}
+
+// Add a stream to the set and request its processing
+bool JBStreamSetProcessor::add(JBStream* client)
+{
+    if (!client)
+	return false;
+    Lock lock(this);
+    if (!JBStreamSet::add(client))
+	return false;
+    Lock lck(client->m_socketMutex);
+    Lock lckReady(m_readyMutex);
+    client->m_processor = this;
+    setReady(client);
+    return true;
+}
+
+// Remove a stream from set. Cancel its pending processing
+bool JBStreamSetProcessor::remove(JBStream* client, bool delObj)
+{
+    if (!client)
+	return false;
+    Lock lock(this);
+    if (m_clients.find(client)) {
+	Lock lck(client->m_socketMutex);
+	Lock lckReady(m_readyMutex);
+	client->m_processor = 0;
+	if (client->m_processReady) {
+	    client->m_processReady = false;
+	    m_ready.remove(client,false);
+	    m_readyLast = m_ready.last();
+	}
+	unschedule(client);
+    }
+    if (!JBStreamSet::remove(client,delObj))
+	return false;
+    // Let the set check if it should exit
+    m_wake.unlock();
+    return true;
+}
+
+// Process streams whose processing was requested or whose timer expired
+void JBStreamSetProcessor::run()
+{
+    DDebug(m_owner->engine(),DebugAll,"JBStreamSetProcessor(%s) start running [%p]",
+	m_owner->toString().c_str(),this);
+    while (true) {
+	if (Thread::check(false)) {
+	    m_exiting = true;
+	    break;
+	}
+	lock();
+	bool changed = m_changed;
+	m_changed = false;
+	if (changed && !m_clients.skipNull()) {
+	    unlock();
+	    // Lock the owner to prevent adding a new client
+	    // Don't exit if a new client was already added
+	    Lock lck(m_owner);
+	    if (!m_changed) {
+		m_exiting = true;
+		break;
+	    }
+	    continue;
+	}
+	unlock();
+	// Pick up the streams to process now, keep a reference while processing
+	ObjList streams;
+	ObjList* last = &streams;
+	u_int64_t now = Time::msecNow();
+	long wait = JB_PROCESS_WAIT;
+	m_readyMutex.lock();
+	while (m_heapLen && m_heap[0]->m_processTime <= now) {
+	    JBStream* stream = m_heap[0];
+	    unschedule(stream);
+	    setReady(stream,false);
+	}
+	for (ObjList* o = m_ready.skipNull(); o; o = o->skipNext()) {
+	    JBStream* stream = static_cast<JBStream*>(o->get());
+	    stream->m_processReady = false;
+	    if (stream->ref())
+		last = last->append(stream);
+	}
+	m_ready.clear();
+	m_readyLast = &m_ready;
+	if (m_heapLen && m_heap[0]->m_processTime - now < (u_int64_t)wait)
+	    wait = (long)(m_heap[0]->m_processTime - now);
+	m_readyMutex.unlock();
+	if (!streams.skipNull()) {
+	    m_wake.lock(wait * 1000);
+	    continue;
+	}
+	for (ObjList* o = streams.skipNull(); o; o = o->skipNext()) {
+	    JBStream* stream = static_cast<JBStream*>(o->get());
+	    process(*stream);
+	    now = Time::msecNow();
+	    u_int64_t next = stream->processTime(now);
+	    Lock lck(m_readyMutex);
+	    // Removed while processed
+	    if (stream->m_processor != this)
+		continue;
+	    if (!next)
+		unschedule(stream);
+	    else if (next <= now)
+		setReady(stream,false);
+	    else
+		schedule(stream,next);
+	}
+    }
+    DDebug(m_owner->engine(),DebugAll,"JBStreamSetProcessor(%s) stop running [%p]",
+	m_owner->toString().c_str(),this);
+}
+
+// Retrieve the number of process sets to spread a large number of streams to
+unsigned int JBStreamSetProcessor::maxSets()
+{
+    return cpuCount();
+}
+
 // Calls stream's getEvent(). Pass a generated event to the engine
 bool JBStreamSetProcessor::process(JBStream& stream)
 {
@@ -2162,15 +2397,262 @@ bool JBStreamSetProcessor::process(JBStream& stream)
     return true;
 }
 
+// Queue a stream in the ready list
+// The stream keeps its timer: it may be processed before and keep the same time
+void JBStreamSetProcessor::setReady(JBStream* stream, bool wake)
+{
+    if (stream->m_processReady)
+	return;
+    stream->m_processReady = true;
+    // Wake up the set when the first stream becomes ready: a set handling
+    //  a burst of requests (e.g. a stanza sent to many streams) is woken once
+    if (wake && !m_ready.get())
+	m_wake.unlock();
+    m_readyLast = m_readyLast->append(stream);
+    m_readyLast->setDelete(false);
+}
+
+// Set the time to process a stream
+void JBStreamSetProcessor::schedule(JBStream* stream, u_int64_t time)
+{
+    if (stream->m_processIndex) {
+	unsigned int pos = stream->m_processIndex - 1;
+	bool earlier = time < stream->m_processTime;
+	stream->m_processTime = time;
+	if (earlier)
+	    heapUp(pos);
+	else
+	    heapDown(pos);
+	return;
+    }
+    if (m_heapLen == m_heapSize) {
+	unsigned int size = m_heapSize ? 2 * m_heapSize : 16;
+	JBStream** heap = new JBStream*[size];
+	for (unsigned int i = 0; i < m_heapLen; i++)
+	    heap[i] = m_heap[i];
+	delete[] m_heap;
+	m_heap = heap;
+	m_heapSize = size;
+    }
+    stream->m_processTime = time;
+    m_heap[m_heapLen] = stream;
+    stream->m_processIndex = ++m_heapLen;
+    heapUp(m_heapLen - 1);
+}
+
+// Remove a stream from timers heap
+void JBStreamSetProcessor::unschedule(JBStream* stream)
+{
+    if (!stream->m_processIndex)
+	return;
+    unsigned int pos = stream->m_processIndex - 1;
+    stream->m_processIndex = 0;
+    m_heapLen--;
+    if (pos == m_heapLen)
+	return;
+    JBStream* last = m_heap[m_heapLen];
+    m_heap[pos] = last;
+    last->m_processIndex = pos + 1;
+    if (pos && last->m_processTime < m_heap[(pos - 1) / 2]->m_processTime)
+	heapUp(pos);
+    else
+	heapDown(pos);
+}
+
+// Move a heap entry up to its place
+void JBStreamSetProcessor::heapUp(unsigned int pos)
+{
+    JBStream* stream = m_heap[pos];
+    while (pos) {
+	unsigned int parent = (pos - 1) / 2;
+	if (m_heap[parent]->m_processTime <= stream->m_processTime)
+	    break;
+	m_heap[pos] = m_heap[parent];
+	m_heap[pos]->m_processIndex = pos + 1;
+	pos = parent;
+    }
+    m_heap[pos] = stream;
+    stream->m_processIndex = pos + 1;
+}
+
+// Move a heap entry down to its place
+void JBStreamSetProcessor::heapDown(unsigned int pos)
+{
+    JBStream* stream = m_heap[pos];
+    while (true) {
+	unsigned int child = 2 * pos + 1;
+	if (child >= m_heapLen)
+	    break;
+	if (child + 1 < m_heapLen &&
+	    m_heap[child + 1]->m_processTime < m_heap[child]->m_processTime)
+	    child++;
+	if (stream->m_processTime <= m_heap[child]->m_processTime)
+	    break;
+	m_heap[pos] = m_heap[child];
+	m_heap[pos]->m_processIndex = pos + 1;
+	pos = child;
+    }
+    m_heap[pos] = stream;
+    stream->m_processIndex = pos + 1;
+}
+
 
 /*
  * JBStreamSetReceive
  */
 JBStreamSetReceive::JBStreamSetReceive(JBStreamSetList* owner)
-    : JBStreamSet(owner)
+    : JBStreamSet(owner),
+    m_poll(-1)
 {
     if (owner && owner->engine())
 	m_buffer.assign(0,owner->engine()->streamReadBuffer());
+#ifdef JB_STREAM_EPOLL
+    m_poll = ::epoll_create(JB_POLL_EVENTS);
+    if (m_poll < 0) {
+	String tmp;
+	Thread::errorString(tmp,errno);
+	Debug(m_owner->engine(),DebugWarn,
+	    "JBStreamSetReceive(%s) failed to create poller: %d '%s' [%p]",
+	    m_owner->toString().c_str(),errno,tmp.c_str(),this);
+    }
+#endif
+}
+
+// Release the socket poller
+JBStreamSetReceive::~JBStreamSetReceive()
+{
+#ifdef JB_STREAM_EPOLL
+    if (m_poll >= 0)
+	::close(m_poll);
+#endif
+}
+
+// Remove a stream from set. Stop waiting for data on its socket
+bool JBStreamSetReceive::remove(JBStream* client, bool delObj)
+{
+    if (!client)
+	return false;
+    Lock lock(this);
+#ifdef JB_STREAM_EPOLL
+    if (m_poll >= 0 && m_clients.find(client)) {
+	// The stream may be released: make sure no event will be reported for it
+	Lock lck(client->m_socketMutex);
+	if (client->m_socket && client->m_socket->valid()) {
+	    struct epoll_event ev;
+	    ::epoll_ctl(m_poll,EPOLL_CTL_DEL,client->m_socket->handle(),&ev);
+	}
+	client->m_pollHandle = Socket::invalidHandle();
+    }
+#endif
+    return JBStreamSet::remove(client,delObj);
+}
+
+// Wait for socket events, read streams with data available
+void JBStreamSetReceive::run()
+{
+#ifdef JB_STREAM_EPOLL
+    if (m_poll < 0) {
+	JBStreamSet::run();
+	return;
+    }
+    DDebug(m_owner->engine(),DebugAll,"JBStreamSetReceive(%s) start polling [%p]",
+	m_owner->toString().c_str(),this);
+    struct epoll_event events[JB_POLL_EVENTS];
+    // Streams to read, they are kept until there is nothing more to read
+    // Sockets may hold data already received (i.e. SSL) not signalled by the poller
+    ObjList ready;
+    u_int64_t check = 0;
+    while (true) {
+	if (Thread::check(false)) {
+	    m_exiting = true;
+	    break;
+	}
+	u_int64_t now = Time::msecNow();
+	lock();
+	bool changed = m_changed;
+	m_changed = false;
+	if (changed) {
+	    for (ObjList* o = ready.skipNull(); o;) {
+		if (m_clients.find(o->get()))
+		    o = o->skipNext();
+		else {
+		    o->remove();
+		    o = o->skipNull();
+		}
+	    }
+	}
+	if (changed || now >= check) {
+	    if (!m_clients.skipNull()) {
+		unlock();
+		// Lock the owner to prevent adding a new client
+		// Don't exit if a new client was already added
+		Lock lck(m_owner);
+		if (!m_changed) {
+		    m_exiting = true;
+		    break;
+		}
+		continue;
+	    }
+	    // Arm new streams, streams whose socket changed or which couldn't read
+	    for (ObjList* o = m_clients.skipNull(); o; o = o->skipNext()) {
+		JBStream* stream = static_cast<JBStream*>(o->get());
+		if (stream->m_pollHandle == Socket::invalidHandle())
+		    pollArm(stream);
+	    }
+	    check = now + JB_POLL_CHECK;
+	}
+	unlock();
+	int timeout = ready.skipNull() ? 0 : (int)(check - now);
+	int n = ::epoll_wait(m_poll,events,JB_POLL_EVENTS,timeout);
+	if (n > 0) {
+	    lock();
+	    for (int i = 0; i < n; i++) {
+		JBStream* stream = static_cast<JBStream*>(events[i].data.ptr);
+		// The stream may have been removed after the event was reported
+		if (m_changed && !m_clients.find(stream))
+		    continue;
+		if (!ready.find(stream) && stream->ref())
+		    ready.append(stream);
+	    }
+	    unlock();
+	}
+	else if (n < 0 && errno != EINTR) {
+	    String tmp;
+	    Thread::errorString(tmp,errno);
+	    Debug(m_owner->engine(),DebugWarn,"JBStreamSetReceive(%s) poll error: %d '%s' [%p]",
+		m_owner->toString().c_str(),errno,tmp.c_str(),this);
+	    Thread::msleep(JB_POLL_CHECK,false);
+	}
+	for (ObjList* o = ready.skipNull(); o;) {
+	    JBStream* stream = static_cast<JBStream*>(o->get());
+	    if (process(*stream)) {
+		o = o->skipNext();
+		continue;
+	    }
+	    // Nothing more to read: wait for the next socket event
+	    lock();
+	    if (!m_changed || m_clients.find(stream))
+		pollArm(stream);
+	    unlock();
+	    o->remove();
+	    o = o->skipNull();
+	}
+    }
+    DDebug(m_owner->engine(),DebugAll,"JBStreamSetReceive(%s) stop polling [%p]",
+	m_owner->toString().c_str(),this);
+#else
+    JBStreamSet::run();
+#endif
+}
+
+// Retrieve the number of receive sets to spread a large number of streams to
+unsigned int JBStreamSetReceive::maxSets()
+{
+#ifdef JB_STREAM_EPOLL
+    return cpuCount();
+#else
+    return 0;
+#endif
 }
 
 // Calls stream's readSocket()
@@ -2179,16 +2661,50 @@ bool JBStreamSetReceive::process(JBStream& stream)
     return stream.readSocket((char*)m_buffer.data(),m_buffer.length());
 }
 
+// Wait for data on stream's socket
+// The socket is disarmed after reporting an event and must be armed again
+bool JBStreamSetReceive::pollArm(JBStream* stream)
+{
+#ifdef JB_STREAM_EPOLL
+    Lock lck(stream->m_socketMutex);
+    JBStream::State st = stream->state();
+    if (!stream->socketCanRead() || st == JBStream::Destroy || st == JBStream::Idle ||
+	st == JBStream::Connecting) {
+	// Check again later
+	stream->m_pollHandle = Socket::invalidHandle();
+	return false;
+    }
+    SOCKET h = stream->m_socket->handle();
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = stream;
+    if (::epoll_ctl(m_poll,EPOLL_CTL_MOD,h,&ev) &&
+	(errno != ENOENT || ::epoll_ctl(m_poll,EPOLL_CTL_ADD,h,&ev))) {
+	String tmp;
+	Thread::errorString(tmp,errno);
+	Debug(m_owner->engine(),DebugNote,
+	    "JBStreamSetReceive(%s) failed to poll stream (%p,'%s'): %d '%s' [%p]",
+	    m_owner->toString().c_str(),stream,stream->name(),errno,tmp.c_str(),this);
+	stream->m_pollHandle = Socket::invalidHandle();
+	return false;
+    }
+    stream->m_pollHandle = h;
+    return true;
+#else
+    return false;
+#endif
+}
+
 
 /*
  * JBStreamSetList
  */
 // Constructor
 JBStreamSetList::JBStreamSetList(JBEngine* engine, unsigned int max,
-    unsigned int sleepMs, const char* name)
+    unsigned int sleepMs, const char* name, unsigned int maxSets)
     : Mutex(true,"JBStreamSetList"),
     m_engine(engine), m_name(name),
-    m_max(max), m_sleepMs(sleepMs), m_streamCount(0)
+    m_max(maxSets ? 0 : max), m_maxSets(maxSets), m_sleepMs(sleepMs), m_streamCount(0)
 {
     XDebug(m_engine,DebugAll,"JBStreamSetList::JBStreamSetList(%s) [%p]",
 	m_name.c_str(),this);
@@ -2207,9 +2723,17 @@ bool JBStreamSetList::add(JBStream* client)
     if (!client || m_engine->exiting())
 	return false;
     Lock lock(this);
-    for (ObjList* o = m_sets.skipNull(); o; o = o->skipNext()) {
-	if ((static_cast<JBStreamSet*>(o->get()))->add(client)) {
+    // Build all allowed sets before spreading the streams over them
+    ObjList* o = (m_maxSets && m_sets.count() < m_maxSets) ? 0 : m_sets.skipNull();
+    for (; o; o = o->skipNext()) {
+	JBStreamSet* set = static_cast<JBStreamSet*>(o->get());
+	if (set->add(client)) {
 	    m_streamCount++;
+	    // Move the set to list end to add the next stream to another one
+	    if (m_maxSets && o->skipNext()) {
+		o->remove(false);
+		m_sets.append(set);
+	    }
 	    return true;
 	}
     }
@@ -20,6 +20,7 @@
 
 #include <yatejabber.h>
 #include <stdlib.h>
+#include <string.h>
 
 using namespace TelEngine;
 
@@ -31,6 +32,9 @@ using namespace TelEngine;
 //  #define JBSTREAM_DEBUG_SOCKET                   // Show socket read/write debug
 #endif
 
+// Maximum amount of stanza data written at once
+#define JB_SEND_BATCH 16384
+
 static const String s_dbVerify = "verify";
 static const String s_dbResult = "result";
 
@@ -94,6 +98,38 @@ static inline bool checkPing(JBStream* stream, const XmlElement* xml, const Stri
 }
 #endif
 
+// Stream parser. Optionally keeps the content of received 'message' and
+//  'presence' stanzas unparsed: only their tag and attributes are parsed, the
+//  content is parsed when needed or sent unchanged
+class JBStreamParser : public XmlDomParser
+{
+public:
+    inline JBStreamParser(const char* name, bool keepContent, unsigned int maxWait)
+	: XmlDomParser(name),
+	m_keepContent(keepContent), m_maxWait(maxWait), m_depth(0)
+	{}
+    virtual void reset();
+protected:
+    virtual void gotElement(const NamedList& elem, bool empty);
+    virtual void endElement(const String& name);
+private:
+    bool m_keepContent;                  // Keep stanza content unparsed
+    unsigned int m_maxWait;              // Maximum stanza content length to wait for
+    unsigned int m_depth;                // Current element depth, root is 1
+};
+
+// Keep the earliest of two times, ignore unset (0) time
+// Set 'passed' for timers expiring after the time is reached
+static inline void setEarliest(u_int64_t& next, u_int64_t t, bool passed = false)
+{
+    if (!t)
+	return;
+    if (passed)
+	t++;
+    if (!next || t < next)
+	next = t;
+}
+
 static const TokenDict s_location[] = {
     {"internal",     0},
     {"remote",       1},
@@ -157,6 +193,37 @@ static inline unsigned int timerMultiplier(JBStream* stream)
 }
 
 
+/*
+ * JBStreamParser
+ */
+void JBStreamParser::reset()
+{
+    XmlDomParser::reset();
+    m_depth = 0;
+}
+
+void JBStreamParser::gotElement(const NamedList& elem, bool empty)
+{
+    if (m_keepContent && m_depth == 1 && !empty &&
+	(elem == XMPPUtils::s_tag[XmlTag::Message] || elem == XMPPUtils::s_tag[XmlTag::Presence]) &&
+	keepContent(elem,m_maxWait)) {
+	if (!error())
+	    m_depth++;
+	return;
+    }
+    XmlDomParser::gotElement(elem,empty);
+    if (!(empty || error()))
+	m_depth++;
+}
+
+void JBStreamParser::endElement(const String& name)
+{
+    XmlDomParser::endElement(name);
+    if (m_depth && !error())
+	m_depth--;
+}
+
+
 /*
  * JBStream
  */
@@ -165,6 +232,7 @@ JBStream::JBStream(JBEngine* engine, Socket* socket, Type t, bool ssl)
     : Mutex(true,"JBStream"),
     m_sasl(0),
     m_state(Idle), m_flags(0), m_xmlns(XMPPNamespace::Count), m_lastEvent(0),
+    m_sendBlocked(false),
     m_setupTimeout(0), m_startTimeout(0),
     m_pingTimeout(0), m_pingInterval(0), m_nextPing(0),
     m_idleTimeout(0), m_connectTimeout(0),
@@ -172,6 +240,8 @@ JBStream::JBStream(JBEngine* engine, Socket* socket, Type t, bool ssl)
     m_engine(engine), m_type(t),
     m_incoming(true), m_terminateEvent(0), m_ppTerminate(0), m_ppTerminateTimeout(0),
     m_xmlDom(0), m_socket(0), m_socketFlags(0), m_socketMutex(true,"JBStream::Socket"),
+    m_pollHandle(Socket::invalidHandle()), m_processor(0), m_processReady(false),
+    m_processIndex(0), m_processTime(0),
     m_connectPort(0), m_compress(0), m_connectStatus(JBConnect::Start),
     m_redirectMax(0), m_redirectCount(0), m_redirectPort(0)
 {
@@ -195,7 +265,8 @@ JBStream::JBStream(JBEngine* engine, Type t, const JabberID& local, const Jabber
     : Mutex(true,"JBStream"),
     m_sasl(0),
     m_state(Idle), m_local(local), m_remote(remote), m_serverHost(serverHost),
-    m_flags(0), m_xmlns(XMPPNamespace::Count), m_lastEvent(0), m_stanzaIndex(0),
+    m_flags(0), m_xmlns(XMPPNamespace::Count), m_lastEvent(0), m_sendBlocked(false),
+    m_stanzaIndex(0),
     m_setupTimeout(0), m_startTimeout(0),
     m_pingTimeout(0), m_nextPing(0),
     m_idleTimeout(0), m_connectTimeout(0),
@@ -204,6 +275,8 @@ JBStream::JBStream(JBEngine* engine, Type t, const JabberID& local, const Jabber
     m_incoming(false), m_name(name),
     m_terminateEvent(0), m_ppTerminate(0), m_ppTerminateTimeout(0),
     m_xmlDom(0), m_socket(0), m_socketFlags(0), m_socketMutex(true,"JBStream::Socket"),
+    m_pollHandle(Socket::invalidHandle()), m_processor(0), m_processReady(false),
+    m_processIndex(0), m_processTime(0),
     m_connectPort(0), m_compress(0), m_connectStatus(JBConnect::Start),
     m_redirectMax(engine->redirectMax()), m_redirectCount(0), m_redirectPort(0)
 {
@@ -285,6 +358,8 @@ bool JBStream::connecting(bool sync, int stat, ObjList& srvs)
 	m_connectTimeout = 0;
     DDebug(this,DebugAll,"Connecting sync=%u stat=%s [%p]",
 	sync,lookup(m_connectStatus,JBConnect::s_statusName),this);
+    // Set the connect timer in the process set
+    requestProcess();
     return true;
 }
 
@@ -420,29 +495,42 @@ bool JBStream::readSocket(char* buf, unsigned int len)
 #ifdef JBSTREAM_DEBUG_SOCKET
 	    Debug(this,DebugInfo,"Received %d compressed bytes [%p]",read,this);
 #endif
-	    DataBlock d;
-	    int res = m_compress->decompress(buf,read,d);
-	    if (res == read) {
+	    // Decompress in chunks into a local buffer, nothing is allocated for each read
+	    char out[2048];
+	    unsigned int inPos = 0;
+	    while (error == XMPPError::NoError) {
+		unsigned int inLen = read - inPos;
+		int res = m_compress->decompressTo(buf + inPos,inLen,out,sizeof(out) - 1);
+		if (res < 0) {
+		    error = XMPPError::UndefinedCondition;
+		    break;
+		}
+		inPos += inLen;
 #ifdef JBSTREAM_DEBUG_COMPRESS
-		Debug(this,DebugInfo,"Decompressed %d --> %u [%p]",read,d.length(),this);
+		Debug(this,DebugInfo,"Decompressed %u --> %d [%p]",inLen,res,this);
 #endif
-		if (d.length()) {
-		    char c = 0;
-		    d.append(&c,1);
-		    buf = (char*)d.data();
+		if (res) {
+		    out[res] = 0;
 #ifdef JBSTREAM_DEBUG_SOCKET
-		    Debug(this,DebugInfo,"Received compressed %s [%p]",buf,this);
+		    Debug(this,DebugInfo,"Received compressed %s [%p]",out,this);
 #endif
-		    if (!m_xmlDom->parse(buf)) {
+		    if (!m_xmlDom->parse(out)) {
 			if (m_xmlDom->error() != XmlSaxParser::Incomplete)
 			    error = XMPPError::Xml;
 			else if (m_xmlDom->buffer().length() > m_engine->m_maxIncompleteXml)
 			    error = XMPPError::Policy;
 		    }
 		}
+		// Done when all input was used and the output did not fill the buffer
+		// An exactly full buffer leads to one more pass producing nothing
+		if (inPos >= (unsigned int)read && (!res || (unsigned int)res < sizeof(out) - 1))
+		    break;
+		// Input left but the decompressor can't make progress
+		if (!(res || inLen)) {
+		    error = XMPPError::UndefinedCondition;
+		    break;
+		}
 	    }
-	    else
-		error = XMPPError::UndefinedCondition;
 	}
 	else
 	    error = XMPPError::Internal;
@@ -479,6 +567,8 @@ bool JBStream::readSocket(char* buf, unsigned int len)
 		socketSetCanRead(false);
 	    }
 	}
+	if (read > 0)
+	    requestProcess();
 	return read > 0;
     }
     // Error
@@ -549,8 +639,18 @@ JBEvent* JBStream::getEvent(u_int64_t time)
     return m_lastEvent;
 }
 
+// Request the stream to be processed by its process set
+void JBStream::requestProcess()
+{
+    Lock lock(m_socketMutex);
+    if (!m_processor)
+	return;
+    Lock lck(m_processor->m_readyMutex);
+    m_processor->setReady(this);
+}
+
 // Send a stanza ('iq', 'message' or 'presence') or dialback elements in Running state.
-bool JBStream::sendStanza(XmlElement*& xml)
+bool JBStream::sendStanza(XmlElement*& xml, const String* raw)
 {
     if (!xml)
 	return false;
@@ -563,10 +663,39 @@ bool JBStream::sendStanza(XmlElement*& xml)
     }
     XmlElementOut* xo = new XmlElementOut(xml);
     xml = 0;
-    xo->prepareToSend();
+    if (TelEngine::null(raw))
+	xo->prepareToSend();
+    else
+	xo->setBuffer(*raw);
     Lock lock(this);
     m_pending.append(xo);
     sendPending();
+    // Let the process set send the rest or connect
+    if (m_pending.skipNull())
+	requestProcess();
+    return true;
+}
+
+// Send a stanza built once for many streams in Running state
+bool JBStream::sendStanza(XmlElementShared* xml, bool send)
+{
+    XmlElement* element = xml ? xml->element() : 0;
+    if (!element)
+	return false;
+    DDebug(this,DebugAll,"sendStanza(%p,%u) '%s' [%p]",xml,send,element->tag(),this);
+    if (!(XMPPUtils::isStanza(*element) ||
+	(m_type == s2s && XMPPUtils::hasXmlns(*element,XMPPNamespace::Dialback)))) {
+	Debug(this,DebugNote,"Request to send non stanza xml='%s' [%p]",element->tag(),this);
+	return false;
+    }
+    XmlElementOut* xo = new XmlElementOut(xml);
+    Lock lock(this);
+    m_pending.append(xo);
+    if (send)
+	sendPending();
+    // Let the process set send the rest or connect
+    if (m_pending.skipNull())
+	requestProcess();
     return true;
 }
 
@@ -621,6 +750,8 @@ bool JBStream::sendStreamXml(State newState, XmlElement* first, XmlElement* seco
     TelEngine::destruct(third);
     if (ok)
 	changeState(newState);
+    if (m_outStreamXml)
+	requestProcess();
     return ok;
 }
 
@@ -878,6 +1009,7 @@ void JBStream::terminate(int location, bool destroy, XmlElement* xml, int error,
     TelEngine::destruct(xml);
 
     changeState(destroy ? Destroy : Idle);
+    requestProcess();
 }
 
 // Close the stream. Release memory
@@ -1185,6 +1317,66 @@ void JBStream::checkTimeouts(u_int64_t time)
     }
 }
 
+// Retrieve the time the stream must be processed again
+// Mirror the checks done by getEvent()
+u_int64_t JBStream::processTime(u_int64_t time)
+{
+    Lock lock(this);
+    // getEvent() does nothing until the last event is terminated
+    if (m_lastEvent)
+	return 0;
+    if (m_terminateEvent || m_events.skipNull())
+	return time;
+    u_int64_t next = 0;
+    if (outgoing()) {
+	if (!flag(NoAutoRestart) && m_restart < m_engine->m_restartMax)
+	    setEarliest(next,m_timeToFillRestart,true);
+	if (m_state == Idle) {
+	    if (m_connectStatus > JBConnect::Start || flag(NoAutoRestart))
+		return time;
+	    if (m_restart && (m_type == c2s || m_type == comp || m_type == cluster ||
+		!flag(InError) || m_pending.skipNull()))
+		return time;
+	}
+    }
+    else if (m_state == Idle && flag(NoAutoRestart))
+	return time;
+    if (m_socket) {
+	Lock lck(m_socketMutex);
+	if (socketCanWrite() && (m_outStreamXml || (m_state == Running && m_pending.skipNull()))) {
+	    // Retry later if the socket could not take all data
+	    if (!m_sendBlocked)
+		return time;
+	    setEarliest(next,time + Thread::idleMsec());
+	}
+	XmlDocument* doc = m_xmlDom ? m_xmlDom->document() : 0;
+	XmlElement* root = doc ? doc->root(false) : 0;
+	if (root) {
+	    if (m_state == WaitStart || root->completed())
+		return time;
+	    XmlElement* xml = root->findFirstChild();
+	    if (xml && xml->completed())
+		return time;
+	    if (m_ppTerminate && !(m_pending.skipNull() && socketCanWrite()))
+		return time;
+	}
+    }
+    setEarliest(next,m_ppTerminateTimeout);
+    if (m_state == Running) {
+	if (m_pingTimeout)
+	    setEarliest(next,m_pingTimeout,true);
+	else
+	    setEarliest(next,m_nextPing);
+	setEarliest(next,m_idleTimeout,true);
+    }
+    else {
+	setEarliest(next,m_setupTimeout,true);
+	setEarliest(next,m_startTimeout,true);
+	setEarliest(next,m_connectTimeout,true);
+    }
+    return next;
+}
+
 // Reset the stream's connection. Build a new XML parser if the socket is valid
 void JBStream::resetConnection(Socket* sock)
 {
@@ -1203,6 +1395,8 @@ void JBStream::resetConnection(Socket* sock)
 		tmp = m_socket;
 		m_socket = 0;
 		m_socketFlags = 0;
+		// Closing the socket removes it from the receive set poller
+		m_pollHandle = Socket::invalidHandle();
 		if (m_xmlDom) {
 		    delete m_xmlDom;
 		    m_xmlDom = 0;
@@ -1227,7 +1421,8 @@ void JBStream::resetConnection(Socket* sock)
 	    delete sock;
 	    return;
 	}
-	m_xmlDom = new XmlDomParser(debugName());
+	m_xmlDom = new JBStreamParser(debugName(),m_engine->m_rawStanzas,
+	    m_engine->m_maxIncompleteXml / 2);
 	m_xmlDom->debugChain(this);
 	m_socket = sock;
 	if (debugAt(DebugAll)) {
@@ -1725,6 +1920,7 @@ void JBStream::changeState(State newState, u_int64_t time)
     m_state = newState;
     if (m_state == Running)
 	setIdleTimer(time);
+    requestProcess();
 }
 
 // Check if the stream compress flag is set and compression was offered by remote party
@@ -1811,6 +2007,7 @@ bool JBStream::sendPending(bool streamOnly)
 	    else
 		m_outStreamXmlCompress.cut(-(int)len);
 	}
+	m_sendBlocked = !all;
 	// Start TLS now for incoming streams
 	if (m_incoming && m_state == Securing) {
 	    if (all) {
@@ -1830,60 +2027,117 @@ bool JBStream::sendPending(bool streamOnly)
     // Send pending stanzas
     if (m_state != Running || streamOnly)
 	return true;
-    ObjList* obj = m_pending.skipNull();
-    if (!obj)
-	return true;
-    XmlElementOut* eout = static_cast<XmlElementOut*>(obj->get());
-    XmlElement* xml = eout->element();
-    if (!xml) {
-	m_pending.remove(eout,true);
-	return true;
-    }
-    bool sent = eout->sent();
-    const void* buf = 0;
-    unsigned int len = 0;
-    if (noComp)
-	buf = (const void*)eout->getData(len);
-    else {
-	if (!sent) {
-	    // Make sure the buffer is prepared for sending
-	    eout->getData(len);
-	    m_outXmlCompress.clear();
-	    if (!compress(eout))
-		return false;
-	}
-	buf = m_outXmlCompress.data();
-	len = m_outXmlCompress.length();
-    }
-    // Print the element only if it's the first time we try to send it
-    if (!sent)
-	m_engine->printXml(this,true,*xml);
-    if (writeSocket(buf,len)) {
-	if (!len)
+    // Send all pending stanzas the socket can take
+    // Uncompressed stanzas queued after the first one are written along with it
+    while (true) {
+	ObjList* obj = m_pending.skipNull();
+	if (!obj)
 	    return true;
-	setIdleTimer();
-	// Adjust element's buffer. Remove it from list on completion
-	unsigned int rest = 0;
+	XmlElementOut* eout = static_cast<XmlElementOut*>(obj->get());
+	XmlElement* xml = eout->element();
+	if (!xml) {
+	    m_pending.remove(eout,true);
+	    continue;
+	}
+	bool sent = eout->sent();
+	const void* buf = 0;
+	unsigned int len = 0;
+	ObjList* last = obj;
+	DataBlock batch;
 	if (noComp) {
-	    eout->dataSent(len);
-	    rest = eout->dataCount();
+	    buf = (const void*)eout->getData(len);
+	    unsigned int total = len;
+	    for (ObjList* o = obj->skipNext(); o && total < JB_SEND_BATCH; o = o->skipNext()) {
+		XmlElementOut* e = static_cast<XmlElementOut*>(o->get());
+		if (!e->element())
+		    break;
+		unsigned int n = 0;
+		e->getData(n);
+		total += n;
+		last = o;
+	    }
+	    if (last != obj) {
+		batch.assign(0,total);
+		unsigned char* d = (unsigned char*)batch.data();
+		for (ObjList* o = obj; o; o = (o != last) ? o->skipNext() : 0) {
+		    unsigned int n = 0;
+		    const char* data = static_cast<XmlElementOut*>(o->get())->getData(n);
+		    ::memcpy(d,data,n);
+		    d += n;
+		}
+		buf = batch.data();
+		len = total;
+	    }
 	}
 	else {
-	    m_outXmlCompress.cut(-(int)len);
-	    rest = m_outXmlCompress.length();
-	}
-	if (!rest) {
-	    DDebug(this,DebugAll,"Sent element (%p,%s) [%p]",xml,xml->tag(),this);
-	    m_pending.remove(eout,true);
+	    if (!sent) {
+		// Make sure the buffer is prepared for sending
+		eout->getData(len);
+		m_outXmlCompress.clear();
+		if (!compress(eout)) {
+		    m_sendBlocked = true;
+		    return false;
+		}
+	    }
+	    buf = m_outXmlCompress.data();
+	    len = m_outXmlCompress.length();
+	}
+	// Print the element only if it's the first time we try to send it
+	// Elements written along with it are printed when written
+	if (!sent)
+	    m_engine->printXml(this,true,*xml);
+	unsigned int size = len;
+	if (writeSocket(buf,len)) {
+	    if (!len) {
+		m_sendBlocked = true;
+		return true;
+	    }
+	    setIdleTimer();
+	    // Adjust elements buffer. Remove them from list on completion
+	    unsigned int rest = 0;
+	    if (noComp) {
+		rest = size - len;
+		ObjList done;
+		for (ObjList* o = obj; o && len; o = (o != last) ? o->skipNext() : 0) {
+		    eout = static_cast<XmlElementOut*>(o->get());
+		    if (o != obj && !eout->sent())
+			m_engine->printXml(this,true,*eout->element());
+		    unsigned int n = eout->dataCount();
+		    if (n > len)
+			n = len;
+		    eout->dataSent(n);
+		    len -= n;
+		    if (eout->dataCount())
+			break;
+		    done.append(eout)->setDelete(false);
+		}
+		xml = eout->element();
+		for (ObjList* o = done.skipNull(); o; o = o->skipNext()) {
+		    DDebug(this,DebugAll,"Sent element (%p,%s) [%p]",
+			static_cast<XmlElementOut*>(o->get())->element(),
+			static_cast<XmlElementOut*>(o->get())->element()->tag(),this);
+		    m_pending.remove(o->get(),true);
+		}
+	    }
+	    else {
+		m_outXmlCompress.cut(-(int)len);
+		rest = m_outXmlCompress.length();
+		if (!rest) {
+		    DDebug(this,DebugAll,"Sent element (%p,%s) [%p]",xml,xml->tag(),this);
+		    m_pending.remove(eout,true);
+		}
+	    }
+	    m_sendBlocked = (rest != 0);
+	    if (!rest)
+		continue;
+	    DDebug(this,DebugAll,"Partially sent element (%p,%s) rest=%u [%p]",
+		xml,xml->tag(),rest,this);
+	    return true;
 	}
-	else
-	    DDebug(this,DebugAll,"Partially sent element (%p,%s) sent=%u rest=%u [%p]",
-		xml,xml->tag(),len,rest,this);
-	return true;
+	// Error
+	Debug(this,DebugNote,"Failed to send (%p,%s) [%p]",xml,xml->tag(),this);
+	return false;
     }
-    // Error
-    Debug(this,DebugNote,"Failed to send (%p,%s) [%p]",xml,xml->tag(),this);
-    return false;
 }
 
 // Write data to socket
@@ -2545,6 +2799,8 @@ void JBStream::eventTerminated(const JBEvent* ev)
     if (ev && ev == m_lastEvent) {
 	m_lastEvent = 0;
 	XDebug(this,DebugAll,"Event (%p,%s) terminated [%p]",ev,ev->name(),this);
+	// Process queued events or data received meanwhile
+	requestProcess();
     }
 }
 
@@ -2611,6 +2867,8 @@ void JBStream::postponeTerminate(int location, bool destroy, int error, const ch
     unlock();
     if (!postponed)
 	terminate(location,destroy,0,error,reason);
+    else
+	requestProcess();
 }
 
 // Handle postponed termination. Return true if found
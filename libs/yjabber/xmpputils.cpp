@@ -1769,4 +1769,28 @@ void XMPPDirVal::toSubscription(String& buf) const
 	buf << lookup(val,s_names);
 }
 
+
+/*
+ * XmlElementShared
+ */
+XmlElementShared::XmlElementShared(XmlElement* element, const String* data)
+    : m_element(element)
+{
+    if (!TelEngine::null(data))
+	m_data = *data;
+    else if (m_element)
+	m_element->toString(m_data,true);
+}
+
+XmlElementShared::XmlElementShared(XmlElementShared* base, const String& data)
+    : m_element(base ? base->element() : 0), m_base(base), m_data(data)
+{
+}
+
+XmlElementShared::~XmlElementShared()
+{
+    if (!m_base)
+	TelEngine::destruct(m_element);
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
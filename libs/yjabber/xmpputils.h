@@ -2285,6 +2285,54 @@ private:
     int m_value;                         // The value
 };
 
+/**
+ * This class holds an XML element built once to be sent through many streams.
+ * Neither the element nor its data may be changed after building
+ * @short A shared outgoing XML element
+ */
+class YJABBER_API XmlElementShared : public RefObject
+{
+public:
+    /**
+     * Constructor. Build the data from the element if not given
+     * @param element The XML element, this object takes ownership of it
+     * @param data Optional already built element data
+     */
+    XmlElementShared(XmlElement* element, const String* data = 0);
+
+    /**
+     * Constructor. Send the element of another object with different data,
+     *  e.g. the same stanza with an added 'to' attribute
+     * @param base The object whose element is used
+     * @param data The data to send
+     */
+    XmlElementShared(XmlElementShared* base, const String& data);
+
+    /**
+     * Destructor. Delete the element if owned
+     */
+    virtual ~XmlElementShared();
+
+    /**
+     * Get the element
+     * @return The element
+     */
+    inline XmlElement* element() const
+	{ return m_element; }
+
+    /**
+     * Get the data to send
+     * @return The data to send
+     */
+    inline const String& data() const
+	{ return m_data; }
+
+private:
+    XmlElement* m_element;               // The XML element
+    RefPointer<XmlElementShared> m_base; // Object owning the element
+    String m_data;                       // Data to send
+};
+
 /**
  * This class holds an XML element to be sent through a stream
  * @short An outgoing XML element
@@ -2304,6 +2352,16 @@ public:
 	m_sent(false)
 	{}
 
+    /**
+     * Constructor. Send an element already built for many streams
+     * @param shared The shared element, its reference counter is increased
+     * @param senderID Optional sender id
+     */
+    inline XmlElementOut(XmlElementShared* shared, const char* senderID = 0)
+	: m_element(0), m_shared(shared), m_offset(0), m_id(senderID),
+	m_unclose(false), m_sent(false)
+	{}
+
     /**
      * Destructor
      * Delete m_element if not 0
@@ -2312,11 +2370,11 @@ public:
 	{ TelEngine::destruct(m_element); }
 
     /**
-     * Get the underlying element
+     * Get the underlying element. The element of a shared object must not be changed
      * @return The underlying element
      */
     inline XmlElement* element() const
-	{ return m_element; }
+	{ return m_shared ? m_shared->element() : m_element; }
 
     /**
      * Check if this element was (partially) sent
@@ -2330,7 +2388,7 @@ public:
      * @return The data buffer
      */
     inline const String& buffer()
-	{ return m_buffer; }
+	{ return m_shared ? m_shared->data() : m_buffer; }
 
     /**
      * Get the id member
@@ -2344,7 +2402,7 @@ public:
      * @return The unsent number of bytes
      */
     inline unsigned int dataCount()
-	{ return m_buffer.length() - m_offset; }
+	{ return buffer().length() - m_offset; }
 
     /**
      * Get the remainig data to send. Set the buffer if not already set
@@ -2352,10 +2410,10 @@ public:
      * @return Pointer to the remaining data or 0
      */
     inline const char* getData(unsigned int& nCount) {
-	    if (!m_buffer)
+	    if (!(m_shared || m_buffer))
 		prepareToSend();
 	    nCount = dataCount();
-	    return m_buffer.c_str() + m_offset;
+	    return buffer().c_str() + m_offset;
 	}
 
     /**
@@ -2365,12 +2423,12 @@ public:
     inline void dataSent(unsigned int nCount) {
 	    m_sent = true;
 	    m_offset += nCount;
-	    if (m_offset > m_buffer.length())
-		m_offset = m_buffer.length();
+	    if (m_offset > buffer().length())
+		m_offset = buffer().length();
 	}
 
     /**
-     * Release the ownership of m_element
+     * Release the ownership of m_element. The element of a shared object is not released
      * The caller is responsable of returned pointer
      * @return XmlElement pointer or 0
      */
@@ -2395,8 +2453,16 @@ public:
     inline void prepareToSend()
 	{ toBuffer(m_buffer); }
 
+    /**
+     * Set the data to send instead of building it from the element
+     * @param data Already built element data
+     */
+    inline void setBuffer(const String& data)
+	{ m_buffer = data; }
+
 private:
     XmlElement* m_element;               // The XML element
+    RefPointer<XmlElementShared> m_shared; // Shared element and data to send
     String m_buffer;                     // Data to send
     unsigned int m_offset;               // Offset to send
     String m_id;                         // Sender's id
@@ -269,7 +269,7 @@ public:
     inline JBEvent(Type type, JBStream* stream, XmlElement* element,
 	const JabberID& from, const JabberID& to, XmlElement* child = 0)
 	: m_type(type), m_stream(0), m_link(true), m_element(element),
-	m_child(child)
+	m_child(child), m_decodeText(false)
 	{ init(stream,element,&from,&to); }
 
     /**
@@ -282,7 +282,7 @@ public:
     inline JBEvent(Type type, JBStream* stream, XmlElement* element,
 	XmlElement* child = 0)
 	: m_type(type), m_stream(0), m_link(true), m_element(element),
-	m_child(child)
+	m_child(child), m_decodeText(false)
 	{ init(stream,element); }
 
     /**
@@ -334,11 +334,13 @@ public:
 	{ return m_id; }
 
     /**
-     * The stanza's text or termination reason for Terminated/Destroy events
+     * The stanza's text or termination reason for Terminated/Destroy events.
+     * The text of a stanza whose content was kept unparsed is decoded when first
+     *  requested, it is not available after the element is released
      * @return The event's text
      */
     inline const String& text() const
-	{ return m_text; }
+	{ if (m_decodeText) decodeText(); return m_text; }
 
     /**
      * Get the stream that generated this event
@@ -445,6 +447,7 @@ private:
     JBEvent() {}                         // Don't use it!
     bool init(JBStream* stream, XmlElement* element,
 	const JabberID* from = 0, const JabberID* to = 0);
+    void decodeText() const;             // Decode the text of the received element
 
     Type m_type;                         // Type of this event
     JBStream* m_stream;                  // The stream that generated this event
@@ -455,8 +458,9 @@ private:
     JabberID m_from;                     // Stanza's 'from' attribute
     JabberID m_to;                       // Stanza's 'to' attribute
     String m_id;                         // 'id' attribute if the received element has one
-    String m_text;                       // The stanza's text or termination reason for
+    mutable String m_text;               // The stanza's text or termination reason for
                                          //  Terminated/Destroy events
+    mutable bool m_decodeText;           // The stanza's text is not decoded yet
 };
 
 
@@ -469,6 +473,8 @@ class YJABBER_API JBStream : public RefObject, public DebugEnabler, public Mutex
 {
     friend class JBEngine;
     friend class JBEvent;
+    friend class JBStreamSetReceive;
+    friend class JBStreamSetProcessor;
 public:
     /**
      * Stream type enumeration
@@ -791,13 +797,35 @@ public:
      */
     JBEvent* getEvent(u_int64_t time = Time::msecNow());
 
+    /**
+     * Request the stream to be processed (its getEvent() called) as soon as
+     *  possible by the process set owning it.
+     * This method must be called when something changed the stream outside
+     *  its process set (data received, element queued, state changed ...).
+     * This method is thread safe
+     */
+    void requestProcess();
+
     /**
      * Send a stanza ('iq', 'message' or 'presence') or dialback elements in Running state.
      * This method is thread safe
      * @param xml Element to send (will be consumed and zeroed)
+     * @param raw Optional already built element data to send instead of
+     *  serializing the element (e.g. the same stanza sent to many streams)
+     * @return True on success
+     */
+    bool sendStanza(XmlElement*& xml, const String* raw = 0);
+
+    /**
+     * Send a stanza built once for many streams in Running state.
+     * The stanza is queued without copying its element or data.
+     * This method is thread safe
+     * @param xml The stanza to send, its reference counter is increased
+     * @param send True to try to send it now, false to let the process set
+     *  owning the stream send it from its own thread
      * @return True on success
      */
-    bool sendStanza(XmlElement*& xml);
+    bool sendStanza(XmlElementShared* xml, bool send = true);
 
     /**
      * Send stream related XML when negotiating the stream or some other
@@ -1006,6 +1034,16 @@ protected:
      */
     virtual void checkTimeouts(u_int64_t time);
 
+    /**
+     * Retrieve the time the stream must be processed again.
+     * This method is called by the process set after getEvent().
+     * Descendants adding timers or state to process should override it
+     * @param time Current time
+     * @return The time to process the stream again, 'time' (or less) if there is
+     *  more to process now, 0 if the stream waits for a process request
+     */
+    virtual u_int64_t processTime(u_int64_t time);
+
     /**
      * Reset the stream's connection. Build a new XML parser if the socket is valid
      * Release the old connection
@@ -1239,6 +1277,7 @@ protected:
     JBEvent* m_lastEvent;                // Last event generated by this stream
     ObjList m_events;                    // Queued events
     ObjList m_pending;                   // Pending outgoing elements
+    bool m_sendBlocked;                  // Last attempt to send pending data could not send all
     unsigned int m_stanzaIndex;          // Index used to generate IDs for stanzas
     // Timers
     u_int64_t m_setupTimeout;            // Overall stream setup timeout
@@ -1371,6 +1410,11 @@ private:
     Socket* m_socket;
     char m_socketFlags;                  // Socket flags: 0: unavailable
     Mutex m_socketMutex;                 // Protect the socket and parser
+    SOCKET m_pollHandle;                 // Socket handle armed in the receive set poller
+    JBStreamSetProcessor* m_processor;   // The process set owning the stream
+    bool m_processReady;                 // Queued in the process set ready list
+    unsigned int m_processIndex;         // Position (1 based) in the process set timers heap
+    u_int64_t m_processTime;             // Time to process the stream (in the timers heap)
     String m_connectAddr;                // Remote ip to connect to
     int m_connectPort;                   // Remote port to connect to
     String m_localIp;                    // Local ip to bind when connecting
@@ -2049,6 +2093,18 @@ public:
      */
     ObjList* findClientStreams(bool in, const JabberID& jid, int flags = 0xffffffff);
 
+    /**
+     * Queue a stanza built once on many streams. The stanza is not sent from
+     *  the calling thread: each process set owning some of the streams is
+     *  woken up once and sends it from its own thread.
+     * A stanza queued on a single stream is sent from the calling thread.
+     * This method is thread safe
+     * @param xml The stanza to send
+     * @param streams List of JBStream objects
+     * @return The number of streams the stanza was queued on
+     */
+    unsigned int sendStanza(XmlElementShared* xml, const ObjList& streams);
+
     /**
      * Find all c2s streams whose local or remote bare jid matches a given one and
      *  their resource is found in the given list.
@@ -2063,6 +2119,19 @@ public:
     ObjList* findClientStreams(bool in, const JabberID& jid, const ObjList& resources,
 	int flags = 0xffffffff);
 
+    /**
+     * Find all c2s streams matching a list of jids in a single pass.
+     * A jid without resource matches all streams of the user.
+     * Ignore destroying streams.
+     * This method is thread safe
+     * @param in True for incoming, false for outgoing
+     * @param jids List of JabberID objects to compare (the local one for outgoing,
+     *  remote jid for incoming)
+     * @param flags Optional stream flag to match
+     * @return List of referenced JBClientStream pointers or 0
+     */
+    ObjList* findClientStreams(bool in, const ObjList& jids, int flags = 0xffffffff);
+
     /**
      * Find a c2s stream by its local or remote jid.
      * This method is thread safe
@@ -2244,6 +2313,7 @@ protected:
     unsigned int m_pptTimeout;           // Non client streams postpone stream termination intervals
     unsigned int m_streamReadBuffer;     // Stream read buffer length
     unsigned int m_maxIncompleteXml;     // Maximum length of an incomplete xml
+    bool m_rawStanzas;                   // Keep received message/presence content unparsed
     unsigned int m_redirectMax;          // Max redirect counter for outgoing streams
     bool m_hasClientTls;                 // True if TLS is available for outgoing streams
     int m_printXml;                      // Print XML data to output
@@ -2551,7 +2621,7 @@ public:
      * Process the list.
      * Returns as soon as there are no more streams in the list
      */
-    void run();
+    virtual void run();
 
     /**
      * Start running
@@ -2597,14 +2667,51 @@ private:
 class YJABBER_API JBStreamSetProcessor : public JBStreamSet
 {
     YCLASS(JBStreamSetProcessor,JBStreamSet);
+    friend class JBStream;
+public:
+    /**
+     * Destructor
+     */
+    virtual ~JBStreamSetProcessor();
+
+    /**
+     * Add a stream to the set and request its processing
+     * @param client The stream to append
+     * @return True on success, false if there is no more room in this set
+     */
+    virtual bool add(JBStream* client);
+
+    /**
+     * Remove a stream from set. Cancel its pending processing
+     * @param client The stream to remove
+     * @param delObj True to release the stream, false to remove it from list
+     *  without releasing it
+     * @return True on success, false if not found
+     */
+    virtual bool remove(JBStream* client, bool delObj = true);
+
+    /**
+     * Process the streams whose processing was requested or whose timer expired.
+     * Wait for requests until the earliest stream timer otherwise.
+     * Returns as soon as there are no more streams in the list
+     */
+    virtual void run();
+
+    /**
+     * Retrieve the number of process sets to spread a large number of streams to.
+     * Sets process only the streams needing it and can handle any number of
+     *  streams: use one set (thread) for each processor
+     * @return The number of sets to use, 0 if unknown and the number of
+     *  streams per set should be limited instead
+     */
+    static unsigned int maxSets();
+
 protected:
     /**
      * Constructor
      * @param owner The list owning this set
      */
-    inline JBStreamSetProcessor(JBStreamSetList* owner)
-	: JBStreamSet(owner)
-	{}
+    JBStreamSetProcessor(JBStreamSetList* owner);
 
     /**
      * This method is called from run() with the list unlocked and stream's
@@ -2615,6 +2722,26 @@ protected:
      * @return True if an event was generated by the stream
      */
     virtual bool process(JBStream& stream);
+
+private:
+    // Queue a stream in the ready list. Wake up the set if asked
+    // The ready mutex must be locked
+    void setReady(JBStream* stream, bool wake = true);
+    // Set the time to process a stream. The ready mutex must be locked
+    void schedule(JBStream* stream, u_int64_t time);
+    // Remove a stream from timers heap. The ready mutex must be locked
+    void unschedule(JBStream* stream);
+    // Move a heap entry up or down to its place
+    void heapUp(unsigned int pos);
+    void heapDown(unsigned int pos);
+
+    Mutex m_readyMutex;                  // Protect the ready list and timers heap
+    Semaphore m_wake;                    // Wake up the set on process request
+    ObjList m_ready;                     // Streams to process now
+    ObjList* m_readyLast;                // Last item in the ready list
+    JBStream** m_heap;                   // Streams waiting for their timers, earliest first
+    unsigned int m_heapLen;              // Streams in timers heap
+    unsigned int m_heapSize;             // Allocated timers heap size
 };
 
 
@@ -2625,9 +2752,41 @@ protected:
 class YJABBER_API JBStreamSetReceive : public JBStreamSet
 {
     YCLASS(JBStreamSetReceive,JBStreamSet);
+public:
+    /**
+     * Destructor. Release the socket poller
+     */
+    virtual ~JBStreamSetReceive();
+
+    /**
+     * Remove a stream from set. Stop waiting for data on its socket
+     * @param client The stream to remove
+     * @param delObj True to release the stream, false to remove it from list
+     *  without releasing it
+     * @return True on success, false if not found
+     */
+    virtual bool remove(JBStream* client, bool delObj = true);
+
+    /**
+     * Receive data. Wait for socket events if a poller is available,
+     *  read only the streams having data to receive.
+     * Fall back to checking all streams in turn otherwise.
+     * Returns as soon as there are no more streams in the list
+     */
+    virtual void run();
+
+    /**
+     * Retrieve the number of receive sets to spread a large number of streams to.
+     * Sets waiting for socket events can handle any number of streams:
+     *  use one set (thread) for each processor
+     * @return The number of sets to use, 0 if the streams are checked in turn
+     *  and the number of streams per set should be limited instead
+     */
+    static unsigned int maxSets();
+
 protected:
     /**
-     * Constructor. Build the read buffer
+     * Constructor. Build the read buffer and the socket poller
      * @param owner The list owning this set
      */
     JBStreamSetReceive(JBStreamSetList* owner);
@@ -2643,6 +2802,10 @@ protected:
 
 protected:
     DataBlock m_buffer;                  // Read buffer
+
+private:
+    bool pollArm(JBStream* stream);      // Wait for data on stream's socket
+    int m_poll;                          // Socket poller, -1 if not available
 };
 
 
@@ -2659,12 +2822,15 @@ public:
     /**
      * Constructor
      * @param engine Engine owning this list
-     * @param max Maximum streams per set (0 for maximum possible)
+     * @param max Maximum streams per set (0 for maximum possible).
+     *  Ignored if the number of sets is limited
      * @param sleepMs Time to sleep when idle
      * @param name List name (for debugging purposes)
+     * @param maxSets Maximum number of sets (0 for no limit). Streams are spread
+     *  over the sets when limited
      */
     JBStreamSetList(JBEngine* engine, unsigned int max, unsigned int sleepMs,
-	const char* name);
+	const char* name, unsigned int maxSets = 0);
 
     /**
      * Retrieve the stream set list.
@@ -2686,6 +2852,13 @@ public:
     inline unsigned int maxStreams() const
 	{ return m_max; }
 
+    /**
+     * Retrieve the maximum number of sets
+     * @return The maximum number of sets, 0 if not limited
+     */
+    inline unsigned int maxSets() const
+	{ return m_maxSets; }
+
     /**
      * Retrieve the number of streams in all sets
      * @return The number of streams in all sets
@@ -2701,7 +2874,8 @@ public:
 	{ return m_engine; }
 
     /**
-     * Add a stream to the list. Build a new set if there is no room in existing sets
+     * Add a stream to the list. Build a new set if there is no room in existing sets.
+     * If the number of sets is limited the streams are added to sets in turn
      * @param client The stream to add
      * @return True on success
      */
@@ -2749,6 +2923,7 @@ protected:
     JBEngine* m_engine;                  // The engine owning this list
     String m_name;                       // List name
     unsigned int m_max;                  // The maximum number of streams per set
+    unsigned int m_maxSets;              // The maximum number of sets
     unsigned int m_sleepMs;              // Time to sleep if nothig processed
     ObjList m_sets;                      // The sets list
 
@@ -245,21 +245,26 @@ bool RTPSecure::rtpDecipher(unsigned char* data, int len, const void* secData, u
 	return true;
     if (!(len && m_rtpCipher))
 	return false;
-    DataBlock iv(m_cipherSalt);
+    // build the IV in place, this runs for every packet
+    unsigned char iv[16];
+    unsigned int ivLen = m_cipherSalt.length();
+    if (ivLen < 8 || ivLen > sizeof(iv))
+	return false;
+    ::memcpy(iv,m_cipherSalt.data(),ivLen);
     int i;
     // SSRC << 64
-    unsigned char* p = (iv.length() - 8) + (unsigned char*)iv.data();
+    unsigned char* p = iv + (ivLen - 8);
     for (i = 0; i < 4; i++) {
 	*--p ^= (ssrc & 0xff);
 	ssrc >>= 8;
     }
     // index << 16
-    p = (iv.length() - 2) + (unsigned char*)iv.data();
+    p = iv + (ivLen - 2);
     for (i = 0; i < 6; i++) {
 	*--p ^= (seq & 0xff);
 	seq >>= 8;
     }
-    m_rtpCipher->initVector(iv);
+    m_rtpCipher->initVector(iv,ivLen);
     m_rtpCipher->decrypt(data,len);
     return true;
 }
@@ -273,25 +278,21 @@ bool RTPSecure::rtpCheckIntegrity(const unsigned char* data, int len, const void
 
     // RFC 3711 4.2
     u_int32_t roc = htonl((u_int32_t)(seq >> 16));
-    SHA1 h1(m_authIpad);
-    h1.update(data,len);
-    h1.update(&roc,sizeof(roc));
-    h1.finalize();
-    SHA1 hmac(m_authOpad);
-    hmac.update(h1.rawDigest(),h1.rawLength());
-    hmac.finalize();
+    unsigned char hmac[20];
+    if (!authenticate(hmac,data,len,roc))
+	return false;
 #ifdef DEBUG
-    if (::memcmp(authData,hmac.rawDigest(),m_rtpAuthLen)) {
+    if (::memcmp(authData,hmac,m_rtpAuthLen)) {
 	String s1,s2;
 	s1.hexify((void*)authData,m_rtpAuthLen);
-	s2.hexify((void*)hmac.rawDigest(),m_rtpAuthLen);
+	s2.hexify(hmac,m_rtpAuthLen);
 	Debug(DebugMild,"SRTP HMAC recv: %s calc: %s seq: " FMT64U " [%p]",
 	    s1.c_str(),s2.c_str(),seq,this);
 	return false;
     }
     return true;
 #else
-    return 0 == ::memcmp(authData,hmac.rawDigest(),m_rtpAuthLen);
+    return 0 == ::memcmp(authData,hmac,m_rtpAuthLen);
 #endif
 }
 
@@ -310,14 +311,17 @@ void RTPSecure::rtpAddIntegrity(const unsigned char* data, int len, unsigned cha
 
     // RFC 3711 4.2
     u_int32_t roc = htonl(m_owner->rollover());
-    SHA1 h1(m_authIpad);
-    h1.update(data,len);
-    h1.update(&roc,sizeof(roc));
-    h1.finalize();
-    SHA1 hmac(m_authOpad);
-    hmac.update(h1.rawDigest(),h1.rawLength());
-    hmac.finalize();
-    ::memcpy(authData,hmac.rawDigest(),m_rtpAuthLen);
+    unsigned char hmac[20];
+    if (authenticate(hmac,data,len,roc))
+	::memcpy(authData,hmac,m_rtpAuthLen);
+}
+
+// Compute the HMAC-SHA1 of packet and rollover counter from the precomputed pads
+bool RTPSecure::authenticate(unsigned char* hmac, const unsigned char* data, int len, u_int32_t roc) const
+{
+    unsigned char inner[20];
+    return m_authIpad.rawDigestWith(inner,data,len,&roc,sizeof(roc))
+	&& m_authOpad.rawDigestWith(hmac,inner,sizeof(inner));
 }
 
 /* vi: set ts=8 sw=4 sts=4 noet: */
@@ -1554,6 +1554,7 @@ protected:
     bool deriveKey(Cipher& cipher, DataBlock& key, unsigned int len, unsigned char label, u_int64_t index = 0);
 
 private:
+    bool authenticate(unsigned char* hmac, const unsigned char* data, int len, u_int32_t roc) const;
     RTPBaseIO* m_owner;
     Cipher* m_rtpCipher;
     DataBlock m_masterKey;
@@ -1140,15 +1140,48 @@ bool ExpEvaluator::runOperation(ObjList& stack, const ExpOperation& oper, GenObj
 			}
 		    }
 		}
+		// recycle an anonymous plain operand to hold the result
+		ExpOperation* res = 0;
+		if (op2->name().null() && op2->opcode() == OpcPush && !op2->barrier()
+			&& !YOBJECT(ExpWrapper,op2)) {
+		    res = op2;
+		    op2 = 0;
+		}
+		else if (op1->name().null() && op1->opcode() == OpcPush && !op1->barrier()
+			&& !YOBJECT(ExpWrapper,op1)) {
+		    res = op1;
+		    op1 = 0;
+		}
 		TelEngine::destruct(op1);
 		TelEngine::destruct(op2);
 		if (boolRes) {
 		    DDebug(this,DebugAll,"Bool result: '%s'",String::boolText(val != 0));
-		    pushOne(stack,new ExpOperation(val != 0));
+		    if (res) {
+			res->String::operator=(String::boolText(val != 0));
+			res->m_number = (val != 0) ? 1 : 0;
+			res->m_bool = true;
+			res->m_isNumber = true;
+			res->m_lineNo = 0;
+			pushOne(stack,res);
+		    }
+		    else
+			pushOne(stack,new ExpOperation(val != 0));
 		}
 		else {
 		    DDebug(this,DebugAll,"Numeric result: " FMT64,val);
-		    pushOne(stack,new ExpOperation(val));
+		    if (res) {
+			if (val != ExpOperation::nonInteger())
+			    res->String::operator=(val);
+			else
+			    res->String::operator=("NaN");
+			res->m_number = val;
+			res->m_bool = false;
+			res->m_isNumber = true;
+			res->m_lineNo = 0;
+			pushOne(stack,res);
+		    }
+		    else
+			pushOne(stack,new ExpOperation(val));
 		}
 	    }
 	    break;
@@ -1343,6 +1376,549 @@ bool ExpEvaluator::runOperation(ObjList& stack, const ExpOperation& oper, GenObj
     return true;
 }
 
+namespace TelEngine {
+
+// Operand popped off a stack of tagged values, read in place where possible
+class ExpOperand
+{
+public:
+    inline ExpOperand()
+	: m_type(0), m_number(ExpOperation::nonInteger()), m_text(0),
+	  m_oper(0), m_owned(0), m_name(0)
+	{ }
+    inline ~ExpOperand()
+	{ TelEngine::destruct(m_owned); }
+    bool pop(const ExpEvaluator& eval, ExpValueStack& values, GenObject* context, ExpOperand* other = 0);
+    void own();
+    void push(ExpValueStack& values);
+    bool assign(const ExpEvaluator& eval, ObjList& stack, const String& name, GenObject* context) const;
+    bool equals(const ExpOperand& other, bool identity) const;
+    const String& text(String& tmp) const;
+    inline bool plain() const
+	{ return m_name != 0; }
+    inline bool isText() const
+	{ return m_type == ExpValueStack::Text; }
+    inline ExpOperation* owned() const
+	{ return m_owned; }
+    inline bool isNumber() const
+	{ return m_oper ? m_oper->isNumber() : !isText(); }
+    inline bool isBoolean() const
+	{ return m_oper ? m_oper->isBoolean() : (m_type == ExpValueStack::Boolean); }
+    inline int64_t valInteger() const
+    {
+	if (!m_oper)
+	    return (m_number != ExpOperation::nonInteger()) ? m_number : 0;
+	return plain() ? m_oper->ExpOperation::valInteger() : m_oper->valInteger();
+    }
+    inline int64_t toNumber() const
+    {
+	if (!m_oper)
+	    return isText() ? m_text->toInt64(ExpOperation::nonInteger()) : m_number;
+	return plain() ? m_oper->ExpOperation::toNumber() : m_oper->toNumber();
+    }
+    inline bool valBoolean() const
+    {
+	if (!m_oper)
+	    return isText() ? !m_text->null() : ((m_number == ExpOperation::nonInteger()) || m_number);
+	return plain() ? m_oper->ExpOperation::valBoolean() : m_oper->valBoolean();
+    }
+    inline void append(String& buf) const
+    {
+	String tmp;
+	buf << text(tmp);
+    }
+private:
+    inline ExpEvaluator::Opcode opcode() const
+	{ return (m_oper && !plain()) ? m_oper->opcode() : ExpEvaluator::OpcPush; }
+    inline int64_t number() const
+	{ return m_oper ? m_oper->number() : m_number; }
+    inline ExpWrapper* wrapper() const
+	{ return (m_oper && !plain()) ? YOBJECT(ExpWrapper,m_oper) : 0; }
+    int m_type;
+    int64_t m_number;
+    const String* m_text;
+    const ExpOperation* m_oper;
+    ExpOperation* m_owned;
+    const String* m_name;
+};
+
+}; // namespace TelEngine
+
+// Pop a value, evaluate a field either in place or by pushing its value on the stack
+bool ExpOperand::pop(const ExpEvaluator& eval, ExpValueStack& values, GenObject* context, ExpOperand* other)
+{
+    if (!values.m_count)
+	return false;
+    ExpValueStack::Value& v = values.m_values[--values.m_count];
+    m_type = v.type;
+    switch (v.type) {
+	case ExpValueStack::Integer:
+	case ExpValueStack::Boolean:
+	    m_number = v.number;
+	    return true;
+	case ExpValueStack::Text:
+	    m_text = &v.text;
+	    return true;
+	case ExpValueStack::Owned:
+	    m_owned = const_cast<ExpOperation*>(v.oper);
+	    m_oper = m_owned;
+	    return true;
+	default:
+	    break;
+    }
+    if (v.oper->opcode() != ExpEvaluator::OpcField) {
+	m_oper = v.oper;
+	return true;
+    }
+    m_oper = eval.fieldValue(values.stack(),*v.oper,context);
+    if (m_oper) {
+	m_name = &v.oper->name();
+	return true;
+    }
+    // evaluating the field may change the value read in place by the other operand
+    if (other)
+	other->own();
+    if (!eval.runField(values.stack(),*v.oper,context))
+	return false;
+    m_owned = ExpEvaluator::popOne(values.stack());
+    m_oper = m_owned;
+    m_type = ExpValueStack::Owned;
+    return m_oper != 0;
+}
+
+// Copy a value read in place from a field like runField() does
+void ExpOperand::own()
+{
+    if (!plain())
+	return;
+    m_owned = new ExpOperation(*m_oper,*m_name,false);
+    m_oper = m_owned;
+    m_name = 0;
+    m_type = ExpValueStack::Owned;
+}
+
+// Push the value back, strings left in place by the last value popped are reused
+void ExpOperand::push(ExpValueStack& values)
+{
+    switch (m_type) {
+	case ExpValueStack::Integer:
+	    values.pushInteger(m_number);
+	    return;
+	case ExpValueStack::Boolean:
+	    values.pushBoolean(m_number != 0);
+	    return;
+	case ExpValueStack::Text:
+	    {
+		unsigned int n = values.count();
+		bool keep = (n < sizeof(values.m_values) / sizeof(values.m_values[0]))
+		    && (m_text == &values.m_values[n].text);
+		String& str = values.pushText(keep);
+		if (!keep)
+		    str = *m_text;
+	    }
+	    return;
+	default:
+	    break;
+    }
+    own();
+    if (m_owned) {
+	values.pushOwned(m_owned);
+	m_owned = 0;
+    }
+    else
+	values.pushReference(m_oper);
+}
+
+// Assign the value to a field, tagged values are passed as temporary operations
+bool ExpOperand::assign(const ExpEvaluator& eval, ObjList& stack, const String& name, GenObject* context) const
+{
+    switch (m_type) {
+	case ExpValueStack::Integer:
+	    {
+		ExpOperation op(m_number,name);
+		return eval.runAssign(stack,op,context);
+	    }
+	case ExpValueStack::Boolean:
+	    {
+		ExpOperation op(m_number != 0,name);
+		return eval.runAssign(stack,op,context);
+	    }
+	case ExpValueStack::Text:
+	    {
+		ExpOperation op(*m_text,name);
+		return eval.runAssign(stack,op,context);
+	    }
+	default:
+	    break;
+    }
+    if (plain()) {
+	ExpOperation op(*m_oper,name,false);
+	return eval.runAssign(stack,op,context);
+    }
+    ExpOperation* op = m_oper->clone(name);
+    bool ok = eval.runAssign(stack,*op,context);
+    TelEngine::destruct(op);
+    return ok;
+}
+
+// Compare like the == and === operators, wrapped objects by identity
+bool ExpOperand::equals(const ExpOperand& other, bool identity) const
+{
+    ExpWrapper* w1 = wrapper();
+    ExpWrapper* w2 = other.wrapper();
+    if (identity) {
+	if (opcode() != other.opcode())
+	    return false;
+	if (w1 || w2)
+	    return w1 && w2 && w1->object() == w2->object();
+	if (number() != other.number())
+	    return false;
+    }
+    else if (w1 && w2 && opcode() == other.opcode())
+	return w1->object() == w2->object();
+    // numbers and booleans computed here have a single text representation
+    if (!(m_oper || other.m_oper || isText() || other.isText()))
+	return (m_type == other.m_type) && (m_number == other.m_number);
+    String tmp1;
+    String tmp2;
+    return text(tmp1) == other.text(tmp2);
+}
+
+const String& ExpOperand::text(String& tmp) const
+{
+    if (m_oper)
+	return *m_oper;
+    switch (m_type) {
+	case ExpValueStack::Text:
+	    return *m_text;
+	case ExpValueStack::Boolean:
+	    tmp = String::boolText(m_number != 0);
+	    break;
+	default:
+	    if (m_number != ExpOperation::nonInteger())
+		tmp = m_number;
+	    else
+		tmp = "NaN";
+	    break;
+    }
+    return tmp;
+}
+
+bool ExpEvaluator::valueOperation(Opcode oper)
+{
+    if (oper & OpcAssign) {
+	if (oper == OpcAssign)
+	    return true;
+	oper = (Opcode)(oper & ~OpcAssign);
+	switch (oper) {
+	    case OpcAdd:
+	    case OpcSub:
+	    case OpcMul:
+	    case OpcDiv:
+	    case OpcMod:
+	    case OpcAnd:
+	    case OpcOr:
+	    case OpcXor:
+	    case OpcShl:
+	    case OpcShr:
+		return true;
+	    default:
+		return false;
+	}
+    }
+    switch (oper) {
+	case OpcDrop:
+	case OpcAdd:
+	case OpcSub:
+	case OpcMul:
+	case OpcDiv:
+	case OpcMod:
+	case OpcNeg:
+	case OpcIncPre:
+	case OpcDecPre:
+	case OpcIncPost:
+	case OpcDecPost:
+	case OpcAnd:
+	case OpcOr:
+	case OpcXor:
+	case OpcNot:
+	case OpcShl:
+	case OpcShr:
+	case OpcLAnd:
+	case OpcLOr:
+	case OpcLNot:
+	case OpcCat:
+	case OpcEq:
+	case OpcNe:
+	case OpcGt:
+	case OpcLt:
+	case OpcGe:
+	case OpcLe:
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+int ExpEvaluator::popBoolean(ExpValueStack& values, GenObject* context) const
+{
+    ExpOperand op;
+    if (!op.pop(*this,values,context))
+	return -1;
+    return op.valBoolean() ? 1 : 0;
+}
+
+int ExpEvaluator::popCompare(ExpValueStack& values, bool identity, GenObject* context) const
+{
+    ExpOperand op2;
+    ExpOperand op1;
+    if (!(op2.pop(*this,values,context) && op1.pop(*this,values,context,&op2)))
+	return -1;
+    return op1.equals(op2,identity) ? 1 : 0;
+}
+
+bool ExpEvaluator::runValues(ExpValueStack& values, const ExpOperation& oper, GenObject* context) const
+{
+    DDebug(this,DebugAll,"runValues(%p,%u,%p) %s",&values,oper.opcode(),context,getOperator(oper.opcode()));
+    Opcode opc = oper.opcode();
+    bool ok = valueOperation(opc);
+    if (ok) {
+	switch (opc) {
+	    case OpcDrop:
+	    case OpcNeg:
+	    case OpcNot:
+	    case OpcLNot:
+		ok = values.count() > 0;
+		break;
+	    case OpcIncPre:
+	    case OpcDecPre:
+	    case OpcIncPost:
+	    case OpcDecPost:
+		ok = values.reference() && values.reference()->opcode() == OpcField;
+		break;
+	    default:
+		if (opc & OpcAssign)
+		    ok = values.reference(1) && values.reference(1)->opcode() == OpcField;
+		else
+		    ok = values.count() > 1;
+		break;
+	}
+    }
+    if (!ok) {
+	// operands are on the evaluation stack or the operation needs them there
+	values.flush();
+	return runOperation(values.stack(),oper,context);
+    }
+    switch (opc) {
+	case OpcDrop:
+	    values.drop();
+	    return true;
+	case OpcNeg:
+	case OpcNot:
+	case OpcLNot:
+	    {
+		ExpOperand op;
+		if (!op.pop(*this,values,context))
+		    return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+		if (opc == OpcLNot)
+		    values.pushBoolean(!op.valBoolean());
+		else
+		    values.pushInteger((opc == OpcNeg) ? -op.toNumber() : ~op.valInteger());
+	    }
+	    return true;
+	case OpcLAnd:
+	case OpcLOr:
+	    {
+		ExpOperand op2;
+		ExpOperand op1;
+		if (!(op2.pop(*this,values,context) && op1.pop(*this,values,context,&op2)))
+		    return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+		if (opc == OpcLAnd)
+		    values.pushBoolean(op1.valBoolean() && op2.valBoolean());
+		else
+		    values.pushBoolean(op1.valBoolean() || op2.valBoolean());
+	    }
+	    return true;
+	case OpcEq:
+	case OpcNe:
+	    {
+		int eq = popCompare(values,false,context);
+		if (eq < 0)
+		    return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+		values.pushBoolean((eq != 0) == (opc == OpcEq));
+	    }
+	    return true;
+	case OpcIncPre:
+	case OpcDecPre:
+	case OpcIncPost:
+	case OpcDecPost:
+	    {
+		const ExpOperation* fld = values.reference();
+		ExpOperand val;
+		if (!val.pop(*this,values,context))
+		    return false;
+		int64_t num = val.valInteger();
+		int64_t res = num;
+		switch (opc) {
+		    case OpcIncPre:
+			res = ++num;
+			break;
+		    case OpcDecPre:
+			res = --num;
+			break;
+		    case OpcIncPost:
+			num++;
+			break;
+		    default:
+			num--;
+			break;
+		}
+		// a plain number is pushed back by value, other values keep their type
+		bool tagged = val.plain() && !val.isBoolean();
+		if (!tagged) {
+		    val.own();
+		    *val.owned() = res;
+		}
+		ExpOperation op(*fld);
+		op.lineNumber(fld->lineNumber());
+		op = num;
+		if (!runAssign(values.stack(),op,context))
+		    return gotError("Assignment failed",oper.lineNumber());
+		if (tagged)
+		    values.pushInteger(res);
+		else
+		    val.push(values);
+	    }
+	    return true;
+	case OpcAssign:
+	    {
+		ExpOperand val;
+		if (!val.pop(*this,values,context))
+		    return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+		const ExpOperation* fld = values.reference();
+		values.drop();
+		// the assignment may release a value read in place
+		val.own();
+		if (!val.assign(*this,values.stack(),fld->name(),context))
+		    return gotError("Assignment failed",oper.lineNumber());
+		val.push(values);
+	    }
+	    return true;
+	default:
+	    break;
+    }
+    // binary arithmetic, comparison, concatenation or assignment by operation
+    const ExpOperation* fld = (opc & OpcAssign) ? values.reference(1) : 0;
+    opc = (Opcode)(opc & ~OpcAssign);
+    ExpOperand op2;
+    ExpOperand op1;
+    if (!(op2.pop(*this,values,context) && op1.pop(*this,values,context,&op2)))
+	return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+    bool boolRes = false;
+    int64_t val = 0;
+    switch (opc) {
+	case OpcDiv:
+	case OpcMod:
+	    if (!op2.toNumber())
+		return gotError("Division by zero",oper.lineNumber());
+	    break;
+	case OpcAdd:
+	    if (op1.isNumber() && op2.isNumber())
+		break;
+	    // turn addition into concatenation
+	    // fall through
+	case OpcCat:
+	    {
+		// append in place to a string left by the first operand
+		bool keep = op1.isText();
+		String& str = values.pushText(keep);
+		if (!keep)
+		    op1.append(str);
+		op2.append(str);
+		DDebug(this,DebugAll,"String result: '%s'",str.c_str());
+	    }
+	    opc = OpcNone;
+	    break;
+	default:
+	    break;
+    }
+    switch (opc) {
+	case OpcNone:
+	    break;
+	case OpcAnd:
+	    val = op1.valInteger() & op2.valInteger();
+	    break;
+	case OpcOr:
+	    val = op1.valInteger() | op2.valInteger();
+	    break;
+	case OpcXor:
+	    val = op1.valInteger() ^ op2.valInteger();
+	    break;
+	case OpcShl:
+	    val = op1.valInteger() << op2.valInteger();
+	    break;
+	case OpcShr:
+	    val = op1.valInteger() >> op2.valInteger();
+	    break;
+	case OpcLt:
+	    boolRes = true;
+	    val = (op1.valInteger() < op2.valInteger()) ? 1 : 0;
+	    break;
+	case OpcGt:
+	    boolRes = true;
+	    val = (op1.valInteger() > op2.valInteger()) ? 1 : 0;
+	    break;
+	case OpcLe:
+	    boolRes = true;
+	    val = (op1.valInteger() <= op2.valInteger()) ? 1 : 0;
+	    break;
+	case OpcGe:
+	    boolRes = true;
+	    val = (op1.valInteger() >= op2.valInteger()) ? 1 : 0;
+	    break;
+	default:
+	    {
+		val = ExpOperation::nonInteger();
+		int64_t op1Val = op1.toNumber();
+		int64_t op2Val = op2.toNumber();
+		if (op1Val == ExpOperation::nonInteger() || op2Val == ExpOperation::nonInteger())
+		    break;
+		switch (opc) {
+		    case OpcAdd:
+			val = op1Val + op2Val;
+			break;
+		    case OpcSub:
+			val = op1Val - op2Val;
+			break;
+		    case OpcMul:
+			val = op1Val * op2Val;
+			break;
+		    case OpcDiv:
+			val = op1Val / op2Val;
+			break;
+		    case OpcMod:
+			val = op1Val % op2Val;
+			break;
+		    default:
+			break;
+		}
+	    }
+	    break;
+    }
+    if (boolRes)
+	values.pushBoolean(val != 0);
+    else if (opc != OpcNone)
+	values.pushInteger(val);
+    if (!fld)
+	return true;
+    ExpOperand res;
+    res.pop(*this,values,context);
+    if (!res.assign(*this,values.stack(),fld->name(),context))
+	return gotError("Assignment failed",oper.lineNumber());
+    res.push(values);
+    return true;
+}
+
 bool ExpEvaluator::runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context) const
 {
     DDebug(this,DebugAll,"runFunction(%p,'%s' " FMT64 ", %p) ext=%p",
@@ -1382,6 +1958,11 @@ bool ExpEvaluator::runAssign(ObjList& stack, const ExpOperation& oper, GenObject
     return m_extender && m_extender->runAssign(stack,oper,context);
 }
 
+const ExpOperation* ExpEvaluator::fieldValue(ObjList& stack, const ExpOperation& oper, GenObject* context) const
+{
+    return 0;
+}
+
 bool ExpEvaluator::runEvaluate(const ObjList& opcodes, ObjList& stack, GenObject* context) const
 {
     DDebug(this,DebugInfo,"runEvaluate(%p,%p,%p)",&opcodes,&stack,context);
@@ -1646,6 +2227,129 @@ void* ExpWrapper::getObject(const String& name) const
 }
 
 
+ExpValueStack::ExpValueStack(ObjList& stack)
+    : m_stack(stack), m_count(0)
+{
+}
+
+ExpValueStack::~ExpValueStack()
+{
+    flush();
+}
+
+void ExpValueStack::pushReference(const ExpOperation* oper)
+{
+    if (m_count >= sizeof(m_values) / sizeof(m_values[0]))
+	flush();
+    Value& v = m_values[m_count++];
+    v.type = Reference;
+    v.oper = oper;
+}
+
+void ExpValueStack::pushOwned(ExpOperation* oper)
+{
+    if (!oper)
+	return;
+    if (m_count >= sizeof(m_values) / sizeof(m_values[0]))
+	flush();
+    Value& v = m_values[m_count++];
+    v.type = Owned;
+    v.oper = oper;
+}
+
+void ExpValueStack::pushInteger(int64_t value)
+{
+    if (m_count >= sizeof(m_values) / sizeof(m_values[0]))
+	flush();
+    Value& v = m_values[m_count++];
+    v.type = Integer;
+    v.number = value;
+}
+
+void ExpValueStack::pushBoolean(bool value)
+{
+    if (m_count >= sizeof(m_values) / sizeof(m_values[0]))
+	flush();
+    Value& v = m_values[m_count++];
+    v.type = Boolean;
+    v.number = value ? 1 : 0;
+}
+
+String& ExpValueStack::pushText(bool keep)
+{
+    if (m_count >= sizeof(m_values) / sizeof(m_values[0])) {
+	flush();
+	keep = false;
+    }
+    Value& v = m_values[m_count++];
+    v.type = Text;
+    if (!keep)
+	v.text.clear();
+    return v.text;
+}
+
+void ExpValueStack::drop(unsigned int count)
+{
+    while (count-- && m_count) {
+	Value& v = m_values[--m_count];
+	if (v.type == Owned)
+	    TelEngine::destruct(const_cast<ExpOperation*>(v.oper));
+    }
+}
+
+int ExpValueStack::find(int opcode) const
+{
+    for (int i = m_count - 1; i >= 0; i--) {
+	const Value& v = m_values[i];
+	if (v.type == Reference && (int)v.oper->opcode() == opcode)
+	    return i;
+    }
+    return -1;
+}
+
+void ExpValueStack::collapse(unsigned int index)
+{
+    if (index + 1 >= m_count)
+	return;
+    Value& top = m_values[m_count - 1];
+    Value& v = m_values[index];
+    for (unsigned int i = index; i < m_count - 1; i++) {
+	if (m_values[i].type == Owned)
+	    TelEngine::destruct(const_cast<ExpOperation*>(m_values[i].oper));
+    }
+    v.type = top.type;
+    v.number = top.number;
+    v.oper = top.oper;
+    if (top.type == Text)
+	v.text = top.text;
+    m_count = index + 1;
+}
+
+void ExpValueStack::flush()
+{
+    for (unsigned int i = 0; i < m_count; i++)
+	ExpEvaluator::pushOne(m_stack,operation(m_values[i]));
+    m_count = 0;
+}
+
+// Build the operation holding a value as runOperation() would have pushed it
+ExpOperation* ExpValueStack::operation(Value& value)
+{
+    switch (value.type) {
+	case Integer:
+	    return new ExpOperation(value.number);
+	case Boolean:
+	    return new ExpOperation(value.number != 0);
+	case Text:
+	    return new ExpOperation(value.text);
+	case Owned:
+	    return const_cast<ExpOperation*>(value.oper);
+	default:
+	    return value.oper->clone();
+    }
+}
+
+
 TableEvaluator::TableEvaluator(const TableEvaluator& original)
     : m_select(original.m_select), m_where(original.m_where),
       m_limit(original.m_limit), m_limitVal(original.m_limitVal)
@@ -23,6 +23,9 @@
 
 //#define STATS_TRACE "jstrace"
 
+// Inline caches of the field reads kept by each runner
+#define JS_FIELD_CACHE 64
+
 using namespace TelEngine;
 
 namespace { // anonymous
@@ -46,10 +49,32 @@ public:
     virtual bool runField(ObjList& stack, const ExpOperation& oper, GenObject* context);
     virtual bool runAssign(ObjList& stack, const ExpOperation& oper, GenObject* context);
     GenObject* resolve(ObjList& stack, String& name, GenObject* context);
+    GenObject* resolveTop(ObjList& stack, const String& name, GenObject* context);
     bool runStringFunction(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
     bool runStringField(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
+    void share(ScriptContext* shared);
+    bool unshare(ObjList& stack, const String& name, GenObject* context);
+    virtual JsObject* copyShared(const JsObject* shared, GenObject* context, bool write);
 private:
-    GenObject* resolveTop(ObjList& stack, const String& name, GenObject* context);
+    void addCopies();
+    RefPointer<ScriptContext> m_shared;
+    ObjList m_copies;
+};
+
+// Private copy made by a context of an object of its snapshot
+class JsCopy : public GenObject
+{
+public:
+    inline JsCopy(const JsObject* shared, JsObject* copy)
+	: m_shared(shared), m_copy(copy)
+	{ }
+    inline const JsObject* shared() const
+	{ return m_shared; }
+    inline JsObject* copy() const
+	{ return m_copy; }
+private:
+    const JsObject* m_shared;
+    RefPointer<JsObject> m_copy;
 };
 
 class JsNull : public JsObject
@@ -159,9 +184,22 @@ public:
 	OpcRequire,
 	OpcPragma,
     };
+    enum JsInstruction {
+	InsGeneric = 0,
+	InsNop,
+	InsPush,
+	InsValue,
+	InsIdentity,
+	InsBegin,
+	InsEnd,
+	InsFlush,
+	InsJump,
+	InsJumpTrue,
+	InsJumpFalse,
+    };
     inline JsCode()
 	: ExpEvaluator(C),
-	  m_pragmas(""), m_label(0), m_depth(0), m_entries(0), m_traceable(false)
+	  m_pragmas(""), m_label(0), m_depth(0), m_entries(0), m_program(0), m_traceable(false)
 	{ debugName("JsCode"); }
     ~JsCode();
     virtual void* getObject(const String& name) const
@@ -217,6 +255,7 @@ protected:
     virtual bool runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context) const;
     virtual bool runField(ObjList& stack, const ExpOperation& oper, GenObject* context) const;
     virtual bool runAssign(ObjList& stack, const ExpOperation& oper, GenObject* context) const;
+    virtual const ExpOperation* fieldValue(ObjList& stack, const ExpOperation& oper, GenObject* context) const;
 private:
     ObjVector m_linked;
     ObjList m_included;
@@ -236,6 +275,7 @@ private:
     bool parseSimple(ParsePoint& expr, bool constOnly, Mutex* mtx = 0);
     bool evalList(ObjList& stack, GenObject* context) const;
     bool evalVector(ObjList& stack, GenObject* context) const;
+    bool evalProgram(ObjList& stack, GenObject* context) const;
     bool jumpToLabel(long int label, GenObject* context) const;
     bool jumpRelative(long int offset, GenObject* context) const;
     bool jumpAbsolute(long int index, GenObject* context) const;
@@ -252,6 +292,7 @@ private:
     long int m_label;
     int m_depth;
     JsEntry* m_entries;
+    unsigned char* m_program;
     bool m_traceable;
 };
 
@@ -371,6 +412,8 @@ public:
 	{ if (m_tracing) traceDump(); }
     inline bool tracing() const
 	{ return m_tracing; }
+    inline JsPropertyCache* fieldCache(const ExpOperation& oper)
+	{ return &m_fields[((uintptr_t)&oper >> 4) % JS_FIELD_CACHE]; }
     virtual Status reset(bool init);
     virtual bool pause();
     virtual Status call(const String& name, ObjList& args, ExpOperation* thisObj = 0, ExpOperation* scopeObj = 0);
@@ -397,6 +440,7 @@ private:
     JsCallInfo* m_callInfo;
     ObjList m_traceStack;
     RefPointer<JsCodeStats> m_stats;
+    JsPropertyCache m_fields[JS_FIELD_CACHE];
 };
 
 class ParseNested : public GenObject
@@ -552,11 +596,48 @@ static const TokenDict s_internals[] =
 static const ExpNull s_null;
 static const String s_noFile = "[no file]";
 static const NativeFields s_nativeFields;
+static const ExpOperation s_begin((ExpEvaluator::Opcode)JsCode::OpcBegin);
+
+// Compact instruction that runs a linked operation
+static unsigned char linkInstruction(const ExpOperation* oper)
+{
+    if (!oper)
+	return JsCode::InsNop;
+    switch ((int)oper->opcode()) {
+	case ExpEvaluator::OpcNone:
+	case ExpEvaluator::OpcLabel:
+	    return JsCode::InsNop;
+	case ExpEvaluator::OpcPush:
+	case ExpEvaluator::OpcField:
+	    // barriers must be seen on the evaluation stack
+	    return oper->barrier() ? JsCode::InsGeneric : JsCode::InsPush;
+	case JsCode::OpcEqIdentity:
+	case JsCode::OpcNeIdentity:
+	    return JsCode::InsIdentity;
+	case JsCode::OpcBegin:
+	    return JsCode::InsBegin;
+	case JsCode::OpcEnd:
+	    return JsCode::InsEnd;
+	case JsCode::OpcFlush:
+	    return JsCode::InsFlush;
+	case JsCode::OpcJRel:
+	    return JsCode::InsJump;
+	case JsCode::OpcJRelTrue:
+	    return JsCode::InsJumpTrue;
+	case JsCode::OpcJRelFalse:
+	    return JsCode::InsJumpFalse;
+	default:
+	    return ExpEvaluator::valueOperation(oper->opcode()) ? JsCode::InsValue : JsCode::InsGeneric;
+    }
+}
 
 GenObject* JsContext::resolveTop(ObjList& stack, const String& name, GenObject* context)
 {
     XDebug(DebugAll,"JsContext::resolveTop '%s'",name.c_str());
     for (ObjList* l = stack.skipNull(); l; l = l->skipNext()) {
+	// scope wrappers carry the "()" value, skip plain operands cheaply
+	if (*static_cast<const ExpOperation*>(l->get()) != YSTRING("()"))
+	    continue;
 	JsObject* jso = YOBJECT(JsObject,l->get());
 	if (jso && jso->toString() == YSTRING("()") && jso->hasField(stack,name,context))
 	    return jso;
@@ -570,43 +651,43 @@ GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
     if (name.find('.') < 0)
 	obj = resolveTop(stack,name,context);
     else {
-	ObjList* list = name.split('.',true);
+	// walk the dotted components in place instead of splitting to a list
+	const String full = name;
 	name.clear();
-	for (ObjList* l = list->skipNull(); l; ) {
-	    const String* s = static_cast<const String*>(l->get());
-	    ObjList* l2 = l->skipNext();
-	    if (TelEngine::null(s)) {
+	int pos = 0;
+	for (;;) {
+	    int dot = full.find('.',pos);
+	    String s = (dot < 0) ? full.substr(pos) : full.substr(pos,dot - pos);
+	    if (s.null()) {
 		// consecutive dots - not good
 		obj = 0;
 		break;
 	    }
 	    if (!obj)
-		obj = resolveTop(stack,*s,context);
-	    name.append(*s,".");
-	    if (!l2)
+		obj = resolveTop(stack,s,context);
+	    name.append(s,".");
+	    if (dot < 0)
 		break;
+	    pos = dot + 1;
 	    ExpExtender* ext = YOBJECT(ExpExtender,obj);
 	    if (ext) {
 		GenObject* adv = ext->getField(stack,name,context);
 		XDebug(DebugAll,"JsContext::resolve advanced to '%s' of %p for '%s'",
-		    (adv ? adv->toString().c_str() : 0),ext,s->c_str());
+		    (adv ? adv->toString().c_str() : 0),ext,s.c_str());
 		if (adv) {
 		    if (YOBJECT(ExpExtender,adv)) {
 			obj = adv;
 			name.clear();
 		    }
-		    else if (l->count() == 2) { // there is only one other field after this one
-			s = static_cast<const String*>(l2->get());
-			if (!TelEngine::null(s) && s_nativeFields.find(*s)) {
+		    else if (full.find('.',pos) < 0) { // there is only one other field after this one
+			if (s_nativeFields.find(full.substr(pos))) {
 			    obj = adv;
 			    name.clear();
 			}
 		    }
 		}
 	    }
-	    l = l2;
 	}
-	TelEngine::destruct(list);
     }
     DDebug(DebugAll,"JsContext::resolve got '%s' %p for '%s'",
 	(obj ? obj->toString().c_str() : 0),obj,name.c_str());
@@ -616,6 +697,13 @@ GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
 bool JsContext::runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context)
 {
     XDebug(DebugAll,"JsContext::runFunction '%s' [%p]",oper.name().c_str(),this);
+    if (m_shared) {
+	// methods of nested objects and freezing may change a shared object
+	int dot = oper.name().find('.');
+	if (dot >= 0 && (oper.name().rfind('.') != dot || oper.name().endsWith(".freeze")
+		|| oper.name().endsWith(".isFrozen")))
+	    unshare(stack,oper.name(),context);
+    }
     String name = oper.name();
     GenObject* o = resolve(stack,name,context);
     if (o && o != this) {
@@ -660,10 +748,29 @@ bool JsContext::runFunction(ObjList& stack, const ExpOperation& oper, GenObject*
 bool JsContext::runField(ObjList& stack, const ExpOperation& oper, GenObject* context)
 {
     XDebug(DebugAll,"JsContext::runField '%s' [%p]",oper.name().c_str(),this);
+    if (oper.name().find('.') < 0) {
+	// simple name - no need to copy and split it
+	GenObject* o = resolveTop(stack,oper.name(),context);
+	if (o != this) {
+	    ExpExtender* ext = YOBJECT(ExpExtender,o);
+	    if (ext)
+		return ext->runField(stack,oper,context);
+	}
+	// a reference to a shared object may be used to change it
+	if (m_shared)
+	    unshare(stack,oper.name(),context);
+	return JsObject::runField(stack,oper,context);
+    }
     String name = oper.name();
     GenObject* o = resolve(stack,name,context);
     if (o && o != this) {
 	ExpExtender* ext = YOBJECT(ExpExtender,o);
+	if (ext && m_shared && YOBJECT(ExpExtender,ext->getField(stack,name,context))
+		&& unshare(stack,oper.name(),context)) {
+	    name = oper.name();
+	    o = resolve(stack,name,context);
+	    ext = YOBJECT(ExpExtender,o);
+	}
 	if (ext) {
 	    ExpOperation op(oper,name);
 	    return ext->runField(stack,op,context);
@@ -920,6 +1027,17 @@ bool JsContext::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* c
 {
     XDebug(DebugAll,"JsContext::runAssign '%s'='%s' (%s) [%p]",
 	oper.name().c_str(),oper.c_str(),oper.typeOf(),this);
+    if (oper.name().find('.') < 0) {
+	GenObject* o = resolveTop(stack,oper.name(),context);
+	if (o != this) {
+	    ExpExtender* ext = YOBJECT(ExpExtender,o);
+	    if (ext)
+		return ext->runAssign(stack,oper,context);
+	}
+	return JsObject::runAssign(stack,oper,context);
+    }
+    if (m_shared)
+	unshare(stack,oper.name(),context);
     String name = oper.name();
     GenObject* o = resolve(stack,name,context);
     if (o && o != this) {
@@ -934,10 +1052,113 @@ bool JsContext::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* c
     return JsObject::runAssign(stack,oper,context);
 }
 
+// Start with references to the fields of a shared context
+void JsContext::share(ScriptContext* shared)
+{
+    m_shared = shared;
+    if (!shared)
+	return;
+    NamedIterator iter(shared->params());
+    while (const NamedString* ns = iter.get()) {
+	if (params().getParam(ns->name()))
+	    continue;
+	const NamedPointer* np = YOBJECT(NamedPointer,ns);
+	if (np) {
+	    RefObject* obj = YOBJECT(RefObject,np->userData());
+	    if (obj && obj->ref())
+		params().addParam(new NamedPointer(ns->name(),obj,*ns));
+	    continue;
+	}
+	const ExpOperation* op = YOBJECT(ExpOperation,ns);
+	params().addParam(op ? op->clone() : new NamedString(ns->name(),*ns));
+    }
+}
+
+// Copy a shared global object in this context before a script may change it
+bool JsContext::unshare(ObjList& stack, const String& name, GenObject* context)
+{
+    if (!m_shared)
+	return false;
+    int dot = name.find('.');
+    const String top = (dot < 0) ? name : name.substr(0,dot);
+    // globals already copied or never shared are rejected by their flag
+    const ObjList* own = propertyItem(top);
+    JsObject* jso = own ? YOBJECT(JsObject,own->get()) : 0;
+    if (!(jso && jso->snapshot()))
+	return false;
+    const NamedString* sh = m_shared->params().getParam(top);
+    if (jso != YOBJECT(JsObject,sh))
+	return false;
+    // local variables hide the global object
+    if (resolveTop(stack,top,context) != this)
+	return false;
+    DDebug(DebugAll,"JsContext unsharing '%s' [%p]",top.c_str(),this);
+    if (m_shared->unshareField(top,*this))
+	renamed(); // the globals were changed through the base class
+    else {
+	const JsFunction* jf = YOBJECT(JsFunction,jso);
+	if (jf) {
+	    const ExpOperation* op = YOBJECT(ExpOperation,sh);
+	    JsObject* nf = jf->copy(mutex(),jf->getFunc()->name());
+	    params().setParam(new ExpWrapper(nf,top,op && op->barrier()));
+	}
+	else
+	    params().setParam(new NamedPointer(top,jso->copy(mutex()),*sh));
+    }
+    addCopies();
+    return true;
+}
+
+// Remember the globals copied from the snapshot and their prototypes
+// Objects created before the copy still refer to the shared prototypes
+void JsContext::addCopies()
+{
+    for (const ObjList* l = m_shared->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* sh = static_cast<const NamedString*>(l->get());
+	const JsObject* jso = YOBJECT(JsObject,sh);
+	if (!jso || copyShared(jso,0,false))
+	    continue;
+	const ObjList* own = propertyItem(sh->name());
+	JsObject* cp = own ? YOBJECT(JsObject,own->get()) : 0;
+	if (!cp || cp == jso || cp->snapshot())
+	    continue;
+	if (cp->ref())
+	    m_copies.append(new JsCopy(jso,cp));
+	const JsObject* proto = YOBJECT(JsObject,jso->params().getParam(YSTRING("prototype")));
+	JsObject* cpProto = YOBJECT(JsObject,static_cast<const JsObject*>(cp)->params().getParam(YSTRING("prototype")));
+	if (proto && cpProto && cpProto != proto && cpProto->ref())
+	    m_copies.append(new JsCopy(proto,cpProto));
+    }
+}
+
+// Find the copy of a snapshot object, copy the global holding it on first write
+JsObject* JsContext::copyShared(const JsObject* shared, GenObject* context, bool write)
+{
+    for (ObjList* l = m_copies.skipNull(); l; l = l->skipNext()) {
+	const JsCopy* c = static_cast<const JsCopy*>(l->get());
+	if (c->shared() == shared)
+	    return c->copy();
+    }
+    if (!(write && m_shared))
+	return 0;
+    for (const ObjList* l = m_shared->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* sh = static_cast<const NamedString*>(l->get());
+	const JsObject* jso = YOBJECT(JsObject,sh);
+	if (!jso || (jso != shared && shared != YOBJECT(JsObject,jso->params().getParam(YSTRING("prototype")))))
+	    continue;
+	ObjList stack;
+	if (!unshare(stack,sh->name(),context))
+	    return 0;
+	return copyShared(shared,context,false);
+    }
+    return 0;
+}
+
 
 JsCode::~JsCode()
 {
     delete[] m_entries;
+    delete[] m_program;
 }
 
 // Initialize standard globals in the execution context
@@ -983,6 +1204,8 @@ bool JsCode::link()
     m_linked.assign(m_opcodes);
     delete[] m_entries;
     m_entries = 0;
+    delete[] m_program;
+    m_program = 0;
     unsigned int n = m_linked.count();
     if (!n)
 	return false;
@@ -1031,6 +1254,9 @@ bool JsCode::link()
 	m_entries[entries].number = -1;
 	m_entries[entries].index = 0;
     }
+    m_program = new unsigned char[n];
+    for (unsigned int i = 0; i < n; i++)
+	m_program[i] = linkInstruction(static_cast<const ExpOperation*>(m_linked[i]));
     return true;
 }
 
@@ -2558,8 +2784,11 @@ bool JsCode::runOperation(ObjList& stack, const ExpOperation& oper, GenObject* c
 		String name = op->name();
 		TelEngine::destruct(op);
 		JsContext* ctx = YOBJECT(JsContext,sr->context());
-		if (ctx)
+		if (ctx) {
+		    if (name.find('.') >= 0)
+			ctx->unshare(stack,name,context);
 		    obj = YOBJECT(JsObject,ctx->resolve(stack,name,context));
+		}
 		bool ret = false;
 		if (obj && (!obj->frozen() || !obj->hasField(stack,name,context))
 			&& obj->toString() != YSTRING("()")) {
@@ -2636,11 +2865,13 @@ void JsCode::resolveObjectParams(JsObject* object, ObjList& stack, GenObject* co
     JsContext* ctx = YOBJECT(JsContext,sr->context());
     if (!ctx)
 	return;
-    JsFunction* objCtr = 0;
+    // read only access to the constructors keeps their property indexes
+    const JsContext* globals = ctx;
+    const JsFunction* objCtr = 0;
     // check first for regexp built /expr/ syntax
     JsRegExp* reg = YOBJECT(JsRegExp,object);
     if (reg) {
-	objCtr = YOBJECT(JsFunction,ctx->params().getParam(YSTRING("RegExp")));
+	objCtr = YOBJECT(JsFunction,globals->params().getParam(YSTRING("RegExp")));
 	if (objCtr) {
 	    JsRegExp* regexpProto = YOBJECT(JsRegExp,objCtr->params().getParam(YSTRING("prototype")));
 	    if (regexpProto && regexpProto->ref())
@@ -2650,12 +2881,12 @@ void JsCode::resolveObjectParams(JsObject* object, ObjList& stack, GenObject* co
     }
 
     JsObject* objProto = 0;
-    objCtr = YOBJECT(JsFunction,ctx->params().getParam(YSTRING("Object")));
+    objCtr = YOBJECT(JsFunction,globals->params().getParam(YSTRING("Object")));
     if (objCtr)
 	objProto = YOBJECT(JsObject,objCtr->params().getParam(YSTRING("prototype")));
 
     JsArray* arrayProto = 0;
-    objCtr = YOBJECT(JsFunction,ctx->params().getParam(YSTRING("Array")));
+    objCtr = YOBJECT(JsFunction,globals->params().getParam(YSTRING("Array")));
     if (objCtr)
 	arrayProto = YOBJECT(JsArray,objCtr->params().getParam(YSTRING("prototype")));
 
@@ -2698,6 +2929,24 @@ bool JsCode::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* cont
     return extender() && extender()->runAssign(stack,oper,context);
 }
 
+// Read plain values of simple variables in place, other fields are pushed by runField()
+const ExpOperation* JsCode::fieldValue(ObjList& stack, const ExpOperation& oper, GenObject* context) const
+{
+    if (!context || oper.name().find('.') >= 0)
+	return 0;
+    JsContext* ctx = YOBJECT(JsContext,static_cast<ScriptRun*>(context)->context());
+    if (!ctx)
+	return 0;
+    // the context and the function scopes are the only objects resolved here
+    JsObject* obj = static_cast<JsObject*>(ctx->resolveTop(stack,oper.name(),context));
+    // own properties are found through the inline cache of this operation
+    ObjList* item = obj->propertyItem(oper.name(),static_cast<JsRunner*>(context)->fieldCache(oper));
+    const ExpOperation* op = YOBJECT(ExpOperation,item ? item->get() : obj->getField(stack,oper.name(),context));
+    if (!op || YOBJECT(ExpWrapper,op) || YOBJECT(ExpFunction,op))
+	return 0;
+    return op;
+}
+
 bool JsCode::evalList(ObjList& stack, GenObject* context) const
 {
     XDebug(this,DebugInfo,"JsCode::evalList(%p,%p)",&stack,context);
@@ -2718,6 +2967,8 @@ bool JsCode::evalVector(ObjList& stack, GenObject* context) const
 {
     XDebug(this,DebugInfo,"JsCode::evalVector(%p,%p)",&stack,context);
     JsRunner* runner = static_cast<JsRunner*>(context);
+    if (m_program && !runner->tracing())
+	return evalProgram(stack,context);
     unsigned int& index = runner->m_index;
     while (index < m_linked.length()) {
 	const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[index++]);
@@ -2729,6 +2980,89 @@ bool JsCode::evalVector(ObjList& stack, GenObject* context) const
     return true;
 }
 
+// Run the linked instructions keeping intermediate values tagged,
+//  they are moved to the stack only before running other operations
+bool JsCode::evalProgram(ObjList& stack, GenObject* context) const
+{
+    XDebug(this,DebugInfo,"JsCode::evalProgram(%p,%p)",&stack,context);
+    JsRunner* runner = static_cast<JsRunner*>(context);
+    unsigned int& index = runner->m_index;
+    ExpValueStack values(stack);
+    while (index < m_linked.length()) {
+	const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[index]);
+	unsigned char ins = runner->tracing() ? (unsigned char)InsGeneric : m_program[index];
+	index++;
+	bool generic = false;
+	switch (ins) {
+	    case InsNop:
+		break;
+	    case InsPush:
+		values.pushReference(o);
+		break;
+	    case InsValue:
+		if (!runValues(values,*o,context))
+		    return false;
+		break;
+	    case InsIdentity:
+		if (values.count() < 2)
+		    generic = true;
+		else {
+		    int eq = popCompare(values,true,context);
+		    if (eq < 0)
+			return gotError("ExpEvaluator stack underflow",o->lineNumber());
+		    values.pushBoolean((eq != 0) == ((JsOpcode)o->opcode() == OpcEqIdentity));
+		}
+		break;
+	    case InsBegin:
+		values.pushReference(&s_begin);
+		break;
+	    case InsEnd:
+	    case InsFlush:
+		{
+		    int begin = values.find(OpcBegin);
+		    if (begin < 0)
+			generic = true;
+		    else if (ins == InsFlush)
+			values.drop(values.count() - begin);
+		    else if (begin + 1 == (int)values.count())
+			values.drop();
+		    else
+			values.collapse(begin);
+		}
+		break;
+	    case InsJumpTrue:
+	    case InsJumpFalse:
+		if (!values.count()) {
+		    generic = true;
+		    break;
+		}
+		{
+		    int val = popBoolean(values,context);
+		    if (val < 0)
+			return gotError("Stack underflow",o->lineNumber());
+		    if ((val != 0) != (ins == InsJumpTrue))
+			break;
+		}
+		// fall through
+	    case InsJump:
+		if (!jumpRelative((long int)o->number(),context))
+		    return gotError("Relative jump failed",o->lineNumber());
+		break;
+	    default:
+		generic = true;
+		break;
+	}
+	if (generic) {
+	    values.flush();
+	    if (o && !runOperation(stack,*o,context))
+		return false;
+	}
+	if (runner->m_paused)
+	    break;
+    }
+    return true;
+}
+
 bool JsCode::jumpToLabel(long int label, GenObject* context) const
 {
     if (!context)
@@ -3549,6 +3883,14 @@ ScriptContext* JsParser::createContext() const
     return new JsContext;
 }
 
+// Create Javascript context sharing the fields of another context
+ScriptContext* JsParser::createContext(ScriptContext* shared) const
+{
+    JsContext* ctx = new JsContext;
+    ctx->share(shared);
+    return ctx;
+}
+
 ScriptRun* JsParser::createRunner(ScriptCode* code, ScriptContext* context, const char* title) const
 {
     if (!code)
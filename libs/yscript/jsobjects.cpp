@@ -190,12 +190,94 @@ static void dumpRecursiveObj(const GenObject* obj, String& buf, unsigned int dep
 	dumpRecursiveObj(nptr->userData(),buf,depth + 1,seen);
 }
 
+#ifdef _WINDOWS
+#define INDEX_BARRIER() MemoryBarrier()
+#define INDEX_INC(var) ::InterlockedIncrement((LONG volatile*)&(var))
+#define INDEX_DEC(var) ::InterlockedDecrement((LONG volatile*)&(var))
+#else
+#define INDEX_BARRIER() __sync_synchronize()
+#define INDEX_INC(var) __sync_add_and_fetch(&(var),1)
+#define INDEX_DEC(var) __sync_sub_and_fetch(&(var),1)
+#endif
+
+// Objects with fewer properties are searched without building an index
+#define INDEX_MIN 8
+
+namespace TelEngine {
+
+// Open addressing hash index of the list items holding the properties of an object
+class JsPropertyIndex
+{
+    YNOCOPY(JsPropertyIndex);
+public:
+    JsPropertyIndex(unsigned int serial, unsigned int count);
+    inline ~JsPropertyIndex()
+	{ delete[] m_slots; }
+    inline unsigned int serial() const
+	{ return m_serial; }
+    ObjList* find(const String& name) const;
+    bool add(ObjList* item);
+private:
+    void insert(ObjList* item);
+    unsigned int m_serial;
+    unsigned int m_mask;
+    unsigned int m_used;
+    ObjList** m_slots;
+};
+
+}; // namespace TelEngine
+
+// Serializes changing indexes, objects shared between contexts are read from several threads
+static Mutex s_indexMutex(false,"JsPropertyIndex");
+// Identifies each built index so inline caches can't match a new index at the same address
+static unsigned int s_indexSerial = 0;
+
+JsPropertyIndex::JsPropertyIndex(unsigned int serial, unsigned int count)
+    : m_serial(serial), m_mask(15), m_used(0)
+{
+    while (m_mask < count * 2)
+	m_mask = (m_mask << 1) | 1;
+    m_slots = new ObjList*[m_mask + 1];
+    ::memset(m_slots,0,(m_mask + 1) * sizeof(ObjList*));
+}
+
+ObjList* JsPropertyIndex::find(const String& name) const
+{
+    for (unsigned int i = name.hash() & m_mask; ObjList* item = m_slots[i]; i = (i + 1) & m_mask) {
+	if (static_cast<NamedString*>(item->get())->name() == name)
+	    return item;
+    }
+    return 0;
+}
+
+// Add an item unless its name is already indexed, the first one in list is used
+// Readers may search the table meanwhile so it is never rehashed in place,
+//  return false if the load would exceed 3/4 and a larger index must be built
+bool JsPropertyIndex::add(ObjList* item)
+{
+    if (!item->get() || find(item->get()->toString()))
+	return true;
+    if ((m_used + 1) * 4 > (m_mask + 1) * 3)
+	return false;
+    insert(item);
+    return true;
+}
+
+void JsPropertyIndex::insert(ObjList* item)
+{
+    unsigned int i = item->get()->toString().hash() & m_mask;
+    while (m_slots[i])
+	i = (i + 1) & m_mask;
+    m_slots[i] = item;
+    m_used++;
+}
+
 
 const String JsObject::s_protoName("__proto__");
 
 JsObject::JsObject(const char* name, Mutex* mtx, bool frozen)
     : ScriptContext(String("[object ") + name + "]"),
-      m_frozen(frozen), m_mutex(mtx)
+      m_frozen(frozen), m_snapshot(false), m_mutex(mtx), m_index(0), m_indexReaders(0), m_indexStale(false)
 {
     XDebug(DebugAll,"JsObject::JsObject('%s',%p,%s) [%p]",
 	name,mtx,String::boolText(frozen),this);
@@ -207,7 +289,7 @@ JsObject::JsObject(const char* name, Mutex* mtx, bool frozen)
 
 JsObject::JsObject(Mutex* mtx, const char* name, bool frozen)
     : ScriptContext(name),
-      m_frozen(frozen), m_mutex(mtx)
+      m_frozen(frozen), m_snapshot(false), m_mutex(mtx), m_index(0), m_indexReaders(0), m_indexStale(false)
 {
     XDebug(DebugAll,"JsObject::JsObject(%p,'%s',%s) [%p]",
 	mtx,name,String::boolText(frozen),this);
@@ -215,7 +297,7 @@ JsObject::JsObject(Mutex* mtx, const char* name, bool frozen)
 
 JsObject::JsObject(GenObject* context, Mutex* mtx, bool frozen)
     : ScriptContext("[object Object]"),
-      m_frozen(frozen), m_mutex(mtx)
+      m_frozen(frozen), m_snapshot(false), m_mutex(mtx), m_index(0), m_indexReaders(0), m_indexStale(false)
 {
     setPrototype(context,YSTRING("Object"));
 }
@@ -223,6 +305,7 @@ JsObject::JsObject(GenObject* context, Mutex* mtx, bool frozen)
 JsObject::~JsObject()
 {
     XDebug(DebugAll,"JsObject::~JsObject '%s' [%p]",toString().c_str(),this);
+    delete m_index;
 }
 
 JsObject* JsObject::copy(Mutex* mtx) const
@@ -253,7 +336,7 @@ void JsObject::setPrototype(GenObject* context, const String& objName)
 	if (!(sr && (ctxt = YOBJECT(ScriptContext,sr->context()))))
 	    return;
     }
-    JsObject* objCtr = YOBJECT(JsObject,ctxt->params().getParam(objName));
+    const JsObject* objCtr = YOBJECT(JsObject,ctxt->params().getParam(objName));
     if (objCtr) {
 	JsObject* proto = YOBJECT(JsObject,objCtr->params().getParam(YSTRING("prototype")));
 	if (proto && proto->ref())
@@ -282,11 +365,101 @@ void JsObject::fillFieldNames(ObjList& names)
 #endif
 }
 
+// Rebuild the index of properties, it is dropped if there are only a few of them
+void JsObject::updateIndex() const
+{
+    const NamedList& list = params();
+    const ObjList* l = list.paramList()->skipNull();
+    unsigned int n = 0;
+    for (; l && n < INDEX_MIN; l = l->skipNext())
+	n++;
+    if (!(l || m_index)) {
+	m_indexStale = false;
+	return;
+    }
+    Lock lock(s_indexMutex);
+    if (!m_indexStale)
+	return;
+    m_indexStale = false;
+    JsPropertyIndex* idx = 0;
+    if (l) {
+	idx = new JsPropertyIndex(++s_indexSerial,list.length());
+	for (l = list.paramList()->skipNull(); l; l = l->skipNext())
+	    idx->add(const_cast<ObjList*>(l));
+    }
+    replaceIndex(idx);
+}
+
+// Install a new index, called with the index mutex locked
+// The old one is deleted after the readers that may have found it are done
+void JsObject::replaceIndex(JsPropertyIndex* idx) const
+{
+    JsPropertyIndex* old = m_index;
+    m_index = idx;
+    // readers incrementing the counter after this point see the new index
+    INDEX_BARRIER();
+    while (old && m_indexReaders)
+	Thread::yield();
+    delete old;
+}
+
+ObjList* JsObject::propertyItem(const String& name, JsPropertyCache* cache) const
+{
+    if (m_indexStale)
+	updateIndex();
+    const JsPropertyIndex* idx = 0;
+    if (m_index) {
+	// announce the reader before loading the index, it can't be deleted until done
+	INDEX_INC(m_indexReaders);
+	idx = m_index;
+	if (!idx)
+	    INDEX_DEC(m_indexReaders);
+    }
+    if (!idx) {
+	for (const ObjList* l = params().paramList()->skipNull(); l; l = l->skipNext()) {
+	    if (static_cast<const NamedString*>(l->get())->name() == name)
+		return const_cast<ObjList*>(l);
+	}
+	return 0;
+    }
+    ObjList* item = 0;
+    if (cache) {
+	// items are valid as long as the index they were found in is
+	if (cache->m_item && cache->m_index == idx && cache->m_serial == idx->serial()
+		&& static_cast<const NamedString*>(cache->m_item->get())->name() == name)
+	    item = cache->m_item;
+	else {
+	    cache->m_item = item = idx->find(name);
+	    cache->m_index = idx;
+	    cache->m_serial = idx->serial();
+	}
+    }
+    else
+	item = idx->find(name);
+    INDEX_DEC(m_indexReaders);
+    return item;
+}
+
+// Private copy of this snapshot object in the context running a script
+JsObject* JsObject::ownCopy(GenObject* context, bool write) const
+{
+    ScriptRun* sr = YOBJECT(ScriptRun,context);
+    JsObject* ctx = sr ? YOBJECT(JsObject,sr->context()) : 0;
+    return ctx ? ctx->copyShared(this,context,write) : 0;
+}
+
 bool JsObject::hasField(ObjList& stack, const String& name, GenObject* context) const
 {
-    if (ScriptContext::hasField(stack,name,context))
+    if (m_snapshot) {
+	// a context that copied this object, maybe through the prototype, sees the copy
+	const JsObject* own = ownCopy(context,false);
+	if (own)
+	    return own->hasField(stack,name,context);
+    }
+    if (propertyItem(name))
 	return true;
-    const ScriptContext* proto = YOBJECT(ScriptContext,params().getParam(protoName()));
+    ObjList* protoItem = propertyItem(protoName());
+    const ScriptContext* proto = protoItem ? YOBJECT(ScriptContext,protoItem->get()) : 0;
     if (proto && proto->hasField(stack,name,context))
 	return true;
     NamedList* np = nativeParams();
@@ -295,12 +468,18 @@ bool JsObject::hasField(ObjList& stack, const String& name, GenObject* context)
 
 NamedString* JsObject::getField(ObjList& stack, const String& name, GenObject* context) const
 {
-    NamedString* fld = ScriptContext::getField(stack,name,context);
-    if (fld)
-	return fld;
-    const ScriptContext* proto = YOBJECT(ScriptContext,params().getParam(protoName()));
+    if (m_snapshot) {
+	const JsObject* own = ownCopy(context,false);
+	if (own)
+	    return own->getField(stack,name,context);
+    }
+    ObjList* item = propertyItem(name);
+    if (item)
+	return static_cast<NamedString*>(item->get());
+    item = propertyItem(protoName());
+    const ScriptContext* proto = item ? YOBJECT(ScriptContext,item->get()) : 0;
     if (proto) {
-	fld = proto->getField(stack,name,context);
+	NamedString* fld = proto->getField(stack,name,context);
 	if (fld)
 	    return fld;
     }
@@ -373,23 +552,45 @@ bool JsObject::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* co
     XDebug(DebugAll,"JsObject::runAssign() '%s'='%s' (%s) in '%s' [%p]",
 	oper.name().c_str(),oper.c_str(),oper.typeOf(),toString().c_str(),this);
     if (frozen()) {
+	// a snapshot object is copied in the context changing it
+	JsObject* own = m_snapshot ? ownCopy(context,true) : 0;
+	if (own && own != this)
+	    return own->runAssign(stack,oper,context);
 	Debug(DebugWarn,"Object '%s' is frozen",toString().c_str());
 	return false;
     }
+    ExpOperation* val = 0;
     ExpFunction* ef = YOBJECT(ExpFunction,&oper);
     if (ef)
-	params().setParam(ef->ExpOperation::clone());
+	val = ef->ExpOperation::clone();
     else {
 	ExpWrapper* w = YOBJECT(ExpWrapper,&oper);
 	if (w) {
 	    JsFunction* jsf = YOBJECT(JsFunction,w->object());
 	    if (jsf)
 		jsf->firstName(oper.name());
-	    params().setParam(w->clone(oper.name()));
+	    val = w->clone(oper.name());
 	}
 	else
-	    params().setParam(oper.clone());
+	    val = oper.clone();
+    }
+    // replace the value in the indexed list item, the index stays valid
+    ObjList* item = propertyItem(oper.name());
+    if (item) {
+	item->set(val);
+	return true;
+    }
+    item = ScriptContext::params().paramList()->append(val);
+    if (!m_index) {
+	// count the properties again on next lookup
+	m_indexStale = true;
+	return true;
     }
+    Lock lock(s_indexMutex);
+    // the lookup above brought the index up to date, readers must see a complete item
+    INDEX_BARRIER();
+    if (!m_indexStale && !(m_index && m_index->add(item)))
+	m_indexStale = true; // a larger index is built on next lookup
     return true;
 }
 
@@ -764,6 +965,7 @@ bool JsArray::runNative(ObjList& stack, const ExpOperation& oper, GenObject* con
 	    if (n2)
 		const_cast<String&>(n2->name()) = s1;
 	}
+	renamed();
 	ref();
 	ExpEvaluator::pushOne(stack,new ExpWrapper(this));
     }
@@ -800,6 +1002,7 @@ bool JsArray::runNative(ObjList& stack, const ExpOperation& oper, GenObject* con
 		}
 		const_cast<String&>(ns->name()) = i;
 	    }
+	    renamed();
 	}
 	else
 	    ExpEvaluator::pushOne(stack,new ExpWrapper(0,0));
@@ -826,6 +1029,7 @@ bool JsArray::runNative(ObjList& stack, const ExpOperation& oper, GenObject* con
 		    const_cast<String&>(ns->name()) = index;
 		}
 	    }
+	    renamed();
 	    for (int32_t i = shift - 1; i >= 0; i--) {
 		ExpOperation* op = popValue(stack,context);
 		if (!op)
@@ -1049,6 +1253,7 @@ bool JsArray::runNativeSplice(ObjList& stack, const ExpOperation& oper, GenObjec
 		const_cast<String&>(ns->name()) = i + shiftIdx;
 	}
     }
+    renamed();
     setLength(length() + shiftIdx);
     // insert the new elements
     for (int i = 0; i < argc; i++) {
@@ -46,6 +46,8 @@ namespace TelEngine {
 
 class ExpEvaluator;
 class ExpOperation;
+class ExpValueStack;
+class ExpOperand;
 
 /**
  * This class allows extending ExpEvaluator to implement custom fields and functions
@@ -235,6 +237,7 @@ public:
 class YSCRIPT_API ExpEvaluator : public DebugEnabler
 {
     friend class ParsePoint;
+    friend class ExpOperand;
 public:
     /**
      * Parsing styles
@@ -518,6 +521,42 @@ public:
      */
     virtual bool runOperation(ObjList& stack, const ExpOperation& oper, GenObject* context = 0) const;
 
+    /**
+     * Try to evaluate a single operation on a stack of tagged values.
+     * Operations that are not value operations or whose operands are not on the
+     *  value stack are run by runOperation() after flushing the value stack
+     * @param values Stack of tagged values in use, results are pushed back on it
+     * @param oper Operation to execute
+     * @param context Pointer to arbitrary object to be passed to called methods
+     * @return True if evaluation succeeded
+     */
+    bool runValues(ExpValueStack& values, const ExpOperation& oper, GenObject* context = 0) const;
+
+    /**
+     * Pops and evaluate the boolean value of an operand off a stack of tagged values
+     * @param values Stack of tagged values to remove the operand from
+     * @param context Pointer to arbitrary object to be passed to called methods
+     * @return 1 or 0 for the boolean value, negative if stack underflow or field not evaluable
+     */
+    int popBoolean(ExpValueStack& values, GenObject* context = 0) const;
+
+    /**
+     * Pops two operands off a stack of tagged values and compare them for equality
+     * @param values Stack of tagged values to remove the operands from
+     * @param identity True to also require the same type of the operands
+     * @param context Pointer to arbitrary object to be passed to called methods
+     * @return 1 if operands are equal, 0 if not, negative if stack underflow
+     *  or field not evaluable
+     */
+    int popCompare(ExpValueStack& values, bool identity, GenObject* context = 0) const;
+
+    /**
+     * Check if an operation can be evaluated on a stack of tagged values
+     * @param oper Operator code to check
+     * @return True if runValues() can evaluate the operation without runOperation()
+     */
+    static bool valueOperation(Opcode oper);
+
     /**
      * Convert all fields on the evaluation stack to their values
      * @param stack Evaluation stack to evaluate fields from
@@ -904,6 +943,17 @@ protected:
      */
     virtual bool runAssign(ObjList& stack, const ExpOperation& oper, GenObject* context = 0) const;
 
+    /**
+     * Find the value of a field that can be read in place, without pushing it on stack.
+     * The value is valid only until the field is assigned or deleted
+     * @param stack Evaluation stack in use
+     * @param oper Field to evaluate
+     * @param context Pointer to arbitrary object to be passed to called methods
+     * @return Plain operation holding the value of the field,
+     *  NULL if the field must be evaluated by runField()
+     */
+    virtual const ExpOperation* fieldValue(ObjList& stack, const ExpOperation& oper, GenObject* context = 0) const;
+
     /**
      * Dump a single operation according to current operators dictionary
      * @param oper Operation to dump
@@ -1018,10 +1068,10 @@ public:
      * @param name Optional of the newly created constant
      */
     inline explicit ExpOperation(int64_t value, const char* name = 0)
-	: NamedString(name,"NaN"),
+	: NamedString(name),
 	  m_opcode(ExpEvaluator::OpcPush),
 	  m_number(value), m_bool(false), m_isNumber(true), m_lineNo(0), m_barrier(false)
-	{ if (value != nonInteger()) String::operator=(value); }
+	{ if (value != nonInteger()) String::operator=(value); else String::operator=("NaN"); }
 
     /**
      * Push Boolean constructor
@@ -1310,6 +1360,135 @@ private:
     GenObject* m_object;
 };
 
+/**
+ * A bounded stack of tagged values holding the intermediate results of value
+ *  operations without allocating them. Integer, boolean and string results are
+ *  kept by value, constants and fields as references to the operations that
+ *  pushed them. The values are moved to the evaluation stack as operations only
+ *  when an operation that is not a value operation needs them there.
+ * @short A stack of tagged values on top of an evaluation stack
+ */
+class YSCRIPT_API ExpValueStack
+{
+    friend class ExpOperand;
+    YNOCOPY(ExpValueStack); // no automatic copies please
+public:
+    /**
+     * Types of tagged values
+     */
+    enum Type {
+	Integer = 1,
+	Boolean,
+	Text,
+	Reference,
+	Owned,
+    };
+
+    /**
+     * Constructor
+     * @param stack Evaluation stack the values are moved to when flushed
+     */
+    explicit ExpValueStack(ObjList& stack);
+
+    /**
+     * Destructor, flushes the values left on the evaluation stack
+     */
+    ~ExpValueStack();
+
+    /**
+     * Retrieve the evaluation stack below the values
+     * @return Reference to the evaluation stack
+     */
+    inline ObjList& stack() const
+	{ return m_stack; }
+
+    /**
+     * Get the number of values on the stack
+     * @return Count of values held
+     */
+    inline unsigned int count() const
+	{ return m_count; }
+
+    /**
+     * Retrieve the operation referenced by a value
+     * @param depth Position of the value counted from the top of the stack
+     * @return Operation referenced by the value, NULL if not a reference
+     */
+    inline const ExpOperation* reference(unsigned int depth = 0) const
+    {
+	if (depth >= m_count || m_values[m_count - depth - 1].type != Reference)
+	    return 0;
+	return m_values[m_count - depth - 1].oper;
+    }
+
+    /**
+     * Push a reference to a constant or field, the operation must outlive the stack
+     * @param oper Operation to reference, must not be a barrier
+     */
+    void pushReference(const ExpOperation* oper);
+
+    /**
+     * Push an operation, the stack takes ownership of it
+     * @param oper Operation to push, NULL will not be pushed
+     */
+    void pushOwned(ExpOperation* oper);
+
+    /**
+     * Push an integer value
+     * @param value Integer value to push, nonInteger() for NaN
+     */
+    void pushInteger(int64_t value);
+
+    /**
+     * Push a boolean value
+     * @param value Boolean value to push
+     */
+    void pushBoolean(bool value);
+
+    /**
+     * Push a string value
+     * @param keep True to keep the text left by the last value popped from the same position
+     * @return Reference to the text of the new value
+     */
+    String& pushText(bool keep = false);
+
+    /**
+     * Remove values off the top of the stack without evaluating them
+     * @param count Number of values to remove
+     */
+    void drop(unsigned int count = 1);
+
+    /**
+     * Find the topmost reference to an operation of a specific type
+     * @param opcode Operation code to search for
+     * @return Position of the value counted from the bottom of the stack, negative if not found
+     */
+    int find(int opcode) const;
+
+    /**
+     * Remove values from a position up to the top one, the top value takes their place
+     * @param index Position counted from the bottom of the stack
+     */
+    void collapse(unsigned int index);
+
+    /**
+     * Move all values to the evaluation stack as operations, oldest first
+     */
+    void flush();
+
+private:
+    struct Value {
+	int type;
+	int64_t number;
+	const ExpOperation* oper;
+	String text;
+    };
+    ExpOperation* operation(Value& value);
+    ObjList& m_stack;
+    unsigned int m_count;
+    Value m_values[32];
+};
+
 /**
  * An evaluator for multi-row (tables like in SQL) expressions
  * @short An SQL-like table evaluator
@@ -1509,6 +1688,15 @@ public:
      */
     virtual bool copyFields(ObjList& stack, const ScriptContext& original, GenObject* context);
 
+    /**
+     * Give another context its own copy of a field shared with this context
+     * @param name Name of the shared field
+     * @param context Context that is about to change the field
+     * @return True if the field was copied, false to let the context copy it
+     */
+    virtual bool unshareField(const String& name, ScriptContext& context) const
+	{ return false; }
+
     /**
      * Try to evaluate a single field searching for a matching context
      * @param stack Evaluation stack in use, field value must be pushed on it
@@ -1899,6 +2087,35 @@ private:
 };
 
 class JsFunction;
+class JsPropertyIndex;
+
+/**
+ * Inline cache of the property last found by a script operation, it is kept
+ *  by the code that repeats the lookup and is checked against the object's index
+ * @short Cached location of an object property
+ */
+class YSCRIPT_API JsPropertyCache
+{
+    friend class JsObject;
+public:
+    /**
+     * Constructor of an empty cache
+     */
+    inline JsPropertyCache()
+	: m_index(0), m_serial(0), m_item(0)
+	{ }
+
+    /**
+     * Forget the cached property
+     */
+    inline void clear()
+	{ m_index = 0; m_item = 0; }
+
+private:
+    const JsPropertyIndex* m_index;
+    unsigned int m_serial;
+    ObjList* m_item;
+};
 
 /**
  * Javascript Object class, base for all JS objects
@@ -1938,6 +2155,20 @@ public:
      */
     virtual ~JsObject();
 
+    /**
+     * Access to the properties for changes, the property index is rebuilt when next used
+     * @return Reference to the internal named list
+     */
+    inline NamedList& params()
+	{ m_indexStale = true; return ScriptContext::params(); }
+
+    /**
+     * Const access to the properties
+     * @return Reference to the internal named list
+     */
+    inline const NamedList& params() const
+	{ return ScriptContext::params(); }
+
     /**
      * Retrieve the Mutex object used to serialize object access
      * @return Pointer to the mutex of the context this object belongs to
@@ -1998,6 +2229,15 @@ public:
      */
     virtual NamedString* getField(ObjList& stack, const String& name, GenObject* context) const;
 
+    /**
+     * Find the list item holding an own property, objects with many properties
+     *  keep a hash index of them that is rebuilt after the properties are changed
+     * @param name Name of the property to find
+     * @param cache Optional inline cache of the item found for the same name
+     * @return Pointer to the list item holding the property, NULL if not found
+     */
+    ObjList* propertyItem(const String& name, JsPropertyCache* cache = 0) const;
+
     /**
      * Native constructor initialization, called by addConstructor on the prototype
      * @param construct Function that has this object as prototype
@@ -2063,6 +2303,30 @@ public:
     inline void freeze()
 	{ m_frozen = true; }
 
+    /**
+     * Check if the object belongs to a snapshot shared by several contexts
+     * @return True if the object is shared and copied on write
+     */
+    inline bool snapshot() const
+	{ return m_snapshot; }
+
+    /**
+     * Mark the object as part of a snapshot shared by several contexts, a context
+     *  gets a private copy of it before changing it and uses the copy from then on
+     */
+    inline void setSnapshot()
+	{ m_frozen = m_snapshot = true; }
+
+    /**
+     * Find the private copy of a snapshot object made by the context of a script
+     * @param shared Object shared with other contexts
+     * @param context Pointer to arbitrary object passed from evaluation methods
+     * @param write True to make the copy now if there is none yet
+     * @return Pointer to the private copy, NULL to use the shared object
+     */
+    virtual JsObject* copyShared(const JsObject* shared, GenObject* context, bool write)
+	{ return 0; }
+
     /**
      * Helper static method that adds an object to a parent
      * @param params List of parameters where to add the object
@@ -2162,10 +2426,24 @@ protected:
     inline Mutex* mutex() const
 	{ return m_mutex; }
 
+    /**
+     * Discard the property index after properties were renamed in place
+     *  or changed through the ScriptContext base class
+     */
+    inline void renamed()
+	{ m_indexStale = true; }
+
 private:
+    void updateIndex() const;
+    void replaceIndex(JsPropertyIndex* idx) const;
+    JsObject* ownCopy(GenObject* context, bool write) const;
     static const String s_protoName;
     bool m_frozen;
+    bool m_snapshot;
     Mutex* m_mutex;
+    mutable JsPropertyIndex* volatile m_index;
+    mutable volatile int m_indexReaders;
+    mutable volatile bool m_indexStale;
 };
 
 /**
@@ -2520,6 +2798,14 @@ public:
      */
     virtual ScriptContext* createContext() const;
 
+    /**
+     * Create a Javascript context that starts with references to the fields of a shared one.
+     * A shared object is copied in the new context before the script can change it
+     * @param shared Context holding the shared fields, must not change once contexts use it
+     * @return A new Javascript context
+     */
+    ScriptContext* createContext(ScriptContext* shared) const;
+
     /**
      * Create a runner adequate for a block of parsed Javascript code
      * @param code Parsed code block
@@ -32,22 +32,84 @@
 #define MIN_TICK_SLEEP 500
 #define DEF_TICK_SLEEP 5000
 #define MAX_TICK_SLEEP 50000
+// Longest interval a timer driven component is left without a tick
+#define MAX_TICK_IDLE 1000000
+#define MAX_TICK_THREADS 16
+
+// Timer wheel slot duration in msec and number of slots, must be a power of 2
+#define WHEEL_SLOT 4
+#define WHEEL_SLOTS 4096
+// Number of wheel slots in a coarse slot and number of coarse slots, powers of 2
+#define WHEEL_COARSE 64
+#define WHEEL_COARSE_SLOTS 16384
+
+#ifdef _WINDOWS
+#define WHEEL_BARRIER() MemoryBarrier()
+#define WHEEL_INC(x) InterlockedIncrement((LONG*)&(x))
+#define WHEEL_DEC(x) InterlockedDecrement((LONG*)&(x))
+#define WHEEL_OR(x,v) InterlockedOr((LONG*)&(x),(LONG)(v))
+#define WHEEL_AND(x,v) InterlockedAnd((LONG*)&(x),(LONG)(v))
+#else
+#define WHEEL_BARRIER() __sync_synchronize()
+#define WHEEL_INC(x) __sync_add_and_fetch(&(x),1)
+#define WHEEL_DEC(x) __sync_sub_and_fetch(&(x),1)
+#define WHEEL_OR(x,v) __sync_fetch_and_or(&(x),(v))
+#define WHEEL_AND(x,v) __sync_fetch_and_and(&(x),(v))
+#endif
 
 namespace TelEngine {
 
 class SignallingThreadPrivate : public Thread
 {
 public:
-    inline SignallingThreadPrivate(SignallingEngine* engine, const char* name, Priority prio)
-	: Thread(name,prio), m_engine(engine)
+    inline SignallingThreadPrivate(SignallingEngine* engine, const char* name, Priority prio,
+	int helper = -1)
+	: Thread(name,prio), m_engine(engine), m_helper(helper)
 	{ }
     virtual ~SignallingThreadPrivate();
     virtual void run();
 
 private:
     SignallingEngine* m_engine;
+    int m_helper;                        // Index in engine's helpers, -1 for worker
 };
 
+// Timeouts of all signalling timers, used to tick timer driven components
+//  only when something expired and to let idle engine threads sleep
+// Near timeouts mark a slot of the wheel, far ones mark a slot of a coarse
+//  wheel and move in the wheel as it advances
+// Timeouts are marked without locking, the mutex serializes the engines
+//  expiring the wheel and protects the sleeping threads
+// Slot numbers are kept modulo 2^32 and compared by their difference
+class SignallingTimerWheel
+{
+public:
+    SignallingTimerWheel();
+    // Record a timeout (msec)
+    void schedule(u_int64_t time);
+    // Expire slots ended before a time (msec), return the expiration serial
+    u_int64_t expire(u_int64_t time);
+    // Retrieve the earliest time (msec) something will expire, 0 if nothing
+    u_int64_t next(u_int64_t now);
+    // Sleep until woken up or the interval passed
+    void sleep(unsigned long usec);
+
+private:
+    void mark(unsigned int slot);
+    u_int64_t nextLocked(u_int64_t now);
+    void wakeAll();
+    Mutex m_mutex;
+    Semaphore m_wake;
+    volatile u_int32_t m_slots[WHEEL_SLOTS / 32];
+    volatile u_int32_t m_coarse[WHEEL_COARSE_SLOTS / 32];
+    volatile unsigned int m_pos;         // First slot not expired yet
+    volatile unsigned int m_coarsePos;   // First slot of the coarse wheel not moved in the wheel
+    u_int64_t m_serial;                  // Incremented when something expired
+    volatile int m_sleeping;             // Threads sleeping in the wheel
+    unsigned int m_wakeSlot;             // Slot ending when the latest sleeping thread wakes up
+};
+
+
 };
 
 
@@ -55,6 +117,7 @@ using namespace TelEngine;
 
 static ObjList s_factories;
 static Mutex s_mutex(true,"SignallingFactory");
+static SignallingTimerWheel s_wheel;
 
 // Retrieve a value from a list
 // Shift it if upper bits are set and mask is not set
@@ -143,7 +206,8 @@ void* SignallingFactory::buildInternal(const String& type, NamedList* name)
 
 
 SignallingComponent::SignallingComponent(const char* name, const NamedList* params, const char* type)
-    : m_engine(0), m_compType(type)
+    : m_engine(0), m_compType(type),
+      m_timerDriven(false), m_tickIdle(0)
 {
     if (params) {
 	name = params->getValue(YSTRING("debugname"),name);
@@ -291,7 +355,11 @@ long SignallingEngine::s_maxLockWait = MAX_LOCK_WAIT;
 SignallingEngine::SignallingEngine(const char* name)
     : Mutex(true,"SignallingEngine"),
       m_thread(0),
-      m_usecSleep(DEF_TICK_SLEEP), m_tickSleep(0)
+      m_usecSleep(DEF_TICK_SLEEP), m_tickSleep(0),
+      m_helpers(0), m_helperCount(0), m_tickBusy(0),
+      m_tickWork(MAX_TICK_THREADS,"SignallingEngine::work",0),
+      m_tickDone(1,"SignallingEngine::done",0),
+      m_wheelSerial(0)
 {
     debugName(name);
 }
@@ -448,7 +516,8 @@ bool SignallingEngine::control(NamedList& params)
     return ok;
 }
 
-bool SignallingEngine::start(const char* name, Thread::Priority prio, unsigned long usec)
+bool SignallingEngine::start(const char* name, Thread::Priority prio, unsigned long usec,
+    unsigned int threads)
 {
     Lock mylock(this);
     if (m_thread)
@@ -461,11 +530,29 @@ bool SignallingEngine::start(const char* name, Thread::Priority prio, unsigned l
     else if (usec > MAX_TICK_SLEEP)
 	usec = MAX_TICK_SLEEP;
 
+    if (threads > MAX_TICK_THREADS)
+	threads = MAX_TICK_THREADS;
+
     SignallingThreadPrivate* tmp = new SignallingThreadPrivate(this,name,prio);
     if (tmp->startup()) {
 	m_usecSleep = usec;
 	m_thread = tmp;
 	DDebug(this,DebugInfo,"Engine started worker thread [%p]",this);
+	// helpers can't tick anything before we release the lock
+	if (threads > 1) {
+	    m_helpers = new SignallingThreadPrivate*[threads - 1];
+	    for (unsigned int i = 0; i < threads - 1; i++) {
+		tmp = new SignallingThreadPrivate(this,"Sig Helper",prio,m_helperCount);
+		if (tmp->startup())
+		    m_helpers[m_helperCount++] = tmp;
+		else {
+		    delete tmp;
+		    Debug(this,DebugWarn,"Engine failed to start helper thread [%p]",this);
+		    break;
+		}
+	    }
+	    DDebug(this,DebugInfo,"Engine started %u helper threads [%p]",m_helperCount,this);
+	}
 	return true;
     }
     delete tmp;
@@ -481,6 +568,25 @@ void SignallingEngine::stop()
     m_thread->cancel(false);
     while (m_thread)
 	Thread::yield(true);
+    // the worker thread is gone, helpers have no more work to do
+    lock();
+    for (unsigned int i = 0; i < m_helperCount; i++)
+	if (m_helpers[i])
+	    m_helpers[i]->cancel(false);
+    unlock();
+    for (;;) {
+	lock();
+	unsigned int i = 0;
+	while (i < m_helperCount && !m_helpers[i])
+	    i++;
+	unlock();
+	if (i >= m_helperCount)
+	    break;
+	Thread::yield(true);
+    }
+    delete[] m_helpers;
+    m_helpers = 0;
+    m_helperCount = 0;
     Debug(this,DebugAll,"Engine stopped worker thread [%p]",this);
 #if 0
     lock();
@@ -506,22 +612,85 @@ unsigned long SignallingEngine::tickSleep(unsigned long usec)
     return m_tickSleep;
 }
 
+// Tick the components that need it
+// Timer driven components are ticked only if some timeout expired
 unsigned long SignallingEngine::timerTick(const Time& when)
 {
-    RefPointer<SignallingComponent> c;
+    u_int64_t serial = s_wheel.expire(when.msec());
+    bool expired = (serial != m_wheelSerial);
+    m_wheelSerial = serial;
     lock();
     m_tickSleep = m_usecSleep;
-    ListIterator iter(m_components);
-    while ((c = static_cast<SignallingComponent*>(iter.get()))) {
-	unlock();
-	c->timerTick(when);
-	c = 0;
+    m_tickTime = when;
+    bool polled = false;
+    u_int64_t idle = when.usec() + MAX_TICK_IDLE;
+    unsigned int count = 0;
+    ObjList* add = &m_ticking;
+    for (ObjList* l = m_components.skipNull(); l; l = l->skipNext()) {
+	SignallingComponent* c = static_cast<SignallingComponent*>(l->get());
+	if (c->m_timerDriven) {
+	    if (expired || c->m_tickIdle <= when.usec())
+		c->m_tickIdle = when.usec() + MAX_TICK_IDLE;
+	    else {
+		if (c->m_tickIdle < idle)
+		    idle = c->m_tickIdle;
+		continue;
+	    }
+	}
+	else
+	    polled = true;
+	if (!c->ref())
+	    continue;
+	add = add->append(c);
+	count++;
+    }
+    // keep the worker thread busy too
+    unsigned int helpers = (count > m_helperCount) ? m_helperCount : (count ? count - 1 : 0);
+    m_tickBusy = helpers;
+    unlock();
+    for (unsigned int i = 0; i < helpers; i++)
+	m_tickWork.unlock();
+    tickComponents();
+    while (helpers) {
 	lock();
+	helpers = m_tickBusy;
+	unlock();
+	if (helpers)
+	    m_tickDone.lock(MAX_TICK_SLEEP);
     }
+    lock();
     unsigned long rval = m_tickSleep;
     m_tickSleep = m_usecSleep;
     unlock();
-    return rval;
+    if (polled || rval < m_usecSleep)
+	return rval;
+    // only timer driven components, sleep until something expires
+    u_int64_t now = Time::now();
+    u_int64_t next = s_wheel.next(now / 1000) * 1000;
+    if (next && next < idle)
+	idle = next;
+    if (idle <= now + m_usecSleep)
+	return rval;
+    return (idle - now > MAX_TICK_IDLE) ? MAX_TICK_IDLE : (unsigned long)(idle - now);
+}
+
+// Tick the components left in the list, called by the worker and helper threads
+void SignallingEngine::tickComponents()
+{
+    lock();
+    Time when(m_tickTime.usec());
+    for (;;) {
+	SignallingComponent* c = static_cast<SignallingComponent*>(m_ticking.remove(false));
+	if (!c)
+	    break;
+	bool tick = (c->engine() == this);
+	unlock();
+	if (tick)
+	    c->timerTick(when);
+	TelEngine::destruct(c);
+	lock();
+    }
+    unlock();
 }
 
 void SignallingEngine::maxLockWait(long maxWait)
@@ -535,18 +704,36 @@ void SignallingEngine::maxLockWait(long maxWait)
 
 SignallingThreadPrivate::~SignallingThreadPrivate()
 {
-    if (m_engine)
+    if (!m_engine)
+	return;
+    if (m_helper < 0) {
 	m_engine->m_thread = 0;
+	return;
+    }
+    Lock mylock(m_engine);
+    m_engine->m_helpers[m_helper] = 0;
 }
 
 void SignallingThreadPrivate::run()
 {
+    if (m_helper >= 0) {
+	for (;;) {
+	    if (m_engine && m_engine->m_tickWork.lock(MAX_TICK_SLEEP)) {
+		m_engine->tickComponents();
+		Lock mylock(m_engine);
+		if (m_engine->m_tickBusy && !--m_engine->m_tickBusy)
+		    m_engine->m_tickDone.unlock();
+	    }
+	    check(true);
+	}
+    }
     for (;;) {
 	if (m_engine) {
 	    Time t;
 	    unsigned long sleepTime = m_engine->timerTick(t);
 	    if (sleepTime) {
-		usleep(sleepTime,true);
+		s_wheel.sleep(sleepTime);
+		check(true);
 		continue;
 	    }
 	}
@@ -558,6 +745,12 @@ void SignallingThreadPrivate::run()
 /*
  * SignallingTimer
  */
+// Record a timeout in the timer wheel
+void SignallingTimer::schedule(u_int64_t time)
+{
+    s_wheel.schedule(time);
+}
+
 // Retrieve a timer interval from a list of parameters
 unsigned int SignallingTimer::getInterval(const NamedList& params, const char* param,
     unsigned int minVal, unsigned int defVal, unsigned int maxVal, bool allowDisable)
@@ -573,6 +766,191 @@ unsigned int SignallingTimer::getInterval(const NamedList& params, const char* p
 }
 
 
+/*
+ * SignallingTimerWheel
+ */
+// Set the bit of a slot, return false if it was already set
+static inline bool wheelSet(volatile u_int32_t* bits, unsigned int index)
+{
+    u_int32_t mask = 1 << (index & 31);
+    volatile u_int32_t& word = bits[index >> 5];
+    if (word & mask)
+	return false;
+    WHEEL_OR(word,mask);
+    return true;
+}
+
+// Clear the bit of a slot, return true if it was set
+static inline bool wheelClear(volatile u_int32_t* bits, unsigned int index)
+{
+    u_int32_t mask = 1 << (index & 31);
+    volatile u_int32_t& word = bits[index >> 5];
+    if (!(word & mask))
+	return false;
+    return (WHEEL_AND(word,~mask) & mask) != 0;
+}
+
+// Find the first bit set in count bits starting at index, return its offset or -1
+static int wheelFind(const volatile u_int32_t* bits, unsigned int size,
+    unsigned int index, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ) {
+	unsigned int idx = (index + i) & (size - 1);
+	u_int32_t word = bits[idx >> 5] >> (idx & 31);
+	if (word & 1)
+	    return i;
+	// skip the rest of an empty word
+	i += word ? 1 : 32 - (idx & 31);
+    }
+    return -1;
+}
+
+SignallingTimerWheel::SignallingTimerWheel()
+    : m_mutex(false,"SignallingTimerWheel"),
+      m_wake(MAX_TICK_THREADS * 4,"SignallingTimerWheel",0),
+      m_serial(0), m_sleeping(0), m_wakeSlot(0)
+{
+    ::memset((void*)m_slots,0,sizeof(m_slots));
+    ::memset((void*)m_coarse,0,sizeof(m_coarse));
+    m_pos = (unsigned int)(Time::msecNow() / WHEEL_SLOT);
+    m_coarsePos = (m_pos + WHEEL_SLOTS) & ~(WHEEL_COARSE - 1);
+}
+
+// Mark a slot of the wheel, a past slot is replaced by the first one not expired
+// A mark set after expire() passed its slot is stale and causes only an
+//  extra expiration when the wheel comes around
+void SignallingTimerWheel::mark(unsigned int slot)
+{
+    for (;;) {
+	unsigned int pos = m_pos;
+	if ((int)(slot - pos) < 0)
+	    slot = pos;
+	if (!wheelSet(m_slots,slot & (WHEEL_SLOTS - 1)))
+	    return;
+	// check if the slot was expired while setting the mark
+	if ((int)(slot - m_pos) >= 0)
+	    return;
+    }
+}
+
+void SignallingTimerWheel::schedule(u_int64_t time)
+{
+    unsigned int slot = (unsigned int)(time / WHEEL_SLOT);
+    if ((int)(slot - m_pos) < WHEEL_SLOTS)
+	mark(slot);
+    else {
+	// far timeout, round it up to a coarse slot
+	// timeouts beyond the coarse wheel expire early and are caught by idle ticks
+	slot = (slot + WHEEL_COARSE - 1) & ~(WHEEL_COARSE - 1);
+	unsigned int pos = m_coarsePos;
+	if ((int)(slot - pos) >= WHEEL_COARSE * (WHEEL_COARSE_SLOTS - 1))
+	    slot = pos + WHEEL_COARSE * (WHEEL_COARSE_SLOTS - 1);
+	// mark it in the wheel if it was moved while setting the mark
+	if (wheelSet(m_coarse,(slot / WHEEL_COARSE) & (WHEEL_COARSE_SLOTS - 1))
+		&& (int)(slot - m_coarsePos) < 0)
+	    mark(slot);
+    }
+    if (!m_sleeping)
+	return;
+    // wake up sleepers if the timeout comes before they would wake up
+    Lock mylock(m_mutex);
+    if (m_sleeping && (int)(slot - m_wakeSlot) < 0)
+	wakeAll();
+}
+
+u_int64_t SignallingTimerWheel::expire(u_int64_t time)
+{
+    unsigned int slot = (unsigned int)(time / WHEEL_SLOT);
+    Lock mylock(m_mutex);
+    bool fired = false;
+    unsigned int pos = m_pos;
+    int n = (int)(slot - pos);
+    if (n > 0) {
+	// publish the position first so marks set behind it are retried
+	m_pos = slot;
+	WHEEL_BARRIER();
+	if (n > WHEEL_SLOTS)
+	    n = WHEEL_SLOTS;
+	for (; n > 0; n--, pos++)
+	    if (wheelClear(m_slots,pos & (WHEEL_SLOTS - 1)))
+		fired = true;
+    }
+    // move far timeouts in the wheel as it advances
+    pos = m_coarsePos;
+    n = (int)(slot + WHEEL_SLOTS - pos) / WHEEL_COARSE;
+    if (n > 0) {
+	m_coarsePos = pos + n * WHEEL_COARSE;
+	WHEEL_BARRIER();
+	if (n > WHEEL_COARSE_SLOTS)
+	    n = WHEEL_COARSE_SLOTS;
+	for (; n > 0; n--, pos += WHEEL_COARSE) {
+	    if (!wheelClear(m_coarse,(pos / WHEEL_COARSE) & (WHEEL_COARSE_SLOTS - 1)))
+		continue;
+	    if ((int)(pos - slot) < 0)
+		fired = true;
+	    else
+		mark(pos);
+	}
+    }
+    if (fired)
+	m_serial++;
+    return m_serial;
+}
+
+u_int64_t SignallingTimerWheel::next(u_int64_t now)
+{
+    Lock mylock(m_mutex);
+    return nextLocked(now);
+}
+
+// Retrieve the earliest time a marked slot ends, wheel must be locked
+u_int64_t SignallingTimerWheel::nextLocked(u_int64_t now)
+{
+    unsigned int slot = m_pos;
+    int i = wheelFind(m_slots,WHEEL_SLOTS,slot,WHEEL_SLOTS);
+    if (i >= 0)
+	slot += i;
+    else {
+	slot = m_coarsePos;
+	i = wheelFind(m_coarse,WHEEL_COARSE_SLOTS,slot / WHEEL_COARSE,WHEEL_COARSE_SLOTS);
+	if (i < 0)
+	    return 0;
+	slot += i * WHEEL_COARSE;
+    }
+    u_int64_t base = now / WHEEL_SLOT;
+    return (base + (int)(slot - (unsigned int)base) + 1) * WHEEL_SLOT;
+}
+
+void SignallingTimerWheel::sleep(unsigned long usec)
+{
+    u_int64_t now = Time::msecNow();
+    unsigned int until = (unsigned int)((now + usec / 1000) / WHEEL_SLOT);
+    m_mutex.lock();
+    if (!m_sleeping || (int)(until - m_wakeSlot) > 0)
+	m_wakeSlot = until;
+    WHEEL_INC(m_sleeping);
+    // timeouts marked before this thread was counted as sleeping did not wake it up
+    u_int64_t next = nextLocked(now);
+    m_mutex.unlock();
+    if (next && next < now + usec / 1000)
+	usec = (next > now) ? (unsigned long)(next - now) * 1000 : 0;
+    if (usec)
+	m_wake.lock(usec);
+    m_mutex.lock();
+    WHEEL_DEC(m_sleeping);
+    m_mutex.unlock();
+}
+
+// Wake up sleeping threads, wheel must be locked
+// Threads already woken will just return early from their next sleep
+void SignallingTimerWheel::wakeAll()
+{
+    for (int i = 0; i < m_sleeping; i++)
+	m_wake.unlock();
+    m_wakeSlot = m_pos;
+}
+
+
 /**
  * SignallingUtils
  */
@@ -989,11 +1367,12 @@ unsigned int SignallingUtils::encodeFlags(const SignallingComponent* comp, const
     if (!dict)
 	return 0;
     unsigned int v = 0;
-    ObjList* l = flags.split(',',false);
-    for (ObjList* o = l->skipNull(); o; o = o->skipNext()) {
-	const String* s = static_cast<const String*>(o->get());
-	for (const SignallingFlags* d = dict; d->mask; d++) {
-	    if (*s == d->name) {
+    // match the names in place, this is called for every encoded message
+    for (const char* s = flags.c_str(); s && *s; ) {
+	const char* sep = ::strchr(s,',');
+	unsigned int len = sep ? (unsigned int)(sep - s) : ::strlen(s);
+	for (const SignallingFlags* d = len ? dict : 0; d && d->mask; d++) {
+	    if (!::strncmp(s,d->name,len) && !d->name[len]) {
 		if (v & d->mask) {
 		    Debug(comp,DebugMild,"Flag %s. %s overwriting bits 0x%x",
 			paramName,d->name,v & d->mask);
@@ -1002,8 +1381,8 @@ unsigned int SignallingUtils::encodeFlags(const SignallingComponent* comp, const
 		v |= d->value;
 	    }
 	}
+	s = sep ? sep + 1 : 0;
     }
-    TelEngine::destruct(l);
     return v;
 }
 
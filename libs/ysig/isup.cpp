@@ -33,6 +33,20 @@ using namespace TelEngine;
 
 // Maximum number of mandatory parameters including two terminators
 #define MAX_MANDATORY_PARAMS 16
+// Extra buffer space to allocate when a MSU being encoded grows
+#define MSU_ALLOC_STEP 64
+// Most parameters a message may hold, more than fit in 272 octets
+#define ISUP_MAX_PARAMS 128
+// Longest parameter area of a message decoded on first use, longer ones are decoded at once
+#define ISUP_LAZY_LENGTH 272
+
+#ifdef _WINDOWS
+#define ISUP_BARRIER() MemoryBarrier()
+#define ISUP_CAS(var,old,val) (::InterlockedCompareExchange((LONG volatile*)&(var),(LONG)(val),(LONG)(old)) == (LONG)(old))
+#else
+#define ISUP_BARRIER() __sync_synchronize()
+#define ISUP_CAS(var,old,val) __sync_bool_compare_and_swap(&(var),(old),(val))
+#endif
 
 // Timer limits and default values
 #define ISUP_T7_MINVAL  20000
@@ -48,6 +62,11 @@ using namespace TelEngine;
 #define ISUP_T34_DEFVAL 3000
 #define ISUP_T34_MAXVAL 4000
 
+// Call index: circuit codes per span, span locks and highest indexed code
+#define ISUP_INDEX_SPAN  32
+#define ISUP_INDEX_LOCKS 16
+#define ISUP_INDEX_MAX   65536
+
 // Utility: check if 2 cic codes are in valid range, return range if valid, 0 otherwise
 static inline int checkValidRange(int code, int extra)
 {
@@ -716,17 +735,20 @@ static unsigned char encodeFlags(const SS7ISUP* isup, SS7MSU& msu, unsigned char
 	v = flags->value;
     }
     DDebug(isup,DebugAll,"encodeFlags encoding %s=0x%x on %u octets",param->name,v,n);
-    if (!buf) {
-	unsigned int l = msu.length();
-	DataBlock dummy(0,n+1);
-	msu += dummy;
-	buf = (unsigned char*)msu.getData(l,n+1);
-	*buf++ = n & 0xff;
+    unsigned char tmp[8];
+    unsigned char* d = buf;
+    if (!d) {
+	if (n >= sizeof(tmp))
+	    return 0;
+	d = tmp;
+	*d++ = n & 0xff;
     }
     while (n--) {
-	*buf++ = v & 0xff;
+	*d++ = v & 0xff;
 	v >>= 8;
     }
+    if (!buf)
+	msu.append(tmp,param->size + 1);
     return param->size;
 }
 
@@ -743,18 +765,21 @@ static unsigned char encodeInt(const SS7ISUP* isup, SS7MSU& msu, unsigned char*
     if (val)
 	v = val->toInteger((const TokenDict*)param->data);
     DDebug(isup,DebugAll,"encodeInt encoding %s=%u on %u octets",param->name,v,n);
-    if (!buf) {
-	unsigned int l = msu.length();
-	DataBlock dummy(0,n+1);
-	msu += dummy;
-	buf = (unsigned char*)msu.getData(l,n+1);
-	*buf++ = n & 0xff;
-    }
-    buf += n;
+    unsigned char tmp[8];
+    unsigned char* d = buf;
+    if (!d) {
+	if (n >= sizeof(tmp))
+	    return 0;
+	d = tmp;
+	*d++ = n & 0xff;
+    }
+    d += n;
     while (n--) {
-	*(--buf) = v & 0xff;
+	*(--d) = v & 0xff;
 	v >>= 8;
     }
+    if (!buf)
+	msu.append(tmp,param->size + 1);
     return param->size;
 }
 
@@ -1856,6 +1881,88 @@ static const MsgParams s_compatibility = {
     }
 };
 
+#define ISUP_NAME_INDEX 512
+
+// Hash of a parameter name of given length, same as String::hash()
+static inline unsigned int paramNameHash(const char* name, unsigned int len)
+{
+    unsigned int h = 0;
+    while (len--)
+	h = (h << 6) + (h << 16) - h + (unsigned char)*name++;
+    return h;
+}
+
+// Parameter and message descriptions indexed for constant time lookup,
+//  built once at library load from the static tables above
+class IsupIndex
+{
+public:
+    IsupIndex();
+    const IsupParam* find(const char* name, unsigned int len) const;
+    const IsupParam* m_params[256];
+    const MsgParams* m_itu[256];
+    const MsgParams* m_ansi[256];
+    String m_names[256];
+private:
+    static void fill(const MsgParams** index, const MsgParams* params);
+    const IsupParam* m_byName[ISUP_NAME_INDEX];
+};
+
+IsupIndex::IsupIndex()
+{
+    for (unsigned int i = 0; i < 256; i++) {
+	m_params[i] = 0;
+	m_itu[i] = m_ansi[i] = 0;
+    }
+    for (unsigned int i = 0; i < ISUP_NAME_INDEX; i++)
+	m_byName[i] = 0;
+    for (const IsupParam* param = s_paramDefs; param->type != SS7MsgISUP::EndOfParameters; param++) {
+	unsigned int type = param->type & 0xff;
+	if (!m_params[type]) {
+	    m_params[type] = param;
+	    m_names[type] = param->name;
+	}
+	unsigned int h = paramNameHash(param->name,::strlen(param->name));
+	for (;; h++) {
+	    const IsupParam*& p = m_byName[h % ISUP_NAME_INDEX];
+	    if (!p) {
+		p = param;
+		break;
+	    }
+	    if (!::strcmp(p->name,param->name))
+		break;
+	}
+    }
+    // specific descriptors take precedence over the common ones
+    fill(m_itu,s_itu_params);
+    fill(m_itu,s_common_params);
+    fill(m_ansi,s_ansi_params);
+    fill(m_ansi,s_common_params);
+}
+
+// Keep the first descriptor found for each message type
+void IsupIndex::fill(const MsgParams** index, const MsgParams* params)
+{
+    for (; params->type != SS7MsgISUP::Unknown; params++) {
+	const MsgParams*& p = index[params->type & 0xff];
+	if (!p)
+	    p = params;
+    }
+}
+
+const IsupParam* IsupIndex::find(const char* name, unsigned int len) const
+{
+    for (unsigned int h = paramNameHash(name,len); ; h++) {
+	const IsupParam* p = m_byName[h % ISUP_NAME_INDEX];
+	if (!p)
+	    return 0;
+	if (!::strncmp(p->name,name,len) && !p->name[len])
+	    return p;
+    }
+}
+
+static const IsupIndex s_index;
+
 // Generic decode helper function for a single parameter
 static bool decodeParam(const SS7ISUP* isup, NamedList& list, const IsupParam* param,
     const unsigned char* buf, unsigned int len, const String& prefix)
@@ -1871,7 +1978,7 @@ static bool decodeParam(const SS7ISUP* isup, NamedList& list, const IsupParam* p
 
 // Generic encode helper function for a single mandatory parameter
 static unsigned char encodeParam(const SS7ISUP* isup, SS7MSU& msu,
-    const IsupParam* param, const NamedList* params, ObjList& exclude,
+    const IsupParam* param, const NamedList* params, const NamedString*& used,
     const String& prefix, unsigned char* buf = 0)
 {
     DDebug(isup,DebugAll,"encodeParam (mand) (%p,%p,%p,%p) type=0x%02x, size=%u, name='%s'",
@@ -1879,9 +1986,16 @@ static unsigned char encodeParam(const SS7ISUP* isup, SS7MSU& msu,
     // variable length must not receive fixed buffer
     if (buf && !param->size)
 	return 0;
-    NamedString* val = params ? params->getParam(prefix+param->name) : 0;
-    if (val)
-	exclude.append(val)->setDelete(false);
+    NamedString* val = 0;
+    if (params) {
+	unsigned int type = param->type & 0xff;
+	// avoid building the name of the parameter if not prefixed
+	if (prefix || s_index.m_params[type] != param)
+	    val = params->getParam(prefix + param->name);
+	else
+	    val = params->getParam(s_index.m_names[type]);
+    }
+    used = val;
     if (param->encoder)
 	return param->encoder(isup,msu,buf,param,val,params,prefix);
     return encodeRaw(isup,msu,buf,param,val,params,prefix);
@@ -1912,53 +2026,29 @@ static unsigned char encodeParam(const SS7ISUP* isup, SS7MSU& msu,
 }
 
 // Locate the description for a parameter by type
-static const IsupParam* getParamDesc(SS7MsgISUP::Parameters type)
+static inline const IsupParam* getParamDesc(SS7MsgISUP::Parameters type)
 {
-    const IsupParam* param = s_paramDefs;
-    for (; param->type != SS7MsgISUP::EndOfParameters; param++) {
-	if (param->type == type)
-	    return param;
-    }
-    return 0;
+    return s_index.m_params[type & 0xff];
 }
 
 // Locate the description for a parameter by name
-static const IsupParam* getParamDesc(const String& name)
+static inline const IsupParam* getParamDesc(const String& name)
 {
-    const IsupParam* param = s_paramDefs;
-    for (; param->type != SS7MsgISUP::EndOfParameters; param++) {
-	if (name == param->name)
-	    return param;
-    }
-    return 0;
+    return s_index.find(name.c_str(),name.length());
 }
 
 // Locate the description table for a message according to protocol type
 static const MsgParams* getIsupParams(SS7PointCode::Type type, SS7MsgISUP::Type msg)
 {
-    const MsgParams* params = 0;
     switch (type) {
 	case SS7PointCode::ITU:
-	    params = s_itu_params;
-	    break;
+	    return s_index.m_itu[msg & 0xff];
 	case SS7PointCode::ANSI:
 	case SS7PointCode::ANSI8:
-	    params = s_ansi_params;
-	    break;
+	    return s_index.m_ansi[msg & 0xff];
 	default:
 	    return 0;
     }
-    // search first in specific table
-    for (; params->type != SS7MsgISUP::Unknown; params++) {
-	if (params->type == msg)
-	    return params;
-    }
-    // then search in common table
-    for (params = s_common_params; params->type != SS7MsgISUP::Unknown; params++) {
-	if (params->type == msg)
-	    return params;
-    }
-    return 0;
 }
 
 // Hexify a list of isup parameter values/names
@@ -2044,6 +2134,324 @@ static bool hasOptionalOnly(SS7MsgISUP::Type msg)
 }
 #undef MAKE_CASE
 
+// Mandatory part of a message resolved to parameter descriptions and sizes
+struct IsupTemplate
+{
+    // descriptions of the mandatory fixed parameters in message order
+    const IsupParam* fixed[MAX_MANDATORY_PARAMS];
+    unsigned int fixedCount;
+    // octets taken by the mandatory fixed parameters
+    unsigned int fixedLen;
+    // descriptions of the mandatory variable parameters in message order
+    const IsupParam* variable[MAX_MANDATORY_PARAMS];
+    unsigned int variableCount;
+    // the message has an optional part
+    bool optional;
+};
+
+// Resolve the mandatory parameters of a message, fail if they can't be encoded or decoded
+static bool buildTemplate(const SS7ISUP* isup, IsupTemplate& tpl, const MsgParams* msgParams)
+{
+    tpl.fixedCount = tpl.fixedLen = tpl.variableCount = 0;
+    tpl.optional = msgParams->optional;
+    const SS7MsgISUP::Parameters* plist = msgParams->params;
+    SS7MsgISUP::Parameters ptype;
+    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
+	const IsupParam* param = getParamDesc(ptype);
+	if (!param) {
+	    // this is fatal as we don't know the length
+	    Debug(isup,DebugGoOn,"Missing description of fixed ISUP parameter 0x%02x [%p]",ptype,isup);
+	    return false;
+	}
+	if (!param->size) {
+	    Debug(isup,DebugGoOn,"Invalid (variable) description of fixed ISUP parameter %s [%p]",param->name,isup);
+	    return false;
+	}
+	tpl.fixed[tpl.fixedCount++] = param;
+	tpl.fixedLen += param->size;
+    }
+    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
+	const IsupParam* param = getParamDesc(ptype);
+	if (!param) {
+	    // we could skip over unknown mandatory variable length but it's still bad
+	    Debug(isup,DebugGoOn,"Missing description of variable ISUP parameter 0x%02x [%p]",ptype,isup);
+	    return false;
+	}
+	if (param->size)
+	    Debug(isup,DebugMild,"Invalid (fixed) description of variable ISUP parameter %s [%p]",param->name,isup);
+	tpl.variable[tpl.variableCount++] = param;
+    }
+    return true;
+}
+
+// Templates of the messages sent and received for every call, built once at library load
+class IsupTemplates
+{
+public:
+    IsupTemplates();
+    const IsupTemplate* find(SS7PointCode::Type pcType, SS7MsgISUP::Type msgType) const;
+private:
+    IsupTemplate m_tpl[2][4];
+    bool m_valid[2][4];
+};
+
+static const SS7MsgISUP::Type s_tplTypes[4] = {
+    SS7MsgISUP::ACM, SS7MsgISUP::ANM, SS7MsgISUP::REL, SS7MsgISUP::RLC
+};
+
+IsupTemplates::IsupTemplates()
+{
+    for (unsigned int i = 0; i < 4; i++) {
+	const MsgParams* itu = getIsupParams(SS7PointCode::ITU,s_tplTypes[i]);
+	const MsgParams* ansi = getIsupParams(SS7PointCode::ANSI,s_tplTypes[i]);
+	m_valid[0][i] = itu && buildTemplate(0,m_tpl[0][i],itu);
+	m_valid[1][i] = ansi && buildTemplate(0,m_tpl[1][i],ansi);
+    }
+}
+
+const IsupTemplate* IsupTemplates::find(SS7PointCode::Type pcType, SS7MsgISUP::Type msgType) const
+{
+    unsigned int pc = 0;
+    switch (pcType) {
+	case SS7PointCode::ITU:
+	    break;
+	case SS7PointCode::ANSI:
+	case SS7PointCode::ANSI8:
+	    pc = 1;
+	    break;
+	default:
+	    return 0;
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+	if (s_tplTypes[i] == msgType)
+	    return m_valid[pc][i] ? &m_tpl[pc][i] : 0;
+    }
+    return 0;
+}
+
+static const IsupTemplates s_templates;
+
+// Location of a parameter in the parameter area of a message
+struct IsupParamLoc
+{
+    unsigned char type;
+    unsigned char size;
+    u_int16_t offset;
+};
+
+// Parameters of a message in the order found: mandatory fixed, variable, optional
+struct IsupParamTable
+{
+    unsigned int count;
+    IsupParamLoc params[ISUP_MAX_PARAMS];
+};
+
+namespace TelEngine {
+
+// Controller of received messages decoded on first use
+// Messages don't hold a reference to the controller itself as they may be
+//  queued in its calls, the pointer is cleared when the controller goes away
+class IsupDecoder : public RefObject
+{
+public:
+    inline IsupDecoder(SS7ISUP* isup)
+	: m_lock("IsupDecoder"), m_isup(isup)
+	{ }
+    RWLock m_lock;                       // Held for reading while decoding, for writing to clear
+    SS7ISUP* m_isup;
+};
+
+// Parameter area of a received message with the parameters located
+struct IsupLazyParams
+{
+    volatile int decoding;               // Set by the first thread to use the parameters
+    IsupDecoder* decoder;
+    SS7PointCode::Type pcType;
+    IsupParamTable table;
+    unsigned int length;
+    unsigned char data[ISUP_LAZY_LENGTH];
+};
+
+}; // namespace TelEngine
+
+// Add a parameter to the table of a message being scanned
+static inline bool addParamLoc(IsupParamTable& table, unsigned char type, unsigned int offset,
+    unsigned int size)
+{
+    if (table.count >= ISUP_MAX_PARAMS)
+	return false;
+    IsupParamLoc& loc = table.params[table.count++];
+    loc.type = type;
+    loc.size = size;
+    loc.offset = offset;
+    return true;
+}
+
+// Locate the parameters of a message and check its structure, nothing is decoded
+static bool scanParams(const SS7ISUP* isup, IsupParamTable& table, const IsupTemplate& tpl,
+    const char* msgName, SS7MsgISUP::Type msgType, const unsigned char* paramPtr, unsigned int paramLen)
+{
+    table.count = 0;
+    if (paramLen > 0xffff) {
+	Debug(isup,DebugWarn,"Invalid length %u of ISUP message %s [%p]",paramLen,msgName,isup);
+	return false;
+    }
+    const unsigned char* start = paramPtr;
+    // first the mandatory fixed parameters the message should have
+    for (unsigned int i = 0; i < tpl.fixedCount; i++) {
+	const IsupParam* param = tpl.fixed[i];
+	if (paramLen < param->size) {
+	    Debug(isup,DebugWarn,"Truncated ISUP message! [%p]",isup);
+	    return false;
+	}
+	addParamLoc(table,param->type,paramPtr - start,param->size);
+	paramPtr += param->size;
+	paramLen -= param->size;
+    }
+    bool mustWarn = true;
+    // next any mandatory variable parameters the message should have
+    for (unsigned int i = 0; i < tpl.variableCount; i++) {
+	mustWarn = false;
+	const IsupParam* param = tpl.variable[i];
+	unsigned int offs = paramPtr[0];
+	if ((offs < 1) || (offs >= paramLen)) {
+	    Debug(isup,DebugWarn,"Invalid offset %u (len=%u) ISUP parameter %s [%p]",
+		offs,paramLen,param->name,isup);
+	    return false;
+	}
+	unsigned int size = paramPtr[offs];
+	if ((size < 1) || (offs+size >= paramLen)) {
+	    Debug(isup,DebugWarn,"Invalid size %u (ofs=%u, len=%u) ISUP parameter %s [%p]",
+		size,offs,paramLen,param->name,isup);
+	    return false;
+	}
+	addParamLoc(table,param->type,paramPtr + offs + 1 - start,size);
+	paramPtr++;
+	paramLen--;
+    }
+    // now the optional parameters if the message supports them
+    if (tpl.optional) {
+	unsigned int offs = paramLen ? paramPtr[0] : 0;
+	if (offs >= paramLen) {
+	    if (paramLen) {
+		Debug(isup,DebugWarn,"Invalid ISUP optional offset %u (len=%u) [%p]",
+		    offs,paramLen,isup);
+		return false;
+	    }
+	    Debug(isup,DebugMild,"ISUP message %s lacking optional parameters [%p]",
+		msgName,isup);
+	}
+	else if (offs) {
+	    mustWarn = true;
+	    // advance pointer past mandatory parameters
+	    paramPtr += offs;
+	    paramLen -= offs;
+	    while (paramLen) {
+		unsigned char ptype = *paramPtr++;
+		paramLen--;
+		if (ptype == SS7MsgISUP::EndOfParameters)
+		    break;
+		if (paramLen < 2) {
+		    Debug(isup,DebugWarn,"Only %u octets while decoding optional ISUP parameter 0x%02x [%p]",
+			paramLen,ptype,isup);
+		    return false;
+		}
+		unsigned int size = *paramPtr++;
+		paramLen--;
+		if ((size < 1) || (size >= paramLen)) {
+		    Debug(isup,DebugWarn,"Invalid size %u (len=%u) ISUP optional parameter 0x%02x [%p]",
+			size,paramLen,ptype,isup);
+		    return false;
+		}
+		if (!addParamLoc(table,ptype,paramPtr - start,size)) {
+		    Debug(isup,DebugWarn,"More than %u parameters in ISUP message %s [%p]",
+			ISUP_MAX_PARAMS,msgName,isup);
+		    return false;
+		}
+		paramPtr += size;
+		paramLen -= size;
+	    } // while (paramLen)
+	} // else if (offs)
+	else
+	    paramLen = 0;
+    }
+    if (paramLen && mustWarn)
+	Debug(isup,DebugWarn,"Got %u garbage octets after message type 0x%02x [%p]",
+	    paramLen,msgType,isup);
+    return true;
+}
+
+// Add the protocol and message type ahead of the parameters
+static void addMessageType(NamedList& msg, SS7PointCode::Type pcType, const char* msgName,
+    const String& prefix)
+{
+    if (!msg.getValue(prefix+"protocol-type")) {
+	switch (pcType) {
+	    case SS7PointCode::ITU:
+		msg.setParam(prefix+"protocol-type","itu-t");
+		break;
+	    case SS7PointCode::ANSI:
+	    case SS7PointCode::ANSI8:
+		msg.setParam(prefix+"protocol-type","ansi");
+		break;
+	    default: ;
+	}
+    }
+    msg.addParam(prefix+"message-type",msgName);
+}
+
+// Decode the located parameters, list those not supported and those asking for release or CNF
+static void decodeParams(const SS7ISUP* isup, NamedList& msg, const IsupParamTable& table,
+    const unsigned char* paramPtr, const String& prefix)
+{
+    String unsupported;
+    for (unsigned int i = 0; i < table.count; i++) {
+	const IsupParamLoc& loc = table.params[i];
+	const unsigned char* buf = paramPtr + loc.offset;
+	// only optional parameters may lack a description
+	const IsupParam* param = getParamDesc((SS7MsgISUP::Parameters)loc.type);
+	if (!param) {
+	    Debug(isup,DebugMild,"Unknown optional ISUP parameter 0x%02x (size=%u) [%p]",loc.type,loc.size,isup);
+	    decodeRawParam(isup,msg,loc.type,buf,loc.size,prefix);
+	    SignallingUtils::appendFlag(unsupported,String((unsigned int)loc.type));
+	}
+	else if (!decodeParam(isup,msg,param,buf,loc.size,prefix)) {
+	    Debug(isup,DebugWarn,"Could not decode ISUP parameter %s (size=%u) [%p]",param->name,loc.size,isup);
+	    decodeRaw(isup,msg,param,buf,loc.size,prefix);
+	    SignallingUtils::appendFlag(unsupported,param->name);
+	}
+    }
+    if (unsupported)
+	msg.addParam(prefix + "parameters-unsupported",unsupported);
+    String release,cnf,npRelease;
+    String pCompat(prefix + "ParameterCompatInformation.");
+    unsigned int n = msg.length();
+    for (unsigned int i = 0; i < n; i++) {
+	NamedString* ns = msg.getParam(i);
+	if (!(ns && ns->name().startsWith(pCompat) && !ns->name().endsWith(".more")))
+	    continue;
+	ObjList* l = ns->split(',',false);
+	for (ObjList* ol = l->skipNull(); ol; ol = ol->skipNext()) {
+	    String* s = static_cast<String*>(ol->get());
+	    if (*s == YSTRING("release")) {
+		SignallingUtils::appendFlag(release,ns->name().substr(pCompat.length()));
+		break;
+	    }
+	    if (*s == YSTRING("cnf"))
+		SignallingUtils::appendFlag(cnf,ns->name().substr(pCompat.length()));
+	    if (*s == YSTRING("nopass-release"))
+		SignallingUtils::appendFlag(npRelease,ns->name().substr(pCompat.length()));
+	}
+	TelEngine::destruct(l);
+    }
+    if (release)
+	msg.setParam(prefix + "parameters-unhandled-release",release);
+    if (cnf)
+	msg.setParam(prefix + "parameters-unhandled-cnf",cnf);
+    if (npRelease)
+	msg.setParam(prefix + "parameters-nopass-release",npRelease);
+}
+
 #define MAKE_NAME(x) { #x, SS7MsgISUP::x }
 static const TokenDict s_names[] = {
     // this list must be kept in synch with the header
@@ -2116,11 +2524,67 @@ static const TokenDict s_names[] = {
 };
 #undef MAKE_NAME
 
+SS7MsgISUP::~SS7MsgISUP()
+{
+    if (m_lazyParams) {
+	TelEngine::destruct(m_lazyParams->decoder);
+	delete m_lazyParams;
+    }
+}
+
 const TokenDict* SS7MsgISUP::names()
 {
     return s_names;
 }
 
+bool SS7MsgISUP::hasParam(Parameters param) const
+{
+    // the located parameters are kept until the message is destroyed
+    if (m_lazy && m_lazyParams) {
+	const IsupParamTable& table = m_lazyParams->table;
+	for (unsigned int i = 0; i < table.count; i++) {
+	    if (table.params[i].type == param)
+		return true;
+	}
+	return false;
+    }
+    const IsupParam* desc = getParamDesc(param);
+    return desc && params().getParam(s_index.m_names[param & 0xff]);
+}
+
+// Decode the parameters located by the controller when the message was received
+// Messages are decoded in parallel, only threads using the same message wait
+void SS7MsgISUP::decodeParams() const
+{
+    IsupLazyParams* lazy = m_lazyParams;
+    if (!lazy) {
+	m_lazy = false;
+	return;
+    }
+    if (!ISUP_CAS(lazy->decoding,0,1)) {
+	// another thread is decoding this message
+	while (m_lazy)
+	    Thread::yield();
+	return;
+    }
+    IsupDecoder* decoder = lazy->decoder;
+    lazy->decoder = 0;
+    if (decoder) {
+	// the controller stays alive while its pointer is set and we hold the lock
+	RLock lock(decoder->m_lock);
+	const SS7ISUP* isup = decoder->m_isup;
+	XDebug(isup,DebugAll,"Decoding msg=%s len=%u on first use [%p]",
+	    name(),lazy->length,isup);
+	addMessageType(m_params,lazy->pcType,name(),String::empty());
+	::decodeParams(isup,m_params,lazy->table,lazy->data,String::empty());
+	lock.drop();
+	TelEngine::destruct(decoder);
+    }
+    // readers not locking must see the complete list before the flag
+    ISUP_BARRIER();
+    m_lazy = false;
+}
+
 void SS7MsgISUP::toString(String& dest, const SS7Label& label, bool params,
 	const void* raw, unsigned int rawLen) const
 {
@@ -2133,9 +2597,10 @@ void SS7MsgISUP::toString(String& dest, const SS7Label& label, bool params,
 	dest << "  " << tmp;
     }
     if (params) {
-	unsigned int n = m_params.length();
+	const NamedList& list = this->params();
+	unsigned int n = list.length();
 	for (unsigned int i = 0; i < n; i++) {
-	    NamedString* s = m_params.getParam(i);
+	    NamedString* s = list.getParam(i);
 	    if (s)
 		dest << "\r\n  " << s->name() << "='" << *s << "'";
 	}
@@ -2220,6 +2685,105 @@ static void setCallsTerminate(ObjList& lst, bool gracefully, const char* reason
     }
 }
 
+namespace TelEngine {
+
+// Calls indexed by circuit code
+// Slots are kept in spans of ISUP_INDEX_SPAN circuits allocated when first used
+// Each span is guarded by one of ISUP_INDEX_LOCKS mutexes so messages for
+//  different circuit ranges don't contend with each other or with the controller
+class SS7ISUPCallIndex : public GenObject
+{
+public:
+    SS7ISUPCallIndex();
+    virtual ~SS7ISUPCallIndex();
+    static inline bool handles(unsigned int cic)
+	{ return cic < ISUP_INDEX_MAX; }
+    SS7ISUPCall* find(unsigned int cic);
+    void find(unsigned int cic, RefPointer<SS7ISUPCall>& call);
+    void set(SS7ISUPCall* call, unsigned int cic, unsigned int oldCic);
+    void reset(SS7ISUPCall* call, unsigned int cic);
+    void clear();
+private:
+    inline Mutex& mutex(unsigned int cic)
+	{ return m_mutex[(cic / ISUP_INDEX_SPAN) % ISUP_INDEX_LOCKS]; }
+    inline SS7ISUPCall** slot(unsigned int cic) const {
+	    SS7ISUPCall** span = m_spans[cic / ISUP_INDEX_SPAN];
+	    return span ? span + (cic % ISUP_INDEX_SPAN) : 0;
+	}
+    SS7ISUPCall** m_spans[ISUP_INDEX_MAX / ISUP_INDEX_SPAN];
+    Mutex m_mutex[ISUP_INDEX_LOCKS];
+};
+
+}; // namespace TelEngine
+
+SS7ISUPCallIndex::SS7ISUPCallIndex()
+{
+    ::memset(m_spans,0,sizeof(m_spans));
+}
+
+SS7ISUPCallIndex::~SS7ISUPCallIndex()
+{
+    for (unsigned int i = 0; i < ISUP_INDEX_MAX / ISUP_INDEX_SPAN; i++)
+	delete[] m_spans[i];
+}
+
+// Find a call, the caller must prevent its destruction
+SS7ISUPCall* SS7ISUPCallIndex::find(unsigned int cic)
+{
+    Lock lck(mutex(cic));
+    SS7ISUPCall** s = slot(cic);
+    SS7ISUPCall* call = s ? *s : 0;
+    return (call && call->id() == cic) ? call : 0;
+}
+
+// Find and reference a call
+// Calls remove themselves from index with the span locked before being destroyed
+void SS7ISUPCallIndex::find(unsigned int cic, RefPointer<SS7ISUPCall>& call)
+{
+    Lock lck(mutex(cic));
+    SS7ISUPCall** s = slot(cic);
+    if (s && *s && (*s)->id() == cic)
+	call = *s;
+    else
+	call = 0;
+}
+
+// Index a call by a new code, remove it from the old one
+void SS7ISUPCallIndex::set(SS7ISUPCall* call, unsigned int cic, unsigned int oldCic)
+{
+    if (oldCic && oldCic != cic)
+	reset(call,oldCic);
+    if (!(cic && handles(cic)))
+	return;
+    Lock lck(mutex(cic));
+    SS7ISUPCall**& span = m_spans[cic / ISUP_INDEX_SPAN];
+    if (!span) {
+	span = new SS7ISUPCall*[ISUP_INDEX_SPAN];
+	::memset(span,0,ISUP_INDEX_SPAN * sizeof(SS7ISUPCall*));
+    }
+    span[cic % ISUP_INDEX_SPAN] = call;
+}
+
+// Remove a call from index if still indexed by the given code
+void SS7ISUPCallIndex::reset(SS7ISUPCall* call, unsigned int cic)
+{
+    if (!(cic && handles(cic)))
+	return;
+    Lock lck(mutex(cic));
+    SS7ISUPCall** s = slot(cic);
+    if (s && *s == call)
+	*s = 0;
+}
+
+void SS7ISUPCallIndex::clear()
+{
+    for (unsigned int i = 0; i < ISUP_INDEX_MAX / ISUP_INDEX_SPAN; i++) {
+	Lock lck(mutex(i * ISUP_INDEX_SPAN));
+	if (m_spans[i])
+	    ::memset(m_spans[i],0,ISUP_INDEX_SPAN * sizeof(SS7ISUPCall*));
+    }
+}
+
 
 /**
  * SS7ISUPCall
@@ -2231,6 +2795,7 @@ SS7ISUPCall::SS7ISUPCall(SS7ISUP* controller, SignallingCircuit* cic,
     m_state(Null),
     m_testCall(testCall),
     m_circuit(cic),
+    m_indexCic(0),
     m_cicRange(range),
     m_terminate(false),
     m_gracefully(true),
@@ -2276,6 +2841,8 @@ SS7ISUPCall::SS7ISUPCall(SS7ISUP* controller, SignallingCircuit* cic,
 
 SS7ISUPCall::~SS7ISUPCall()
 {
+    if (isup())
+	isup()->unindexCall(this);
     TelEngine::destruct(m_iamMsg);
     TelEngine::destruct(m_sgmMsg);
     const char* timeout = 0;
@@ -2355,7 +2922,7 @@ SignallingEvent* SS7ISUPCall::getEvent(const Time& when)
 	}
 	// Process received messages
 	msg = static_cast<SS7MsgISUP*>(dequeue());
-	if (msg && validMsgState(false,msg->type(),(msg->params().getParam(YSTRING("BackwardCallIndicators")) != 0)))
+	if (msg && validMsgState(false,msg->type(),msg->hasParam(SS7MsgISUP::BackwardCallIndicators)))
 	    switch (msg->type()) {
 		case SS7MsgISUP::IAM:
 		case SS7MsgISUP::CCR:
@@ -2490,6 +3057,22 @@ SignallingEvent* SS7ISUPCall::getEvent(const Time& when)
     return m_lastEvent;
 }
 
+// Check if getEvent() has anything to do
+// Timers are checked the same way getEvent() checks them
+bool SS7ISUPCall::eventPending(const Time& when) const
+{
+    if (m_lastEvent || m_state == Released)
+	return false;
+    if (m_terminate || m_sgmMsg || queued() || (m_circuit && m_circuit->hasEvents()))
+	return true;
+    // getEvent() resets the overlapped flag after leaving Setup state
+    if (m_overlap && m_state > Setup)
+	return true;
+    u_int64_t msec = when.msec();
+    return m_iamTimer.timeout(msec) || m_contTimer.timeout(msec) ||
+	m_relTimer.timeout(msec) || m_anmTimer.timeout(msec);
+}
+
 // Helper that copies all parameters starting with a capital letter
 static void copyUpper(NamedList& dest, const NamedList& src)
 {
@@ -2711,6 +3294,8 @@ bool SS7ISUPCall::replaceCircuit(SignallingCircuit* circuit, SS7MsgISUP* msg)
     if (controller())
 	controller()->releaseCircuit(m_circuit);
     m_circuit = circuit;
+    if (isup())
+	isup()->indexCall(this);
     Debug(isup(),DebugNote,"Call(%u). Circuit replaced by %u [%p]",oldId,id(),this);
     m_circuitChanged = true;
     return transmitIAM();
@@ -3330,6 +3915,8 @@ SS7ISUP::SS7ISUP(const NamedList& params, unsigned char sio)
       m_t21Interval(300000),             // Q.764 T21 (CGU global) 5..15 minutes
       m_t27Interval(ISUP_T27_DEFVAL),    // Q.764 T27 4 minutes
       m_t34Interval(ISUP_T34_DEFVAL),    // Q.764 T34 2..4 seconds
+      m_callIndex(new SS7ISUPCallIndex),
+      m_decoder(new IsupDecoder(this)),
       m_uptTimer(0),
       m_userPartAvail(true),
       m_uptMessage(SS7MsgISUP::UPT),
@@ -3445,6 +4032,7 @@ SS7ISUP::SS7ISUP(const NamedList& params, unsigned char sio)
 
     setDebug(params.getBoolValue(YSTRING("print-messages"),false),
 	params.getBoolValue(YSTRING("extended-debug"),false));
+    timerDriven(true);
 
     if (debugAt(DebugInfo)) {
 	String s;
@@ -3480,6 +4068,7 @@ SS7ISUP::~SS7ISUP()
     cleanup();
     if (m_remotePoint)
 	m_remotePoint->destruct();
+    TelEngine::destruct(m_callIndex);
     Debug(this,DebugInfo,"ISUP Call Controller destroyed [%p]",this);
 }
 
@@ -3552,6 +4141,9 @@ void SS7ISUP::attach(SS7Layer3* network)
 {
     SS7Layer4::attach(network);
     m_l3LinkUp = network && network->operational();
+    // timers are not handled while the link is down, check them now
+    if (m_l3LinkUp)
+	tickRequest();
 }
 
 // Append a point code to the list of point codes serviced by this controller
@@ -3716,6 +4308,7 @@ SignallingCall* SS7ISUP::call(SignallingMessage* msg, String& reason)
 	call = new SS7ISUPCall(this,cic,*m_defPoint,dest,true,sls,range);
 	call->ref();
 	m_calls.append(call);
+	indexCall(call);
 	SignallingEvent* event = new SignallingEvent(SignallingEvent::NewCall,msg,call);
 	// (re)start RSC timer if not currently reseting
 	if (!m_rscCic && m_rscTimer.interval())
@@ -3810,13 +4403,22 @@ void SS7ISUP::cleanup(const char* reason)
     unlock();
     setCallsTerminate(terminate,true,reason);
     clearCalls();
+    m_callIndex->clear();
 }
 
 // Remove all links with other layers. Disposes the memory
 void SS7ISUP::destroyed()
 {
+    // messages not decoded yet may outlive us
+    if (m_decoder) {
+	m_decoder->m_lock.writeLock();
+	m_decoder->m_isup = 0;
+	m_decoder->m_lock.unlock();
+	TelEngine::destruct(m_decoder);
+    }
     lock();
     clearCalls();
+    m_callIndex->clear();
     unlock();
     SignallingCallControl::attach(0);
     SS7Layer4::destroyed();
@@ -3847,7 +4449,11 @@ static bool findPendingMsgTimerLock(ObjList& list, unsigned int code)
 void SS7ISUP::timerTick(const Time& when)
 {
     Lock mylock(this,SignallingEngine::maxLockWait());
-    if (!(mylock.locked() && m_l3LinkUp && circuits()))
+    if (!mylock.locked()) {
+	tickRequest();
+	return;
+    }
+    if (!(m_l3LinkUp && circuits()))
 	return;
 
     // Test remote user part
@@ -4032,6 +4638,8 @@ void SS7ISUP::timerTick(const Time& when)
 	    Debug(this,DebugMild,"Circuit reset timed out for cic=%u",m_rscCic->code());
 	    m_rscCic->resetLock(SignallingCircuit::Resetting);
 	    releaseCircuit(m_rscCic);
+	    // pick the next circuit to reset on next tick
+	    tickRequest();
 	    return;
 	}
     }
@@ -4218,6 +4826,9 @@ void SS7ISUP::notify(SS7Layer3* link, int sls)
 	m_uptTimer.stop();
 	m_userPartAvail = false;
     }
+    // let timerTick() resume or restart the user part test
+    if (m_l3LinkUp)
+	tickRequest();
     Debug(this,DebugInfo,
 	"L3 '%s' sls=%d is %soperational.%s Route is %s. Remote User Part is %savailable",
 	link->toString().safe(),sls,
@@ -4249,54 +4860,35 @@ SS7MSU* SS7ISUP::buildMSU(SS7MsgISUP::Type type, unsigned char sio,
     if (type == SS7MsgISUP::PAM && params)
 	return encodeRawMessage(type,sio,label,cic,(*params)[YSTRING("PassAlong")]);
     // see what mandatory parameters we should put in this message
-    const MsgParams* msgParams = getIsupParams(label.type(),type);
-    if (!msgParams) {
-	if (!hasOptionalOnly(type)) {
-	    const char* name = SS7MsgISUP::lookup(type);
-	    if (name)
-		Debug(this,DebugWarn,"No parameter table for ISUP MSU type %s [%p]",name,this);
-	    else
-		Debug(this,DebugWarn,"Cannot create ISUP MSU type 0x%02x [%p]",type,this);
-	    return 0;
-	}
-	msgParams = &s_compatibility;
-    }
-    unsigned int len = m_cicLen + 1;
-
-    const SS7MsgISUP::Parameters* plist = msgParams->params;
-    SS7MsgISUP::Parameters ptype;
-    // first add the length of mandatory fixed parameters
-    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    // this is fatal as we don't know the length
-	    Debug(this,DebugGoOn,"Missing description of fixed ISUP parameter 0x%02x [%p]",ptype,this);
-	    return 0;
+    const IsupTemplate* tpl = s_templates.find(label.type(),type);
+    IsupTemplate layout;
+    if (!tpl) {
+	const MsgParams* msgParams = getIsupParams(label.type(),type);
+	if (!msgParams) {
+	    if (!hasOptionalOnly(type)) {
+		const char* name = SS7MsgISUP::lookup(type);
+		if (name)
+		    Debug(this,DebugWarn,"No parameter table for ISUP MSU type %s [%p]",name,this);
+		else
+		    Debug(this,DebugWarn,"Cannot create ISUP MSU type 0x%02x [%p]",type,this);
+		return 0;
+	    }
+	    msgParams = &s_compatibility;
 	}
-	if (!param->size) {
-	    Debug(this,DebugGoOn,"Invalid (variable) description of fixed ISUP parameter 0x%02x [%p]",ptype,this);
+	if (!buildTemplate(this,layout,msgParams))
 	    return 0;
-	}
-	len += param->size;
-    }
-    // initialize the pointer array offset just past the mandatory fixed part
-    unsigned int ptr = label.length() + 1 + len;
-    // then add one pointer octet to each mandatory variable parameter
-    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    // this is fatal as we won't be able to populate later
-	    Debug(this,DebugGoOn,"Missing description of variable ISUP parameter 0x%02x [%p]",ptype,this);
-	    return 0;
-	}
-	if (param->size)
-	    Debug(this,DebugMild,"Invalid (fixed) description of variable ISUP parameter 0x%02x [%p]",ptype,this);
-	len++;
+	tpl = &layout;
     }
-    // finally add a pointer to the optional part only if supported by type
-    if (msgParams->optional)
+    // mandatory fixed parameters, one pointer octet to each mandatory variable
+    //  parameter and a pointer to the optional part only if supported by type
+    unsigned int len = m_cicLen + 1 + tpl->fixedLen + tpl->variableCount;
+    if (tpl->optional)
 	len++;
+    // initialize the pointer array offset just past the mandatory fixed part
+    unsigned int ptr = label.length() + 1 + m_cicLen + 1 + tpl->fixedLen;
     SS7MSU* msu = new SS7MSU(sio,label,0,len);
+    // parameters are appended one by one, don't reallocate for each of them
+    msu->overAlloc(MSU_ALLOC_STEP);
     unsigned char* d = msu->getData(label.length()+1,len);
     unsigned int i = m_cicLen;
     while (i--) {
@@ -4312,38 +4904,33 @@ SS7MSU* SS7ISUP::buildMSU(SS7MsgISUP::Type type, unsigned char sio,
 	    tmp.c_str());
     }
 #endif
-    ObjList exclude;
-    plist = msgParams->params;
+    // values taken by mandatory parameters are left out of the optional part
+    const NamedString* exclude[MAX_MANDATORY_PARAMS];
+    unsigned int excluded = 0;
     String prefix = params->getValue(YSTRING("message-prefix"));
     // first populate with mandatory fixed parameters
-    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    Debug(this,DebugFail,"Stage 2: no description of fixed ISUP parameter 0x%02x [%p]",ptype,this);
-	    continue;
-	}
-	if (!param->size) {
-	    Debug(this,DebugFail,"Stage 2: Invalid (variable) description of fixed ISUP parameter %s [%p]",param->name,this);
-	    continue;
-	}
-	if (!encodeParam(this,*msu,param,params,exclude,prefix,d))
+    for (unsigned int n = 0; n < tpl->fixedCount; n++) {
+	const IsupParam* param = tpl->fixed[n];
+	const NamedString* val = 0;
+	if (!encodeParam(this,*msu,param,params,val,prefix,d))
 	    Debug(this,DebugGoOn,"Could not encode fixed ISUP parameter %s [%p]",param->name,this);
+	if (val)
+	    exclude[excluded++] = val;
 	d += param->size;
     }
     // now populate with mandatory variable parameters
-    for (; (ptype = *plist++) != SS7MsgISUP::EndOfParameters; ptr++) {
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    Debug(this,DebugFail,"Stage 2: no description of variable ISUP parameter 0x%02x [%p]",ptype,this);
-	    continue;
-	}
+    for (unsigned int n = 0; n < tpl->variableCount; n++, ptr++) {
+	const IsupParam* param = tpl->variable[n];
 	if (param->size) {
 	    Debug(this,DebugFail,"Stage 2: Invalid (fixed) description of variable ISUP parameter %s [%p]",param->name,this);
 	    continue;
 	}
 	// remember the offset this parameter will actually get stored
 	len = msu->length();
-	unsigned char size = encodeParam(this,*msu,param,params,exclude,prefix);
+	const NamedString* val = 0;
+	unsigned char size = encodeParam(this,*msu,param,params,val,prefix);
+	if (val)
+	    exclude[excluded++] = val;
 	d = msu->getData(0,len+1);
 	if (!(size && d)) {
 	    Debug(this,DebugGoOn,"Could not encode variable ISUP parameter %s [%p]",param->name,this);
@@ -4357,31 +4944,42 @@ SS7MSU* SS7ISUP::buildMSU(SS7MsgISUP::Type type, unsigned char sio,
 	// store pointer to parameter
 	d[ptr] = len - ptr;
     }
-    if (msgParams->optional && params) {
+    if (tpl->optional && params) {
 	// remember the offset past last mandatory == first optional parameter
 	len = msu->length();
 	// optional parameters are possible - try to set anything left in the message
 	unsigned int n = params->length();
 	for (unsigned int i = 0; i < n; i++) {
 	    NamedString* ns = params->getParam(i);
-	    if (!ns || exclude.find(ns))
-		continue;
-	    if (prefix && !ns->name().startsWith(prefix))
+	    unsigned int e = 0;
+	    while (e < excluded && exclude[e] != ns)
+		e++;
+	    if (!ns || e < excluded)
 		continue;
-	    String tmp(ns->name());
-	    tmp >> prefix.c_str();
-	    static const Regexp s_suffix("\\.[0-9]\\+$");
-	    if (tmp.matches(s_suffix)) {
-		tmp.assign(tmp,tmp.matchOffset());
+	    const char* name = ns->name().c_str();
+	    unsigned int nameLen = ns->name().length();
+	    if (prefix) {
+		if (!ns->name().startsWith(prefix))
+		    continue;
+		name += prefix.length();
+		nameLen -= prefix.length();
+	    }
+	    // strip a numeric index suffix like ".1"
+	    unsigned int l = nameLen;
+	    while (l && name[l - 1] >= '0' && name[l - 1] <= '9')
+		l--;
+	    if (l > 1 && l < nameLen && name[l - 1] == '.') {
+		nameLen = l - 1;
 		// WARNING: HACK - ApplicationTransport does not follow naming convention
-		if (tmp == YSTRING("ApplicationTransport"))
+		if (nameLen == 20 && !::strncmp(name,"ApplicationTransport",20))
 		    continue;
 	    }
-	    const IsupParam* param = getParamDesc(tmp);
+	    const IsupParam* param = s_index.find(name,nameLen);
 	    unsigned char size = 0;
 	    if (param)
 		size = encodeParam(this,*msu,param,ns,params,prefix);
-	    else if (tmp.startSkip("Param_",false)) {
+	    else if (nameLen > 6 && !::strncmp(name,"Param_",6)) {
+		String tmp(name + 6,nameLen - 6);
 		int val = tmp.toInteger(-1);
 		if (val >= 0 && val <= 255) {
 		    IsupParam p;
@@ -4402,10 +5000,11 @@ SS7MSU* SS7ISUP::buildMSU(SS7MsgISUP::Type type, unsigned char sio,
 	}
 	if (!len) {
 	    // we stored some optional parameters so we need to put the terminator
-	    DataBlock tmp(0,1);
-	    *msu += tmp;
+	    unsigned char eop = 0;
+	    msu->append(&eop,1);
 	}
     }
+    msu->overAlloc(0);
     return msu;
 }
 
@@ -4441,8 +5040,12 @@ bool SS7ISUP::decodeMessage(NamedList& msg,
     SS7MsgISUP::Type msgType, SS7PointCode::Type pcType,
     const unsigned char* paramPtr, unsigned int paramLen)
 {
-    String msgTypeName((int)msgType);
-    const char* msgName = SS7MsgISUP::lookup(msgType,msgTypeName);
+    String msgTypeName;
+    const char* msgName = SS7MsgISUP::lookup(msgType);
+    if (!msgName) {
+	msgTypeName = (int)msgType;
+	msgName = msgTypeName;
+    }
 #ifdef XDEBUG
     String tmp;
     tmp.hexify((void*)paramPtr,paramLen,' ');
@@ -4454,8 +5057,9 @@ bool SS7ISUP::decodeMessage(NamedList& msg,
 #endif
 
     // see what parameters we expect for this message
-    const MsgParams* params = getIsupParams(pcType,msgType);
-    if (!params) {
+    const IsupTemplate* tpl = s_templates.find(pcType,msgType);
+    const MsgParams* params = tpl ? 0 : getIsupParams(pcType,msgType);
+    if (!(tpl || params)) {
 	if (hasOptionalOnly(msgType)) {
 	    Debug(this,DebugNote,"Unsupported message %s, decoding compatibility [%p]",msgName,this);
 	    params = &s_compatibility;
@@ -4475,19 +5079,7 @@ bool SS7ISUP::decodeMessage(NamedList& msg,
     String prefix = msg.getValue(YSTRING("message-prefix"));
 
     // Add protocol and message type
-    if (!msg.getValue(prefix+"protocol-type")) {
-	switch (pcType) {
-	    case SS7PointCode::ITU:
-		msg.setParam(prefix+"protocol-type","itu-t");
-		break;
-	    case SS7PointCode::ANSI:
-	    case SS7PointCode::ANSI8:
-		msg.setParam(prefix+"protocol-type","ansi");
-		break;
-	    default: ;
-	}
-    }
-    msg.addParam(prefix+"message-type",msgName);
+    addMessageType(msg,pcType,msgName,prefix);
 
     // Special decoder for PAM
     if (msgType == SS7MsgISUP::PAM) {
@@ -4505,151 +5097,58 @@ bool SS7ISUP::decodeMessage(NamedList& msg,
 	return true;
     }
 
-    String unsupported;
-    const SS7MsgISUP::Parameters* plist = params->params;
-    SS7MsgISUP::Parameters ptype;
-    // first decode any mandatory fixed parameters the message should have
-    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    // this is fatal as we don't know the length
-	    Debug(this,DebugGoOn,"Missing description of fixed ISUP parameter 0x%02x [%p]",ptype,this);
-	    return false;
-	}
-	if (!param->size) {
-	    Debug(this,DebugGoOn,"Invalid (variable) description of fixed ISUP parameter %s [%p]",param->name,this);
-	    return false;
-	}
-	if (paramLen < param->size) {
-	    Debug(this,DebugWarn,"Truncated ISUP message! [%p]",this);
+    IsupTemplate layout;
+    if (!tpl) {
+	if (!buildTemplate(this,layout,params))
 	    return false;
-	}
-	if (!decodeParam(this,msg,param,paramPtr,param->size,prefix)) {
-	    Debug(this,DebugWarn,"Could not decode fixed ISUP parameter %s [%p]",param->name,this);
-	    decodeRaw(this,msg,param,paramPtr,param->size,prefix);
-	    SignallingUtils::appendFlag(unsupported,param->name);
-	}
-	paramPtr += param->size;
-	paramLen -= param->size;
-    } // while ((ptype = *plist++)...
-    bool mustWarn = true;
-    // next decode any mandatory variable parameters the message should have
-    while ((ptype = *plist++) != SS7MsgISUP::EndOfParameters) {
-	mustWarn = false;
-	const IsupParam* param = getParamDesc(ptype);
-	if (!param) {
-	    // we could skip over unknown mandatory variable length but it's still bad
-	    Debug(this,DebugGoOn,"Missing description of variable ISUP parameter 0x%02x [%p]",ptype,this);
-	    return false;
-	}
-	if (param->size)
-	    Debug(this,DebugMild,"Invalid (fixed) description of variable ISUP parameter %s [%p]",param->name,this);
-	unsigned int offs = paramPtr[0];
-	if ((offs < 1) || (offs >= paramLen)) {
-	    Debug(this,DebugWarn,"Invalid offset %u (len=%u) ISUP parameter %s [%p]",
-		offs,paramLen,param->name,this);
-	    return false;
-	}
-	unsigned int size = paramPtr[offs];
-	if ((size < 1) || (offs+size >= paramLen)) {
-	    Debug(this,DebugWarn,"Invalid size %u (ofs=%u, len=%u) ISUP parameter %s [%p]",
-		size,offs,paramLen,param->name,this);
-	    return false;
-	}
-	if (!decodeParam(this,msg,param,paramPtr+offs+1,size,prefix)) {
-	    Debug(this,DebugWarn,"Could not decode variable ISUP parameter %s (size=%u) [%p]",
-		param->name,size,this);
-	    decodeRaw(this,msg,param,paramPtr+offs+1,size,prefix);
-	    SignallingUtils::appendFlag(unsupported,param->name);
-	}
-	paramPtr++;
-	paramLen--;
-    } // while ((ptype = *plist++)...
-    // now decode the optional parameters if the message supports them
-    if (params->optional) {
-	unsigned int offs = paramLen ? paramPtr[0] : 0;
-	if (offs >= paramLen) {
-	    if (paramLen) {
-		Debug(this,DebugWarn,"Invalid ISUP optional offset %u (len=%u) [%p]",
-		    offs,paramLen,this);
-		return false;
-	    }
-	    Debug(this,DebugMild,"ISUP message %s lacking optional parameters [%p]",
-		msgName,this);
-	}
-	else if (offs) {
-	    mustWarn = true;
-	    // advance pointer past mandatory parameters
-	    paramPtr += offs;
-	    paramLen -= offs;
-	    while (paramLen) {
-		ptype = (SS7MsgISUP::Parameters)(*paramPtr++);
-		paramLen--;
-		if (ptype == SS7MsgISUP::EndOfParameters)
-		    break;
-		if (paramLen < 2) {
-		    Debug(this,DebugWarn,"Only %u octets while decoding optional ISUP parameter 0x%02x [%p]",
-			paramLen,ptype,this);
-		    return false;
-		}
-		unsigned int size = *paramPtr++;
-		paramLen--;
-		if ((size < 1) || (size >= paramLen)) {
-		    Debug(this,DebugWarn,"Invalid size %u (len=%u) ISUP optional parameter 0x%02x [%p]",
-			size,paramLen,ptype,this);
-		    return false;
-		}
-		const IsupParam* param = getParamDesc(ptype);
-		if (!param) {
-		    Debug(this,DebugMild,"Unknown optional ISUP parameter 0x%02x (size=%u) [%p]",ptype,size,this);
-		    decodeRawParam(this,msg,ptype,paramPtr,size,prefix);
-		    SignallingUtils::appendFlag(unsupported,String((unsigned int)ptype));
-		}
-		else if (!decodeParam(this,msg,param,paramPtr,size,prefix)) {
-		    Debug(this,DebugWarn,"Could not decode optional ISUP parameter %s (size=%u) [%p]",param->name,size,this);
-		    decodeRaw(this,msg,param,paramPtr,size,prefix);
-		    SignallingUtils::appendFlag(unsupported,param->name);
-		}
-		paramPtr += size;
-		paramLen -= size;
-	    } // while (paramLen)
-	} // else if (offs)
-	else
-	    paramLen = 0;
+	tpl = &layout;
     }
-    if (unsupported)
-	msg.addParam(prefix + "parameters-unsupported",unsupported);
-    String release,cnf,npRelease;
-    String pCompat(prefix + "ParameterCompatInformation.");
-    unsigned int n = msg.length();
-    for (unsigned int i = 0; i < n; i++) {
-	NamedString* ns = msg.getParam(i);
-	if (!(ns && ns->name().startsWith(pCompat) && !ns->name().endsWith(".more")))
-	    continue;
-	ObjList* l = ns->split(',',false);
-	for (ObjList* ol = l->skipNull(); ol; ol = ol->skipNext()) {
-	    String* s = static_cast<String*>(ol->get());
-	    if (*s == YSTRING("release")) {
-		SignallingUtils::appendFlag(release,ns->name().substr(pCompat.length()));
-		break;
-	    }
-	    if (*s == YSTRING("cnf"))
-		SignallingUtils::appendFlag(cnf,ns->name().substr(pCompat.length()));
-	    if (*s == YSTRING("nopass-release"))
-		SignallingUtils::appendFlag(npRelease,ns->name().substr(pCompat.length()));
+    IsupParamTable table;
+    if (!scanParams(this,table,*tpl,msgName,msgType,paramPtr,paramLen))
+	return false;
+    decodeParams(this,msg,table,paramPtr,prefix);
+    return true;
+}
+
+// Build a message with the parameters located, decode them when first used
+SS7MsgISUP* SS7ISUP::decodeMessage(SS7MsgISUP::Type msgType, unsigned int cic,
+    SS7PointCode::Type pcType, const unsigned char* paramPtr, unsigned int paramLen)
+{
+    SS7MsgISUP* msg = new SS7MsgISUP(msgType,cic);
+    if (!SS7MsgISUP::lookup(msgType)) {
+	String tmp;
+	tmp.hexify(&msgType,1);
+	msg->params().assign("Message_" + tmp);
+    }
+    // Locate the parameters now, most messages are dropped or forwarded
+    //  before all of them are used so decode them on first access
+    const MsgParams* params = (m_decoder && msgType != SS7MsgISUP::CRG && paramLen <= ISUP_LAZY_LENGTH) ?
+	getIsupParams(pcType,msgType) : 0;
+    if (params) {
+	const IsupTemplate* tpl = s_templates.find(pcType,msgType);
+	IsupTemplate layout;
+	if (!tpl && buildTemplate(this,layout,params))
+	    tpl = &layout;
+	IsupLazyParams* lazy = tpl ? new IsupLazyParams : 0;
+	if (!(lazy && scanParams(this,lazy->table,*tpl,msg->name(),msgType,paramPtr,paramLen))) {
+	    delete lazy;
+	    TelEngine::destruct(msg);
+	    return 0;
 	}
-	TelEngine::destruct(l);
+	m_decoder->ref();
+	lazy->decoding = 0;
+	lazy->decoder = m_decoder;
+	lazy->pcType = pcType;
+	lazy->length = paramLen;
+	::memcpy(lazy->data,paramPtr,paramLen);
+	msg->m_lazyParams = lazy;
+	msg->m_lazy = true;
     }
-    if (release)
-	msg.setParam(prefix + "parameters-unhandled-release",release);
-    if (cnf)
-	msg.setParam(prefix + "parameters-unhandled-cnf",cnf);
-    if (npRelease)
-	msg.setParam(prefix + "parameters-nopass-release",npRelease);
-    if (paramLen && mustWarn)
-	Debug(this,DebugWarn,"Got %u garbage octets after message type 0x%02x [%p]",
-	    paramLen,msgType,this);
-    return true;
+    else if (!decodeMessage(msg->params(),msgType,pcType,paramPtr,paramLen)) {
+	TelEngine::destruct(msg);
+	return 0;
+    }
+    return msg;
 }
 
 // Encode an ISUP list of parameters to a buffer
@@ -4762,16 +5261,9 @@ bool SS7ISUP::processMSU(SS7MsgISUP::Type type, unsigned int cic,
     XDebug(this,DebugAll,"SS7ISUP::processMSU(%u,%u,%p,%u,%p,%p,%d) [%p]",
 	type,cic,paramPtr,paramLen,&label,network,sls,this);
 
-    SS7MsgISUP* msg = new SS7MsgISUP(type,cic);
-    if (!SS7MsgISUP::lookup(type)) {
-	String tmp;
-	tmp.hexify(&type,1);
-	msg->params().assign("Message_" + tmp);
-    }
-    if (!decodeMessage(msg->params(),type,label.type(),paramPtr,paramLen)) {
-	TelEngine::destruct(msg);
+    SS7MsgISUP* msg = decodeMessage(type,cic,label.type(),paramPtr,paramLen);
+    if (!msg)
 	return false;
-    }
 
     if (m_printMsg && debugAt(DebugInfo)) {
 	String tmp;
@@ -5068,6 +5560,7 @@ void SS7ISUP::processCallMsg(SS7MsgISUP* msg, const SS7Label& label, int sls)
 	    call = new SS7ISUPCall(this,circuit,label.dpc(),label.opc(),false,label.sls(),
 		0,msg->type() == SS7MsgISUP::CCR);
 	    m_calls.append(call);
+	    indexCall(call);
 	    break;
 	}
 	// Congestion: send REL
@@ -5581,6 +6074,8 @@ bool SS7ISUP::blockCircuit(unsigned int cic, bool block, bool remote, bool hwFai
 
 SS7ISUPCall* SS7ISUP::findCall(unsigned int cic)
 {
+    if (SS7ISUPCallIndex::handles(cic))
+	return m_callIndex->find(cic);
     for (ObjList* o = m_calls.skipNull(); o; o = o->skipNext()) {
 	SS7ISUPCall* call = static_cast<SS7ISUPCall*>(o->get());
 	if (call->id() == cic)
@@ -5589,6 +6084,34 @@ SS7ISUPCall* SS7ISUP::findCall(unsigned int cic)
     return 0;
 }
 
+// Indexed circuits are looked up without locking the controller
+void SS7ISUP::findCall(unsigned int cic, RefPointer<SS7ISUPCall>& call)
+{
+    if (SS7ISUPCallIndex::handles(cic)) {
+	m_callIndex->find(cic,call);
+	return;
+    }
+    Lock mylock(this);
+    call = findCall(cic);
+}
+
+void SS7ISUP::indexCall(SS7ISUPCall* call)
+{
+    if (!(call && m_callIndex))
+	return;
+    unsigned int cic = call->id();
+    m_callIndex->set(call,cic,call->m_indexCic);
+    call->m_indexCic = cic;
+}
+
+void SS7ISUP::unindexCall(SS7ISUPCall* call)
+{
+    if (!(call && m_callIndex))
+	return;
+    m_callIndex->reset(call,call->m_indexCic);
+    call->m_indexCic = 0;
+}
+
 // Utility used in sendLocalLock()
 // Check if a circuit has lock change flag set and can be locked (not busy)
 static inline bool canLock(SignallingCircuit* cic, bool hw)
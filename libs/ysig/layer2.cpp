@@ -34,6 +34,13 @@ static const TokenDict s_dict_prio[] = {
     { 0, 0 }
 };
 
+// Record a timeout given in usec in the signalling timer wheel
+static inline u_int64_t wheelTime(u_int64_t usec)
+{
+    SignallingTimer::schedule(usec / 1000);
+    return usec;
+}
+
 static const TokenDict s_dict_netind[] = {
     { "international",      SS7MSU::International },
     { "spareinternational", SS7MSU::SpareInternational },
@@ -160,8 +167,11 @@ void SS7Layer2::attach(SS7L2User* l2user)
 void SS7Layer2::timerTick(const Time& when)
 {
     SignallingComponent::timerTick(when);
-    if (!m_l2userMutex.lock(SignallingEngine::maxLockWait()))
+    if (!m_l2userMutex.lock(SignallingEngine::maxLockWait())) {
+	// try again soon, a notification may be pending
+	tickRequest();
 	return;
+    }
     RefPointer<SS7L2User> tmp = m_notify ? m_l2user : 0;
     m_notify = false;
     m_l2userMutex.unlock();
@@ -187,6 +197,7 @@ void SS7Layer2::notify()
     m_l2userMutex.lock();
     m_notify = true;
     m_l2userMutex.unlock();
+    tickRequest();
     if (doNotify && engine()) {
 	String text(statusName());
 	if (wasUp)
@@ -311,6 +322,7 @@ SS7MTP2::SS7MTP2(const NamedList& params, unsigned int status)
     else if (m_maxErrors > 256)
 	m_maxErrors = 256;
     setDumper(params.getValue(YSTRING("layer2dump")));
+    timerDriven(true);
 }
 
 SS7MTP2::~SS7MTP2()
@@ -331,6 +343,7 @@ void SS7MTP2::setLocalStatus(unsigned int status)
 	statusName(m_lStatus,true),statusName(status,true),this);
     m_lStatus = status;
     m_fillTime = 0;
+    tickRequest();
 }
 
 void SS7MTP2::setRemoteStatus(unsigned int status)
@@ -474,8 +487,10 @@ bool SS7MTP2::notify(SignallingInterface::Notification event)
 void SS7MTP2::timerTick(const Time& when)
 {
     SS7Layer2::timerTick(when);
-    if (!lock(SignallingEngine::maxLockWait()))
+    if (!lock(SignallingEngine::maxLockWait())) {
+	tickRequest();
 	return;
+    }
     bool tout = m_interval && (when >= m_interval);
     if (tout)
 	m_interval = 0;
@@ -546,7 +561,7 @@ void SS7MTP2::timerTick(const Time& when)
 		c++;
 	    }
 	    if (c) {
-		m_resend = Time::now() + (1000 * m_resendMs);
+		m_resend = wheelTime(Time::now() + (1000 * m_resendMs));
 		m_fillTime = 0;
 		Debug(this,DebugInfo,"Resent %d packets, last bsn=%u/%u [%p]",
 		    c,m_lastBsn,m_lastBib,this);
@@ -618,9 +633,9 @@ bool SS7MTP2::transmitMSU(const SS7MSU& msu)
 	transmitFISU();
     }
     if (!m_abort)
-	m_abort = Time::now() + (1000 * m_abortMs);
+	m_abort = wheelTime(Time::now() + (1000 * m_abortMs));
     if (!m_resend)
-	m_resend = Time::now() + (1000 * m_resendMs);
+	m_resend = wheelTime(Time::now() + (1000 * m_resendMs));
     return ok;
 }
 
@@ -717,12 +732,12 @@ bool SS7MTP2::receivedPacket(const DataBlock& packet)
 	    Debug(this,DebugNote,"Remote requested resend remote bsn=%u local fsn=%u [%p]",
 		bsn,m_fsn,this);
 	    m_lastBib = bib;
-	    m_resend = Time::now();
+	    m_resend = wheelTime(Time::now());
 	}
 	unqueueAck(bsn);
 	// end proving now if received MSU with correct sequence
 	if (m_interval && (diff == 1))
-	    m_interval = Time::now();
+	    m_interval = wheelTime(Time::now());
     }
     else {
 	// keep sequence numbers in sync with the remote
@@ -731,6 +746,7 @@ bool SS7MTP2::receivedPacket(const DataBlock& packet)
 	m_lastBsn = bsn;
 	m_lastBib = bib;
 	m_fillTime = 0;
+	tickRequest();
     }
     unlock();
 
@@ -741,6 +757,7 @@ bool SS7MTP2::receivedPacket(const DataBlock& packet)
 	return false;
     m_lastSeqRx = m_bsn = fsn;
     m_fillTime = 0;
+    tickRequest();
     DDebug(this,DebugInfo,"New local bsn=%u/%d fsn=%u/%d [%p]",
 	m_bsn,m_bib,m_fsn,m_fib,this);
     SS7MSU msu((void*)(buf+3),len,false);
@@ -797,7 +814,7 @@ void SS7MTP2::unqueueAck(unsigned char bsn)
     }
     if (c) {
 	DDebug(this,DebugNote,"Unqueued %d packets up to FSN=%u [%p]",c,bsn,this);
-	m_abort = m_resend ? Time::now() + (1000 * m_abortMs) : 0;
+	m_abort = m_resend ? wheelTime(Time::now() + (1000 * m_abortMs)) : 0;
     }
 }
 
@@ -814,8 +831,10 @@ bool SS7MTP2::txPacket(const DataBlock& packet, bool repeat, SignallingInterface
 // Process incoming FISU
 void SS7MTP2::processFISU()
 {
-    if (m_fillLink && !aligned())
+    if (m_fillLink && !aligned()) {
 	m_fillTime = 0;
+	tickRequest();
+    }
 }
 
 // Process incoming LSSU
@@ -876,7 +895,7 @@ bool SS7MTP2::transmitLSSU(unsigned int status)
     DataBlock packet(buf,buf[2]+3,false);
     XDebug(this,DebugAll,"Transmit LSSU with status %s",statusName(buf[3],true));
     bool ok = txPacket(packet,repeat,SignallingInterface::SS7Lssu);
-    m_fillTime = Time::now() + (1000 * m_fillIntervalMs);
+    m_fillTime = wheelTime(Time::now() + (1000 * m_fillIntervalMs));
     unlock();
     packet.clear(false);
     return ok;
@@ -893,7 +912,7 @@ bool SS7MTP2::transmitFISU()
     buf[1] = m_fib ? m_fsn | 0x80 : m_fsn;
     DataBlock packet(buf,3,false);
     bool ok = txPacket(packet,m_fillLink,SignallingInterface::SS7Fisu);
-    m_fillTime = Time::now() + (1000 * m_fillIntervalMs);
+    m_fillTime = wheelTime(Time::now() + (1000 * m_fillIntervalMs));
     unlock();
     packet.clear(false);
     return ok;
@@ -919,7 +938,7 @@ void SS7MTP2::startAlignment(bool emergency)
     m_status = emergency ? EmergencyAlignment : NormalAlignment;
     m_abort = m_resend = 0;
     setLocalStatus(OutOfAlignment);
-    m_interval = Time::now() + 5000000;
+    m_interval = wheelTime(Time::now() + 5000000);
     unlock();
     transmitLSSU();
     SS7Layer2::notify();
@@ -932,7 +951,7 @@ void SS7MTP2::abortAlignment(bool retry)
     if (!retry)
 	m_status = OutOfService;
     setLocalStatus(OutOfService);
-    m_interval = Time::now() + 1000000;
+    m_interval = wheelTime(Time::now() + 1000000);
     m_abort = m_resend = 0;
     m_errors = 0;
     m_bsn = m_fsn = 127;
@@ -954,7 +973,7 @@ bool SS7MTP2::startProving()
     // proving interval is defined in octet transmission times
     u_int64_t interval = emg ? 4096 : 65536;
     // FIXME: assuming 64 kbit/s, 125 usec/octet
-    m_interval = Time::now() + (125 * interval);
+    m_interval = wheelTime(Time::now() + (125 * interval));
     unlock();
     return true;
 }
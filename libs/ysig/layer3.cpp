@@ -22,6 +22,7 @@
 #include "yatesig.h"
 #include <yatephone.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 using namespace TelEngine;
@@ -38,6 +39,130 @@ static const TokenDict s_dict_control[] = {
 
 typedef GenPointer<SS7Layer2> L2Pointer;
 
+#ifdef _WINDOWS
+#define ROUTE_BARRIER() MemoryBarrier()
+#define ROUTE_INC(x) InterlockedIncrement((LONG*)&(x))
+#define ROUTE_DEC(x) InterlockedDecrement((LONG*)&(x))
+#else
+#define ROUTE_BARRIER() __sync_synchronize()
+#define ROUTE_INC(x) __sync_add_and_fetch(&(x),1)
+#define ROUTE_DEC(x) __sync_sub_and_fetch(&(x),1)
+#endif
+
+namespace TelEngine {
+
+// Immutable point code index of a routing table, replaced whenever the table changes
+class SS7RouteIndex : public GenObject
+{
+public:
+    SS7RouteIndex(const ObjList& routes, SS7PointCode::Type type);
+    virtual ~SS7RouteIndex();
+    inline unsigned int count() const
+	{ return m_count; }
+    inline SS7Route* find(unsigned int packed) const
+	{ unsigned int pos = lookup(packed); return pos ? m_routes[pos - 1] : 0; }
+    SS7Route::State state(unsigned int packed, bool checkAdjacent) const;
+private:
+    unsigned int lookup(unsigned int packed) const;
+    unsigned int m_count;
+    SS7Route** m_routes;                 // Routes in table order
+    unsigned int* m_adjacent;            // Table positions of adjacent routes
+    unsigned int m_adjCount;
+    unsigned int* m_direct;              // Position + 1 by point code, short point codes
+    unsigned int m_directSize;
+    unsigned int* m_hash;                // Point code, position + 1 pairs, long point codes
+    unsigned int m_hashMask;
+};
+
+}; // namespace TelEngine
+
+SS7RouteIndex::SS7RouteIndex(const ObjList& routes, SS7PointCode::Type type)
+    : m_count(routes.count()), m_routes(0), m_adjacent(0), m_adjCount(0),
+      m_direct(0), m_directSize(0), m_hash(0), m_hashMask(0)
+{
+    if (!m_count)
+	return;
+    m_routes = new SS7Route*[m_count];
+    m_adjacent = new unsigned int[m_count];
+    unsigned int bits = SS7PointCode::size(type);
+    if (bits && bits <= 16) {
+	m_directSize = 1 << bits;
+	m_direct = new unsigned int[m_directSize];
+	::memset(m_direct,0,m_directSize * sizeof(unsigned int));
+    }
+    else {
+	unsigned int size = 16;
+	while (size < 2 * m_count)
+	    size <<= 1;
+	m_hashMask = size - 1;
+	m_hash = new unsigned int[2 * size];
+	::memset(m_hash,0,2 * size * sizeof(unsigned int));
+    }
+    unsigned int pos = 0;
+    for (const ObjList* o = routes.skipNull(); o; o = o->skipNext()) {
+	SS7Route* route = static_cast<SS7Route*>(o->get());
+	m_routes[pos++] = route;
+	if (!route->priority())
+	    m_adjacent[m_adjCount++] = pos - 1;
+	unsigned int packed = route->packed();
+	if (m_direct) {
+	    // keep the first of duplicate entries like a table scan would
+	    if (packed < m_directSize && !m_direct[packed])
+		m_direct[packed] = pos;
+	    continue;
+	}
+	for (unsigned int i = (packed * 2654435761U) >> 8;; i++) {
+	    unsigned int* e = m_hash + 2 * (i & m_hashMask);
+	    if (!e[1]) {
+		e[0] = packed;
+		e[1] = pos;
+		break;
+	    }
+	    if (e[0] == packed)
+		break;
+	}
+    }
+}
+
+SS7RouteIndex::~SS7RouteIndex()
+{
+    delete[] m_routes;
+    delete[] m_adjacent;
+    delete[] m_direct;
+    delete[] m_hash;
+}
+
+// Retrieve the table position + 1 of a point code, zero if not found
+unsigned int SS7RouteIndex::lookup(unsigned int packed) const
+{
+    if (m_direct)
+	return (packed < m_directSize) ? m_direct[packed] : 0;
+    if (!m_hash)
+	return 0;
+    for (unsigned int i = (packed * 2654435761U) >> 8;; i++) {
+	const unsigned int* e = m_hash + 2 * (i & m_hashMask);
+	if (!e[1])
+	    return 0;
+	if (e[0] == packed)
+	    return e[1];
+    }
+}
+
+SS7Route::State SS7RouteIndex::state(unsigned int packed, bool checkAdjacent) const
+{
+    unsigned int pos = lookup(packed);
+    if (checkAdjacent) {
+	// a prohibited adjacent route listed before the destination hides it
+	unsigned int end = pos ? pos - 1 : m_count;
+	for (unsigned int i = 0; i < m_adjCount && m_adjacent[i] < end; i++) {
+	    SS7Route::State st = m_routes[m_adjacent[i]]->state();
+	    if (!(st & SS7Route::NotProhibited))
+		return st;
+	}
+    }
+    return pos ? m_routes[pos - 1]->state() : SS7Route::Unknown;
+}
+
 void SS7L3User::notify(SS7Layer3* network, int sls)
 {
     Debug(this,DebugStub,"Please implement SS7L3User::notify(%p,%d) [%p]",network,sls,this);
@@ -58,14 +183,26 @@ const ObjList* SS7L3User::getNetRoutes(const SS7Layer3* network, SS7PointCode::T
 SS7Layer3::SS7Layer3(SS7PointCode::Type type)
     : SignallingComponent("SS7Layer3"),
       m_routeMutex(true,"SS7Layer3::route"),
+      m_routeEpoch(0),
       m_l3userMutex(true,"SS7Layer3::l3user"),
       m_l3user(0), m_defNI(SS7MSU::National)
 {
-    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++)
+    m_routeReaders[0] = m_routeReaders[1] = 0;
+    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++) {
 	m_local[i] = 0;
+	m_routeIndex[i] = 0;
+    }
     setType(type);
 }
 
+// Destructor
+SS7Layer3::~SS7Layer3()
+{
+    attach(0);
+    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++)
+	TelEngine::destruct(m_routeIndex[i]);
+}
+
 // Initialize the Layer 3 component
 bool SS7Layer3::initialize(const NamedList* config)
 {
@@ -169,7 +306,8 @@ bool SS7Layer3::buildRoutes(const NamedList& params)
 {
     Lock lock(m_routeMutex);
     for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++) {
-	m_route[i].clear();
+	while (GenObject* route = m_route[i].remove(false))
+	    retireRoute(static_cast<SS7Route*>(route));
 	m_local[i] = 0;
     }
     unsigned int n = params.length();
@@ -228,14 +366,27 @@ bool SS7Layer3::buildRoutes(const NamedList& params)
 	    m_local[type - 1] = packed;
 	    continue;
 	}
-	if (findRoute(type,packed)) {
-	    Debug(this,DebugWarn,"Duplicate route found %s!!",ns->c_str());
-	    continue;
-	}
 	added = true;
 	m_route[(unsigned int)type - 1].append(new SS7Route(packed,type,prio,shift,maxLength));
 	DDebug(this,DebugAll,"Added route '%s'",ns->c_str());
     }
+    updateRouteIndex();
+    // the index keeps the first route to a point code, drop the others
+    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++) {
+	SS7PointCode::Type type = (SS7PointCode::Type)(i + 1);
+	ListIterator iter(m_route[i]);
+	while (SS7Route* route = static_cast<SS7Route*>(iter.get())) {
+	    if (findRoute(type,route->packed()) == route)
+		continue;
+	    String tmp;
+	    tmp << SS7PointCode::lookup(type) << "," << SS7PointCode(type,route->packed());
+	    Debug(this,DebugWarn,"Duplicate route found %s!!",tmp.c_str());
+	    m_route[i].remove(route,false);
+	    retireRoute(route);
+	}
+    }
+    if (!updateRouteIndex())
+	added = false;
     if (!added)
 	Debug(this,DebugMild,"No outgoing routes [%p]",this);
     else
@@ -248,8 +399,7 @@ unsigned int SS7Layer3::getRouteMaxLength(SS7PointCode::Type type, unsigned int
 {
     if (type == SS7PointCode::Other || (unsigned int)type > YSS7_PCTYPE_COUNT || !packedPC)
 	return MAX_TDM_DATA_SIZE;
-    Lock lock(m_routeMutex);
-    SS7Route* route = findRoute(type,packedPC);
+    RefPointer<SS7Route> route = findRoute(type,packedPC);
     if (route)
 	return route->m_maxDataLength;
     return MAX_TDM_DATA_SIZE;
@@ -261,8 +411,7 @@ unsigned int SS7Layer3::getRoutePriority(SS7PointCode::Type type, unsigned int p
 {
     if (type == SS7PointCode::Other || (unsigned int)type > YSS7_PCTYPE_COUNT || !packedPC)
 	return (unsigned int)-1;
-    Lock lock(m_routeMutex);
-    SS7Route* route = findRoute(type,packedPC);
+    RefPointer<SS7Route> route = findRoute(type,packedPC);
     if (route)
 	return route->m_priority;
     return (unsigned int)-1;
@@ -273,15 +422,11 @@ SS7Route::State SS7Layer3::getRouteState(SS7PointCode::Type type, unsigned int p
 {
     if (type == SS7PointCode::Other || (unsigned int)type > YSS7_PCTYPE_COUNT || !packedPC)
 	return SS7Route::Unknown;
-    Lock lock(m_routeMutex);
-    for (ObjList* o = m_route[type-1].skipNull(); o; o = o->skipNext()) {
-	SS7Route* route = static_cast<SS7Route*>(o->get());
-	if (route->packed() == packedPC)
-	    return route->state();
-	if (checkAdjacent && !route->priority() && !(route->state() & SS7Route::NotProhibited))
-	    return route->state();
-    }
-    return SS7Route::Unknown;
+    unsigned int slot = enterRouteIndex();
+    const SS7RouteIndex* idx = m_routeIndex[type - 1];
+    SS7Route::State state = idx ? idx->state(packedPC,checkAdjacent) : SS7Route::Unknown;
+    leaveRouteIndex(slot);
+    return state;
 }
 
 bool SS7Layer3::maintenance(const SS7MSU& msu, const SS7Label& label, int sls)
@@ -440,20 +585,79 @@ bool SS7Layer3::prohibited(unsigned char ssf, const SS7Label& label, int sls)
 }
 
 // Find a route having the specified point code type and packed point code
-SS7Route* SS7Layer3::findRoute(SS7PointCode::Type type, unsigned int packed)
+RefPointer<SS7Route> SS7Layer3::findRoute(SS7PointCode::Type type, unsigned int packed)
 {
     if ((unsigned int)type == 0 || !packed)
 	return 0;
     unsigned int index = (unsigned int)type - 1;
     if (index >= YSS7_PCTYPE_COUNT)
 	return 0;
+    unsigned int slot = enterRouteIndex();
+    const SS7RouteIndex* idx = m_routeIndex[index];
+    // the reference keeps the route after the index is released
+    RefPointer<SS7Route> route = idx ? idx->find(packed) : 0;
+    leaveRouteIndex(slot);
+    return route;
+}
+
+// Count a lock free reader of the indexes in the slot of the current epoch
+unsigned int SS7Layer3::enterRouteIndex()
+{
+    for (;;) {
+	unsigned int slot = m_routeEpoch & 1;
+	ROUTE_INC(m_routeReaders[slot]);
+	// retry if a writer switched the epoch before it could see this reader
+	if ((m_routeEpoch & 1) == slot)
+	    return slot;
+	ROUTE_DEC(m_routeReaders[slot]);
+    }
+}
+
+void SS7Layer3::leaveRouteIndex(unsigned int slot)
+{
+    ROUTE_DEC(m_routeReaders[slot]);
+}
+
+// Publish new indexes of the routing tables, release the retired objects
+unsigned int SS7Layer3::updateRouteIndex()
+{
     Lock lock(m_routeMutex);
-    for (ObjList* o = m_route[index].skipNull(); o; o = o->skipNext()) {
-	SS7Route* route = static_cast<SS7Route*>(o->get());
-	if (route->packed() == packed)
-	    return route;
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++) {
+	SS7RouteIndex* idx = 0;
+	if (m_route[i].skipNull()) {
+	    idx = new SS7RouteIndex(m_route[i],(SS7PointCode::Type)(i + 1));
+	    count += idx->count();
+	}
+	else if (!m_routeIndex[i])
+	    continue;
+	// make sure the index is fully built before readers can see it
+	ROUTE_BARRIER();
+	SS7RouteIndex* old = m_routeIndex[i];
+	m_routeIndex[i] = idx;
+	if (old)
+	    m_routeRetired.append(old);
     }
-    return 0;
+    if (m_routeRetired.skipNull()) {
+	// switch readers to the other slot, wait for those that may see old objects
+	unsigned int slot = m_routeEpoch & 1;
+	ROUTE_BARRIER();
+	m_routeEpoch++;
+	ROUTE_BARRIER();
+	while (m_routeReaders[slot])
+	    Thread::yield();
+	m_routeRetired.clear();
+    }
+    return count;
+}
+
+// Removed routes may still be in use by readers of the current index
+void SS7Layer3::retireRoute(SS7Route* route)
+{
+    if (!route)
+	return;
+    Lock lock(m_routeMutex);
+    m_routeRetired.append(route);
 }
 
 void SS7Layer3::printRoutes()
@@ -570,6 +774,7 @@ SS7MTP3::SS7MTP3(const NamedList& params)
 	    check = 300000;
 	m_checkT2 = 1000 * check;
     }
+    timerDriven(true);
     buildRoutes(params);
     unsigned int n = params.length();
     for (unsigned int p = 0; p < n; p++) {
@@ -1193,8 +1398,10 @@ void SS7MTP3::notify(SS7Layer2* link)
 	    if (link->inhibited(SS7Layer2::Unchecked)) {
 		// initiate a slightly delayed SLTM check
 		u_int64_t t = Time::now() + 100000 + (Random::random() % 200000);
-		if ((link->m_checkTime > t) || (t - 2000000 > link->m_checkTime))
+		if ((link->m_checkTime > t) || (t - 2000000 > link->m_checkTime)) {
 		    link->m_checkTime = t;
+		    SignallingTimer::schedule(t / 1000);
+		}
 	    }
 	}
 	else {
@@ -1272,8 +1479,10 @@ void SS7MTP3::notify(SS7Layer2* link)
 void SS7MTP3::timerTick(const Time& when)
 {
     Lock mylock(this,SignallingEngine::maxLockWait());
-    if (!mylock.locked())
+    if (!mylock.locked()) {
+	tickRequest();
 	return;
+    }
     for (ObjList* o = m_links.skipNull(); o; o = o->skipNext()) {
 	L2Pointer* p = static_cast<L2Pointer*>(o->get());
 	if (!p)
@@ -1311,6 +1520,8 @@ void SS7MTP3::timerTick(const Time& when)
 	    if (l2->m_checkTime || !l2->operational())
 		continue;
 	    l2->m_checkTime = check ? when + check : 0;
+	    if (check)
+		SignallingTimer::schedule(l2->m_checkTime / 1000);
 	    for (unsigned int i = 0; i < YSS7_PCTYPE_COUNT; i++) {
 		SS7PointCode::Type type = (SS7PointCode::Type)(i + 1);
 		unsigned int local = getLocal(type);
@@ -1369,13 +1580,17 @@ void SS7MTP3::linkChecked(int sls, bool remote)
 	    if (l2->inhibited(SS7Layer2::Unchecked)) {
 		// trigger a slightly delayed SLTM check
 		u_int64_t t = Time::now() + 100000;
-		if ((l2->m_checkTime > t + m_checkT1) || (t - 4000000 > l2->m_checkTime))
+		if ((l2->m_checkTime > t + m_checkT1) || (t - 4000000 > l2->m_checkTime)) {
 		    l2->m_checkTime = t;
+		    SignallingTimer::schedule(t / 1000);
+		}
 	    }
 	}
 	else {
 	    l2->m_checkFail = 0;
 	    l2->m_checkTime = m_checkT2 ? Time::now() + m_checkT2 : 0;
+	    if (m_checkT2)
+		SignallingTimer::schedule(l2->m_checkTime / 1000);
 	    if (l2->inhibited(SS7Layer2::Unchecked)) {
 		Debug(this,DebugNote,"Placing link %d '%s' in service [%p]",
 		    sls,l2->toString().c_str(),this);
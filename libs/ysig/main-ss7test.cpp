@@ -41,6 +41,190 @@ public:
 	}
 };
 
+// Translate random global titles with a large built-in GTT table
+static void testGTT(unsigned int entries, unsigned int count)
+{
+    NamedList params("gtt");
+    GTT* gtt = new GTT(params);
+    ObjList table;
+    for (unsigned int i = 0; i < entries; i++) {
+	NamedList* e = new NamedList("");
+	*e << "entry" << i;
+	String gt;
+	gt << (unsigned int)(400000 + i);
+	e->addParam("gt",gt);
+	e->addParam("translation","0");
+	e->addParam("plan","isdn");
+	e->addParam("pointcode",String(100 + (i % 1000)));
+	e->addParam("backup",String(2000 + (i % 1000)));
+	e->addParam("ssn","8");
+	table.append(e);
+    }
+    gtt->setTable(table);
+    NamedList msg("");
+    msg.addParam("CalledPartyAddress.gt","");
+    msg.addParam("CalledPartyAddress.gt.translation","0");
+    msg.addParam("CalledPartyAddress.gt.plan","isdn");
+    msg.addParam("CalledPartyAddress.gt.nature","international");
+    msg.addParam("CalledPartyAddress.ssn","6");
+    msg.addParam("CalledPartyAddress.route","gt");
+    NamedString* gt = msg.getParam("CalledPartyAddress.gt");
+    unsigned int found = 0;
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < count; i++) {
+	*gt = "";
+	*gt << (unsigned int)(400000 + (Random::random() % (entries + entries / 10))) << "123456";
+	NamedList* route = gtt->routeGT(msg,"CalledPartyAddress","CallingPartyAddress");
+	if (route)
+	    found++;
+	TelEngine::destruct(route);
+    }
+    t = Time::now() - t;
+    Output("GTT translated %u of %u GTs with %u entries in " FMT64U " usec, %u/s",
+	found,count,entries,t,(unsigned int)(t ? (u_int64_t)count * 1000000 / t : 0));
+    TelEngine::destruct(gtt);
+}
+
+// Sample ITU ISUP messages (data after the message type) and their parameters
+static const struct {
+    SS7MsgISUP::Type type;
+    const char* data;
+    const char* params[32];
+} s_isupTrace[] = {
+    { SS7MsgISUP::IAM,
+	"00 00 01 0a 03 02 0a 08 83 10 04 12 98 98 89 09 0a 07 03 13 20 31 54 76 98 1d 02 80 90 00",
+	{ "CalledPartyNumber", "40218989989", "CalledPartyNumber.nature", "national",
+	  "CalledPartyNumber.plan", "isdn", "ForwardCallIndicators", "isdn-orig",
+	  "NatureOfConnectionIndicators", "", "CallingPartyCategory", "ordinary",
+	  "TransmissionMediumRequirement", "3.1khz-audio", "CallingPartyNumber", "0213456789",
+	  "CallingPartyNumber.nature", "national", "CallingPartyNumber.restrict", "allowed",
+	  "CallingPartyNumber.screened", "network-provided", "UserServiceInformation", "", 0 } },
+    { SS7MsgISUP::ACM, "12 10 01 29 01 01 00",
+	{ "BackwardCallIndicators", "charge,called-ordinary,isdn-end",
+	  "OptionalBackwardCallIndicators", "inband", 0 } },
+    { SS7MsgISUP::ANM, "00", { 0 } },
+    { SS7MsgISUP::REL, "02 00 02 82 90",
+	{ "CauseIndicators", "normal-clearing", "CauseIndicators.location", "LN",
+	  "CauseIndicators.coding", "CCITT", 0 } },
+    { SS7MsgISUP::RLC, "00", { 0 } },
+    { SS7MsgISUP::Unknown, 0, { 0 } }
+};
+
+// State shared by the threads using the same received message
+struct IsupShared
+{
+    SS7MsgISUP* msg;
+    const String* expected;
+    volatile bool go;
+    volatile int running;
+    volatile int errors;
+};
+
+// Thread reading a message other threads read at the same time
+class IsupReadThread : public Thread
+{
+public:
+    inline IsupReadThread(IsupShared* shared)
+	: Thread("IsupRead"), m_shared(shared)
+	{ }
+    virtual void run();
+private:
+    IsupShared* m_shared;
+};
+
+void IsupReadThread::run()
+{
+    while (!m_shared->go)
+	Thread::yield();
+    String dump;
+    m_shared->msg->params().dump(dump,",");
+    if (dump != *m_shared->expected)
+	__sync_add_and_fetch(&m_shared->errors,1);
+    __sync_sub_and_fetch(&m_shared->running,1);
+}
+
+// Let several threads decode the same received messages on first use
+static void testISUPThreads(SS7ISUP* isup, unsigned int rounds)
+{
+    DataBlock data;
+    data.unHexify(String(s_isupTrace[0].data));
+    NamedList decoded(SS7MsgISUP::lookup(s_isupTrace[0].type));
+    isup->decodeMessage(decoded,s_isupTrace[0].type,SS7PointCode::ITU,(const unsigned char*)data.data(),data.length());
+    String expected;
+    decoded.dump(expected,",");
+    int errors = 0;
+    for (unsigned int r = 0; r < rounds; r++) {
+	SS7MsgISUP* msg = isup->decodeMessage(s_isupTrace[0].type,1,SS7PointCode::ITU,
+	    (const unsigned char*)data.data(),data.length());
+	if (!msg)
+	    return;
+	IsupShared shared = { msg, &expected, false, 0, 0 };
+	for (int i = 0; i < 4; i++) {
+	    IsupReadThread* t = new IsupReadThread(&shared);
+	    if (t->startup())
+		__sync_add_and_fetch(&shared.running,1);
+	    else
+		delete t;
+	}
+	shared.go = true;
+	while (shared.running)
+	    Thread::yield();
+	errors += shared.errors;
+	TelEngine::destruct(msg);
+    }
+    if (errors)
+	Debug(DebugWarn,"ISUP decoded by concurrent threads with %d errors",errors);
+    else
+	Output("ISUP decoded by concurrent threads %u times",rounds);
+}
+
+// Encode and decode the most frequent ISUP messages
+static void testISUP(SS7ISUP* isup, unsigned int count)
+{
+    for (int i = 0; s_isupTrace[i].data; i++) {
+	const char* name = SS7MsgISUP::lookup(s_isupTrace[i].type);
+	NamedList params("");
+	for (const char* const* p = s_isupTrace[i].params; *p; p += 2)
+	    params.addParam(p[0],p[1]);
+	DataBlock data;
+	data.unHexify(String(s_isupTrace[i].data));
+	NamedList decoded(name);
+	u_int64_t t = Time::now();
+	for (unsigned int n = 0; n < count; n++) {
+	    decoded.clearParams();
+	    isup->decodeMessage(decoded,s_isupTrace[i].type,SS7PointCode::ITU,(const unsigned char*)data.data(),data.length());
+	}
+	u_int64_t dec = Time::now() - t;
+	// messages built on receive only locate their parameters
+	t = Time::now();
+	for (unsigned int n = 0; n < count; n++)
+	    TelEngine::destruct(isup->decodeMessage(s_isupTrace[i].type,1,SS7PointCode::ITU,
+		(const unsigned char*)data.data(),data.length()));
+	u_int64_t loc = Time::now() - t;
+	SS7MsgISUP* msg = isup->decodeMessage(s_isupTrace[i].type,1,SS7PointCode::ITU,
+	    (const unsigned char*)data.data(),data.length());
+	bool bci = msg && msg->hasParam(SS7MsgISUP::BackwardCallIndicators);
+	String lazy,eager;
+	if (msg)
+	    msg->params().dump(lazy,",");
+	decoded.dump(eager,",");
+	if (lazy != eager || bci != (0 != decoded.getParam("BackwardCallIndicators")))
+	    Debug(DebugWarn,"ISUP %s decoded on first use as '%s' instead of '%s'",name,lazy.c_str(),eager.c_str());
+	TelEngine::destruct(msg);
+	DataBlock buf;
+	t = Time::now();
+	for (unsigned int n = 0; n < count; n++)
+	    isup->encodeMessage(buf,s_isupTrace[i].type,SS7PointCode::ITU,params);
+	u_int64_t enc = Time::now() - t;
+	String hex;
+	hex.hexify(buf.data(1),buf.length() - 1,' ');
+	if (hex != s_isupTrace[i].data)
+	    Debug(DebugWarn,"ISUP %s encoded as '%s' instead of '%s'",name,hex.c_str(),s_isupTrace[i].data);
+	Output("ISUP %s x %u: decode " FMT64U " usec, locate " FMT64U " usec, encode " FMT64U " usec",
+	    name,count,dec,loc,enc);
+    }
+}
+
 int main()
 {
     Debugger::enableOutput(true,true);
@@ -129,6 +313,9 @@ int main()
 	delete iam;
     }
     Thread::msleep(500);
+    testISUP(isup,100000);
+    testISUPThreads(isup,200);
+    testGTT(10000,200000);
     delete engine;
     Output("SS7 library test stopped");
     return 0;
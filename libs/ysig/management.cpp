@@ -312,6 +312,7 @@ SS7Management::SS7Management(const NamedList& params, unsigned char sio)
     m_changeMsgs = params.getBoolValue(YSTRING("changemsgs"),m_changeMsgs);
     m_changeSets = params.getBoolValue(YSTRING("changesets"),m_changeSets);
     m_neighbours = params.getBoolValue(YSTRING("neighbours"),m_neighbours);
+    timerDriven(true);
 }
 
 
@@ -1171,8 +1172,10 @@ bool SS7Management::timeout(SignallingMessageTimer& timer, bool final)
 void SS7Management::timerTick(const Time& when)
 {
     for (;;) {
-	if (!lock(SignallingEngine::maxLockWait()))
+	if (!lock(SignallingEngine::maxLockWait())) {
+	    tickRequest();
 	    break;
+	}
 	SnmPending* msg = static_cast<SnmPending*>(m_pending.timeout(when));
 	unlock();
 	if (!msg)
@@ -167,6 +167,7 @@ ISDNQ921::ISDNQ921(const NamedList& params, const char* name, ISDNQ921Management
     }
     if (!mgmt)
 	setDumper(params.getValue(YSTRING("layer2dump")));
+    timerDriven(true);
 }
 
 // Destructor
@@ -311,8 +312,12 @@ void ISDNQ921::timerTick(const Time& when)
     if (state() == Released)
 	return;
     Lock lock(l2Mutex(),SignallingEngine::maxLockWait());
+    if (!lock.locked()) {
+	tickRequest();
+	return;
+    }
     // Check state again after locking, to be sure it didn't change
-    if (!lock.locked() || (state() == Released))
+    if (state() == Released)
 	return;
     // T200 not started
     if (!m_retransTimer.started()) {
@@ -1007,6 +1012,9 @@ void ISDNQ921::timer(bool start, bool t203, u_int64_t time)
 	    m_idleTimer.stop();
 	    XDebug(this,DebugAll,"T203 stopped");
 	}
+	// timerTick() restarts T203 if still needed
+	if (!m_idleTimer.started())
+	    tickRequest();
     }
 }
 
@@ -1034,6 +1042,7 @@ ISDNQ921Management::ISDNQ921Management(const NamedList& params, const char* name
     m_teiManTimer.interval(params,"t202",2500,2600,false);
     m_teiTimer.interval(params,"t201",1000,5000,false);
     setDumper(params.getValue(YSTRING("layer2dump")));
+    timerDriven(true);
     bool set0 = true;
     if (baseName.endsWith("Management")) {
 	baseName = baseName.substr(0,baseName.length()-10);
@@ -1502,6 +1511,7 @@ ISDNQ921Passive::ISDNQ921Passive(const NamedList& params, const char* name)
 	linkSide(network()),String::boolText(detectType()),
 	(unsigned int)m_idleTimer.interval(),this);
     m_idleTimer.start();
+    timerDriven(true);
     // Try to dump from specific parameter, fall back to generic
     const char* dump = network() ? "layer2dump-net" : "layer2dump-cpe";
     setDumper(params.getValue(dump,params.getValue(YSTRING("layer2dump"))));
@@ -1566,7 +1576,11 @@ void ISDNQ921Passive::cleanup()
 void ISDNQ921Passive::timerTick(const Time& when)
 {
     Lock lock(l2Mutex(),SignallingEngine::maxLockWait());
-    if (!(lock.locked() && m_idleTimer.timeout(when.msec())))
+    if (!lock.locked()) {
+	tickRequest();
+	return;
+    }
+    if (!m_idleTimer.timeout(when.msec()))
 	return;
     // Timeout. Notify layer 3. Restart timer
     XDebug(this,DebugNote,"Timeout. Channel was idle for " FMT64 " ms",m_idleTimer.interval());
@@ -1869,8 +1883,11 @@ void ISDNLayer2::teiAssigned(bool status)
     m_teiAssigned = status;
     DDebug(this,DebugAll,"%s 'TEI assigned' state",
 	m_teiAssigned ? "Enter" : "Exit from");
-    if (!m_teiAssigned)
+    if (!m_teiAssigned) {
 	cleanup();
+	// let the TEI management ask for a new one
+	tickRequest();
+    }
 }
 
 // Change the data link status while in TEI ASSIGNED state
@@ -1889,6 +1906,9 @@ void ISDNLayer2::changeState(State newState, const char* reason)
 	stateName(m_state),stateName(newState),
 	(reason ? " (" : ""),c_safe(reason),(reason ? ")" : ""));
     m_state = newState;
+    // timers of a link that is not released are started on next tick
+    if (Released != newState)
+	tickRequest();
 }
 
 // Change the interface type
@@ -2459,6 +2459,7 @@ ISDNQ931::ISDNQ931(const NamedList& params, const char* name)
     }
     setDumper(params.getValue(YSTRING("layer3dump")));
     m_syncGroupTimer.start();
+    timerDriven(true);
 }
 
 ISDNQ931::~ISDNQ931()
@@ -2909,8 +2910,10 @@ void ISDNQ931::setInterval(SignallingTimer& timer, int id)
 void ISDNQ931::timerTick(const Time& when)
 {
     Lock mylock(l3Mutex(),SignallingEngine::maxLockWait());
-    if (!mylock.locked())
+    if (!mylock.locked()) {
+	tickRequest();
 	return;
+    }
     // Check segmented message
     if (m_recvSgmTimer.timeout(when.msec()))
 	endReceiveSegment("timeout");
@@ -3483,6 +3486,8 @@ ISDNQ931Monitor::ISDNQ931Monitor(const NamedList& params, const char* name)
     // Debug
     setDebug(params.getBoolValue(YSTRING("print-messages"),true),
 	params.getBoolValue(YSTRING("extended-debug"),false));
+    // nothing to do in timerTick()
+    timerDriven(true);
 }
 
 ISDNQ931Monitor::~ISDNQ931Monitor()
@@ -128,7 +128,7 @@ void SS7Route::attach(SS7Layer3* network, SS7PointCode::Type type)
     Lock lock(this);
     // Remove from list if already there
     detach(network);
-    SS7Route* route = network->findRoute(m_type,m_packed);
+    RefPointer<SS7Route> route = network->findRoute(m_type,m_packed);
     if (route) {
 	if (m_maxDataLength > route->getMaxDataLength() || m_maxDataLength == 0)
 	    m_maxDataLength = route->getMaxDataLength();
@@ -172,7 +172,7 @@ bool SS7Route::detach(SS7Layer3* network)
 	RefPointer<SS7Layer3> l3 = static_cast<SS7Layer3*>(*p);
 	if (!l3)
 	    continue;
-	SS7Route* route = l3->findRoute(m_type,m_packed);
+	RefPointer<SS7Route> route = l3->findRoute(m_type,m_packed);
 	if (route) {
 	    if (m_maxDataLength > route->getMaxDataLength() ||
 		    m_maxDataLength == 0)
@@ -338,6 +338,7 @@ void SS7Route::reroute()
     XDebug(DebugAll,"Initiating controlled rerouting to %u",packed());
     lock();
     m_buffering = Time::now() + 800000;
+    SignallingTimer::schedule(m_buffering / 1000);
     unlock();
 }
 
@@ -354,6 +355,7 @@ SS7Router::SS7Router(const NamedList& params)
       m_transferSilent(false), m_checkRoutes(false), m_autoAllowed(false),
       m_sendUnavail(true), m_sendProhibited(true),
       m_rxMsu(0), m_txMsu(0), m_fwdMsu(0), m_failMsu(0), m_congestions(0),
+      m_statsMsu(0), m_statsTime(Time::now()),
       m_mngmt(0)
 {
 #ifdef DEBUG
@@ -379,6 +381,7 @@ SS7Router::SS7Router(const NamedList& params)
     m_trafficOk.interval(m_restart.interval() + 4000);
     m_trafficSent.interval(m_restart.interval() + 8000);
     m_testRestricted = params.getBoolValue(YSTRING("testrestricted"),m_testRestricted);
+    timerDriven(true);
     loadLocalPC(params);
     const String* param = params.getParam(YSTRING("management"));
     const char* name = "ss7snm";
@@ -535,6 +538,9 @@ bool SS7Router::restart()
     checkRoutes();
     m_checkRoutes = true;
     m_restart.start();
+    // STP restart second phase begins 5s before the end
+    if (m_transfer)
+	SignallingTimer::schedule(m_restart.fireTime() - 5000);
     m_trafficOk.start();
     unlock();
     rerouteFlush();
@@ -703,8 +709,11 @@ void SS7Router::buildView(SS7PointCode::Type type, ObjList& view, SS7Layer3* net
 void SS7Router::timerTick(const Time& when)
 {
     Lock mylock(this,SignallingEngine::maxLockWait());
-    if (!mylock.locked())
+    if (!mylock.locked()) {
+	// timer driven, the expired timers would wait for the idle tick
+	tickRequest();
 	return;
+    }
     if (m_isolate.timeout(when.msec())) {
 	Debug(this,DebugWarn,"Node is isolated and down! [%p]",this);
 	m_phase2 = false;
@@ -718,6 +727,16 @@ void SS7Router::timerTick(const Time& when)
 	return;
     }
     if (m_started) {
+	// only one of these timers is handled on each tick
+	unsigned int expired = 0;
+	if (m_routeTest.timeout(when.msec()))
+	    expired++;
+	if (m_trafficOk.timeout(when.msec()))
+	    expired++;
+	if (m_trafficSent.timeout(when.msec()))
+	    expired++;
+	if (expired > 1)
+	    tickRequest();
 	if (m_routeTest.timeout(when.msec())) {
 	    m_routeTest.start(when.msec());
 	    mylock.drop();
@@ -781,9 +800,7 @@ int SS7Router::routeMSU(const SS7MSU& msu, const SS7Label& label, SS7Layer3* net
 {
     XDebug(this,DebugStub,"Possibly incomplete SS7Router::routeMSU(%p,%p,%p,%d) states=0x%X",
 	&msu,&label,network,sls,states);
-    m_routeMutex.lock();
     RefPointer<SS7Route> route = findRoute(label.type(),label.dpc().pack(label.type()));
-    m_routeMutex.unlock();
     int slsTx = route ? route->transmitMSU(this,msu,label,sls,states,network) : -1;
     if (slsTx >= 0) {
 	bool cong = route->congested();
@@ -862,7 +879,7 @@ HandledMSU SS7Router::receivedMSU(const SS7MSU& msu, const SS7Label& label, SS7L
     if (m_autoAllowed && network && (msu.getSIF() > SS7MSU::MTNS)) {
 	unsigned int src = label.opc().pack(label.type());
 	Lock mylock(m_routeMutex);
-	SS7Route* route = findRoute(label.type(),src);
+	RefPointer<SS7Route> route = findRoute(label.type(),src);
 	if (route && !route->priority() && (route->state() & (SS7Route::Unknown|SS7Route::Prohibited))) {
 	    Debug(this,DebugNote,"Auto activating adjacent route %u on '%s' [%p]",
 		src,network->toString().c_str(),this);
@@ -992,7 +1009,7 @@ void SS7Router::updateRoutes(SS7Layer3* network)
 	SS7PointCode::Type type = (SS7PointCode::Type)(i + 1);
 	for (ObjList* o = network->m_route[i].skipNull(); o; o = o->skipNext()) {
 	    SS7Route* src = static_cast<SS7Route*>(o->get());
-	    SS7Route* dest = findRoute(type,src->packed());
+	    RefPointer<SS7Route> dest = findRoute(type,src->packed());
 	    if (dest) {
 		if (dest->priority() > src->priority())
 		    dest->m_priority = src->priority();
@@ -1000,14 +1017,16 @@ void SS7Router::updateRoutes(SS7Layer3* network)
 		    dest->m_shift = src->shift();
 	    }
 	    else {
-		dest = new SS7Route(*src);
-		m_route[i].append(dest);
+		SS7Route* route = new SS7Route(*src);
+		m_route[i].append(route);
+		dest = route;
 	    }
 	    DDebug(this,DebugAll,"Add route type=%s packed=%u for network (%p,'%s') [%p]",
 		SS7PointCode::lookup(type),src->m_packed,network,network->toString().safe(),this);
 	    dest->attach(network,type);
 	}
     }
+    updateRouteIndex();
 }
 
 // Remove the given network from all destinations in the routing table.
@@ -1036,10 +1055,12 @@ void SS7Router::removeRoutes(SS7Layer3* network)
 			route->m_state = SS7Route::Prohibited;
 			routeChanged(route,type,0,network);
 		}
-		m_route[i].remove(route,true);
+		m_route[i].remove(route,false);
+		retireRoute(route);
 	    }
 	}
     }
+    updateRouteIndex();
     DDebug(this,DebugAll,"Removed network (%p,'%s') from routing table [%p]",
 	network,network->toString().safe(),this);
 }
@@ -1138,7 +1159,7 @@ SS7Route::State SS7Router::getRouteView(SS7PointCode::Type type, unsigned int pa
 	    packedPC,remotePC,network->toString().c_str());
 	return SS7Route::Prohibited;
     }
-    SS7Route* route = 0;
+    RefPointer<SS7Route> route;
     if (network)
 	route = const_cast<SS7Layer3*>(network)->findRoute(type,packedPC);
     SS7Route::State routeState = route ? route->state() : SS7Route::Unknown;
@@ -1152,7 +1173,7 @@ SS7Route::State SS7Router::getRouteView(SS7PointCode::Type type, unsigned int pa
 	    continue;
 	SS7Route::State state;
 	if (l3->operational()) {
-	    SS7Route* r = l3->findRoute(type,packedPC);
+	    RefPointer<SS7Route> r = l3->findRoute(type,packedPC);
 	    if (!r)
 		continue;
 	    if (r->priority() == routePrio) {
@@ -1214,7 +1235,7 @@ bool SS7Router::setRouteState(SS7PointCode::Type type, unsigned int packedPC, SS
     if (type == SS7PointCode::Other || (unsigned int)type > YSS7_PCTYPE_COUNT || !packedPC)
 	return false;
     Lock lock(m_routeMutex);
-    SS7Route* route = findRoute(type,packedPC);
+    RefPointer<SS7Route> route = findRoute(type,packedPC);
     if (!route)
 	return false;
     if (state != route->m_state) {
@@ -1236,7 +1257,7 @@ bool SS7Router::setRouteSpecificState(SS7PointCode::Type type, unsigned int pack
     if (type == SS7PointCode::Other || (unsigned int)type > YSS7_PCTYPE_COUNT || !packedPC)
 	return false;
     Lock myLock(m_routeMutex);
-    SS7Route* route = findRoute(type,packedPC);
+    RefPointer<SS7Route> route = findRoute(type,packedPC);
     if (!route) {
 	Debug(this,DebugNote,"Route to %u advertised by %u not found",packedPC,srcPC);
 	return false;
@@ -1247,7 +1268,7 @@ bool SS7Router::setRouteSpecificState(SS7PointCode::Type type, unsigned int pack
 	SS7Layer3* l3 = *static_cast<L3Pointer*>(nl->get());
 	if (!l3)
 	    continue;
-	SS7Route* r = l3->findRoute(type,packedPC);
+	RefPointer<SS7Route> r = l3->findRoute(type,packedPC);
 	if (!r) {
 	    Debug(this,DebugGoOn,"Route to %u not found in network '%s'",packedPC,l3->toString().c_str());
 	    continue;
@@ -2010,6 +2031,14 @@ void SS7Router::printStats()
     tmp << "Rx=" << (unsigned int)m_rxMsu << ", Tx=" << (unsigned int)m_txMsu;
     tmp << ", Fwd=" << (unsigned int)m_fwdMsu << ", Fail=" << (unsigned int)m_failMsu;
     tmp << ", Cong=" << (unsigned int)m_congestions;
+    // routing throughput since the previous report
+    u_int64_t now = Time::now();
+    if (now > m_statsTime) {
+	u_int64_t msu = m_rxMsu + m_txMsu - m_statsMsu;
+	tmp << ", Rate=" << (unsigned int)(msu * 1000000 / (now - m_statsTime)) << "/s";
+    }
+    m_statsMsu = m_rxMsu + m_txMsu;
+    m_statsTime = now;
     m_statsMutex.unlock();
     Output("Statistics for '%s': %s",debugName(),tmp.c_str());
 }
@@ -1383,6 +1383,7 @@ SS7MsgSccpReassemble::SS7MsgSccpReassemble(SS7MsgSCCP* msg, const SS7Label& labe
     m_segmentationLocalReference = msg->params().getIntValue(
 	    YSTRING("Segmentation.SegmentationLocalReference"));
     m_timeout = Time::msecNow() + timeToLive;
+    SignallingTimer::schedule(m_timeout);
     m_remainingSegments = msg->params().getIntValue(
 	    YSTRING("Segmentation.RemainingSegments"));
     setData(new DataBlock(*msg->getData()));
@@ -1729,13 +1730,143 @@ bool SCCPUser::managementNotify(SCCP::Type type, NamedList& params)
     return false;
 }
 
+/**
+ * Built-in Global Title Translation table
+ */
+namespace TelEngine {
+
+// One translation of the built-in table
+class GTTEntry : public GenObject
+{
+public:
+    inline GTTEntry(const String& name, int pointcode, int backup, int ssn)
+	: m_name(name), m_pointcode(pointcode), m_backup(backup), m_ssn(ssn)
+	{ }
+    String m_name;
+    int m_pointcode;                     // Primary destination, 0 to keep
+    int m_backup;                        // Backup destination, 0 if none
+    int m_ssn;                           // New subsystem, negative to keep
+    String m_route;                      // New routing indicator, empty to keep
+    String m_sccp;                       // Local SCCP to route to
+};
+
+// Translations with the same translation type, numbering plan and nature
+// A negative value matches anything
+class GTTBucket : public GenObject
+{
+public:
+    inline GTTBucket(int tt, int np, int nai)
+	: m_tt(tt), m_np(np), m_nai(nai)
+	{ }
+    inline bool matches(int tt, int np, int nai) const
+	{ return (m_tt < 0 || m_tt == tt) && (m_np < 0 || m_np == np) && (m_nai < 0 || m_nai == nai); }
+    inline bool same(int tt, int np, int nai) const
+	{ return m_tt == tt && m_np == np && m_nai == nai; }
+    // Number of fields that must match exactly
+    inline int specific() const
+	{ return (m_tt >= 0 ? 1 : 0) + (m_np >= 0 ? 1 : 0) + (m_nai >= 0 ? 1 : 0); }
+    int m_tt;
+    int m_np;
+    int m_nai;
+    PrefixTable m_prefixes;              // GT digit prefixes to GTTEntry
+};
+
+class GTTTable : public RefObject
+{
+public:
+    inline GTTTable()
+	: m_count(0)
+	{ }
+    bool add(const NamedList& params, SS7PointCode::Type type);
+    const GTTEntry* find(int tt, int np, int nai, const char* digits) const;
+    inline unsigned int count() const
+	{ return m_count; }
+private:
+    ObjList m_buckets;
+    unsigned int m_count;
+};
+
+};
+
+// Retrieve a point code given as packed integer or in dotted notation
+static int gttPointCode(const NamedList& params, const String& name, SS7PointCode::Type type)
+{
+    const String& str = params[name];
+    if (str.null())
+	return 0;
+    int pc = str.toInteger(-1);
+    if (pc > 0)
+	return pc;
+    SS7PointCode code;
+    if (code.assign(str,type) && code.pack(type))
+	return code.pack(type);
+    return -1;
+}
+
+bool GTTTable::add(const NamedList& params, SS7PointCode::Type type)
+{
+    const String& prefix = params[YSTRING("gt")].null() ? (const String&)params : params[YSTRING("gt")];
+    int tt = params.getIntValue(YSTRING("translation"),-1);
+    int np = params.getIntValue(YSTRING("plan"),s_numberingPlan,-1);
+    int nai = params.getIntValue(YSTRING("nature"),s_nai,-1);
+    int pc = gttPointCode(params,YSTRING("pointcode"),type);
+    int backup = gttPointCode(params,YSTRING("backup"),type);
+    int ssn = params.getIntValue(YSTRING("ssn"),-1);
+    if (pc < 0 || backup < 0 || ssn > 255 || (!pc && ssn < 0)) {
+	Debug(DebugWarn,"GTT: Invalid translation '%s'",params.c_str());
+	return false;
+    }
+    GTTEntry* e = new GTTEntry(params,pc,backup,ssn);
+    e->m_route = params[YSTRING("route")];
+    e->m_sccp = params[YSTRING("sccp")];
+    GTTBucket* b = 0;
+    for (ObjList* o = m_buckets.skipNull(); o; o = o->skipNext()) {
+	b = static_cast<GTTBucket*>(o->get());
+	if (b->same(tt,np,nai))
+	    break;
+	b = 0;
+    }
+    if (!b) {
+	b = new GTTBucket(tt,np,nai);
+	m_buckets.append(b);
+    }
+    b->m_prefixes.addPrefix(prefix,e);
+    m_count++;
+    return true;
+}
+
+// Find the entry with the longest matching prefix
+// On equal length prefer the entry with the most specific match criteria
+const GTTEntry* GTTTable::find(int tt, int np, int nai, const char* digits) const
+{
+    const GTTEntry* found = 0;
+    int len = -1;
+    int spec = -1;
+    for (ObjList* o = m_buckets.skipNull(); o; o = o->skipNext()) {
+	const GTTBucket* b = static_cast<const GTTBucket*>(o->get());
+	if (!b->matches(tt,np,nai))
+	    continue;
+	int idx = b->m_prefixes.longest(digits);
+	if (idx < 0)
+	    continue;
+	int l = b->m_prefixes.pattern(idx).length();
+	if (l < len || (l == len && b->specific() <= spec))
+	    continue;
+	len = l;
+	spec = b->specific();
+	found = static_cast<const GTTEntry*>(b->m_prefixes.data(idx));
+    }
+    return found;
+}
+
+
 /**
  * class GTT
  */
 
 GTT::GTT(const NamedList& config)
     : SignallingComponent(config.safe("GTT"),&config,"ss7-gtt"),
-      m_sccp(0)
+      m_sccp(0), m_table(0), m_hasDown(false), m_tableMutex(false,"GTTTable")
 {
 }
 
@@ -1746,11 +1877,15 @@ GTT::~GTT()
 	TelEngine::destruct(m_sccp);
 	m_sccp = 0;
     }
+    TelEngine::destruct(m_table);
 }
 
 bool GTT::initialize(const NamedList* config)
 {
     DDebug(this,DebugInfo,"GTT::initialize(%p) [%p]",config,this);
+    const String* table = config ? config->getParam(YSTRING("table")) : 0;
+    if (!TelEngine::null(table))
+	loadTable(*table);
     if (engine()) {
 	NamedList params("sccp");
 	if (!resolveConfig(YSTRING("sccp"),params,config))
@@ -1764,9 +1899,144 @@ bool GTT::initialize(const NamedList* config)
 
 NamedList* GTT::routeGT(const NamedList& gt, const String& prefix, const String& nextPrefix)
 {
-    Debug(DebugStub,"Please implement NamedList* GTT::routeGT(%s,%s,%s)",
-	    gt.c_str(),prefix.c_str(),nextPrefix.c_str());
-    return 0;
+    return routeTable(gt,prefix);
+}
+
+unsigned int GTT::setTable(const ObjList& entries)
+{
+    GTTTable* table = new GTTTable;
+    SS7PointCode::Type type = SS7PointCode::ITU;
+    for (ObjList* o = entries.skipNull(); o; o = o->skipNext()) {
+	const NamedList* params = YOBJECT(NamedList,o->get());
+	if (!params)
+	    continue;
+	if (*params == YSTRING("general")) {
+	    type = SS7PointCode::lookup(params->getValue(YSTRING("pointcodetype"),"ITU"));
+	    if (type == SS7PointCode::Other)
+		type = SS7PointCode::ITU;
+	    continue;
+	}
+	if (!table->add(*params,type))
+	    Debug(this,DebugWarn,"Ignoring invalid translation '%s' [%p]",params->c_str(),this);
+    }
+    unsigned int n = table->count();
+    m_tableMutex.lock();
+    GTTTable* old = m_table;
+    m_table = table;
+    m_tableMutex.unlock();
+    TelEngine::destruct(old);
+    DDebug(this,DebugInfo,"Loaded %u global title translations [%p]",n,this);
+    return n;
+}
+
+bool GTT::loadTable(const String& file)
+{
+    Configuration cfg(file);
+    if (!cfg.load(false)) {
+	Debug(this,DebugWarn,"Could not load translations from '%s' [%p]",file.c_str(),this);
+	return false;
+    }
+    ObjList entries;
+    for (unsigned int i = 0; i < cfg.sections(); i++) {
+	NamedList* sect = cfg.getSection(i);
+	if (sect)
+	    entries.append(sect)->setDelete(false);
+    }
+    unsigned int n = setTable(entries);
+    Debug(this,DebugInfo,"Loaded %u global title translations from '%s' [%p]",
+	n,file.c_str(),this);
+    return true;
+}
+
+NamedList* GTT::routeTable(const NamedList& gt, const String& prefix)
+{
+    m_tableMutex.lock();
+    RefPointer<GTTTable> table = m_table;
+    bool checkDown = m_hasDown;
+    m_tableMutex.unlock();
+    if (!table)
+	return 0;
+    String name(prefix);
+    name << ".gt";
+    const String* digits = gt.getParam(name);
+    if (TelEngine::null(digits))
+	return 0;
+    int tt = gt.getIntValue(name + ".translation",-1);
+    int np = gt.getIntValue(name + ".plan",s_numberingPlan,-1);
+    int nai = gt.getIntValue(name + ".nature",s_nai,-1);
+    const GTTEntry* e = table->find(tt,np,nai,*digits);
+    if (!e)
+	return 0;
+    int pc = e->m_pointcode;
+    if (checkDown && pc && unavailable(pc,e->m_ssn)) {
+	if (!(e->m_backup && !unavailable(e->m_backup,e->m_ssn))) {
+	    DDebug(this,DebugInfo,"All destinations of translation '%s' are unavailable [%p]",
+		e->m_name.c_str(),this);
+	    return 0;
+	}
+	pc = e->m_backup;
+    }
+    XDebug(this,DebugAll,"Translated GT '%s' using '%s' [%p]",
+	digits->c_str(),e->m_name.c_str(),this);
+    NamedList* route = new NamedList(e->m_name);
+    route->copySubParams(gt,prefix + ".");
+    if (pc)
+	route->setParam("pointcode",String(pc));
+    if (e->m_ssn >= 0)
+	route->setParam("ssn",String(e->m_ssn));
+    if (e->m_route)
+	route->setParam("route",e->m_route);
+    if (e->m_sccp) {
+	route->setParam("sccp",e->m_sccp);
+	if (pc)
+	    route->setParam("RemotePC",String(pc));
+    }
+    return route;
+}
+
+void GTT::updateTables(const NamedList& params)
+{
+    const String& pc = params[YSTRING("pointcode")];
+    if (pc.null())
+	return;
+    Lock lock(m_tableMutex);
+    const String* state = params.getParam(YSTRING("pc-state"));
+    if (state) {
+	ObjList* o = m_down.find(pc);
+	if (*state == YSTRING("prohibited")) {
+	    if (!o)
+		m_down.append(new String(pc));
+	}
+	else if (o)
+	    o->remove();
+    }
+    const String& ssn = params[YSTRING("subsystem")];
+    state = params.getParam(YSTRING("subsystem-state"));
+    if (ssn && state) {
+	String key;
+	key << pc << ":" << ssn;
+	ObjList* o = m_down.find(key);
+	if (*state == YSTRING("prohibited")) {
+	    if (!o)
+		m_down.append(new String(key));
+	}
+	else if (o)
+	    o->remove();
+    }
+    m_hasDown = (0 != m_down.skipNull());
+}
+
+// Check if a point code or a subsystem on it was reported unavailable
+bool GTT::unavailable(int pc, int ssn)
+{
+    String key(pc);
+    Lock lock(m_tableMutex);
+    if (m_down.find(key))
+	return true;
+    if (ssn < 0)
+	return false;
+    key << ":" << ssn;
+    return 0 != m_down.find(key);
 }
 
 void GTT::attach(SCCP* sccp)
@@ -1793,6 +2063,11 @@ void GTT::destroyed()
 	TelEngine::destruct(m_sccp);
 	m_sccp = 0;
     }
+    m_tableMutex.lock();
+    GTTTable* table = m_table;
+    m_table = 0;
+    m_tableMutex.unlock();
+    TelEngine::destruct(table);
     SignallingComponent::destroyed();
 }
 
@@ -1806,6 +2081,7 @@ SCCPManagement::SCCPManagement(const NamedList& params, SS7PointCode::Type type)
     m_subsystemFailure(0), m_routeFailure(0), m_autoAppend(false), m_printMessages(false)
 {
     DDebug(DebugAll,"Creating SCCP management (%p)",this);
+    timerDriven(true);
     // stat.info timer
     m_testTimeout = params.getIntValue(YSTRING("test-timer"),5000);
     if (m_testTimeout < 5000)
@@ -2326,8 +2602,10 @@ void SCCPManagement::routeStatus(String& dest,bool extended)
 
 void SCCPManagement::timerTick(const Time& when)
 {
-    if (!lock(SignallingEngine::maxLockWait()))
+    if (!lock(SignallingEngine::maxLockWait())) {
+	tickRequest();
 	return;
+    }
     ObjList coordt;
     for (ObjList* o = m_localSubsystems.skipNull();o;o = o->skipNext()) {
 	SccpLocalSubsystem* ss = static_cast<SccpLocalSubsystem*>(o->get());
@@ -2799,6 +3077,7 @@ SS7SCCP::SS7SCCP(const NamedList& params)
     m_printMsg(false), m_extendedDebug(false), m_endpoint(true)
 {
     DDebug(this,DebugInfo,"Creating new SS7SCCP [%p]",this);
+    timerDriven(true);
 #ifdef DEBUG
     if (debugAt(DebugAll)) {
 	String tmp;
@@ -2918,8 +3197,10 @@ bool SS7SCCP::managementStatus(Type type, NamedList& params)
 
 void SS7SCCP::timerTick(const Time& when)
 {
-    if (!lock(SignallingEngine::maxLockWait()))
+    if (!lock(SignallingEngine::maxLockWait())) {
+	tickRequest();
 	return;
+    }
     for (ObjList* o = m_reassembleList.skipNull();o;) {
         SS7MsgSccpReassemble* usr = YOBJECT(SS7MsgSccpReassemble,o->get());
         if (usr->timeout()) {
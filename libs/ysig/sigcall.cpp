@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Circuit codes above this are not indexed in circuit groups
+#define MAX_CIRCUIT_INDEX 65536
 
 using namespace TelEngine;
 
@@ -220,18 +222,22 @@ SignallingEvent* SignallingCallControl::getEvent(const Time& when)
 	unlock();
 	return event;
     }
-    ListIterator iter(m_calls);
-    for (;;) {
-	SignallingCall* call = static_cast<SignallingCall*>(iter.get());
-	// End of iteration?
-	if (!call)
-	    break;
-	RefPointer<SignallingCall> callRef = call;
-	// Dead pointer?
-	if (!callRef)
-	    continue;
+    // Poll the calls that may have events, idle ones are skipped without locking them
+    // The list is refilled only after all its calls were polled so returning an
+    //  event doesn't restart the walk of all calls
+    if (!m_pollCalls.skipNull()) {
+	ObjList* last = &m_pollCalls;
+	for (ObjList* o = m_calls.skipNull(); o; o = o->skipNext()) {
+	    SignallingCall* call = static_cast<SignallingCall*>(o->get());
+	    if (call->eventPending(when) && call->ref())
+		last = last->append(call);
+	}
+    }
+    for (ObjList* o = m_pollCalls.skipNull(); o; o = m_pollCalls.skipNull()) {
+	SignallingCall* call = static_cast<SignallingCall*>(o->remove(false));
 	unlock();
-	SignallingEvent* event = callRef->getEvent(when);
+	SignallingEvent* event = call->getEvent(when);
+	TelEngine::destruct(call);
 	// Check if this call controller wants the event
 	if (event && !processEvent(event))
 	    return event;
@@ -266,6 +272,7 @@ SignallingEvent* SignallingCallControl::getEvent(const Time& when)
 void SignallingCallControl::clearCalls()
 {
     lock();
+    m_pollCalls.clear();
     m_calls.clear();
     unlock();
 }
@@ -307,6 +314,7 @@ SignallingCall::SignallingCall(SignallingCallControl* controller, bool outgoing,
     m_controller(controller),
     m_outgoing(outgoing),
     m_signalOnly(signalOnly),
+    m_inMsgCount(0),
     m_inMsgMutex(true,"SignallingCall::inMsg"),
     m_private(0)
 {
@@ -315,7 +323,7 @@ SignallingCall::SignallingCall(SignallingCallControl* controller, bool outgoing,
 SignallingCall::~SignallingCall()
 {
     lock();
-    m_inMsg.clear();
+    clearQueue();
     if (m_controller)
 	m_controller->removeCall(this,false);
     unlock();
@@ -337,6 +345,7 @@ void SignallingCall::enqueue(SignallingMessage* msg)
 	return;
     Lock lock(m_inMsgMutex);
     m_inMsg.append(msg);
+    m_inMsgCount++;
     XDebug(DebugAll,"SignallingCall. Enqueued message (%p,'%s') [%p]",
 	msg,msg->name(),this);
 }
@@ -351,6 +360,7 @@ SignallingMessage* SignallingCall::dequeue(bool remove)
     SignallingMessage* msg = static_cast<SignallingMessage*>(obj->get());
     if (remove) {
 	m_inMsg.remove(msg,false);
+	m_inMsgCount--;
 	XDebug(DebugAll,"SignallingCall. Dequeued message (%p,'%s') [%p]",
 	   msg,msg->name(),this);
     }
@@ -740,6 +750,8 @@ const TokenDict SignallingCircuitGroup::s_strategy[] = {
 SignallingCircuitGroup::SignallingCircuitGroup(unsigned int base, int strategy, const char* name)
     : SignallingComponent(name),
       Mutex(true,"SignallingCircuitGroup"),
+      m_index(0),
+      m_indexSize(0),
       m_range(String::empty(),name,strategy),
       m_base(base)
 {
@@ -752,6 +764,7 @@ SignallingCircuitGroup::SignallingCircuitGroup(unsigned int base, int strategy,
 SignallingCircuitGroup::~SignallingCircuitGroup()
 {
     clearAll();
+    delete[] m_index;
     XDebug(this,DebugAll,"SignallingCircuitGroup::~SignallingCircuitGroup() [%p]",this);
 }
 
@@ -766,6 +779,8 @@ SignallingCircuit* SignallingCircuitGroup::find(unsigned int cic, bool local)
     Lock mylock(this);
     if (cic >= m_range.m_last)
 	return 0;
+    if (cic < m_indexSize)
+	return m_index[cic];
     ObjList* l = m_circuits.skipNull();
     for (; l; l = l->skipNext()) {
 	SignallingCircuit* c = static_cast<SignallingCircuit*>(l->get());
@@ -804,6 +819,7 @@ bool SignallingCircuitGroup::insert(SignallingCircuit* circuit)
     circuit->m_group = this;
     m_circuits.append(circuit);
     m_range.add(circuit->code());
+    indexCircuit(circuit->code(),circuit);
     return true;
 }
 
@@ -817,6 +833,7 @@ void SignallingCircuitGroup::remove(SignallingCircuit* circuit)
 	return;
     circuit->m_group = 0;
     m_range.remove(circuit->code());
+    indexCircuit(circuit->code(),0);
     // TODO: remove from all ranges
 }
 
@@ -1112,6 +1129,31 @@ void SignallingCircuitGroup::clearAll()
     }
     m_circuits.clear();
     m_ranges.clear();
+    if (m_index)
+	::memset(m_index,0,m_indexSize * sizeof(SignallingCircuit*));
+}
+
+// Set or clear a circuit in the code index, grow it to fit the codes in use
+// Codes above the limit are not indexed and are found by searching the list
+void SignallingCircuitGroup::indexCircuit(unsigned int code, SignallingCircuit* circuit)
+{
+    if (code >= m_indexSize) {
+	if (!circuit || code >= MAX_CIRCUIT_INDEX)
+	    return;
+	unsigned int size = m_indexSize ? m_indexSize : 32;
+	while (size <= code)
+	    size *= 2;
+	if (size > MAX_CIRCUIT_INDEX)
+	    size = MAX_CIRCUIT_INDEX;
+	SignallingCircuit** index = new SignallingCircuit*[size];
+	if (m_indexSize)
+	    ::memcpy(index,m_index,m_indexSize * sizeof(SignallingCircuit*));
+	::memset(index + m_indexSize,0,(size - m_indexSize) * sizeof(SignallingCircuit*));
+	delete[] m_index;
+	m_index = index;
+	m_indexSize = size;
+    }
+    m_index[code] = circuit;
 }
 
 
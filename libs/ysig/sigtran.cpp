@@ -323,6 +323,7 @@ SIGAdaptation::SIGAdaptation(const char* name, const NamedList* params,
       m_waitHeartbeatAck(0)
 {
     DDebug(this,DebugAll,"Creating SIGTRAN UA [%p]",this);
+    timerDriven(true);
     for (int i = 0; i < 32;i++)
 	m_streamsHB[i] = HeartbeatDisabled;
     if (params) {
@@ -1054,6 +1055,7 @@ SS7M2PA::SS7M2PA(const NamedList& params)
 	m_maxQueueSize = 16;
     if (m_maxQueueSize > 65356)
 	m_maxQueueSize = 65356;
+    timerDriven(true);
     DDebug(this,DebugAll,"Creating SS7M2PA [%p]",this);
 }
 
@@ -1241,8 +1243,10 @@ void SS7M2PA::timerTick(const Time& when)
 {
     SS7Layer2::timerTick(when);
     Lock lock(m_mutex,SignallingEngine::maxLockWait());
-    if (!lock.locked())
+    if (!lock.locked()) {
+	tickRequest();
 	return;
+    }
     if (m_confTimer.timeout(when.msec())) {
 	sendAck(); // Acknowledge last received message before endpoint drops down the link
 	m_confTimer.stop();
@@ -1300,6 +1304,7 @@ void SS7M2PA::timerTick(const Time& when)
 	// Retransmit proving state
 	if ((when & 0x3f) == 0)
 	    transmitLS();
+	tickRequest();
     }
     if (m_t1.timeout(when.msec())) {
 	m_t1.stop();
@@ -1570,6 +1575,9 @@ bool SS7M2PA::processLinkStatus(DataBlock& data,int streamId)
 		else
 		    m_t4.start();
 	    }
+	    // proving status is retransmitted while T4 runs
+	    if (m_t4.started())
+		tickRequest();
 	    setRemoteStatus(status);
 	    break;
 	case Ready:
@@ -1904,6 +1912,7 @@ SS7M2UA::SS7M2UA(const NamedList& params)
     m_retrieve.interval(params,"retrieve",5,200,true);
     m_longSeq = params.getBoolValue(YSTRING("longsequence"));
     m_lastSeqRx = -2;
+    timerDriven(true);
 }
 
 bool SS7M2UA::initialize(const NamedList* config)
@@ -254,6 +254,271 @@ const TokenDict SS7TCAP::s_compOperClasses[] = {
 };
 
 
+#define TCAP_SHARDS 16
+#define TCAP_BUCKETS 64
+#define TCAP_WHEEL_SLOT 50
+#define TCAP_WHEEL_SLOTS 256
+
+namespace TelEngine {
+
+// Entry of the transaction hash, owns a reference to the transaction
+class TCAPTransEntry : public GenObject
+{
+public:
+    inline TCAPTransEntry(SS7TCAPTransaction* tr)
+	: m_tr(tr), m_due(0)
+	{ }
+    virtual ~TCAPTransEntry()
+	{ TelEngine::destruct(m_tr); }
+    virtual const String& toString() const
+	{ return m_tr->toString(); }
+    SS7TCAPTransaction* m_tr;
+    // time of the earliest pending check in the timer wheel, 0 if none
+    u_int64_t m_due;
+};
+
+// Pending check of a transaction in a timer wheel slot
+class TCAPTimerEntry : public String
+{
+public:
+    inline TCAPTimerEntry(const String& tid, u_int64_t due)
+	: String(tid), m_due(due)
+	{ }
+    u_int64_t m_due;
+};
+
+// One lock protected part of the transaction table with its own timer wheel
+class TCAPTransShard : public Mutex
+{
+public:
+    TCAPTransShard();
+    ~TCAPTransShard();
+    TCAPTransEntry* find(const String& tid, unsigned int hash);
+    void add(TCAPTransEntry* entry, unsigned int hash);
+    TCAPTransEntry* remove(SS7TCAPTransaction* tr, unsigned int hash);
+    void schedule(TCAPTransEntry* entry, u_int64_t due);
+    void expire(u_int64_t now, ObjList*& due);
+    ObjList* m_buckets;
+    unsigned int m_size;
+    unsigned int m_count;
+private:
+    void resize(unsigned int size);
+    ObjList m_wheel[TCAP_WHEEL_SLOTS];
+    u_int64_t m_wheelSlot;
+};
+
+// Transactions hashed by local ID, the lock is split between shards so
+//  messages of unrelated dialogues don't serialize
+class SS7TCAPTransactionTable : public GenObject
+{
+public:
+    // spread the bits of the string hash as IDs are short and often sequential
+    inline static unsigned int hash(const String& tid)
+    {
+	unsigned int h = tid.hash();
+	h ^= h >> 15;
+	h *= 0x2c1b3c6d;
+	return h ^ (h >> 12);
+    }
+    unsigned int count();
+    void add(SS7TCAPTransaction* tr);
+    SS7TCAPTransaction* find(const String& tid);
+    void remove(SS7TCAPTransaction* tr);
+    void schedule(SS7TCAPTransaction* tr, u_int64_t due);
+    void expire(u_int64_t now, ObjList& due);
+    void clear();
+private:
+    inline TCAPTransShard& shard(unsigned int hash)
+	{ return m_shards[hash % TCAP_SHARDS]; }
+    TCAPTransShard m_shards[TCAP_SHARDS];
+};
+
+}; // namespace TelEngine
+
+TCAPTransShard::TCAPTransShard()
+    : Mutex(false,"TCAPTransactions"),
+      m_buckets(new ObjList[TCAP_BUCKETS]), m_size(TCAP_BUCKETS), m_count(0),
+      m_wheelSlot(Time::msecNow() / TCAP_WHEEL_SLOT)
+{
+}
+
+TCAPTransShard::~TCAPTransShard()
+{
+    delete[] m_buckets;
+}
+
+TCAPTransEntry* TCAPTransShard::find(const String& tid, unsigned int hash)
+{
+    ObjList* o = m_buckets[(hash / TCAP_SHARDS) % m_size].find(tid);
+    return o ? static_cast<TCAPTransEntry*>(o->get()) : 0;
+}
+
+void TCAPTransShard::add(TCAPTransEntry* entry, unsigned int hash)
+{
+    m_buckets[(hash / TCAP_SHARDS) % m_size].insert(entry);
+    if (++m_count > 2 * m_size)
+	resize(4 * m_size);
+}
+
+TCAPTransEntry* TCAPTransShard::remove(SS7TCAPTransaction* tr, unsigned int hash)
+{
+    ObjList& bucket = m_buckets[(hash / TCAP_SHARDS) % m_size];
+    for (ObjList* o = bucket.skipNull(); o; o = o->skipNext()) {
+	TCAPTransEntry* entry = static_cast<TCAPTransEntry*>(o->get());
+	if (entry->m_tr != tr)
+	    continue;
+	o->remove(false);
+	m_count--;
+	return entry;
+    }
+    return 0;
+}
+
+// Move all entries to a new set of buckets
+void TCAPTransShard::resize(unsigned int size)
+{
+    DDebug(DebugInfo,"TCAPTransShard resizing from %u to %u buckets [%p]",m_size,size,this);
+    ObjList* buckets = new ObjList[size];
+    for (unsigned int i = 0; i < m_size; i++) {
+	ObjList* o = m_buckets[i].skipNull();
+	while (o) {
+	    TCAPTransEntry* entry = static_cast<TCAPTransEntry*>(o->remove(false));
+	    buckets[(SS7TCAPTransactionTable::hash(entry->toString()) / TCAP_SHARDS) % size].insert(entry);
+	    o = o->skipNull();
+	}
+    }
+    delete[] m_buckets;
+    m_buckets = buckets;
+    m_size = size;
+}
+
+// Request a check of the transaction at the given time, keep only the earliest one
+void TCAPTransShard::schedule(TCAPTransEntry* entry, u_int64_t due)
+{
+    if (entry->m_due && entry->m_due <= due)
+	return;
+    entry->m_due = due;
+    m_wheel[(due / TCAP_WHEEL_SLOT) % TCAP_WHEEL_SLOTS].insert(new TCAPTimerEntry(entry->toString(),due));
+    SignallingTimer::schedule(due);
+}
+
+// Collect referenced transactions whose check time has come
+void TCAPTransShard::expire(u_int64_t now, ObjList*& due)
+{
+    u_int64_t slot = now / TCAP_WHEEL_SLOT;
+    // the current slot is visited again on next call as it may still receive entries
+    u_int64_t first = m_wheelSlot;
+    if (slot - first >= TCAP_WHEEL_SLOTS)
+	first = slot - TCAP_WHEEL_SLOTS + 1;
+    for (u_int64_t s = first; s <= slot; s++) {
+	ObjList* o = &m_wheel[s % TCAP_WHEEL_SLOTS];
+	while (o) {
+	    TCAPTimerEntry* t = static_cast<TCAPTimerEntry*>(o->get());
+	    if (!t || t->m_due > now) {
+		// empty node or entry due in a later round of the wheel
+		o = o->next();
+		continue;
+	    }
+	    o->remove(false);
+	    TCAPTransEntry* entry = find(*t,SS7TCAPTransactionTable::hash(*t));
+	    // ignore entries of removed or rescheduled transactions
+	    if (entry && entry->m_due == t->m_due) {
+		entry->m_due = 0;
+		if (entry->m_tr->ref())
+		    due = due->append(entry->m_tr);
+	    }
+	    TelEngine::destruct(t);
+	}
+	m_wheel[s % TCAP_WHEEL_SLOTS].compact();
+    }
+    m_wheelSlot = slot;
+}
+
+unsigned int SS7TCAPTransactionTable::count()
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < TCAP_SHARDS; i++)
+	n += m_shards[i].m_count;
+    return n;
+}
+
+// Take ownership of a reference, the transaction is checked on next timer tick
+void SS7TCAPTransactionTable::add(SS7TCAPTransaction* tr)
+{
+    unsigned int h = hash(tr->toString());
+    TCAPTransEntry* entry = new TCAPTransEntry(tr);
+    TCAPTransShard& s = shard(h);
+    Lock lock(s);
+    s.add(entry,h);
+    s.schedule(entry,Time::msecNow());
+}
+
+// Return a referenced transaction, it will be checked on next timer tick
+//  as the caller is most likely going to change its state
+SS7TCAPTransaction* SS7TCAPTransactionTable::find(const String& tid)
+{
+    unsigned int h = hash(tid);
+    TCAPTransShard& s = shard(h);
+    Lock lock(s);
+    TCAPTransEntry* entry = s.find(tid,h);
+    if (!(entry && entry->m_tr->ref()))
+	return 0;
+    s.schedule(entry,Time::msecNow());
+    return entry->m_tr;
+}
+
+void SS7TCAPTransactionTable::remove(SS7TCAPTransaction* tr)
+{
+    if (!tr)
+	return;
+    unsigned int h = hash(tr->toString());
+    TCAPTransShard& s = shard(h);
+    s.lock();
+    TCAPTransEntry* entry = s.remove(tr,h);
+    s.unlock();
+    // release the transaction without holding the lock
+    TelEngine::destruct(entry);
+}
+
+void SS7TCAPTransactionTable::schedule(SS7TCAPTransaction* tr, u_int64_t due)
+{
+    unsigned int h = hash(tr->toString());
+    TCAPTransShard& s = shard(h);
+    Lock lock(s);
+    TCAPTransEntry* entry = s.find(tr->toString(),h);
+    if (entry && entry->m_tr == tr)
+	s.schedule(entry,due);
+}
+
+void SS7TCAPTransactionTable::expire(u_int64_t now, ObjList& due)
+{
+    ObjList* last = &due;
+    for (unsigned int i = 0; i < TCAP_SHARDS; i++) {
+	Lock lock(m_shards[i]);
+	m_shards[i].expire(now,last);
+    }
+}
+
+void SS7TCAPTransactionTable::clear()
+{
+    for (unsigned int i = 0; i < TCAP_SHARDS; i++) {
+	ObjList tmp;
+	ObjList* last = &tmp;
+	TCAPTransShard& s = m_shards[i];
+	s.lock();
+	for (unsigned int b = 0; b < s.m_size; b++) {
+	    ObjList* o = s.m_buckets[b].skipNull();
+	    while (o) {
+		last = last->append(o->remove(false));
+		o = o->skipNull();
+	    }
+	    s.m_buckets[b].compact();
+	}
+	s.m_count = 0;
+	s.unlock();
+    }
+}
+
 SS7TCAP::SS7TCAP(const NamedList& params)
     : SCCPUser(params),
       m_usersMtx(true,"TCAPUsers"),
@@ -264,13 +529,14 @@ SS7TCAP::SS7TCAP(const NamedList& params)
       m_defaultRemotePC(0),
       m_remoteTypePC(SS7PointCode::Other),
       m_trTimeout(300),
-      m_transactionsMtx(true,"TCAPTransactions"),
+      m_transactions(new SS7TCAPTransactionTable),
       m_tcapType(UnknownTCAP),
       m_idsPool(0)
 {
     Debug(this,DebugAll,"SS7TCAP::SS7TCAP() [%p] created",this);
     m_recvMsgs = m_sentMsgs = m_discardMsgs = m_normalMsgs = m_abnormalMsgs = 0;
     m_ssnStatus = SCCPManagement::UserOutOfService;
+    timerDriven(true);
 }
 
 SS7TCAP::~SS7TCAP()
@@ -289,7 +555,8 @@ SS7TCAP::~SS7TCAP()
 	}
 	m_users.setDelete(false);
     }
-    m_transactions.clear();
+    m_transactions->clear();
+    TelEngine::destruct(m_transactions);
     m_inQueue.clear();
 
 }
@@ -497,13 +764,17 @@ void SS7TCAP::enqueue(SS7TCAPMessage* msg)
     Lock lock(m_inQueueMtx);
     m_inQueue.append(msg);
     XDebug(this,DebugAll,"SS7TCAP::enqueue(). Enqueued transaction wrapper (%p) [%p]",msg,this);
+    tickRequest();
 }
 
 SS7TCAPMessage* SS7TCAP::dequeue()
 {
     Lock lock(m_inQueueMtx,SignallingEngine::maxLockWait());
-    if (!lock.locked())
+    if (!lock.locked()) {
+	// messages left in queue are processed on next tick
+	tickRequest();
 	return 0;
+    }
     ObjList* obj = m_inQueue.skipNull();
     if (!obj)
 	return 0;
@@ -596,20 +867,17 @@ void SS7TCAP::userStatus(NamedList& status)
 
 SS7TCAPTransaction* SS7TCAP::getTransaction(const String& tid)
 {
-    SS7TCAPTransaction* tr = 0;
-    Lock lock(m_transactionsMtx);
-    ObjList* o = m_transactions.find(tid);
-    if (o)
-	tr = static_cast<SS7TCAPTransaction*>(o->get());
-    if (tr && tr->ref())
-	return tr;
-    return 0;
+    return m_transactions->find(tid);
 }
 
 void SS7TCAP::removeTransaction(SS7TCAPTransaction* tr)
 {
-    Lock lock(m_transactionsMtx);
-    m_transactions.remove(tr);
+    m_transactions->remove(tr);
+}
+
+unsigned int SS7TCAP::transactionCount() const
+{
+    return m_transactions->count();
 }
 
 void SS7TCAP::timerTick(const Time& when)
@@ -624,17 +892,17 @@ void SS7TCAP::timerTick(const Time& when)
 	msg = dequeue();
     }
 
-    // update/handle rest of transactions
-    Lock lock(m_transactionsMtx);
-    ListIterator iter(m_transactions);
-    for (;;) {
-	SS7TCAPTransaction* tr = static_cast<SS7TCAPTransaction*>(iter.get());
-	// End of iteration?
-	if (!tr)
-	    break;
-	if (!tr->ref())
+    // update/handle transactions that were used or whose timers expired
+    u_int64_t now = when.msec();
+    ObjList due;
+    m_transactions->expire(now,due);
+    for (ObjList* o = due.skipNull(); o; o = o->skipNext()) {
+	SS7TCAPTransaction* tr = static_cast<SS7TCAPTransaction*>(o->get());
+	// still referenced by the table and by us, otherwise it's being processed by someone else
+	if (tr->refcount() > 2) {
+	    m_transactions->schedule(tr,now);
 	    continue;
-	lock.drop();
+	}
 	NamedList params("");
 	DataBlock data;
 	if (tr->transactionState() != SS7TCAPTransaction::Idle)
@@ -653,9 +921,11 @@ void SS7TCAP::timerTick(const Time& when)
 
 	if (tr->transactionState() == SS7TCAPTransaction::Idle)
 	    removeTransaction(tr);
-	TelEngine::destruct(tr);
-	if (!lock.acquire(m_transactionsMtx))
-	    break;
+	else {
+	    u_int64_t t = tr->nextTimeout();
+	    if (t)
+		m_transactions->schedule(tr,t);
+	}
     }
 }
 
@@ -700,9 +970,7 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 		allocTransactionID(newID);
 		tr = buildTransaction(type,newID,msgParams,false);
 		tr->ref();
-		m_transactionsMtx.lock();
-		m_transactions.append(tr);
-		m_transactionsMtx.unlock();
+		m_transactions->add(tr);
 		msgParams.setParam(s_tcapLocalTID,newID);
 	    }
 	    break;
@@ -822,9 +1090,7 @@ SS7TCAPError SS7TCAP::userRequest(NamedList& params)
 		if (!TelEngine::null(user))
 		    tr->setUserName(user);
 		tr->ref();
-		m_transactionsMtx.lock();
-		m_transactions.append(tr);
-		m_transactionsMtx.unlock();
+		m_transactions->add(tr);
 		break;
 	    case SS7TCAP::TC_Continue:
 	    case SS7TCAP::TC_ConversationWithPerm:
@@ -1517,6 +1783,18 @@ void SS7TCAPTransaction::checkComponents()
     }
 }
 
+u_int64_t SS7TCAPTransaction::nextTimeout()
+{
+    Lock l(this);
+    u_int64_t t = m_timeout.fireTime();
+    for (ObjList* o = m_components.skipNull(); o; o = o->skipNext()) {
+	u_int64_t c = static_cast<SS7TCAPComponent*>(o->get())->fireTime();
+	if (c && (!t || c < t))
+	    t = c;
+    }
+    return t;
+}
+
 void SS7TCAPTransaction::setTransmitState(TransactionTransmit state)
 {
     Lock l(this);
@@ -1852,7 +2130,7 @@ SS7TCAPANSI::SS7TCAPANSI(const NamedList& params)
 SS7TCAPANSI::~SS7TCAPANSI()
 {
     DDebug(this,DebugAll,"SS7TCAPANSI::~SS7TCAPANSI() [%p] destroyed with %d transactions, refCount=%d",
-		this,m_transactions.count(),refcount());
+		this,transactionCount(),refcount());
 }
 
 SS7TCAPTransaction* SS7TCAPANSI::buildTransaction(SS7TCAP::TCAPUserTransActions type, const String& transactID, NamedList& params,
@@ -3099,7 +3377,7 @@ SS7TCAPITU::SS7TCAPITU(const NamedList& params)
 SS7TCAPITU::~SS7TCAPITU()
 {
     DDebug(this,DebugAll,"SS7TCAPITU::~SS7TCAPITU() [%p] destroyed with %d transactions, refCount=%d",
-	this,m_transactions.count(),refcount());
+	this,transactionCount(),refcount());
 }
 
 SS7TCAPTransaction* SS7TCAPITU::buildTransaction(SS7TCAP::TCAPUserTransActions type, const String& transactID, NamedList& params,
@@ -87,6 +87,7 @@ class SIGAdaptUser;                      // Abstract Adaptation User SIGTRAN
 class ASPUser;                           // Abstract SS7 ASP user interface
 class SCCP;                              // Abstract SS7 SCCP interface
 class GTT;                               // Abstract SCCP Global Title Translation interface
+class GTTTable;                          // Built-in Global Title Translation table
 class SCCPManagement;                    // Abstract SCCP Management interface
 class SCCPUser;                          // Abstract SS7 SCCP user interface
 class TCAPUser;                          // Abstract SS7 TCAP user interface
@@ -96,6 +97,7 @@ class SS7L3User;                         // Abstract user of SS7 layer 3 (networ
 class SS7Layer3;                         // Abstract SS7 layer 3 (network) message transfer part
 class SS7Layer4;                         // Abstract SS7 layer 4 (application) protocol
 class SS7Route;                          // A SS7 MSU route
+class SS7RouteIndex;                     // Point code index of a SS7 routing table
 class SS7Router;                         // Main router for SS7 message transfer and applications
 class SS7M2PA;                           // SIGTRAN MTP2 User Peer-to-Peer Adaptation Layer
 class SS7M2UA;                           // SIGTRAN MTP2 User Adaptation Layer
@@ -109,6 +111,9 @@ class SS7MsgSCCP;                        // SCCP signalling message
 class SS7Management;                     // SS7 SNM implementation
 class SS7ISUPCall;                       // A SS7 ISUP call
 class SS7ISUP;                           // SS7 ISUP implementation
+class SS7ISUPCallIndex;                  // SS7 ISUP calls indexed by circuit code
+class IsupDecoder;                       // SS7 ISUP shared with messages not decoded yet
+struct IsupLazyParams;                   // SS7 ISUP parameters located but not decoded yet
 class SS7BICC;                           // SS7 BICC implementation
 class SS7TUP;                            // SS7 TUP implementation
 class SS7SCCP;                           // SS7 SCCP implementation
@@ -123,6 +128,7 @@ class SS7TCAPMessage;                    // SS7 TCAP message wrapper
 class SS7TCAPError;                      // SS7 TCAP errors
 class SS7TCAP;                           // SS7 TCAP implementation
 class SS7TCAPTransaction;                // SS7 TCAP transaction base class
+class SS7TCAPTransactionTable;           // SS7 TCAP transactions indexed by local ID
 class SS7TCAPComponent;                  // SS7 TCAP component
 class SS7TCAPANSI;                       // SS7 ANSI TCAP implementation
 class SS7TCAPTransactionANSI;            // SS7 TCAP ANSI Transaction
@@ -447,14 +453,14 @@ public:
      * @param time Time to be added to the interval to set the timeout point
      */
     inline void start(u_int64_t time = Time::msecNow())
-	{ if (m_interval) m_timeout = time + m_interval; }
+	{ if (m_interval) schedule(m_timeout = time + m_interval); }
 
     /**
      * Fire the timer at a specific absolute time
      * @param time Absolute time (in msec) when the timer will fire
      */
     inline void fire(u_int64_t time = Time::msecNow())
-	{ m_timeout = time; }
+	{ schedule(m_timeout = time); }
 
     /**
      * Stop the timer
@@ -491,6 +497,16 @@ public:
 	unsigned int minVal, unsigned int defVal, unsigned int maxVal = 0,
 	bool allowDisable = false);
 
+    /**
+     * Record in the engines' timer wheel that a timeout will occur.
+     * Timer driven components are ticked only after such a time has passed.
+     * Timers call this when started, components keeping their own timeouts
+     *  must call it whenever they set one.
+     * This method does not lock, timeouts in the same wheel slot share a mark
+     * @param time Absolute time (in msec) of the timeout
+     */
+    static void schedule(u_int64_t time);
+
 private:
     u_int64_t m_interval;                // Timer interval
     u_int64_t m_timeout;                 // Timeout value
@@ -770,10 +786,38 @@ protected:
      */
     unsigned long tickSleep(unsigned long usec = 1000000) const;
 
+    /**
+     * Set or clear the timer driven flag of this component.
+     * The engine skips ticking a timer driven component until a scheduled
+     *  timeout has passed, a tick was requested or a long idle interval passed.
+     * Set it only if timerTick() has nothing to do unless a SignallingTimer
+     *  or a time given to SignallingTimer::schedule() expired
+     * @param on True if the component only needs ticks when timers expire
+     */
+    inline void timerDriven(bool on)
+	{ m_timerDriven = on; }
+
+    /**
+     * Check if this component is ticked only when timers expire
+     * @return True if the component is timer driven
+     */
+    inline bool timerDriven() const
+	{ return m_timerDriven; }
+
+    /**
+     * Request a timer tick as soon as possible, used by timer driven components
+     *  that have work to do in timerTick() which is not triggered by a timeout.
+     * This method is thread safe
+     */
+    inline void tickRequest()
+	{ SignallingTimer::schedule(Time::msecNow()); }
+
 private:
     SignallingEngine* m_engine;
     String m_name;
     String m_compType;
+    bool m_timerDriven;                  // Ticked only when timers expire
+    u_int64_t m_tickIdle;                // Time of the next idle tick
 };
 
 /**
@@ -875,9 +919,11 @@ public:
      * @param name Static name of the thread
      * @param prio Thread's priority
      * @param usec How long to sleep between iterations in usec, 0 to use library default
+     * @param threads Number of threads ticking components in parallel
      * @return True if (already) started, false if an error occured
      */
-    bool start(const char* name = "Sig Engine", Thread::Priority prio = Thread::Normal, unsigned long usec = 0);
+    bool start(const char* name = "Sig Engine", Thread::Priority prio = Thread::Normal, unsigned long usec = 0,
+	unsigned int threads = 1);
 
     /**
      * Stops and destroys the worker thread if running
@@ -963,10 +1009,21 @@ protected:
     ObjList m_components;
 
 private:
+    // Tick components left in the tick list, run by all ticking threads
+    void tickComponents();
+
     SignallingThreadPrivate* m_thread;
     SignallingNotifier* m_notifier;
     unsigned long m_usecSleep;
     unsigned long m_tickSleep;
+    ObjList m_ticking;                   // Referenced components left to tick
+    Time m_tickTime;                     // Time of the tick in progress
+    SignallingThreadPrivate** m_helpers; // Additional ticking threads
+    unsigned int m_helperCount;
+    unsigned int m_tickBusy;             // Helpers not done with current tick
+    Semaphore m_tickWork;                // Wakes up helpers
+    Semaphore m_tickDone;                // Signals last helper done
+    u_int64_t m_wheelSerial;             // Timer wheel expirations seen
     static long s_maxLockWait;
 };
 
@@ -983,7 +1040,7 @@ public:
      * @param name Named list's name
      */
     inline SignallingMessage(const char* name = 0)
-	: m_params(name)
+	: m_params(name), m_lazy(false)
 	{ }
 
     /**
@@ -998,20 +1055,33 @@ public:
      * @return This message's parameter list
      */
     inline NamedList& params()
-	{ return m_params; }
+	{ if (m_lazy) decodeParams(); return m_params; }
 
     /**
      * Get this message's parameter list - const version
      * @return This message's parameter list
      */
     inline const NamedList& params() const
-	{ return m_params; }
+	{ if (m_lazy) decodeParams(); return m_params; }
 
 protected:
+    /**
+     * Build the parameter list of a message whose decoding was deferred.
+     * Called on first access to the parameters while the lazy flag is set,
+     *  implementations must fill the list then clear the flag
+     */
+    virtual void decodeParams() const
+	{ m_lazy = false; }
+
     /**
      * Message parameter list
      */
-    NamedList m_params;
+    mutable NamedList m_params;
+
+    /**
+     * The parameter list must be built by decodeParams() before use
+     */
+    mutable volatile bool m_lazy;
 };
 
 /**
@@ -1281,6 +1351,7 @@ protected:
 
 private:
     SignallingCircuitGroup* m_circuits;  // Circuit group
+    ObjList m_pollCalls;                 // Referenced calls left to poll for events
     int m_strategy;                      // Strategy to allocate circuits for outgoing calls
     bool m_exiting;                      // Call control is terminating. Generate a Disable event when no more calls
 };
@@ -1362,6 +1433,15 @@ public:
      */
     virtual SignallingEvent* getEvent(const Time& when) = 0;
 
+    /**
+     * Check without locking the call if getEvent() may have something to report.
+     * The call controller uses this to skip idle calls when polling for events
+     * @param when The current time
+     * @return False if getEvent() would surely return no event
+     */
+    virtual bool eventPending(const Time& when) const
+	{ return true; }
+
     /**
      * Event terminated notification. No event will be generated until
      *  the current event is terminated
@@ -1393,8 +1473,17 @@ protected:
     {
 	Lock lock(m_inMsgMutex);
 	m_inMsg.clear();
+	m_inMsgCount = 0;
     }
 
+    /**
+     * Check if there are incoming messages in queue.
+     * The check is made without locking so it's just a hint
+     * @return True if the queue is not empty
+     */
+    inline bool queued() const
+	{ return 0 != m_inMsgCount; }
+
     /**
      * Last event generated by this call. Used to serialize events
      */
@@ -1410,6 +1499,7 @@ private:
     bool m_outgoing;                     // Call direction
     bool m_signalOnly;                   // Just signalling flag
     ObjList m_inMsg;                     // Incoming messages queue
+    unsigned int m_inMsgCount;           // Number of messages in queue
     Mutex m_inMsgMutex;                  // Lock incoming messages queue
     void* m_private;                     // Private user data
 };
@@ -1904,6 +1994,13 @@ public:
      */
     SignallingCircuitEvent* getEvent(const Time& when);
 
+    /**
+     * Check if there may be events in queue. The check is made without locking
+     * @return False if getEvent() would surely return no event
+     */
+    inline bool hasEvents() const
+	{ return !m_noEvents; }
+
     /**
      * Send an event through this circuit
      * @param type The type of the event to send
@@ -2355,7 +2452,11 @@ private:
     unsigned int advance(unsigned int n, int strategy, SignallingCircuitRange& range);
     void clearAll();
 
+    void indexCircuit(unsigned int code, SignallingCircuit* circuit);
+
     ObjList m_circuits;                  // The circuits belonging to this group
+    SignallingCircuit** m_index;         // Circuits indexed by code
+    unsigned int m_indexSize;            // Length of circuit index
     ObjList m_spans;                     // The spans belonging to this group
     ObjList m_ranges;                    // Additional circuit ranges
     SignallingCircuitRange m_range;      // Range containing all circuits belonging to this group
@@ -5173,7 +5274,8 @@ public:
     virtual ~GTT();
 
     /**
-     * Route a SCCP message based on Global Title
+     * Route a SCCP message based on Global Title.
+     * The default implementation looks up the built-in translation table
      * @param gt The original global title used for message routing
      * @param prefix Optional prefix for gt params
      * @param nextPrefix Optional prefix for gt params
@@ -5182,10 +5284,37 @@ public:
     virtual NamedList* routeGT(const NamedList& gt, const String& prefix, const String& nextPrefix);
 
     /**
-     * Initialize this GTT
+     * Initialize this GTT, (re)load the translation table named by the
+     *  "table" parameter
      */
     virtual bool initialize(const NamedList* config);
 
+    /**
+     * Replace the built-in translation table.
+     * The new table is built aside and swapped in, translations in progress
+     *  complete on the old table
+     * @param entries List of NamedList, each describing one translation
+     * @return Number of translations loaded
+     */
+    unsigned int setTable(const ObjList& entries);
+
+    /**
+     * Load the built-in translation table from a file, each section other
+     *  than [general] describes one translation
+     * @param file Path of the file to load
+     * @return True if the file was loaded, false if it could not be read
+     */
+    bool loadTable(const String& file);
+
+    /**
+     * Translate a Global Title using only the built-in table
+     * @param gt The original global title used for message routing
+     * @param prefix Prefix of the global title parameters
+     * @return A new SCCP called party address or null if no entry matched
+     *  or all the entry's destinations are unavailable
+     */
+    NamedList* routeTable(const NamedList& gt, const String& prefix);
+
     /**
      * Attach a SCCP to us
      * @param sccp Pointer to the SCCP to use
@@ -5194,11 +5323,12 @@ public:
 
     /**
      * Request to update Translations tables.
-     * Called when a remote pointcode or ssn has become reachable / unreachable
+     * Called when a remote pointcode or ssn has become reachable / unreachable.
+     * The default implementation switches built-in table entries to their
+     *  backup destination while the primary one is unavailable
      * @param params List of parameters that fired this request
      */
-    virtual void updateTables(const NamedList& params)
-	{ }
+    virtual void updateTables(const NamedList& params);
 
     /**
      * Retrieve the SCCP attached to this translator
@@ -5211,8 +5341,13 @@ protected:
     virtual void destroyed();
 
 private:
+    // Check if a destination was reported unavailable
+    bool unavailable(int pc, int ssn);
     SCCP* m_sccp;
-
+    GTTTable* m_table;                   // Built-in translations
+    ObjList m_down;                      // Unavailable destinations
+    bool m_hasDown;
+    Mutex m_tableMutex;
 };
 
 /**
@@ -6237,8 +6372,7 @@ public:
     /**
      * Destructor
      */
-    virtual ~SS7Layer3()
-	 { attach(0); }
+    virtual ~SS7Layer3();
 
     /**
      * Initialize the network layer, connect it to the SS7 router
@@ -6591,12 +6725,29 @@ protected:
 
     /**
      * Find a route having the specified point code type and packed point code.
-     * This method is thread safe
+     * This method is thread safe and does not lock the routing table, it looks
+     *  up the point code index built by @ref updateRouteIndex()
      * @param type The point code type used to choose the list of packed point codes
      * @param packed The packed point code to find in the list
-     * @return SS7Route pointer or 0 if type is invalid or the given packed point code was not found
+     * @return Referenced route, NULL if type is invalid or the given packed point code was not found
      */
-    SS7Route* findRoute(SS7PointCode::Type type, unsigned int packed);
+    RefPointer<SS7Route> findRoute(SS7PointCode::Type type, unsigned int packed);
+
+    /**
+     * Rebuild the point code index after the routing table was changed.
+     * This method locks the routing table mutex. It waits for the lock free readers
+     *  of the replaced indexes then releases them and the routes passed to @ref retireRoute()
+     * @return Total number of indexed routes
+     */
+    unsigned int updateRouteIndex();
+
+    /**
+     * Keep a route removed from the routing table until no reader can use it.
+     * This method locks the routing table mutex, the route is released by the
+     *  next call to @ref updateRouteIndex()
+     * @param route Route removed from the table, its reference is taken over
+     */
+    void retireRoute(SS7Route* route);
 
     /**
      * Retrieve the route table for a specific Point Code type
@@ -6621,6 +6772,12 @@ protected:
     ObjList m_route[YSS7_PCTYPE_COUNT];
 
 private:
+    unsigned int enterRouteIndex();
+    void leaveRouteIndex(unsigned int slot);
+    SS7RouteIndex* m_routeIndex[YSS7_PCTYPE_COUNT]; // Lock free lookup indexes of routes
+    ObjList m_routeRetired;              // Replaced indexes and removed routes
+    volatile unsigned int m_routeEpoch;  // Switched when retired objects are released
+    volatile int m_routeReaders[2];      // Lock free readers by epoch parity
     Mutex m_l3userMutex;                 // Mutex to lock L3 user pointer
     SS7L3User* m_l3user;
     SS7PointCode::Type m_cpType[4];      // Map incoming MSUs net indicators to point code type
@@ -7137,6 +7294,8 @@ private:
     unsigned long m_fwdMsu;
     unsigned long m_failMsu;
     unsigned long m_congestions;
+    unsigned long m_statsMsu;
+    u_int64_t m_statsTime;
     SS7Management* m_mngmt;
 };
 
@@ -8173,6 +8332,7 @@ class YSIG_API SS7MsgISUP : public SignallingMessage
 {
     YCLASS(SS7MsgISUP,SignallingMessage)
     friend class SS7ISUPCall;
+    friend class SS7ISUP;
 public:
     /**
      * ISUP Message type as defined by Q.762 Table 2 and Q.763 Table 4
@@ -8385,14 +8545,13 @@ public:
      * @param cic Source/destination Circuit Identification Code
      */
     inline SS7MsgISUP(Type type, unsigned int cic)
-	: SignallingMessage(lookup(type,"Unknown")), m_type(type), m_cic(cic)
+	: SignallingMessage(lookup(type,"Unknown")), m_type(type), m_cic(cic), m_lazyParams(0)
 	{ }
 
     /**
      * Destructor
      */
-    virtual ~SS7MsgISUP()
-	{ }
+    virtual ~SS7MsgISUP();
 
     /**
      * Get the type of this message
@@ -8408,6 +8567,13 @@ public:
     inline unsigned int cic() const
 	{ return m_cic; }
 
+    /**
+     * Check if a parameter is present in the message without decoding the others
+     * @param param Type of the parameter to look for
+     * @return True if the message holds the parameter
+     */
+    bool hasParam(Parameters param) const;
+
     /**
      * Fill a string with this message's parameters for debug purposes
      * @param dest The destination string
@@ -8443,9 +8609,16 @@ public:
     static inline Type lookup(const char* name, Type defvalue = Unknown)
 	{ return static_cast<Type>(TelEngine::lookup(name,names(),defvalue)); }
 
+protected:
+    /**
+     * Decode the parameters located when the message was received
+     */
+    virtual void decodeParams() const;
+
 private:
     Type m_type;                         // Message type
     unsigned int m_cic;                  // Source/destination Circuit Identification Code
+    IsupLazyParams* m_lazyParams;        // Parameters located when received, decoded on first use
 };
 
 /**
@@ -8661,6 +8834,13 @@ public:
      */
     virtual SignallingEvent* getEvent(const Time& when);
 
+    /**
+     * Check without locking the call if getEvent() may have something to report
+     * @param when The current time
+     * @return False if there are no received messages, expired timers or circuit events
+     */
+    virtual bool eventPending(const Time& when) const;
+
     /**
      * Send an event to this call
      * @param event The event to send
@@ -8788,6 +8968,7 @@ private:
     State m_state;                       // Call state
     bool m_testCall;                     // Test only call
     SignallingCircuit* m_circuit;        // Circuit reserved for this call
+    unsigned int m_indexCic;             // Circuit code this call is indexed by
     String m_cicRange;                   // The range used to re(alloc) a circuit
     SS7Label m_label;                    // The routing label for this call
     bool m_terminate;                    // Termination flag
@@ -9003,6 +9184,19 @@ public:
     bool decodeMessage(NamedList& msg, SS7MsgISUP::Type msgType, SS7PointCode::Type pcType,
 	const unsigned char* paramPtr, unsigned int paramLen);
 
+    /**
+     * Build a message from an ISUP buffer. The parameters are located and checked
+     *  but decoded only when the message's parameter list is first accessed
+     * @param msgType The message type
+     * @param cic The circuit code of the message
+     * @param pcType The point code type (message version)
+     * @param paramPtr Pointer to the Parameter area (just after the message type)
+     * @param paramLen Length of the Parameter area
+     * @return New message or NULL if the buffer could not be parsed
+     */
+    SS7MsgISUP* decodeMessage(SS7MsgISUP::Type msgType, unsigned int cic, SS7PointCode::Type pcType,
+	const unsigned char* paramPtr, unsigned int paramLen);
+
     /**
      * Encode an ISUP list of parameters to a buffer.
      * The input list may contain a 'message-prefix' parameter to override this controller's prefix
@@ -9150,10 +9344,11 @@ private:
     SS7ISUPCall* findCall(unsigned int cic);
     // Find a call by its circuit identification code
     // This method is thread safe
-    inline void findCall(unsigned int cic, RefPointer<SS7ISUPCall>& call) {
-	    Lock mylock(this);
-	    call = findCall(cic);
-	}
+    void findCall(unsigned int cic, RefPointer<SS7ISUPCall>& call);
+    // (Re)index a call by its current circuit code
+    void indexCall(SS7ISUPCall* call);
+    // Remove a call from circuit code index
+    void unindexCall(SS7ISUPCall* call);
     // Encode a raw message
     SS7MSU* encodeRawMessage(SS7MsgISUP::Type type, unsigned char sio,
 	const SS7Label& label, unsigned int cic, const String& param) const;
@@ -9233,6 +9428,8 @@ private:
     u_int64_t m_t27Interval;             // Q.764 T27 Reset after Cont. Check failure
     u_int64_t m_t34Interval;             // Q.764 T34 Segmentation receive timout
     SignallingMessageTimerList m_pending;// Pending messages (RSC ...)
+    SS7ISUPCallIndex* m_callIndex;       // Calls indexed by circuit code
+    IsupDecoder* m_decoder;              // Shared with received messages decoded on first use
     // Remote User Part test
     SignallingTimer m_uptTimer;          // Timer for UPT
     bool m_userPartAvail;                // Flag indicating the remote User Part availability
@@ -11005,6 +11202,12 @@ public:
      */
     void removeTransaction(SS7TCAPTransaction* tr);
 
+    /**
+     * Retrieve the number of transactions currently held by this TCAP
+     * @return Number of transactions
+     */
+    unsigned int transactionCount() const;
+
     /**
      * Method called periodically to do processing and timeout checks
      * @param when Time to use as computing base for events and timeouts
@@ -11157,9 +11360,8 @@ protected:
     SS7PointCode::Type m_remoteTypePC;
     u_int64_t m_trTimeout;
 
-    // list of current TCAP transactions
-    Mutex m_transactionsMtx;
-    ObjList m_transactions;
+    // current TCAP transactions, hashed by local ID
+    SS7TCAPTransactionTable* m_transactions;
     // type of TCAP
     TCAPType m_tcapType;
 
@@ -11514,6 +11716,12 @@ public:
     inline bool timedOut()
 	{ return m_timeout.timeout(); }
 
+    /**
+     * Retrieve the earliest time a timer of this transaction or of its components fires
+     * @return Time in milliseconds of the first timer to fire, 0 if no timer is running
+     */
+    u_int64_t nextTimeout();
+
     /**
      * Find a component with given id
      * @param id Id of component to find
@@ -11691,6 +11899,13 @@ public:
     inline bool timedOut()
 	{ return m_opTimer.timeout(); }
 
+    /**
+     * Retrieve the time when the invocation timer of this component fires
+     * @return Time in milliseconds, 0 if the timer is not running
+     */
+    inline u_int64_t fireTime() const
+	{ return m_opTimer.fireTime(); }
+
     /**
      * Set component state
      * @param state The state to be set
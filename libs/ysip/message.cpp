@@ -23,6 +23,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 
 using namespace TelEngine;
@@ -380,11 +381,35 @@ int SIPMessage::copyAllHeaders(const SIPMessage* message, const char* name, cons
     return c;
 }
 
+// Length of a SIP/x.y protocol version at start of string, zero if there is none
+static int sipVersionLen(const char* s)
+{
+    if (::strncasecmp(s,"SIP/",4) || !::isdigit((unsigned char)s[4])
+	|| s[5] != '.' || !::isdigit((unsigned char)s[6]))
+	return 0;
+    int i = 7;
+    while (::isdigit((unsigned char)s[i]))
+	i++;
+    return i;
+}
+
+// Length of the run of whitespace at start of string
+static inline int sipSpaceLen(const char* s)
+{
+    int i = 0;
+    while (::isspace((unsigned char)s[i]))
+	i++;
+    return i;
+}
+
 bool SIPMessage::parseFirst(String& line)
 {
     XDebug(DebugAll,"SIPMessage::parse firstline= '%s'",line.c_str());
     if (line.null())
 	return false;
+    // follow the engine wide parser selection, fall back to regexps on failure
+    if (URI::fastParse() && parseFirstFast(line))
+	return true;
     static Regexp r("^\\([Ss][Ii][Pp]/[0-9]\\.[0-9]\\+\\)[[:space:]]\\+\\([0-9][0-9][0-9]\\)[[:space:]]\\+\\(.*\\)$");
     if (line.matches(r)) {
 	// Answer: <version> <code> <reason-phrase>
@@ -416,6 +441,64 @@ bool SIPMessage::parseFirst(String& line)
     return true;
 }
 
+// Single pass scanner accepting exactly what the regexps in parseFirst() do
+bool SIPMessage::parseFirstFast(const String& line)
+{
+    const char* s = line.c_str();
+    int v = sipVersionLen(s);
+    if (v) {
+	// Answer: <version> <code> <reason-phrase>
+	int sp = sipSpaceLen(s + v);
+	if (!sp)
+	    return false;
+	const char* c = s + v + sp;
+	if (!(::isdigit((unsigned char)c[0]) && ::isdigit((unsigned char)c[1])
+	    && ::isdigit((unsigned char)c[2])))
+	    return false;
+	sp = sipSpaceLen(c + 3);
+	if (!sp)
+	    return false;
+	m_answer = true;
+	version.assign(s,v).toUpper();
+	code = 100 * (c[0] - '0') + 10 * (c[1] - '0') + (c[2] - '0');
+	reason = c + 3 + sp;
+	DDebug(DebugAll,"got answer version='%s' code=%d reason='%s'",
+	    version.c_str(),code,reason.c_str());
+	return true;
+    }
+    // Request: <method> <uri> <version>
+    int m = 0;
+    while (::isalpha((unsigned char)s[m]))
+	m++;
+    if (!m)
+	return false;
+    int sp = sipSpaceLen(s + m);
+    if (!sp)
+	return false;
+    const char* u = s + m + sp;
+    int ul = 0;
+    while (u[ul] && !::isspace((unsigned char)u[ul]))
+	ul++;
+    if (!ul)
+	return false;
+    sp = sipSpaceLen(u + ul);
+    if (!sp)
+	return false;
+    const char* ver = u + ul + sp;
+    v = sipVersionLen(ver);
+    if (!v || ver[v])
+	return false;
+    m_answer = false;
+    method.assign(s,m).toUpper();
+    uri.assign(u,ul);
+    version.assign(ver,v).toUpper();
+    DDebug(DebugAll,"got request method='%s' uri='%s' version='%s'",
+	method.c_str(),uri.c_str(),version.c_str());
+    if (method == YSTRING("ACK"))
+	m_ack = true;
+    return true;
+}
+
 bool SIPMessage::parse(const char* buf, int len, unsigned int* bodyLen)
 {
     DDebug(DebugAll,"SIPMessage::parse(%p,%d) [%p]",buf,len,this);
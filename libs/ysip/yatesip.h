@@ -510,6 +510,7 @@ public:
 protected:
     bool parse(const char* buf, int len, unsigned int* bodyLen);
     bool parseFirst(String& line);
+    bool parseFirstFast(const String& line);
     SIPParty* m_ep;
     RefPointer<SIPSequence> m_seq;
     bool m_valid;
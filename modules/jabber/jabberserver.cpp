@@ -40,6 +40,8 @@ class YStreamProcess;                    // Stream process (getEvent()) thread
 class YStreamSetProcess;                 // A list of stream process threads
 class YJBConnectThread;                  // Stream connect thread
 class YJBEntityCapsList;                 // Entity capbilities
+class PresenceFanout;                    // A presence built once and sent to many destinations
+class PresenceFanoutList;                // Recently built presences
 class YJBEngine;                         // Jabber engine
 class JBPendingJob;                      // A pending stanza waiting to be routed/processed
 class JBPendingWorker;                   // A thread processing pending jobs containing stanzas with
@@ -108,8 +110,9 @@ protected:
 class YStreamSetReceive : public JBStreamSetList
 {
 public:
-    inline YStreamSetReceive(JBEngine* engine, unsigned int max, const char* name)
-	: JBStreamSetList(engine,max,0,name)
+    inline YStreamSetReceive(JBEngine* engine, unsigned int max, const char* name,
+	unsigned int maxSets = 0)
+	: JBStreamSetList(engine,max,0,name,maxSets)
 	{}
 protected:
     virtual JBStreamSet* build()
@@ -140,8 +143,9 @@ protected:
 class YStreamSetProcess : public JBStreamSetList
 {
 public:
-    inline YStreamSetProcess(JBEngine* engine, unsigned int max, const char* name)
-	: JBStreamSetList(engine,max,0,name)
+    inline YStreamSetProcess(JBEngine* engine, unsigned int max, const char* name,
+	unsigned int maxSets = 0)
+	: JBStreamSetList(engine,max,0,name,maxSets)
 	{}
 protected:
     virtual JBStreamSet* build()
@@ -187,6 +191,44 @@ protected:
     String m_file;
 };
 
+/*
+ * A presence stanza built once and sent to many destinations.
+ * The element and its data don't have a 'to' attribute: clients get the same
+ *  shared data, the attribute is added to the data sent to other servers
+ */
+class PresenceFanout : public RefObject
+{
+public:
+    PresenceFanout(const String& key, XmlElement* xml);
+    // Retrieve the stanza to send to a given destination
+    // The stanza has no 'to' attribute if the destination is empty
+    // Return a referenced object
+    XmlElementShared* build(const String& to) const;
+    virtual const String& toString() const
+	{ return m_key; }
+private:
+    String m_key;                        // Notification operation, sender and presence data
+    RefPointer<XmlElementShared> m_xml;  // The presence without 'to' attribute
+    unsigned int m_toPos;                // Offset of the 'to' attribute in presence data
+};
+
+/*
+ * Recently built presences kept to be sent to all subscribers of an user
+ */
+class PresenceFanoutList : public Mutex
+{
+public:
+    inline PresenceFanoutList()
+	: Mutex(false,"PresenceFanoutList")
+	{}
+    // Retrieve the presence of a resource.notify message. Build and keep it if not found
+    // Return a referenced object
+    PresenceFanout* get(Message& msg, const String& oper, const char* from,
+	XMPPUtils::Presence presType);
+private:
+    RefPointer<PresenceFanout> m_list[64];
+};
+
 /*
  * Jabber engine
  */
@@ -318,10 +360,10 @@ public:
 	const NamedList* params = 0);
     // Notify online/offline presence from client streams
     void notifyPresence(JBClientStream& cs, bool online, XmlElement* xml,
-	const String& capsId);
+	int prio, const String& capsId);
     // Notify directed online/offline presence
     void notifyPresence(const JabberID& from, const JabberID& to, bool online,
-	XmlElement* xml, bool fromRemote, bool toRemote, const String& capsId);
+	XmlElement* xml, int prio, bool fromRemote, bool toRemote, const String& capsId);
     // Build a jabber.feature message
     Message* jabberFeature(XmlElement* xml, XMPPNamespace::Type t, JBStream::Type sType,
 	const char* from, const char* to = 0, const char* operation = 0);
@@ -654,6 +696,7 @@ static const String s_yate = "yate";
 static ObjList s_clusterControlSkip;     // Params to skip from chan.control when sent in cluster
 INIT_PLUGIN(JBModule);                   // The module
 static YJBEntityCapsList s_entityCaps;
+static PresenceFanoutList s_presences;
 static YJBEngine* s_jabber = 0;
 
 // Commands help
@@ -1032,6 +1075,73 @@ void YJBEntityCapsList::save()
 }
 
 
+/*
+ * PresenceFanout
+ */
+PresenceFanout::PresenceFanout(const String& key, XmlElement* xml)
+    : m_key(key), m_toPos(0)
+{
+    xml->removeAttribute("to");
+    String buf;
+    xml->toString(buf);
+    // Attribute values are escaped: the first '>' ends the start tag
+    int pos = buf.find('>');
+    if (pos > 0 && buf.at(pos - 1) == '/')
+	pos--;
+    m_toPos = (pos > 0) ? pos : buf.length();
+    XmlElementShared* shared = new XmlElementShared(xml,&buf);
+    m_xml = shared;
+    TelEngine::destruct(shared);
+}
+
+// Retrieve the stanza to send to a given destination
+XmlElementShared* PresenceFanout::build(const String& to) const
+{
+    XmlElementShared* shared = m_xml;
+    if (!to)
+	return shared->ref() ? shared : 0;
+    const String& buf = shared->data();
+    String data(buf.c_str(),m_toPos);
+    data << " to=\"";
+    XmlSaxParser::escape(data,to);
+    data << "\"" << (buf.c_str() + m_toPos);
+    return new XmlElementShared(shared,data);
+}
+
+
+/*
+ * PresenceFanoutList
+ */
+// Retrieve the presence of a resource.notify message. Build and keep it if not found
+PresenceFanout* PresenceFanoutList::get(Message& msg, const String& oper, const char* from,
+    XMPPUtils::Presence presType)
+{
+    const String& data = msg["data"];
+    // Presence carried by an element or built from parameters is used once
+    if (!data || XMPPUtils::getXml(msg.getParam("xml"),false))
+	return new PresenceFanout(String::empty(),getPresenceXml(msg,from,presType));
+    String key;
+    key << oper << " " << from << " " << data;
+    unsigned int idx = key.hash() % (sizeof(m_list) / sizeof(m_list[0]));
+    lock();
+    PresenceFanout* pres = m_list[idx];
+    if (pres && pres->toString() == key && pres->ref()) {
+	unlock();
+	return pres;
+    }
+    unlock();
+    XmlElement* xml = XMPPUtils::getXml(data);
+    if (!xml)
+	return new PresenceFanout(String::empty(),getPresenceXml(msg,from,presType));
+    xml->setAttribute("from",from);
+    pres = new PresenceFanout(key,xml);
+    lock();
+    m_list[idx] = pres;
+    unlock();
+    return pres;
+}
+
+
 /*
  * YJBEngine
  */
@@ -1040,8 +1150,10 @@ YJBEngine::YJBEngine()
     m_allowUnsecurePlainAuth(false),
     m_plainAuthOnly(false)
 {
-    m_c2sReceive = new YStreamSetReceive(this,10,"c2s/recv");
-    m_c2sProcess = new YStreamSetProcess(this,10,"c2s/process");
+    // Receive threads waiting for socket events and process threads handling only
+    //  the streams needing it are not limited by the number of streams
+    m_c2sReceive = new YStreamSetReceive(this,10,"c2s/recv",JBStreamSetReceive::maxSets());
+    m_c2sProcess = new YStreamSetProcess(this,10,"c2s/process",JBStreamSetProcessor::maxSets());
     m_s2sReceive = new YStreamSetReceive(this,0,"s2s/recv");
     m_s2sProcess = new YStreamSetProcess(this,0,"s2s/process");
     m_compReceive = new YStreamSetReceive(this,0,"comp/recv");
@@ -1602,84 +1714,104 @@ bool YJBEngine::handleResSubscribe(Message& msg)
 }
 
 // Process 'resource.notify' messages
+// Destinations are given in 'to' or in a 'to.N' parameters list
 bool YJBEngine::handleResNotify(Message& msg)
 {
     String* oper = msg.getParam("operation");
     if (TelEngine::null(oper))
 	return false;
     JabberID from(msg.getValue("from"));
-    JabberID to(msg.getValue("to"));
-    if (!(from.node() && to.node()))
+    if (!from.node())
 	return false;
-    Debug(this,DebugAll,"Processing %s from=%s to=%s oper=%s",
-	msg.c_str(),from.c_str(),to.c_str(),oper->c_str());
-    XmlElement* xml = 0;
-    bool c2s = hasDomain(to.domain()) && !hasComponent(to.domain());
+    XMPPUtils::Presence presType = XMPPUtils::PresenceNone;
+    // (Un)subscribed and probe are sent from/to bare jids, not sent to clients
+    bool bare = false;
     bool online = (*oper == "online" || *oper == "update");
     if (online  || *oper == "offline" || *oper == "delete") {
-	if (!from.resource())
-	    from.resource(msg.getValue("from_instance"));
+	if (!online)
+	    presType = XMPPUtils::Unavailable;
+    }
+    else if (*oper == "subscribed" || *oper == "unsubscribed") {
+	presType = (*oper == "subscribed") ? XMPPUtils::Subscribed : XMPPUtils::Unsubscribed;
+	bare = true;
+    }
+    else if (*oper == "probe") {
+	presType = XMPPUtils::Probe;
+	bare = true;
+    }
+    else if (*oper == "error")
+	presType = XMPPUtils::PresenceError;
+    else
+	return false;
+    if (bare)
+	from.resource("");
+    else if (!from.resource()) {
+	from.resource(msg.getValue("from_instance"));
 	if (!from.resource() && online)
 	    return false;
-	if (!to.resource())
-	    to.resource(msg.getValue("to_instance"));
-	xml = getPresenceXml(msg,from,
-	    online ? XMPPUtils::PresenceNone : XMPPUtils::Unavailable);
     }
-    else {
-	bool sub = (*oper == "subscribed");
-	if (sub || *oper == "unsubscribed") {
-	    // Don't sent (un)subscribed to clients
-	    if (c2s)
-		return false;
-	    // Make sure 'to' is a bare jid
-	    to.resource("");
-	    xml = getPresenceXml(msg,from.bare(),
-		sub ? XMPPUtils::Subscribed : XMPPUtils::Unsubscribed);
+    ObjList dest;
+    ObjList* last = &dest;
+    unsigned int n = msg.getParam("to") ? 0 : msg.getIntValue("to.count");
+    for (unsigned int i = 0; i <= n; i++) {
+	String to("to");
+	String inst("to_instance");
+	if (i) {
+	    to << "." << i;
+	    inst << "." << i;
 	}
-	else if (*oper == "probe") {
-	    // Don't sent probe to clients
-	    if (c2s)
-		return false;
-	    // Make sure 'to' is a bare jid
-	    to.resource("");
-	    xml = getPresenceXml(msg,from.bare(),XMPPUtils::Probe);
-	}
-	else if (*oper == "error") {
-	    if (!from.resource())
-		from.resource(msg.getValue("from_instance"));
-	    if (!to.resource())
-		to.resource(msg.getValue("to_instance"));
-	    xml = getPresenceXml(msg,from,XMPPUtils::PresenceError);
+	JabberID* jid = new JabberID(msg.getValue(to));
+	if (!jid->node()) {
+	    TelEngine::destruct(jid);
+	    continue;
 	}
-	else
-	    return false;
-    }
+	// Make sure 'to' is a bare jid when required
+	if (bare)
+	    jid->resource("");
+	else if (!jid->resource())
+	    jid->resource(msg.getValue(inst));
+	last = last->append(jid);
+    }
+    if (!dest.skipNull())
+	return false;
+    // The same presence is notified to all subscribers of an user:
+    //  build it once, queue the same data on all client streams
+    PresenceFanout* pres = s_presences.get(msg,*oper,from,presType);
     bool ok = false;
-    if (c2s) {
-	// We don't need to send the 'to' attribute
-	// Remove it to make sure we don't send a wrong value (trust the
-	// 'to' parameter received with the message)
-	xml->removeAttribute("to");
-	// Ignore streams whose clients didn't sent the initial presence
-	if (to.resource()) {
-	    JBClientStream* s = findClientStream(true,to);
-	    ok = s && s->flag(JBStream::AvailableResource) && s->sendStanza(xml);
-	    TelEngine::destruct(s);
-	}
-	else {
-	    ObjList* list = findClientStreams(true,to,JBStream::AvailableResource);
-	    ok = sendStanza(xml,list);
+    ObjList clients;
+    last = &clients;
+    for (ObjList* o = dest.skipNull(); o; o = o->skipNext()) {
+	JabberID* to = static_cast<JabberID*>(o->get());
+	Debug(this,DebugAll,"Processing %s from=%s to=%s oper=%s",
+	    msg.c_str(),from.c_str(),to->c_str(),oper->c_str());
+	if (hasDomain(to->domain()) && !hasComponent(to->domain())) {
+	    if (!bare) {
+		last = last->append(to);
+		last->setDelete(false);
+	    }
+	    continue;
 	}
-    }
-    else {
 	// Make sure the 'to' attribute is correct
-	xml->setAttribute("to",to);
-	JBStream* stream = getServerStream(from,to);
-	ok = stream && stream->sendStanza(xml);
+	JBStream* stream = getServerStream(from,*to);
+	if (stream) {
+	    XmlElementShared* xml = pres->build(*to);
+	    ok = stream->sendStanza(xml) || ok;
+	    TelEngine::destruct(xml);
+	}
 	TelEngine::destruct(stream);
     }
-    TelEngine::destruct(xml);
+    // We don't need to send the 'to' attribute to clients
+    // Don't send a wrong value (trust the 'to' parameter received with the message)
+    // Ignore streams whose clients didn't sent the initial presence
+    // Queue the presence on all client streams, let their sets send it
+    ObjList* streams = findClientStreams(true,clients,JBStream::AvailableResource);
+    if (streams) {
+	XmlElementShared* xml = pres->build(String::empty());
+	ok = (0 != JBEngine::sendStanza(xml,*streams)) || ok;
+	TelEngine::destruct(xml);
+	TelEngine::destruct(streams);
+    }
+    TelEngine::destruct(pres);
     return ok;
 }
 
@@ -1846,11 +1978,22 @@ void YJBEngine::processPresenceStanza(JBEvent* ev)
     XMPPUtils::Presence pres = XMPPUtils::presenceType(ev->stanzaType());
     bool online = false;
     String capsId;
+    int prio = 0;
+    if (pres == XMPPUtils::PresenceNone || pres == XMPPUtils::Unavailable) {
+	// Read from a copy if the content was not parsed: it's notified as received
+	XmlElement* xml = ev->element();
+	XmlElement* copy = xml->rawContent() ? new XmlElement(*xml) : 0;
+	if (copy)
+	    xml = copy;
+	// Update caps
+	if (pres == XMPPUtils::PresenceNone)
+	    s_entityCaps.processCaps(capsId,xml,ev->stream(),ev->to(),ev->from());
+	prio = XMPPUtils::priority(*xml);
+	TelEngine::destruct(copy);
+    }
     switch (pres) {
 	case XMPPUtils::PresenceNone:
 	    online = true;
-	    // Update caps
-	    s_entityCaps.processCaps(capsId,ev->element(),ev->stream(),ev->to(),ev->from());
 	case XMPPUtils::Unavailable:
 	    if (c2s) {
 		bool offlinechat = false;
@@ -1860,13 +2003,12 @@ void YJBEngine::processPresenceStanza(JBEvent* ev)
 			break;
 		    lock.drop();
 		    // Presence broadcast
-		    int prio = XMPPUtils::priority(*ev->element());
 		    offlinechat = c2s->setAvailableResource(online,prio >= 0) &&
 			online && c2s->flag(JBStream::PositivePriority);
-		    notifyPresence(*c2s,online,ev->element(),capsId);
+		    notifyPresence(*c2s,online,ev->element(),prio,capsId);
 		}
 		else
-		    notifyPresence(ev->from(),ev->to(),online,ev->element(),
+		    notifyPresence(ev->from(),ev->to(),online,ev->element(),prio,
 			false,hasDomain(ev->to().domain()),capsId);
 		if (offlinechat) {
 		    Message* m = jabberFeature(0,XMPPNamespace::MsgOffline,
@@ -1891,7 +2033,7 @@ void YJBEngine::processPresenceStanza(JBEvent* ev)
 		return;
 	    }
 	    if (s2s) {
-		notifyPresence(ev->from(),ev->to(),online,ev->element(),true,false,capsId);
+		notifyPresence(ev->from(),ev->to(),online,ev->element(),prio,true,false,capsId);
 		return;
 	    }
 	    break;
@@ -2317,7 +2459,7 @@ void YJBEngine::processStreamEvent(JBEvent* ev)
 		s->remote(jid);
 		// Notify 'offline' for client streams that forgot to send 'unavailable'
 		if (changed && jid.resource())
-		    notifyPresence(*(static_cast<JBClientStream*>(s)),false,0,String::empty());
+		    notifyPresence(*(static_cast<JBClientStream*>(s)),false,0,0,String::empty());
 		// Unregister
 		m = userRegister(*s,false,jid.resource());
 	    }
@@ -2687,20 +2829,15 @@ bool YJBEngine::sendStanza(XmlElement*& xml, ObjList*& streams)
 {
     DDebug(this,DebugAll,"sendStanza(%p,%p)",xml,streams);
     bool ok = false;
-    if (streams && xml) {
-	ObjList* o = streams->skipNull();
-	while (o) {
-	    JBClientStream* stream = static_cast<JBClientStream*>(o->get());
-	    o = o->skipNext();
-	    // Last stream in the list: send the xml (release it)
-	    // Otherwise: send a copy of the element
-	    if (!o)
-		ok = stream->sendStanza(xml) || ok;
-	    else {
-		XmlElement* tmp = new XmlElement(*xml);
-		ok = stream->sendStanza(tmp) || ok;
-	    }
-	}
+    ObjList* o = (streams && xml) ? streams->skipNull() : 0;
+    if (o && !o->skipNext())
+	ok = static_cast<JBClientStream*>(o->get())->sendStanza(xml);
+    else if (o) {
+	// Build the element data once, queue it on all streams
+	XmlElementShared* shared = new XmlElementShared(xml);
+	xml = 0;
+	ok = (0 != JBEngine::sendStanza(shared,*streams));
+	TelEngine::destruct(shared);
     }
     TelEngine::destruct(streams);
     TelEngine::destruct(xml);
@@ -2728,7 +2865,7 @@ JBStream* YJBEngine::getServerStream(const JabberID& from, const JabberID& to,
 
 // Notify online/offline presence from client streams
 void YJBEngine::notifyPresence(JBClientStream& cs, bool online, XmlElement* xml,
-    const String& capsId)
+    int prio, const String& capsId)
 {
     Message* m = __plugin.message("resource.notify");
     m->addParam("operation",online ? "online" : "offline");
@@ -2738,7 +2875,7 @@ void YJBEngine::notifyPresence(JBClientStream& cs, bool online, XmlElement* xml,
     cs.unlock();
     if (online) {
 	if (xml)
-	    m->addParam("priority",String(XMPPUtils::priority(*xml)));
+	    m->addParam("priority",String(prio));
 	if (capsId)
 	    s_entityCaps.addCaps(*m,capsId);
     }
@@ -2748,7 +2885,7 @@ void YJBEngine::notifyPresence(JBClientStream& cs, bool online, XmlElement* xml,
 
 // Notify directed online/offline presence
 void YJBEngine::notifyPresence(const JabberID& from, const JabberID& to, bool online,
-    XmlElement* xml, bool fromRemote, bool toRemote, const String& capsId)
+    XmlElement* xml, int prio, bool fromRemote, bool toRemote, const String& capsId)
 {
     Message* m = __plugin.message("resource.notify");
     m->addParam("operation",online ? "online" : "offline");
@@ -2762,7 +2899,7 @@ void YJBEngine::notifyPresence(const JabberID& from, const JabberID& to, bool on
 	m->addParam("to_local",String::boolText(false));
     if (online) {
 	if (xml)
-	    m->addParam("priority",String(XMPPUtils::priority(*xml)));
+	    m->addParam("priority",String(prio));
 	if (capsId)
 	    s_entityCaps.addCaps(*m,capsId);
     }
@@ -3445,8 +3582,12 @@ void JBPendingWorker::processChat(JBPendingJob& job)
 	// Execute
 	m = "msg.execute";
 	XmlElement* xml = ev->releaseXml();
-	addValidParam(m,"subject",XMPPUtils::subject(*xml));
-	addValidParam(m,"body",XMPPUtils::body(*xml));
+	// Read the text from a copy if the content was not parsed: keep it as received
+	XmlElement* copy = xml->rawContent() ? new XmlElement(*xml) : 0;
+	XmlElement& text = copy ? *copy : *xml;
+	addValidParam(m,"subject",XMPPUtils::subject(text));
+	addValidParam(m,"body",XMPPUtils::body(text));
+	TelEngine::destruct(copy);
 	m.addParam(new NamedPointer("xml",xml));
 	if (!Engine::dispatch(m))
 	    error = XMPPError::Gone;
@@ -59,6 +59,7 @@ private:
     bool evalContext(String& retVal, const String& cmd, ScriptContext* context = 0);
     void clearPostHook();
     JsParser m_assistCode;
+    RefPointer<ScriptContext> m_assistShared;
     MessagePostHook* m_postHook;
     bool m_started;
 };
@@ -631,6 +632,46 @@ private:
     Hasher* m_hasher;
 };
 
+class JsPrefixTable : public JsObject
+{
+    YCLASS(JsPrefixTable,JsObject)
+public:
+    inline JsPrefixTable(Mutex* mtx)
+	: JsObject("PrefixTable",mtx,true),
+	  m_table(0), m_lock("JsPrefixTable")
+	{
+	    XDebug(DebugAll,"JsPrefixTable::JsPrefixTable() [%p]",this);
+	    params().addParam(new ExpFunction("add"));
+	    params().addParam(new ExpFunction("addPrefix"));
+	    params().addParam(new ExpFunction("find"));
+	    params().addParam(new ExpFunction("longest"));
+	    params().addParam(new ExpFunction("count"));
+	    params().addParam(new ExpFunction("clear"));
+	}
+    inline JsPrefixTable(GenObject* context, Mutex* mtx, bool extended, bool insensitive)
+	: JsObject(mtx,"PrefixTable",false),
+	  m_table(new PrefixTable(extended,insensitive)), m_lock("JsPrefixTable")
+	{
+	    XDebug(DebugAll,"JsPrefixTable::JsPrefixTable(%p) [%p]",m_table,this);
+	    setPrototype(context,YSTRING("PrefixTable"));
+	}
+    virtual ~JsPrefixTable()
+	{
+	    if (m_table) {
+		delete m_table;
+		m_table = 0;
+	    }
+	}
+    virtual JsObject* runConstructor(ObjList& stack, const ExpOperation& oper, GenObject* context);
+    static void initialize(ScriptContext* context);
+protected:
+    bool runNative(ObjList& stack, const ExpOperation& oper, GenObject* context);
+private:
+    void pushEntry(ObjList& stack, int index);
+    PrefixTable* m_table;
+    RWLock m_lock;
+};
+
 class JsJSON : public JsObject
 {
     YCLASS(JsJSON,JsObject)
@@ -783,6 +824,16 @@ UNLOAD_PLUGIN(unloadNow)
     return true;
 }
 
+// Drop all objects of a script context, a Javascript one must forget its property index
+static void clearContext(ScriptContext* ctx)
+{
+    JsObject* jso = YOBJECT(JsObject,ctx);
+    if (jso)
+	jso->params().clearParams();
+    else
+	ctx->params().clearParams();
+}
+
 // Load extensions in a script context
 static bool contextLoad(ScriptContext* ctx, const char* name, const char* libs = 0, const char* objs = 0)
 {
@@ -826,12 +877,112 @@ static void contextInit(ScriptRun* runner, const char* name = 0, JsAssist* assis
     JsConfigFile::initialize(ctx);
     JsXML::initialize(ctx);
     JsHasher::initialize(ctx);
+    JsPrefixTable::initialize(ctx);
     JsJSON::initialize(ctx);
     JsDNS::initialize(ctx);
     if (s_autoExt)
 	contextLoad(ctx,name);
 }
 
+// Context holding the objects shared by all calls of the routing script
+// Objects created by the shared constructors are not serialized by it
+class JsSnapshot : public ScriptContext
+{
+public:
+    virtual Mutex* mutex()
+	{ return 0; }
+    virtual bool unshareField(const String& name, ScriptContext& context) const;
+private:
+    void clearShared(NamedList& params, const String& name) const;
+};
+
+// Create the native objects again in a call context before its script changes them
+bool JsSnapshot::unshareField(const String& name, ScriptContext& context) const
+{
+    NamedList& p = context.params();
+    if (name == YSTRING("Object") || name == YSTRING("Function") || name == YSTRING("Array")
+	    || name == YSTRING("RegExp") || name == YSTRING("Date") || name == YSTRING("Math")) {
+	// these refer to each other so they are copied together
+	clearShared(p,YSTRING("Object"));
+	clearShared(p,YSTRING("Function"));
+	clearShared(p,YSTRING("Array"));
+	clearShared(p,YSTRING("RegExp"));
+	clearShared(p,YSTRING("Date"));
+	clearShared(p,YSTRING("Math"));
+	JsObject::initialize(&context);
+    }
+    else if (name == YSTRING("File")) {
+	clearShared(p,name);
+	JsFile::initialize(&context);
+    }
+    else if (name == YSTRING("ConfigFile")) {
+	clearShared(p,name);
+	JsConfigFile::initialize(&context);
+    }
+    else if (name == YSTRING("XML")) {
+	clearShared(p,name);
+	JsXML::initialize(&context);
+    }
+    else if (name == YSTRING("Hasher")) {
+	clearShared(p,name);
+	JsHasher::initialize(&context);
+    }
+    else if (name == YSTRING("PrefixTable")) {
+	clearShared(p,name);
+	JsPrefixTable::initialize(&context);
+    }
+    else if (name == YSTRING("JSON")) {
+	clearShared(p,name);
+	JsJSON::initialize(&context);
+    }
+    else if (name == YSTRING("DNS")) {
+	clearShared(p,name);
+	JsDNS::initialize(&context);
+    }
+    else
+	return false;
+    return true;
+}
+
+// Remove a field only if it still refers to the shared object
+void JsSnapshot::clearShared(NamedList& params, const String& name) const
+{
+    JsObject* jso = YOBJECT(JsObject,params.getParam(name));
+    if (jso && jso == YOBJECT(JsObject,this->params().getParam(name)))
+	params.clearParam(name);
+}
+
+// Build the native objects and the global functions of the script once per load
+// Calls get references to them and copy one only before their script changes it
+// Engine, Channel and Message hold per call state and are created by contextInit
+static ScriptContext* contextSnapshot(const JsParser& parser)
+{
+    if (!parser.code())
+	return 0;
+    ScriptContext* ctx = new JsSnapshot;
+    JsObject::initialize(ctx);
+    JsFile::initialize(ctx);
+    JsConfigFile::initialize(ctx);
+    JsXML::initialize(ctx);
+    JsHasher::initialize(ctx);
+    JsPrefixTable::initialize(ctx);
+    JsJSON::initialize(ctx);
+    JsDNS::initialize(ctx);
+    parser.code()->initialize(ctx);
+    // a call changing a shared object or prototype, even through an object
+    //  created before, gets its own copy and uses it from then on
+    for (ObjList* l = ctx->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	JsObject* jso = YOBJECT(JsObject,l->get());
+	if (!jso)
+	    continue;
+	jso->setSnapshot();
+	JsObject* proto = YOBJECT(JsObject,jso->params().getParam(YSTRING("prototype")));
+	if (proto)
+	    proto->setSnapshot();
+    }
+    return ctx;
+}
+
 // Build a tabular dump of an Object or Array
 static void dumpTable(const ExpOperation& oper, String& str, const char* eol)
 {
@@ -3092,6 +3243,117 @@ bool JsHasher::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 }
 
 
+JsObject* JsPrefixTable::runConstructor(ObjList& stack, const ExpOperation& oper,
+    GenObject* context)
+{
+    XDebug(&__plugin,DebugAll,"JsPrefixTable::runConstructor '%s'(" FMT64 ") [%p]",
+	oper.name().c_str(),oper.number(),this);
+    ObjList args;
+    bool extended = false;
+    bool insensitive = false;
+    switch (extractArgs(stack,oper,context,args)) {
+	case 2:
+	    insensitive = static_cast<ExpOperation*>(args[1])->valBoolean();
+	    // fall through
+	case 1:
+	    extended = static_cast<ExpOperation*>(args[0])->valBoolean();
+	    // fall through
+	case 0:
+	    break;
+	default:
+	    return 0;
+    }
+    return new JsPrefixTable(context,mutex(),extended,insensitive);
+}
+
+void JsPrefixTable::initialize(ScriptContext* context)
+{
+    if (!context)
+	return;
+    Mutex* mtx = context->mutex();
+    Lock mylock(mtx);
+    NamedList& params = context->params();
+    if (!params.getParam(YSTRING("PrefixTable")))
+	addConstructor(params,"PrefixTable",new JsPrefixTable(mtx));
+}
+
+// Push the value stored in an entry, its pattern if it has none or null if not found
+void JsPrefixTable::pushEntry(ObjList& stack, int index)
+{
+    if (index < 0) {
+	ExpEvaluator::pushOne(stack,JsParser::nullClone());
+	return;
+    }
+    const ExpOperation* val = static_cast<const ExpOperation*>(m_table->data(index));
+    if (val)
+	ExpEvaluator::pushOne(stack,val->clone(""));
+    else
+	ExpEvaluator::pushOne(stack,new ExpOperation(m_table->pattern(index)));
+}
+
+bool JsPrefixTable::runNative(ObjList& stack, const ExpOperation& oper, GenObject* context)
+{
+    XDebug(&__plugin,DebugAll,"JsPrefixTable::runNative '%s'(" FMT64 ") [%p]",
+	oper.name().c_str(),oper.number(),this);
+    if (oper.name() == YSTRING("add")) {
+	if (!m_table)
+	    return false;
+	ObjList args;
+	ExpOperation* pattern = 0;
+	ExpOperation* value = 0;
+	if (!extractStackArgs(1,this,stack,oper,context,args,&pattern,&value))
+	    return false;
+	WLock lck(m_lock);
+	unsigned int index = m_table->add(*pattern,value ? value->clone("") : 0);
+	lck.drop();
+	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)index));
+    }
+    else if (oper.name() == YSTRING("addPrefix")) {
+	if (!m_table)
+	    return false;
+	ObjList args;
+	ExpOperation* prefix = 0;
+	ExpOperation* value = 0;
+	ExpOperation* exact = 0;
+	if (!extractStackArgs(1,this,stack,oper,context,args,&prefix,&value,&exact))
+	    return false;
+	WLock lck(m_lock);
+	unsigned int index = m_table->addPrefix(*prefix,value ? value->clone("") : 0,
+	    exact && exact->valBoolean());
+	lck.drop();
+	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)index));
+    }
+    else if (oper.name() == YSTRING("find") || oper.name() == YSTRING("longest")) {
+	if (!m_table)
+	    return false;
+	ObjList args;
+	ExpOperation* str = 0;
+	if (!extractStackArgs(1,this,stack,oper,context,args,&str,0))
+	    return false;
+	RLock lck(m_lock);
+	if (oper.name() == YSTRING("find"))
+	    pushEntry(stack,m_table->find(*str));
+	else
+	    pushEntry(stack,m_table->longest(*str));
+    }
+    else if (oper.name() == YSTRING("count")) {
+	if (!m_table || oper.number())
+	    return false;
+	RLock lck(m_lock);
+	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)m_table->count()));
+    }
+    else if (oper.name() == YSTRING("clear")) {
+	if (!m_table || oper.number())
+	    return false;
+	WLock lck(m_lock);
+	m_table->clear();
+    }
+    else
+	return JsObject::runNative(stack,oper,context);
+    return true;
+}
+
+
 void* JsXML::getObject(const String& name) const
 {
     void* obj = (name == YATOM("JsXML")) ? const_cast<JsXML*>(this) : JsObject::getObject(name);
@@ -4281,7 +4543,7 @@ JsAssist::~JsAssist()
 	m_message = 0;
 	if (context) {
 	    Lock mylock(context->mutex());
-	    context->params().clearParams();
+	    clearContext(context);
 	}
 	TelEngine::destruct(m_runner);
     }
@@ -4558,7 +4820,7 @@ JsGlobal::~JsGlobal()
     }
     if (m_context) {
 	Lock mylock(m_context->mutex());
-	m_context->params().clearParams();
+	clearContext(m_context);
     }
 }
 
@@ -4990,8 +5252,11 @@ ChanAssist* JsModule::create(Message& msg, const String& id)
     if ((msg == YSTRING("chan.startup")) && (msg[YSTRING("direction")] == YSTRING("outgoing")))
 	return 0;
     lock();
-    ScriptRun* runner = m_assistCode.createRunner(0,NATIVE_TITLE);
+    // a context starting with the shared objects skips their creation on init
+    ScriptContext* ctx = m_assistShared ? m_assistCode.createContext(m_assistShared) : 0;
+    ScriptRun* runner = m_assistCode.createRunner(ctx,NATIVE_TITLE);
     unlock();
+    TelEngine::destruct(ctx);
     if (!runner)
 	return 0;
     DDebug(this,DebugInfo,"Creating Javascript for '%s'",id.c_str());
@@ -5056,6 +5321,14 @@ void JsModule::initialize()
 	    Debug(this,DebugInfo,"Parsed routing script: %s",tmp.c_str());
 	else if (tmp)
 	    Debug(this,DebugWarn,"Failed to parse script: %s",tmp.c_str());
+	m_assistShared = 0;
+    }
+    if (!cfg.getBoolValue("general","context_snapshot",true))
+	m_assistShared = 0;
+    else if (!m_assistShared) {
+	ScriptContext* ctx = contextSnapshot(m_assistCode);
+	m_assistShared = ctx;
+	TelEngine::destruct(ctx);
     }
     JsGlobal::markUnused();
     unlock();
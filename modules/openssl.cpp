@@ -30,6 +30,11 @@
 
 #ifndef OPENSSL_NO_AES
 #include <openssl/aes.h>
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+// EVP picks AES-NI at runtime if the CPU has it, portable code otherwise
+#include <openssl/evp.h>
+#define AES_CTR_EVP
+#endif
 #endif
 
 #ifndef OPENSSL_NO_DES
@@ -133,6 +138,11 @@ public:
 protected:
     AES_KEY* m_key;
     unsigned char m_initVector[AES_BLOCK_SIZE];
+#ifdef AES_CTR_EVP
+private:
+    EVP_CIPHER_CTX* m_ctx;
+    bool m_ctxKey;
+#endif
 };
 
 //AES - Cipher Feedback Mode
@@ -604,14 +614,25 @@ bool SslHandler::received(Message& msg)
 #ifndef OPENSSL_NO_AES
 AesCtrCipher::AesCtrCipher()
     : m_key(0)
+#ifdef AES_CTR_EVP
+      , m_ctx(0), m_ctxKey(false)
+#endif
 {
     m_key = new AES_KEY;
+    ::memset(m_initVector,0,AES_BLOCK_SIZE);
+#ifdef AES_CTR_EVP
+    m_ctx = EVP_CIPHER_CTX_new();
+#endif
     DDebug(&__plugin,DebugAll,"AesCtrCipher::AesCtrCipher() key=%p [%p]",m_key,this);
 }
 
 AesCtrCipher::~AesCtrCipher()
 {
     DDebug(&__plugin,DebugAll,"AesCtrCipher::~AesCtrCipher() key=%p [%p]",m_key,this);
+#ifdef AES_CTR_EVP
+    if (m_ctx)
+	EVP_CIPHER_CTX_free(m_ctx);
+#endif
     delete m_key;
 }
 
@@ -620,7 +641,27 @@ bool AesCtrCipher::setKey(const void* key, unsigned int len, Direction dir)
     if (!(key && len && m_key))
 	return false;
     // AES_ctr128_encrypt is its own inverse
-    return 0 == AES_set_encrypt_key((const unsigned char*)key,len*8,m_key);
+    if (0 != AES_set_encrypt_key((const unsigned char*)key,len*8,m_key))
+	return false;
+#ifdef AES_CTR_EVP
+    const EVP_CIPHER* type = 0;
+    switch (len) {
+	case 16:
+	    type = EVP_aes_128_ctr();
+	    break;
+	case 24:
+	    type = EVP_aes_192_ctr();
+	    break;
+	case 32:
+	    type = EVP_aes_256_ctr();
+	    break;
+    }
+    m_ctxKey = type && m_ctx &&
+	EVP_EncryptInit_ex(m_ctx,type,0,(const unsigned char*)key,m_initVector);
+    return m_ctxKey;
+#else
+    return true;
+#endif
 }
 
 bool AesCtrCipher::initVector(const void* vect, unsigned int len, Direction dir)
@@ -633,6 +674,11 @@ bool AesCtrCipher::initVector(const void* vect, unsigned int len, Direction dir)
 	::memset(m_initVector,0,AES_BLOCK_SIZE);
     if (len)
 	::memcpy(m_initVector,vect,len);
+#ifdef AES_CTR_EVP
+    // only reload the counter, the key schedule is kept in the context
+    if (m_ctxKey)
+	return 0 != EVP_EncryptInit_ex(m_ctx,0,0,0,m_initVector);
+#endif
     return true;
 }
 
@@ -642,6 +688,12 @@ bool AesCtrCipher::encrypt(void* outData, unsigned int len, const void* inpData)
 	return false;
     if (!inpData)
 	inpData = outData;
+#ifdef AES_CTR_EVP
+    // CTR mode allows in place processing, the output has the same length
+    int outLen = 0;
+    return m_ctxKey && EVP_EncryptUpdate(m_ctx,(unsigned char*)outData,&outLen,
+	(const unsigned char*)inpData,len);
+#else
     unsigned int num = 0;
     unsigned char eCountBuf[AES_BLOCK_SIZE];
     AES_ctr128_encrypt(
@@ -653,6 +705,7 @@ bool AesCtrCipher::encrypt(void* outData, unsigned int len, const void* inpData)
 	eCountBuf,
 	&num);
     return true;
+#endif
 }
 
 bool AesCtrCipher::decrypt(void* outData, unsigned int len, const void* inpData)
@@ -38,11 +38,120 @@ static bool s_insensitive;
 static bool s_prerouteall;
 static int s_maxDepth = 5;
 static String s_defRule;
-static Mutex s_mutex(true,"RegexRoute");
+static RWLock s_mutex("RegexRoute");
+static Mutex s_varsMutex(true,"RegexRoute::vars");
 static ObjList s_extra;
 static NamedList s_vars("");
 static int s_dispatching = 0;
+static Regexp s_blockStart("\\(=[[:space:]]*\\)\\?{$");
 
+// One precompiled condition: called number, parameter or function against a regexp
+class RouteMatch : public GenObject
+{
+public:
+    enum Source {
+	Called,
+	Param,
+	Function,
+    };
+    RouteMatch(const String& rule, const String& context, unsigned int line);
+    bool matches(Message& msg, const String& str, String& match) const;
+    // Expression to add to the prefix table if it tests the called number
+    inline const char* prefix() const
+	{ return (m_valid && m_doMatch && (Called == m_source)) ? m_regexp.c_str() : 0; }
+private:
+    int m_source;
+    String m_name;
+    String m_default;
+    Regexp m_regexp;
+    bool m_doMatch;
+    bool m_valid;
+};
+
+// A secondary condition chained by 'if', 'and' or 'or'
+class RouteLink : public GenObject
+{
+public:
+    inline RouteLink(bool alternate, RouteMatch* match)
+	: m_alternate(alternate), m_match(match)
+	{ }
+    virtual ~RouteLink()
+	{ TelEngine::destruct(m_match); }
+    inline bool alternate() const
+	{ return m_alternate; }
+    inline const RouteMatch* match() const
+	{ return m_match; }
+private:
+    bool m_alternate;
+    RouteMatch* m_match;
+};
+
+// One line of a context, parsed and compiled when the configuration is loaded
+class RouteRule : public GenObject
+{
+public:
+    RouteRule(const NamedString& line, const String& context, unsigned int index);
+    virtual ~RouteRule()
+	{ TelEngine::destruct(m_match); }
+    bool matches(Message& msg, const String& str, String& match) const;
+    inline const String& name() const
+	{ return m_name; }
+    inline const String& action() const
+	{ return m_action; }
+    inline unsigned int line() const
+	{ return m_line; }
+    inline bool blockStart() const
+	{ return m_blockStart; }
+    inline bool blockEnd() const
+	{ return m_blockEnd; }
+    const char* prefix() const;
+private:
+    String m_name;
+    String m_action;
+    unsigned int m_line;
+    RouteMatch* m_match;
+    ObjList m_links;
+    bool m_blockStart;
+    bool m_blockEnd;
+    bool m_malformed;
+};
+
+// Compiled rules of a configuration section
+// Rules testing the called number are indexed by prefix so only candidates are tried
+class RouteContext : public String
+{
+public:
+    RouteContext(const NamedList& sect);
+    inline unsigned int count() const
+	{ return m_rules.length(); }
+    inline const RouteRule* rule(int index) const
+	{ return static_cast<const RouteRule*>(m_rules.at(index)); }
+    inline int next(const String& str, int index) const
+	{ return m_table.candidate(str,index); }
+private:
+    ObjVector m_rules;
+    PrefixTable m_table;
+};
+
+
+// All compiled contexts of a configuration
+// Handlers hold a reference while routing so they don't keep the lock, rules
+//  dispatching messages may reach a reload of the configuration in the same thread
+class RouteConfig : public RefObject
+{
+public:
+    inline RouteConfig()
+	: m_contexts(64), m_rules(0)
+	{ }
+    inline const RouteContext* context(const String& name) const
+	{ return static_cast<const RouteContext*>(m_contexts[name]); }
+    inline unsigned int rules() const
+	{ return m_rules; }
+    void compile(const Configuration& cfg);
+private:
+    HashList m_contexts;
+    unsigned int m_rules;
+};
 
 class RouteHandler : public MessageHandler
 {
@@ -105,6 +214,7 @@ class RegexRoutePlugin : public Plugin
 {
 public:
     RegexRoutePlugin();
+    virtual ~RegexRoutePlugin();
     virtual void initialize();
 private:
     void initVars(NamedList* sect);
@@ -124,6 +234,7 @@ static String& vars(String& s, String* vName = 0)
 	s.trimBlanks();
 	if (vName)
 	    *vName = s;
+	Lock lock(s_varsMutex);
 	s = s_vars.getValue(s);
     }
     return s;
@@ -216,12 +327,14 @@ static void evalFunc(String& str, Message& msg)
 	;
     else if (str.startSkip("++",false)) {
 	String tmp;
+	Lock lock(s_varsMutex);
 	str = vars(str,&tmp).toInteger(0,10) + 1;
 	if (tmp)
 	    s_vars.setParam(tmp,str);
     }
     else if (str.startSkip("--",false)) {
 	String tmp;
+	Lock lock(s_varsMutex);
 	str = vars(str,&tmp).toInteger(0,10) - 1;
 	if (tmp)
 	    s_vars.setParam(tmp,str);
@@ -356,6 +469,7 @@ static void evalFunc(String& str, Message& msg)
 		// auto increment the index variable if any
 		if (vname) {
 		    par = (idx + 1) % n;
+		    Lock lock(s_varsMutex);
 		    s_vars.setParam(vname,par);
 		}
 	    }
@@ -403,6 +517,7 @@ static void evalFunc(String& str, Message& msg)
 	    }
 	    else
 		str.clear();
+	    Lock lock(s_varsMutex);
 	    if (par.null() || par == YSTRING("count"))
 		str = s_vars.count();
 	    else if (par == YSTRING("list")) {
@@ -450,8 +565,10 @@ static void evalFunc(String& str, Message& msg)
 	    Debugger::formatTime(buf);
 	    str = buf;
 	}
-	else if (bare && str.trimBlanks())
+	else if (bare && str.trimBlanks()) {
+	    Lock lock(s_varsMutex);
 	    str = s_vars.getValue(str);
+	}
 	else {
 	    Debug("RegexRoute",DebugWarn,"Invalid function '%s'",str.c_str());
 	    str.clear();
@@ -507,15 +624,19 @@ static void setMessage(const String& match, Message& msg, String& line, Message*
 		n.trimBlanks();
 		v.trimBlanks();
 		DDebug("RegexRoute",DebugAll,"Setting '%s' to '%s'",n.c_str(),v.c_str());
-		if (n.startSkip("$",false))
+		if (n.startSkip("$",false)) {
+		    Lock lock(s_varsMutex);
 		    s_vars.setParam(n,v);
+		}
 		else
 		    target->setParam(n,v);
 	    }
 	    else {
 		DDebug("RegexRoute",DebugAll,"Clearing parameter '%s'",s->c_str());
-		if (s->startSkip("$",false))
+		if (s->startSkip("$",false)) {
+		    Lock lock(s_varsMutex);
 		    s_vars.clearParam(*s);
+		}
 		else
 		    target->clearParam(*s);
 	    }
@@ -525,7 +646,7 @@ static void setMessage(const String& match, Message& msg, String& line, Message*
 }
 
 // helper function to set the default regexp
-static void setDefault(Regexp& reg)
+static void setDefault(String& reg)
 {
     if (s_defRule.null())
 	return;
@@ -540,69 +661,210 @@ static void setDefault(Regexp& reg)
     }
 }
 
-// helper function to process one match attempt
-static bool oneMatch(Message& msg, Regexp& reg, String& match, const String& context, unsigned int rule)
+RouteMatch::RouteMatch(const String& rule, const String& context, unsigned int line)
+    : m_source(Called), m_regexp(0,s_extended,s_insensitive), m_doMatch(true), m_valid(false)
 {
+    String reg(rule);
     if (reg.startsWith("${")) {
 	// handle special matching by param ${paramname}regexp
 	int p = reg.find('}');
 	if (p < 3) {
 	    Debug("RegexRoute",DebugWarn,"Invalid parameter match '%s' in rule #%u in context '%s'",
-		reg.c_str(),rule,context.c_str());
-	    return false;
+		reg.c_str(),line,context.c_str());
+	    return;
 	}
-	match = reg.substr(2,p-2);
+	m_name = reg.substr(2,p-2);
 	reg = reg.substr(p+1);
-	match.trimBlanks();
+	m_name.trimBlanks();
 	reg.trimBlanks();
-	String def;
-	p = match.find('$');
+	p = m_name.find('$');
 	if (p >= 0) {
 	    // param is in ${<name>$<default>} format
-	    def = match.substr(p+1);
-	    match = match.substr(0,p);
-	    match.trimBlanks();
+	    m_default = m_name.substr(p+1);
+	    m_name = m_name.substr(0,p);
+	    m_name.trimBlanks();
 	}
 	setDefault(reg);
-	if (match.null() || reg.null()) {
+	if (m_name.null() || reg.null()) {
 	    Debug("RegexRoute",DebugWarn,"Missing parameter or rule in rule #%u in context '%s'",
-		rule,context.c_str());
-	    return false;
+		line,context.c_str());
+	    return;
 	}
-	DDebug("RegexRoute",DebugAll,"Using message parameter '%s' default '%s'",
-	    match.c_str(),def.c_str());
-	match = msg.getValue(match,def);
+	m_source = Param;
     }
     else if (reg.startsWith("$(")) {
 	// handle special matching by param $(function)regexp
 	int p = reg.find(')');
 	if (p < 3) {
 	    Debug("RegexRoute",DebugWarn,"Invalid function match '%s' in rule #%u in context '%s'",
-		reg.c_str(),rule,context.c_str());
-	    return false;
+		reg.c_str(),line,context.c_str());
+	    return;
 	}
-	match = reg.substr(0,p+1);
+	m_name = reg.substr(0,p+1);
 	reg = reg.substr(p+1);
 	reg.trimBlanks();
 	setDefault(reg);
 	if (reg.null()) {
 	    Debug("RegexRoute",DebugWarn,"Missing rule in rule #%u in context '%s'",
-		rule,context.c_str());
-	    return false;
+		line,context.c_str());
+	    return;
 	}
-	DDebug("RegexRoute",DebugAll,"Using function '%s'",match.c_str());
-	msg.replaceParams(match);
-	replaceFuncs(match,msg);
+	m_source = Function;
     }
-    match.trimBlanks();
-
-    bool doMatch = true;
     if (reg.endsWith("^")) {
 	// reverse match on final ^ (makes no sense in a regexp)
-	doMatch = false;
+	m_doMatch = false;
 	reg = reg.substr(0,reg.length()-1);
     }
-    return (match.matches(reg) == doMatch);
+    m_regexp = reg;
+    if (!m_regexp.compile())
+	Debug("RegexRoute",DebugWarn,"Invalid regular expression '%s' in rule #%u in context '%s'",
+	    reg.c_str(),line,context.c_str());
+    m_valid = true;
+}
+
+// process one match attempt, leave in match the string that was tested
+bool RouteMatch::matches(Message& msg, const String& str, String& match) const
+{
+    if (!m_valid)
+	return false;
+    switch (m_source) {
+	case Param:
+	    DDebug("RegexRoute",DebugAll,"Using message parameter '%s' default '%s'",
+		m_name.c_str(),m_default.c_str());
+	    match = msg.getValue(m_name,m_default);
+	    break;
+	case Function:
+	    DDebug("RegexRoute",DebugAll,"Using function '%s'",m_name.c_str());
+	    match = m_name;
+	    msg.replaceParams(match);
+	    replaceFuncs(match,msg);
+	    break;
+	default:
+	    match = str;
+    }
+    match.trimBlanks();
+    return (match.matches(m_regexp) == m_doMatch);
+}
+
+RouteRule::RouteRule(const NamedString& line, const String& context, unsigned int index)
+    : m_name(line.name()), m_line(index), m_match(0),
+      m_blockStart(false), m_blockEnd(false), m_malformed(false)
+{
+    String reg(m_name);
+    if (reg.startSkip("}")) {
+	m_blockEnd = true;
+	if (reg.trimBlanks().null())
+	    reg = ".*";
+    }
+    m_blockStart = s_blockStart.matches(line);
+    m_match = new RouteMatch(reg,context,index);
+    m_action = line;
+    for (;;) {
+	bool alt = m_action.startSkip("or");
+	if (!(alt || m_action.startSkip("if") || m_action.startSkip("and")))
+	    break;
+	int p = m_action.find('=');
+	if (p < 0) {
+	    // nothing can follow, rule fails if this link is ever reached
+	    Debug("RegexRoute",DebugWarn,"Malformed '%s' rule #%u in context '%s'",
+		(alt ? "or" : "if"),index,context.c_str());
+	    m_links.append(new RouteLink(alt,0));
+	    m_malformed = true;
+	    break;
+	}
+	reg = m_action.substr(0,p);
+	m_action = m_action.substr(p+1);
+	reg.trimBlanks();
+	m_action.trimBlanks();
+	RouteMatch* m = 0;
+	if (reg.null())
+	    Debug("RegexRoute",DebugWarn,"Missing 'if' in rule #%u in context '%s'",
+		index,context.c_str());
+	else
+	    m = new RouteMatch(reg,context,index);
+	m_links.append(new RouteLink(alt,m));
+    }
+}
+
+// evaluate the chain of conditions, leave in match the last string tested
+bool RouteRule::matches(Message& msg, const String& str, String& match) const
+{
+    bool ok = m_match->matches(msg,str,match);
+    for (ObjList* o = m_links.skipNull(); o; o = o->skipNext()) {
+	const RouteLink* l = static_cast<const RouteLink*>(o->get());
+	if (ok) {
+	    // already matched, skip over the remaining alternatives
+	    if (l->alternate())
+		return !m_malformed;
+	}
+	else if (!l->alternate())
+	    return false;
+	if (!l->match())
+	    return false;
+	NDebug("RegexRoute",DebugAll,"Secondary match by rule #%u '%s'",
+	    m_line,m_name.c_str());
+	ok = l->match()->matches(msg,str,match);
+    }
+    return ok;
+}
+
+// Expression to index the rule by, 0 if the rule must always be tried
+const char* RouteRule::prefix() const
+{
+    if (m_blockStart || m_blockEnd)
+	return 0;
+    // an alternate condition may match numbers not starting with the prefix
+    for (ObjList* o = m_links.skipNull(); o; o = o->skipNext()) {
+	if (static_cast<const RouteLink*>(o->get())->alternate())
+	    return 0;
+    }
+    return m_match->prefix();
+}
+
+RouteContext::RouteContext(const NamedList& sect)
+    : String(sect),
+      m_table(s_extended,s_insensitive)
+{
+    ObjList rules;
+    unsigned int len = sect.length();
+    for (unsigned int i = 0; i < len; i++) {
+	const NamedString* n = sect.getParam(i);
+	if (!n)
+	    continue;
+	RouteRule* r = new RouteRule(*n,*this,i+1);
+	rules.append(r);
+	// rules that can't be indexed are always returned as candidates
+	m_table.add(r->prefix());
+    }
+    m_rules.assign(rules);
+}
+
+// compile all sections of the configuration into route contexts
+void RouteConfig::compile(const Configuration& cfg)
+{
+    unsigned int n = cfg.sections();
+    for (unsigned int i = 0; i < n; i++) {
+	const NamedList* sect = cfg.getSection(i);
+	// settings, variables and extra handlers are not routing rules
+	if (!sect || (*sect == YSTRING("priorities")) || (*sect == YSTRING("extra"))
+		|| sect->startsWith("$"))
+	    continue;
+	RouteContext* ctx = new RouteContext(*sect);
+	m_rules += ctx->count();
+	m_contexts.append(ctx);
+    }
+    DDebug("RegexRoute",DebugInfo,"Compiled %u rules in %u contexts",m_rules,m_contexts.count());
+}
+
+// Current compiled configuration, replaced as a whole on reload
+static RouteConfig* s_config = 0;
+
+// Get a reference to the current configuration
+static RouteConfig* getConfig()
+{
+    RLock lock(s_mutex);
+    return (s_config && s_config->ref()) ? s_config : 0;
 }
 
 enum BlockState {
@@ -612,8 +874,8 @@ enum BlockState {
 };
 
 // process one context, can call itself recursively
-static bool oneContext(Message &msg, String &str, const String &context, String &ret,
-    bool warn = false, int depth = 0)
+static bool oneContext(const RouteConfig& cfg, Message &msg, String &str, const String &context,
+    String &ret, bool warn = false, int depth = 0)
 {
     if (context.null())
 	return false;
@@ -621,36 +883,32 @@ static bool oneContext(Message &msg, String &str, const String &context, String
 	Debug("RegexRoute",DebugWarn,"Possible loop detected, current context '%s'",context.c_str());
 	return false;
     }
-    NamedList *l = s_cfg.getSection(context);
-    if (l) {
+    const RouteContext* ctx = cfg.context(context);
+    if (ctx) {
 	unsigned int blockDepth = 0;
 	BlockState blockStack[BLOCK_STACK];
-	unsigned int len = l->length();
-	for (unsigned int i = 0; i < len; i++) {
-	    const NamedString* n = l->getParam(i);
-	    if (!n)
-		continue;
+	// the match string is trimmed before each test, look it up the same way
+	String called(str);
+	called.trimBlanks();
+	for (int i = ctx->next(called,-1); i >= 0; i = ctx->next(called,i)) {
+	    const RouteRule* rule = ctx->rule(i);
 	    BlockState blockThis = (blockDepth > 0) ? blockStack[blockDepth-1] : BlockRun;
 	    BlockState blockLast = BlockSkip;
-	    Regexp reg(n->name(),s_extended,s_insensitive);
-	    if (reg.startSkip("}")) {
+	    if (rule->blockEnd()) {
 		if (!blockDepth) {
 		    Debug("RegexRoute",DebugWarn,"Got '}' outside block in line #%u in context '%s'",
-			i+1,context.c_str());
+			rule->line(),context.c_str());
 		    continue;
 		}
-		if (reg.trimBlanks().null())
-		    reg = ".*";
 		blockDepth--;
 		blockLast = blockThis;
 		blockThis = (blockDepth > 0) ? blockStack[blockDepth-1] : BlockRun;
 	    }
-	    static Regexp s_blockStart("\\(=[[:space:]]*\\)\\?{$");
-	    if (s_blockStart.matches(*n)) {
+	    if (rule->blockStart()) {
 		// start of a new block
 		if (blockDepth >= BLOCK_STACK) {
 		    Debug("RegexRoute",DebugWarn,"Block stack overflow in line #%u in context '%s'",
-			i+1,context.c_str());
+			rule->line(),context.c_str());
 		    return false;
 		}
 		// assume block is done
@@ -664,58 +922,16 @@ static bool oneContext(Message &msg, String &str, const String &context, String
 		}
 		blockStack[blockDepth++] = blockEnter;
 	    }
-	    XDebug("RegexRoute",DebugAll,"%s:%d(%u:%s) %s=%s",context.c_str(),i+1,
+	    XDebug("RegexRoute",DebugAll,"%s:%u(%u:%s) %s=%s",context.c_str(),rule->line(),
 		blockDepth,String::boolText(BlockRun == blockThis),
-		n->name().c_str(),n->c_str());
+		rule->name().c_str(),rule->action().c_str());
 	    if (BlockRun != blockThis)
 		continue;
 
-	    String val(*n);
 	    String match;
-	    bool ok;
-	    do {
-		match = str;
-		ok = oneMatch(msg,reg,match,context,i+1);
-		if (ok) {
-		    if (val.startSkip("or")) {
-			do {
-			    int p = val.find('=');
-			    if (p < 0) {
-				Debug("RegexRoute",DebugWarn,"Malformed 'or' rule #%u in context '%s'",
-				    i+1,context.c_str());
-				ok = false;
-				break;
-			    }
-			    val = val.substr(p+1);
-			    val.trimBlanks();
-			} while (ok && (val.startSkip("or") || val.startSkip("if") || val.startSkip("and")));
-			break;
-		    }
-		    if (!(val.startSkip("if") || val.startSkip("and")))
-			break;
-		}
-		else if (val.startSkip("or"))
-		    ok = true;
-		if (ok) {
-		    int p = val.find('=');
-		    if (p >= 1) {
-			reg = val.substr(0,p);
-			val = val.substr(p+1);
-			reg.trimBlanks();
-			val.trimBlanks();
-			if (!reg.null()) {
-			    NDebug("RegexRoute",DebugAll,"Secondary match rule '%s' by rule #%u in context '%s'",
-				reg.c_str(),i+1,context.c_str());
-			    continue;
-			}
-		    }
-		    Debug("RegexRoute",DebugWarn,"Missing 'if' in rule #%u in context '%s'",
-			i+1,context.c_str());
-		    ok = false;
-		}
-	    } while (ok);
-	    if (!ok)
+	    if (!rule->matches(msg,str,match))
 		continue;
+	    String val(rule->action());
 
 	    int level = 0;
 	    if (val.startSkip("echo") || val.startSkip("output")
@@ -744,7 +960,7 @@ static bool oneContext(Message &msg, String &str, const String &context, String
 		    blockStack[blockDepth-1] = BlockRun;
 		else
 		    Debug("RegexRoute",DebugWarn,"Got '{' outside block in line #%u in context '%s'",
-			i+1,context.c_str());
+			rule->line(),context.c_str());
 		continue;
 	    }
 	    bool disp = val.startSkip("dispatch");
@@ -760,11 +976,15 @@ static bool oneContext(Message &msg, String &str, const String &context, String
 			m->userData(msg.userData());
 			NDebug("RegexRoute",DebugAll,"%s new message '%s' by rule #%u '%s' in context '%s'",
 			    (disp ? "Dispatching" : "Enqueueing"),
-			    val.c_str(),i+1,n->name().c_str(),context.c_str());
+			    val.c_str(),rule->line(),rule->name().c_str(),context.c_str());
 			if (disp) {
+			    s_varsMutex.lock();
 			    s_dispatching++;
+			    s_varsMutex.unlock();
 			    Engine::dispatch(m);
+			    s_varsMutex.lock();
 			    s_dispatching--;
+			    s_varsMutex.unlock();
 			}
 			else {
 			    Engine::enqueue(m);
@@ -791,40 +1011,45 @@ static bool oneContext(Message &msg, String &str, const String &context, String
 	    else if (val.startSkip("goto") || val.startSkip("jump") ||
 		((val.startSkip("@goto") || val.startSkip("@jump")) && !(warn = false))) {
 		NDebug("RegexRoute",DebugAll,"Jumping to context '%s' by rule #%u '%s'",
-		    val.c_str(),i+1,n->name().c_str());
-		return oneContext(msg,str,val,ret,warn,depth+1);
+		    val.c_str(),rule->line(),rule->name().c_str());
+		return oneContext(cfg,msg,str,val,ret,warn,depth+1);
 	    }
 	    else if (val.startSkip("include") || val.startSkip("call") ||
 		((val.startSkip("@include") || val.startSkip("@call")) && !(warn = false))) {
 		NDebug("RegexRoute",DebugAll,"Including context '%s' by rule #%u '%s'",
-		    val.c_str(),i+1,n->name().c_str());
-		if (oneContext(msg,str,val,ret,warn,depth+1)) {
+		    val.c_str(),rule->line(),rule->name().c_str());
+		if (oneContext(cfg,msg,str,val,ret,warn,depth+1)) {
 		    DDebug("RegexRoute",DebugAll,"Returning true from context '%s'", context.c_str());
 		    return true;
 		}
+		// the included context may have changed the match string
+		called = str;
+		called.trimBlanks();
 	    }
 	    else if (val.startSkip("match") || val.startSkip("newmatch")) {
 		if (!val.null()) {
 		    NDebug("RegexRoute",DebugAll,"Setting match string '%s' by rule #%u '%s' in context '%s'",
-			val.c_str(),i+1,n->name().c_str(),context.c_str());
+			val.c_str(),rule->line(),rule->name().c_str(),context.c_str());
 		    str = val;
+		    called = str;
+		    called.trimBlanks();
 		}
 	    }
 	    else if (val.startSkip("rename")) {
 		if (!val.null()) {
 		    NDebug("RegexRoute",DebugAll,"Renaming message '%s' to '%s' by rule #%u '%s' in context '%s'",
-			msg.c_str(),val.c_str(),i+1,n->name().c_str(),context.c_str());
+			msg.c_str(),val.c_str(),rule->line(),rule->name().c_str(),context.c_str());
 		    msg = val;
 		}
 	    }
 	    else if (val.startSkip("retval")) {
 		NDebug("RegexRoute",DebugAll,"Setting retValue length %u by rule #%u '%s' in context '%s'",
-			val.length(),i+1,n->name().c_str(),context.c_str());
+			val.length(),rule->line(),rule->name().c_str(),context.c_str());
 		ret = val;
 	    }
 	    else {
 		DDebug("RegexRoute",DebugAll,"Returning '%s' for '%s' in context '%s' by rule #%u '%s'",
-		    val.c_str(),str.c_str(),context.c_str(),i+1,n->name().c_str());
+		    val.c_str(),str.c_str(),context.c_str(),rule->line(),rule->name().c_str());
 		ret = val;
 		return true;
 	    }
@@ -847,8 +1072,12 @@ bool RouteHandler::received(Message &msg)
     if (called.null())
 	return false;
     const char *context = msg.getValue(YSTRING("context"),"default");
-    Lock lock(s_mutex);
-    if (oneContext(msg,called,context,msg.retValue())) {
+    RouteConfig* cfg = getConfig();
+    if (!cfg)
+	return false;
+    bool ok = oneContext(*cfg,msg,called,context,msg.retValue());
+    TelEngine::destruct(cfg);
+    if (ok) {
 	Debug(DebugInfo,"Routing %s to '%s' in context '%s' via '%s' in " FMT64U " usec",
 	    msg.getValue(YSTRING("route_type"),"call"),called.c_str(),context,
 	    msg.retValue().c_str(),Time::now()-tmr);
@@ -872,8 +1101,12 @@ bool PrerouteHandler::received(Message &msg)
 	return false;
 
     String ret;
-    Lock lock(s_mutex);
-    if (oneContext(msg,caller,"contexts",ret)) {
+    RouteConfig* cfg = getConfig();
+    if (!cfg)
+	return false;
+    bool ok = oneContext(*cfg,msg,caller,"contexts",ret);
+    TelEngine::destruct(cfg);
+    if (ok) {
 	Debug(DebugInfo,"Classifying caller '%s' in context '%s' in " FMT64 " usec",
 	    caller.c_str(),ret.c_str(),Time::now()-tmr);
 	if (ret == YSTRING("-") || ret == YSTRING("error"))
@@ -896,8 +1129,12 @@ bool GenericHandler::received(Message &msg)
 	what = msg.getValue(what);
     else
 	what = *this;
-    Lock lock(s_mutex);
-    return oneContext(msg,what,m_context,msg.retValue());
+    RouteConfig* cfg = getConfig();
+    if (!cfg)
+	return false;
+    bool ok = oneContext(*cfg,msg,what,m_context,msg.retValue());
+    TelEngine::destruct(cfg);
+    return ok;
 }
 
 
@@ -906,9 +1143,11 @@ bool StatusHandler::received(Message &msg)
     const String& dest = msg[YSTRING("module")];
     if (dest && (dest != __plugin.name()))
 	return false;
-    Lock lock(s_mutex);
+    RLock lock(s_mutex);
+    Lock varsLock(s_varsMutex);
     msg.retValue() << "name=" << __plugin.name()
 	<< ",type=route;sections=" << s_cfg.count()
+	<< ",rules=" << (s_config ? s_config->rules() : 0)
 	<< ",extra=" << s_extra.count()
 	<< ",variables=" << s_vars.count() << "\r\n";
     return !dest.null();
@@ -936,10 +1175,17 @@ RegexRoutePlugin::RegexRoutePlugin()
     Output("Loaded module RegexRoute");
 }
 
+RegexRoutePlugin::~RegexRoutePlugin()
+{
+    Output("Unloading module RegexRoute");
+    TelEngine::destruct(s_config);
+}
+
 void RegexRoutePlugin::initVars(NamedList* sect)
 {
     if (!sect)
 	return;
+    Lock lock(s_varsMutex);
     unsigned int len = sect->length();
     for (unsigned int i=0; i<len; i++) {
 	NamedString* n = sect->getParam(i);
@@ -956,7 +1202,8 @@ void RegexRoutePlugin::initialize()
     TelEngine::destruct(m_status);
     TelEngine::destruct(m_command);
     s_extra.clear();
-    Lock lock(s_mutex);
+    WLock lock(s_mutex);
+    s_blockStart.compile();
     s_cfg = Engine::configFile(name());
     s_cfg.load();
     if (m_first) {
@@ -987,6 +1234,10 @@ void RegexRoutePlugin::initialize()
 	depth = 100;
     s_maxDepth = depth;
     s_defRule = s_cfg.getValue("priorities","defaultrule",DEFAULT_RULE);
+    RouteConfig* cfg = new RouteConfig;
+    cfg->compile(s_cfg);
+    TelEngine::destruct(s_config);
+    s_config = cfg;
     NamedList* l = s_cfg.getSection("extra");
     if (l) {
 	unsigned int len = l->length();
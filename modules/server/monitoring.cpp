@@ -331,6 +331,8 @@ public:
 	ENGINE_MSGENQUEUED  = 19,
 	ENGINE_MSGDEQUEUED  = 20,
 	ENGINE_MSGDISPATCHED = 21,
+	ENGINE_LOCKCONTENDED = 22,
+	ENGINE_LOCKWAIT     = 23,
     };
     // Constructor
     inline EngineInfo()
@@ -1073,6 +1075,8 @@ static TokenDict s_categories[] = {
     {"workers",			Monitor::ENGINE},
     {"mutexes",			Monitor::ENGINE},
     {"locks",			Monitor::ENGINE},
+    {"lockContended",		Monitor::ENGINE},
+    {"lockWaitTime",		Monitor::ENGINE},
     {"semaphores",		Monitor::ENGINE},
     {"waitingSemaphores",       Monitor::ENGINE},
     {"acceptStatus",		Monitor::ENGINE},
@@ -1254,6 +1258,8 @@ static TokenDict s_engineQuery[] = {
     {"workers",		    EngineInfo::ENGINE_WORKERS},
     {"mutexes",		    EngineInfo::ENGINE_MUTEXES},
     {"locks",		    EngineInfo::ENGINE_LOCKS},
+    {"lockContended",	    EngineInfo::ENGINE_LOCKCONTENDED},
+    {"lockWaitTime",	    EngineInfo::ENGINE_LOCKWAIT},
     {"semaphores",	    EngineInfo::ENGINE_SEMAPHORES},
     {"waitingSemaphores",   EngineInfo::ENGINE_WAITING},
     {"acceptStatus",	    EngineInfo::ENGINE_CALL_ACCEPT},
@@ -1280,6 +1286,8 @@ TokenDict EngineInfo::s_engineInfo[] = {
     {"workers",             EngineInfo::ENGINE_WORKERS},
     {"mutexes",             EngineInfo::ENGINE_MUTEXES},
     {"locks",               EngineInfo::ENGINE_LOCKS},
+    {"lockcontended",       EngineInfo::ENGINE_LOCKCONTENDED},
+    {"lockwait",            EngineInfo::ENGINE_LOCKWAIT},
     {"semaphores",          EngineInfo::ENGINE_SEMAPHORES},
     {"waiting",             EngineInfo::ENGINE_WAITING},
     {"runattempt",          EngineInfo::ENGINE_RUNATTEMPT},
@@ -35,7 +35,7 @@ private:
     bool m_init;
 };
 
-Mutex s_mutex(false,"RegFile");
+RWLock s_mutex("RegFile");
 static Configuration s_cfg(Engine::configFile("regfile"));
 static Configuration s_accounts;
 static bool s_create = false;
@@ -160,7 +160,7 @@ bool AuthHandler::received(Message &msg)
     String username(msg.getValue("username"));
     if (username.null() || username == s_general)
 	return false;
-    Lock lock(s_mutex);
+    RLock lock(s_mutex);
     const NamedList* usr = s_cfg.getSection(username);
     if (!usr)
 	return false;
@@ -268,7 +268,7 @@ bool RouteHandler::received(Message &msg)
     if (!msg.getBoolValue(YSTRING("route_regfile"),true))
 	return false;
     String user = msg.getValue("caller");
-    Lock lock(s_mutex);
+    RLock lock(s_mutex);
     NamedList* params = 0;
     if (user) {
 	params = s_cfg.getSection(user);
@@ -376,7 +376,7 @@ bool StatusHandler::received(Message &msg)
     String dest(msg.getValue("module"));
     if (dest && (dest != "regfile") && (dest != "misc"))
 	return false;
-    Lock lock(s_mutex);
+    RLock lock(s_mutex);
     unsigned int n = s_cfg.sections();
     if (s_cfg.getSection("general") || !s_cfg.getSection(0))
 	n--;
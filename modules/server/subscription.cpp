@@ -128,6 +128,30 @@ public:
     NamedList* m_caps;
 };
 
+/*
+ * The destinations of a notification made from an user's instance
+ * Sent in a single resource.notify carrying the destinations list
+ */
+class NotifyGroup
+{
+public:
+    inline NotifyGroup(bool online, const String& from, const String& inst,
+	const char* data)
+	: m_online(online), m_from(from), m_instance(inst), m_data(data)
+	{}
+    // Add a destination
+    inline void add(const String& to, const String& inst)
+	{ m_dest.append(new NamedString(to,inst)); }
+    // Enqueue the notification, clear the destinations list
+    void send();
+private:
+    bool m_online;
+    String m_from;
+    String m_instance;
+    String m_data;
+    ObjList m_dest;                      // Destination users (value: instance)
+};
+
 /*
  * A known instance of an user/contact
  */
@@ -159,10 +183,14 @@ public:
     // Notify all instances in the list to/from another one
     void notifyInstance(bool online, bool out, const String& from, const String& to,
 	const String& inst, const char* data) const;
+    // Add all instances in the list to the destinations of a notification
+    void notifyInstance(NotifyGroup& group, const String& to) const;
     // Notify all instances in the list with the same from/to.
     // Notifications are made from/to the given instance to/from all other instances
     void notifySkip(bool online, bool out, const String& notifier,
 	const String& inst, const char* data) const;
+    // Add all instances in the list but the given one to the destinations of a notification
+    void notifySkip(NotifyGroup& group, const String& notifier, const String& inst) const;
     // Retrieve data and notify each instance in the list to a given one
     void notifyUpdate(bool online, const String& from, const String& to,
 	const String& inst) const;
@@ -482,6 +510,10 @@ public:
 	Message& msg);
     // Handle online/offline resource.notify from contact or directed notifications
     bool handleResNotify(bool online, Message& msg);
+    // Handle an online/offline notification sent from an instance to a given destination
+    void handleResNotifyTo(bool online, Message& msg, const String& from,
+	const String& inst, const String& to, const String& toInst,
+	bool fromLocal, bool toLocal);
     // Handle resource.notify with operation (un)subscribed
     bool handleResNotifySub(bool sub, const String& from, const String& to,
 	Message& msg);
@@ -542,6 +574,8 @@ private:
 INIT_PLUGIN(SubscriptionModule);         // The module
 static bool s_singleOffline = true;      // Enqueue a single 'offline' resource.notify
                                          // message when multiple instances are available
+static bool s_groupNotify = true;        // Enqueue a single resource.notify carrying all
+                                         // destinations of an instance's notification
 static bool s_usersLoaded = false;       // Users were loaded at startup
 bool s_check = true;
 
@@ -786,6 +820,45 @@ unsigned int InstanceList::addListParam(NamedList& list, String* skip)
     return n;
 }
 
+// Enqueue the notification, clear the destinations list
+// Destinations are listed in 'to.N' and 'to_instance.N' parameters
+void NotifyGroup::send()
+{
+    ObjList* o = m_dest.skipNull();
+    if (!o)
+	return;
+    if (!(s_groupNotify && o->skipNext())) {
+	for (; o; o = o->skipNext()) {
+	    NamedString* ns = static_cast<NamedString*>(o->get());
+	    __plugin.notify(m_online,m_from,ns->name(),m_instance,*ns,m_data);
+	}
+	m_dest.clear();
+	return;
+    }
+    const char* what = m_online ? "online" : "offline";
+    Message* m = __plugin.message("resource.notify");
+    m->addParam("operation",what);
+    m->addParam("from",m_from);
+    if (m_instance)
+	m->addParam("from_instance",m_instance);
+    unsigned int n = 0;
+    for (; o; o = o->skipNext()) {
+	NamedString* ns = static_cast<NamedString*>(o->get());
+	String prefix("to.");
+	prefix << ++n;
+	m->addParam(prefix,ns->name());
+	if (*ns)
+	    m->addParam("to_instance." + String(n),*ns);
+    }
+    m->addParam("to.count",String(n));
+    if (m_data)
+	m->addParam("data",m_data);
+    Debug(&__plugin,DebugAll,"notify=%s notifier=%s (%s) subscribers=%u",
+	what,m_from.c_str(),m_instance.c_str(),n);
+    Engine::enqueue(m);
+    m_dest.clear();
+}
+
 // Notify all instances in the list
 void InstanceList::notifyInstance(bool online, bool out, const String& from,
     const String& to, const String& inst, const char* data) const
@@ -803,6 +876,13 @@ void InstanceList::notifyInstance(bool online, bool out, const String& from,
     }
 }
 
+// Add all instances in the list to the destinations of a notification
+void InstanceList::notifyInstance(NotifyGroup& group, const String& to) const
+{
+    for (ObjList* o = skipNull(); o; o = o->skipNext())
+	group.add(to,*static_cast<Instance*>(o->get()));
+}
+
 // Notify all instances in the list with the same from/to.
 // Notifications are made from/to the given instance to/from all other instances
 void InstanceList::notifySkip(bool online, bool out, const String& notifier,
@@ -822,6 +902,17 @@ void InstanceList::notifySkip(bool online, bool out, const String& notifier,
     }
 }
 
+// Add all instances in the list but the given one to the destinations of a notification
+void InstanceList::notifySkip(NotifyGroup& group, const String& notifier,
+    const String& inst) const
+{
+    for (ObjList* o = skipNull(); o; o = o->skipNext()) {
+	Instance* tmp = static_cast<Instance*>(o->get());
+	if (*tmp != inst)
+	    group.add(notifier,*tmp);
+    }
+}
+
 // Retrieve data and notify each instance in the list to a given one
 void InstanceList::notifyUpdate(bool online, const String& from, const String& to,
     const String& inst) const
@@ -1764,6 +1855,7 @@ void SubscriptionModule::initialize()
 	}
     }
     Lock lck(this);
+    s_groupNotify = cfg.getBoolValue("general","group_notify",true);
     m_routeCallto = cfg.getValue("general","route_callto","jabber/${called}");
     if (!m_routeCallto)
 	Debug(this,DebugConf,"Empty 'route_callto' in config");
@@ -2186,7 +2278,45 @@ bool SubscriptionModule::handleResSubscribeQuery(const String& subscriber,
     return ok;
 }
 
+// Handle an online/offline notification sent from an instance to a given destination
+void SubscriptionModule::handleResNotifyTo(bool online, Message& msg, const String& from,
+    const String& inst, const String& to, const String& toInst, bool fromLocal, bool toLocal)
+{
+    DDebug(this,DebugAll,"handleResNotify(%s) from=%s instance=%s to=%s",
+	String::boolText(online),from.c_str(),inst.c_str(),to.c_str());
+    // Update directed notifications for contacts not in sender's roster
+    // or not having a subscription 'from'
+    PresenceUser* src = fromLocal ? m_users.getUser(from) : 0;
+    Lock lock(src);
+    if (src) {
+	src->lock();
+	if (!src->isSubFrom(to))
+	    src->updateDirectNotify(online,inst,to,toInst);
+	src->unlock();
+	TelEngine::destruct(src);
+    }
+    // Update instance capabilities to target's instances
+    PresenceUser* u = toLocal ? m_users.getUser(to) : 0;
+    if (!u)
+	return;
+    u->lock();
+    Contact* c = u->findContact(from);
+    if (c) {
+	if (online) {
+	    Instance* i = c->m_instances.set(inst,msg.getIntValue("priority"));
+	    String* capsid = msg.getParam("caps.id");
+	    if (!TelEngine::null(capsid))
+		i->setCaps(*capsid,msg);
+	}
+	else
+	    c->m_instances.remove(inst);
+    }
+    u->unlock();
+    TelEngine::destruct(u);
+}
+
 // Handle online/offline resource.notify from contact or directed notifications
+// Directed notifications may carry a destinations list in 'to.N' parameters
 bool SubscriptionModule::handleResNotify(bool online, Message& msg)
 {
     String* contact = msg.getParam("contact");
@@ -2201,40 +2331,23 @@ bool SubscriptionModule::handleResNotify(bool online, Message& msg)
 	if (TelEngine::null(inst))
 	    return false;
 	String* from = msg.getParam("from");
-	String* to = msg.getParam("to");
-	if(TelEngine::null(from) || TelEngine::null(to))
+	if (TelEngine::null(from))
 	    return false;
-	DDebug(this,DebugAll,"handleResNotify(%s) from=%s instance=%s to=%s",
-	    String::boolText(online),from->c_str(),inst->c_str(),to->c_str());
-	// Update directed notifications for contacts not in sender's roster
-	// or not having a subscription 'from'
-	PresenceUser* src = fromLocal ? m_users.getUser(*from) : 0;
-	Lock lock(src);
-	if (src) {
-	    src->lock();
-	    if (!src->isSubFrom(*to))
-		src->updateDirectNotify(online,*inst,*to,msg.getValue("to_instance"));
-	    src->unlock();
-	    TelEngine::destruct(src);
-	}
-	// Update instance capabilities to target's instances
-	PresenceUser* u = toLocal ? m_users.getUser(*to) : 0;
-	if (!u)
+	String* to = msg.getParam("to");
+	if (!TelEngine::null(to)) {
+	    handleResNotifyTo(online,msg,*from,*inst,*to,msg["to_instance"],
+		fromLocal,toLocal);
 	    return false;
-	u->lock();
-	Contact* c = u->findContact(*from);
-	if (c) {
-	    if (online) {
-		Instance* i = c->m_instances.set(*inst,msg.getIntValue("priority"));
-		String* capsid = msg.getParam("caps.id");
-		if (!TelEngine::null(capsid))
-		    i->setCaps(*capsid,msg);
-	    }
-	    else
-		c->m_instances.remove(*inst);
 	}
-	u->unlock();
-	TelEngine::destruct(u);
+	unsigned int n = msg.getIntValue("to.count");
+	for (unsigned int i = 1; i <= n; i++) {
+	    String prefix("to.");
+	    prefix << i;
+	    to = msg.getParam(prefix);
+	    if (!TelEngine::null(to))
+		handleResNotifyTo(online,msg,*from,*inst,*to,msg["to_instance." + String(i)],
+		    fromLocal,toLocal);
+	}
 	return false;
     }
     String* inst = msg.getParam("instance");
@@ -2284,6 +2397,8 @@ bool SubscriptionModule::handleResNotify(bool online, Message& msg)
     }
     if (notify) {
 	const char* data = msg.getValue("data");
+	// Contacts and user's instances are notified in a single message
+	NotifyGroup group(online,u->toString(),inst ? *inst : String::empty(),data);
 	// Notify contacts (from user) and new online user (from contacts)
 	// Send pending in subscription requests to user's new instance
 	// Re-send pending out subscription requests each time a new instance is notified
@@ -2305,7 +2420,7 @@ bool SubscriptionModule::handleResNotify(bool online, Message& msg)
 		// Send presence and probe it if our user is online
 		if (c->m_subscription.from()) {
 		    if (online)
-			__plugin.notify(true,u->toString(),*c,*inst,String::empty(),data);
+			group.add(*c,String::empty());
 		    else
 			__plugin.notify(false,u->toString(),*c,inst ? *inst : String::empty());
 		}
@@ -2319,8 +2434,7 @@ bool SubscriptionModule::handleResNotify(bool online, Message& msg)
 	    dest->lock();
 	    // Notify user's instance to all contact's instances
 	    if (c->m_subscription.from())
-		dest->instances().notifyInstance(online,false,u->toString(),
-		    dest->toString(),inst ? *inst : String::empty(),data);
+		dest->instances().notifyInstance(group,dest->toString());
 	    // Notify all contact's instances to the new user's instance
 	    if (fromContact)
 		dest->instances().notifyUpdate(online,dest->toString(),
@@ -2336,10 +2450,11 @@ bool SubscriptionModule::handleResNotify(bool online, Message& msg)
 	// Notify the instance to all other user's instance
 	// Notify a new instance about other user's instances
 	if (!TelEngine::null(inst)) {
-	    u->instances().notifySkip(online,false,u->toString(),*inst,data);
+	    u->instances().notifySkip(group,u->toString(),*inst);
 	    if (newInstance && online)
 		u->instances().notifySkip(online,true,u->toString(),*inst,data);
 	}
+	group.send();
     }
     u->unlock();
     TelEngine::destruct(u);
@@ -3136,7 +3136,8 @@ void SigDriver::initialize()
 	Engine::install(new SCCPHandler);
 	m_engine = SignallingEngine::self(true);
 	m_engine->debugChain(this);
-	m_engine->start();
+	m_engine->start("Sig Engine",Thread::Normal,0,
+	    s_cfg.getIntValue("general","threads",1,1,16));
 	m_engine->setNotifier(&s_notifier);
     }
     // Apply debug levels to driver and engine
@@ -4995,10 +4996,10 @@ GTTranslator::~GTTranslator()
 
 NamedList* GTTranslator::routeGT(const NamedList& gt, const String& prefix, const String& nextPrefix)
 {
-    // TODO keep a cache!!
-    // Verify if the requested gt exists in cache
-    // if exists return the cached translation of th GT
-    // if not exists send it for translation
+    // Try the built-in table first, ask the scripts only for unknown GTs
+    NamedList* route = routeTable(gt,prefix);
+    if (route)
+	return route;
     Message* msg = new Message("sccp.route");
     const char* name = sccp() ? sccp()->toString().c_str() : (const char*)0;
     msg->addParam("component",name,false);
@@ -5017,6 +5018,7 @@ NamedList* GTTranslator::routeGT(const NamedList& gt, const String& prefix, cons
 
 void GTTranslator::updateTables(const NamedList& params)
 {
+    GTT::updateTables(params);
     Message* msg = new Message("sccp.update");
     msg->copyParams(params);
     Engine::enqueue(msg);
@@ -5024,7 +5026,13 @@ void GTTranslator::updateTables(const NamedList& params)
 
 bool GTTranslator::initialize(const NamedList* config)
 {
-    return GTT::initialize(config);
+    const String* table = config ? config->getParam(YSTRING("table")) : 0;
+    if (TelEngine::null(table) || table->find('/') >= 0)
+	return GTT::initialize(config);
+    // a plain name refers to a file in the configuration directory
+    NamedList params(*config);
+    params.setParam("table",Engine::configFile(*table));
+    return GTT::initialize(&params);
 }
 
 /**
@@ -0,0 +1,227 @@
+/**
+ * base64bench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Base64 and hexadecimal codecs consistency and throughput test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+#include <string.h>
+
+using namespace TelEngine;
+
+static const unsigned int s_sizes[] = { 16, 64, 1024, 65536, 0 };
+static const char* s_levels[] = { "portable", "SSSE3", "AVX2" };
+
+// RFC 4648 test vectors
+static const char* s_vectors[] = {
+    "", "",
+    "f", "Zg==",
+    "fo", "Zm8=",
+    "foo", "Zm9v",
+    "foob", "Zm9vYg==",
+    "fooba", "Zm9vYmE=",
+    "foobar", "Zm9vYmFy",
+    0
+};
+
+class TestBase64 : public Plugin
+{
+public:
+    TestBase64();
+    virtual void initialize();
+private:
+    unsigned int checkVectors();
+    unsigned int check(const DataBlock& data, int level);
+    void bench(const DataBlock& data, unsigned int total, int level);
+    bool m_first;
+};
+
+TestBase64::TestBase64()
+    : Plugin("testbase64"),
+      m_first(true)
+{
+    Output("Hello, I am module TestBase64");
+}
+
+// Encode a buffer at once
+static String encode(const void* buf, unsigned int len, unsigned int lineLen = 0)
+{
+    Base64 b((void*)buf,len);
+    String res;
+    b.encode(res,lineLen);
+    return res;
+}
+
+unsigned int TestBase64::checkVectors()
+{
+    unsigned int errors = 0;
+    for (int i = 0; s_vectors[i]; i += 2) {
+	String plain(s_vectors[i]);
+	String res = encode(plain.c_str(),plain.length());
+	if (res == s_vectors[i + 1])
+	    continue;
+	errors++;
+	Debug("testbase64",DebugWarn,"Encoded '%s' to '%s' expecting '%s'",
+	    s_vectors[i],res.c_str(),s_vectors[i + 1]);
+    }
+    return errors;
+}
+
+// Compare the results at a given level with the portable implementation
+unsigned int TestBase64::check(const DataBlock& data, int level)
+{
+    unsigned int errors = 0;
+    const unsigned char* buf = (const unsigned char*)data.data();
+    for (unsigned int len = 0; len <= 300 && len <= data.length(); len++) {
+	Base64::simd(Base64::SimdNone);
+	String ref = encode(buf,len);
+	String refLines = encode(buf,len,76);
+	String refHex;
+	refHex.hexify((void*)buf,len);
+	Base64::simd(level);
+	String err;
+	if (ref != encode(buf,len))
+	    err << " encode";
+	if (refLines != encode(buf,len,76))
+	    err << " lines";
+	String hex;
+	hex.hexify((void*)buf,len);
+	if (hex != refHex)
+	    err << " hexify";
+	DataBlock bin;
+	if (!(bin.unHexify(hex) && bin.length() == len && !::memcmp(bin.data(),buf,len)))
+	    err << " unhexify";
+	hex.toUpper();
+	if (!(bin.unHexify(hex) && bin.length() == len && !::memcmp(bin.data(),buf,len)))
+	    err << " unhexify-upper";
+	for (int liberal = 0; len && liberal < 2; liberal++) {
+	    Base64 b64;
+	    b64 << (liberal ? refLines : ref);
+	    DataBlock out;
+	    if (!(b64.decode(out,0 != liberal) && out.length() == len && !::memcmp(out.data(),buf,len)))
+		err << (liberal ? " decode-liberal" : " decode");
+	    // An invalid char must be detected wherever it is
+	    DataBlock bad(b64);
+	    ((unsigned char*)bad.data())[(len * 7) % ref.length()] = '*';
+	    Base64 b64bad(bad.data(),bad.length());
+	    if (b64bad.decode(out,0 != liberal))
+		err << " invalid";
+	}
+	// Ignored chars not aligned to groups
+	String spaced;
+	for (unsigned int i = 0; i < ref.length(); i += 13)
+	    spaced << ref.substr(i,13) << " \t";
+	Base64 b64sp;
+	b64sp << spaced;
+	DataBlock outSp;
+	if (len && !(b64sp.decode(outSp) && outSp.length() == len && !::memcmp(outSp.data(),buf,len)))
+	    err << " decode-spaced";
+	// Streaming in chunks of various sizes gives the same results
+	unsigned int chunk = 1 + len % 17;
+	Base64 enc;
+	String text;
+	for (unsigned int i = 0; i < len; i += chunk)
+	    enc.encodeChunk(text,buf + i,(i + chunk < len) ? chunk : len - i);
+	enc.encodeChunk(text,0,0,true);
+	if (text != ref)
+	    err << " encode-chunk";
+	Base64 dec;
+	DataBlock out;
+	bool ok = true;
+	for (unsigned int i = 0; ok && i < refLines.length(); i += chunk)
+	    ok = dec.decodeChunk(out,refLines.c_str() + i,
+		(i + chunk < refLines.length()) ? chunk : refLines.length() - i);
+	ok = ok && dec.decodeChunk(out,0,0,true);
+	if (!(ok && out.length() == len && !::memcmp(out.data(),buf,len)))
+	    err << " decode-chunk";
+	if (!err)
+	    continue;
+	if (errors++ < 10)
+	    Debug("testbase64",DebugWarn,"%s length %u failed:%s",s_levels[level],len,err.c_str());
+    }
+    return errors;
+}
+
+// Encode and decode about total bytes in blocks of each size
+void TestBase64::bench(const DataBlock& data, unsigned int total, int level)
+{
+    Base64::simd(level);
+    for (int i = 0; s_sizes[i]; i++) {
+	unsigned int size = s_sizes[i];
+	unsigned int loops = total / size;
+	u_int64_t t[4];
+	Base64 b64((void*)data.data(),size);
+	String text;
+	u_int64_t start = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    b64.encode(text);
+	t[0] = Time::now() - start;
+	Base64 enc;
+	enc << text;
+	DataBlock out;
+	start = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    enc.decode(out);
+	t[1] = Time::now() - start;
+	String hex;
+	start = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    hex.hexify(data.data(),size);
+	t[2] = Time::now() - start;
+	start = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    out.unHexify(hex);
+	t[3] = Time::now() - start;
+	for (int j = 0; j < 4; j++)
+	    if (!t[j])
+		t[j] = 1;
+	u_int64_t bytes = (u_int64_t)loops * size * 1000000 / 1048576;
+	Debug("testbase64",DebugNote,"%s %u bytes MB/s: base64 encode " FMT64U " decode " FMT64U
+	    ", hex encode " FMT64U " decode " FMT64U,
+	    s_levels[level],size,bytes / t[0],bytes / t[1],bytes / t[2],bytes / t[3]);
+    }
+}
+
+void TestBase64::initialize()
+{
+    Output("Initializing module TestBase64");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int total = 1024 * Engine::config().getIntValue("testbase64","size",16384,1,1048576);
+    int best = Base64::simd();
+    Debug("testbase64",DebugNote,"Best vector instructions: %s",s_levels[best]);
+
+    DataBlock data(0,65536);
+    unsigned char* d = (unsigned char*)data.data();
+    for (unsigned int i = 0; i < data.length(); i++)
+	d[i] = (unsigned char)Random::random();
+    unsigned int errors = checkVectors();
+    for (int level = Base64::SimdNone; level <= best; level++)
+	errors += check(data,level);
+    Debug("testbase64",errors ? DebugWarn : DebugNote,"Compared implementations, %u errors",errors);
+
+    for (int level = Base64::SimdNone; level <= best; level++)
+	bench(data,total,level);
+    Base64::simd(best);
+}
+
+INIT_PLUGIN(TestBase64);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,295 @@
+/**
+ * compressbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Compressor consistency test, buffer and context reuse speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+#include <string.h>
+
+using namespace TelEngine;
+
+// Stanza repeated to build the test stream
+static const char* s_stanza =
+    "<message from='alice@example.com/resource' to='bob@example.org' type='chat' id='m1'>"
+    "<body>Hello there, this is a test message</body><thread>abc</thread></message>";
+
+// Object carried by engine.compress to retrieve the new compressor
+class CompressorHolder : public RefObject
+{
+public:
+    inline CompressorHolder()
+	: m_comp(0)
+	{ }
+    virtual ~CompressorHolder()
+	{ TelEngine::destruct(m_comp); }
+    virtual void* getObject(const String& name) const
+	{
+	    if (name == YATOM("Compressor*"))
+		return (void*)&m_comp;
+	    return RefObject::getObject(name);
+	}
+    Compressor* m_comp;
+};
+
+// Compressors are provided by other modules, run when all are initialized
+class StartHandler : public MessageHandler
+{
+public:
+    inline StartHandler()
+	: MessageHandler("engine.start",150,"testcompress")
+	{ }
+    virtual bool received(Message& msg);
+private:
+    static Compressor* create(const char* name);
+    unsigned int check(const String& data);
+    unsigned int checkExact(const String& data);
+    void benchRead(const String& data, unsigned int loops);
+    void benchStreams(unsigned int count);
+};
+
+class TestCompress : public Plugin
+{
+public:
+    TestCompress();
+    virtual void initialize();
+private:
+    bool m_first;
+};
+
+TestCompress::TestCompress()
+    : Plugin("testcompress"),
+      m_first(true)
+{
+    Output("Hello, I am module TestCompress");
+}
+
+// Ask the installed modules for a zlib compressor
+Compressor* StartHandler::create(const char* name)
+{
+    CompressorHolder* h = new CompressorHolder;
+    Message msg("engine.compress");
+    msg.userData(h);
+    msg.addParam("format","zlib");
+    msg.addParam("name",name);
+    Engine::dispatch(msg);
+    Compressor* c = h->m_comp;
+    h->m_comp = 0;
+    TelEngine::destruct(h);
+    return c;
+}
+
+// Push data through compressTo and decompressTo using small odd sized buffers
+unsigned int StartHandler::check(const String& data)
+{
+    Compressor* comp = create("testcompress/comp");
+    Compressor* decomp = create("testcompress/decomp");
+    if (!(comp && decomp)) {
+	Debug("testcompress",DebugWarn,"Failed to create compressors, is zlibcompress loaded?");
+	TelEngine::destruct(comp);
+	TelEngine::destruct(decomp);
+	return 1;
+    }
+    String res;
+    unsigned int errors = 0;
+    unsigned int chunk = 1;
+    for (unsigned int i = 0; i < data.length() && !errors; i += chunk) {
+	chunk = 1 + (i * 7) % 997;
+	if (i + chunk > data.length())
+	    chunk = data.length() - i;
+	const char* in = data.c_str() + i;
+	unsigned int inLen = chunk;
+	while (!errors) {
+	    unsigned char z[37];
+	    unsigned int used = inLen;
+	    int n = comp->compressTo(in,used,z,sizeof(z));
+	    if (n < 0) {
+		errors++;
+		break;
+	    }
+	    in += used;
+	    inLen -= used;
+	    const unsigned char* zp = z;
+	    unsigned int zLen = n;
+	    while (true) {
+		char out[53];
+		unsigned int zUsed = zLen;
+		int m = decomp->decompressTo(zp,zUsed,out,sizeof(out));
+		if (m < 0) {
+		    errors++;
+		    break;
+		}
+		res.append(out,m);
+		zp += zUsed;
+		zLen -= zUsed;
+		if (!zLen && m < (int)sizeof(out))
+		    break;
+	    }
+	    if (!inLen && n < (int)sizeof(z))
+		break;
+	}
+    }
+    if (!errors && res != data)
+	errors++;
+    if (errors)
+	Debug("testcompress",DebugWarn,"Round trip failed, got %u of %u bytes",
+	    res.length(),data.length());
+    TelEngine::destruct(comp);
+    TelEngine::destruct(decomp);
+    return errors;
+}
+
+// Output filling the buffer exactly, another call without input must produce nothing and no error
+unsigned int StartHandler::checkExact(const String& data)
+{
+    Compressor* comp = create("testcompress/comp");
+    Compressor* decomp = create("testcompress/decomp");
+    unsigned int errors = 0;
+    if (comp && decomp) {
+	char out[2047];
+	DataBlock z;
+	comp->compress(data.c_str(),sizeof(out),z);
+	unsigned int used = z.length();
+	int n = decomp->decompressTo(z.data(),used,out,sizeof(out));
+	unsigned int none = 0;
+	int m = decomp->decompressTo(0,none,out,sizeof(out));
+	if (n != (int)sizeof(out) || used != z.length() || m != 0 || ::memcmp(out,data.c_str(),sizeof(out))) {
+	    errors++;
+	    Debug("testcompress",DebugWarn,"Exact buffer decompress returned %d (%u of %u used) then %d",
+		n,used,z.length(),m);
+	}
+    }
+    else
+	errors++;
+    TelEngine::destruct(comp);
+    TelEngine::destruct(decomp);
+    return errors;
+}
+
+// Decompress the same stanzas with the DataBlock and the caller buffer interfaces
+void StartHandler::benchRead(const String& data, unsigned int loops)
+{
+    Compressor* comp = create("testcompress/comp");
+    if (!comp)
+	return;
+    // Compress each stanza separately as a stream peer flushing them would
+    ObjList packets;
+    for (unsigned int i = 0; i < data.length(); i += ::strlen(s_stanza)) {
+	DataBlock* d = new DataBlock;
+	comp->compress(data.c_str() + i,::strlen(s_stanza),*d);
+	packets.append(d);
+    }
+    TelEngine::destruct(comp);
+    u_int64_t t[2];
+    unsigned int total[2] = { 0, 0 };
+    for (int mode = 0; mode < 2; mode++) {
+	Compressor* decomp = create("testcompress/decomp");
+	if (!decomp)
+	    return;
+	u_int64_t start = Time::now();
+	for (unsigned int n = 0; n < loops; n++) {
+	    for (ObjList* o = packets.skipNull(); o; o = o->skipNext()) {
+		DataBlock* d = static_cast<DataBlock*>(o->get());
+		if (!mode) {
+		    DataBlock out;
+		    if (decomp->decompress(d->data(),d->length(),out) > 0)
+			total[mode] += out.length();
+		    continue;
+		}
+		const unsigned char* p = (const unsigned char*)d->data();
+		unsigned int len = d->length();
+		while (true) {
+		    char out[2048];
+		    unsigned int used = len;
+		    int m = decomp->decompressTo(p,used,out,sizeof(out));
+		    if (m < 0)
+			break;
+		    total[mode] += m;
+		    p += used;
+		    len -= used;
+		    if (!len && m < (int)sizeof(out))
+			break;
+		}
+	    }
+	    // a fresh compressed stream is needed for each pass
+	    if (n + 1 < loops) {
+		TelEngine::destruct(decomp);
+		decomp = create("testcompress/decomp");
+		if (!decomp)
+		    return;
+	    }
+	}
+	t[mode] = Time::now() - start;
+	TelEngine::destruct(decomp);
+    }
+    Debug("testcompress",DebugNote,"Decompressed %u packets %u times: DataBlock " FMT64U " usec %u bytes, buffer " FMT64U " usec %u bytes",
+	packets.count(),loops,t[0],total[0],t[1],total[1]);
+}
+
+// Create and release many compressors, context memory comes from the pool after the first pass
+void StartHandler::benchStreams(unsigned int count)
+{
+    Compressor** list = new Compressor*[count];
+    for (int pass = 0; pass < 2; pass++) {
+	u_int64_t start = Time::now();
+	for (unsigned int i = 0; i < count; i++)
+	    list[i] = create("testcompress/stream");
+	u_int64_t t = Time::now() - start;
+	unsigned int ok = 0;
+	for (unsigned int i = 0; i < count; i++) {
+	    if (list[i])
+		ok++;
+	    TelEngine::destruct(list[i]);
+	}
+	Debug("testcompress",DebugNote,"Pass %d created %u of %u compressors in " FMT64U " usec",
+	    pass + 1,ok,count,t);
+    }
+    delete[] list;
+}
+
+bool StartHandler::received(Message& msg)
+{
+    unsigned int size = Engine::config().getIntValue("testcompress","size",64,1,4096);
+    unsigned int loops = Engine::config().getIntValue("testcompress","loops",20,1,10000);
+    unsigned int streams = Engine::config().getIntValue("testcompress","streams",200,1,100000);
+
+    String data;
+    size *= 1024;
+    while (data.length() < size)
+	data << s_stanza;
+    unsigned int errors = check(data) + checkExact(data);
+    Debug("testcompress",errors ? DebugWarn : DebugNote,"Checked %u bytes round trip, %u errors",
+	data.length(),errors);
+    benchRead(data,loops);
+    benchStreams(streams);
+    return false;
+}
+
+void TestCompress::initialize()
+{
+    Output("Initializing module TestCompress");
+    if (!m_first)
+	return;
+    m_first = false;
+    Engine::install(new StartHandler);
+}
+
+INIT_PLUGIN(TestCompress);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
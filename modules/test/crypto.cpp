@@ -21,6 +21,8 @@
 
 #include <yatengine.h>
 
+#include <string.h>
+
 using namespace TelEngine;
 
 class TestCrypto : public Plugin
@@ -29,10 +31,81 @@ public:
     TestCrypto();
     virtual void initialize();
     void report(const char* test, const String& result, const char* expect);
+private:
+    bool m_first;
+};
+
+// Ciphers are provided by other modules, test them once all are initialized
+class SrtpHandler : public MessageHandler
+{
+public:
+    inline SrtpHandler()
+	: MessageHandler("engine.start",150,"testcrypto")
+	{ }
+    virtual bool received(Message& msg);
+};
+
+class CipherHolder : public RefObject
+{
+public:
+    inline CipherHolder()
+	: m_cipher(0)
+	{ }
+    virtual ~CipherHolder()
+	{ TelEngine::destruct(m_cipher); }
+    virtual void* getObject(const String& name) const
+	{ return (name == YATOM("Cipher*")) ? (void*)&m_cipher : RefObject::getObject(name); }
+    inline Cipher* cipher()
+	{ Cipher* tmp = m_cipher; m_cipher = 0; return tmp; }
+private:
+    Cipher* m_cipher;
 };
 
+static Cipher* createCipher(const char* name)
+{
+    Message msg("engine.cipher");
+    msg.addParam("cipher",name);
+    CipherHolder* cHold = new CipherHolder;
+    msg.userData(cHold);
+    cHold->deref();
+    return Engine::dispatch(msg) ? cHold->cipher() : 0;
+}
+
+// Build the HMAC inner and outer partial digests like RTPSecure does
+static void hmacPads(SHA1& inner, SHA1& outer, const DataBlock& key)
+{
+    unsigned char ipad[64];
+    unsigned char opad[64];
+    const unsigned char* k = (const unsigned char*)key.data();
+    for (unsigned int i = 0; i < 64; i++) {
+	unsigned char c = (i < key.length()) ? k[i] : 0;
+	ipad[i] = c ^ 0x36;
+	opad[i] = c ^ 0x5c;
+    }
+    inner.clear();
+    outer.clear();
+    inner.update(ipad,sizeof(ipad));
+    outer.update(opad,sizeof(opad));
+}
+
+// Set the SRTP counter for a packet index in an IV that starts as the session salt
+static void srtpCounter(unsigned char* iv, u_int32_t ssrc, u_int64_t seq)
+{
+    unsigned char* p = iv + 8;
+    for (int i = 0; i < 4; i++) {
+	*--p ^= (ssrc & 0xff);
+	ssrc >>= 8;
+    }
+    p = iv + 14;
+    for (int i = 0; i < 6; i++) {
+	*--p ^= (seq & 0xff);
+	seq >>= 8;
+    }
+}
+
 TestCrypto::TestCrypto()
-    : Plugin("testcrypto")
+    : Plugin("testcrypto"),
+      m_first(true)
 {
     Output("Hello, I am module TestCrypto");
 }
@@ -106,8 +179,92 @@ void TestCrypto::initialize()
     String str;
     str.hexify(out.data(),out.length());
     report("fips-186-prf",str,"2070b3223dba372fde1c0ffc7b2e3b498b2606143c6c18bacb0f6c55babb13788e20d737a3275116");
+
+    SHA1 inner, outer;
+    unsigned char in[20], mac[20];
+    hmacPads(inner,outer,DataBlock((void*)"Jefe",4));
+    inner.rawDigestWith(in,"what do ya want ",16,"for nothing?",12);
+    outer.rawDigestWith(mac,in,sizeof(in));
+    str.hexify(mac,sizeof(mac));
+    report("sha1-hmac-pads",str,"effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+
+    if (m_first) {
+	m_first = false;
+	Engine::install(new SrtpHandler);
+    }
 }
 
 INIT_PLUGIN(TestCrypto);
 
+// Protect RTP packets the way SRTP does, compare copying per packet state with reusing it
+bool SrtpHandler::received(Message& msg)
+{
+    Cipher* cipher = createCipher("aes_ctr");
+    if (!cipher) {
+	Debug("srtp",DebugMild,"No aes_ctr cipher available, is the openssl module loaded?");
+	return false;
+    }
+    // RFC 3711 B.2 AES-CM keystream test vector
+    DataBlock key, salt;
+    key.unHexify("2b7e151628aed2a6abf7158809cf4f3c");
+    salt.unHexify("f0f1f2f3f4f5f6f7f8f9fafbfcfd0000");
+    cipher->setKey(key);
+    cipher->initVector(salt);
+    DataBlock ks(0,32);
+    cipher->encrypt(ks);
+    String str;
+    str.hexify(ks.data(),ks.length());
+    __plugin.report("aes-cm-keystream",str,"e03ead0935c95e80e166b16dd92b4eb4d23513162b02d0f72a43a2fe4a5f97ab");
+
+    unsigned int loops = Engine::config().getIntValue("testcrypto","loops",100000,1,10000000);
+    SHA1 inner, outer;
+    hmacPads(inner,outer,DataBlock((void*)"0123456789abcdefghij",20));
+    // 20 msec of G.711 with a RTP header
+    unsigned char pkt1[172], pkt2[172];
+    unsigned char tag1[10], tag2[10];
+    for (unsigned int i = 0; i < sizeof(pkt1); i++)
+	pkt1[i] = pkt2[i] = (unsigned char)i;
+    const u_int32_t ssrc = 0x12345678;
+
+    u_int64_t t = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	DataBlock iv(salt);
+	srtpCounter((unsigned char*)iv.data(),ssrc,n);
+	cipher->initVector(iv);
+	cipher->encrypt(pkt1 + 12,sizeof(pkt1) - 12);
+	u_int32_t roc = htonl(n >> 16);
+	SHA1 h1(inner);
+	h1.update(pkt1,sizeof(pkt1));
+	h1.update(&roc,sizeof(roc));
+	h1.finalize();
+	SHA1 hmac(outer);
+	hmac.update(h1.rawDigest(),h1.rawLength());
+	hmac.finalize();
+	::memcpy(tag1,hmac.rawDigest(),sizeof(tag1));
+    }
+    u_int64_t tCopy = Time::now() - t;
+
+    t = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	unsigned char iv[16];
+	::memcpy(iv,salt.data(),sizeof(iv));
+	srtpCounter(iv,ssrc,n);
+	cipher->initVector(iv,sizeof(iv));
+	cipher->encrypt(pkt2 + 12,sizeof(pkt2) - 12);
+	u_int32_t roc = htonl(n >> 16);
+	unsigned char in[20], mac[20];
+	inner.rawDigestWith(in,pkt2,sizeof(pkt2),&roc,sizeof(roc));
+	outer.rawDigestWith(mac,in,sizeof(in));
+	::memcpy(tag2,mac,sizeof(tag2));
+    }
+    u_int64_t tInPlace = Time::now() - t;
+    TelEngine::destruct(cipher);
+
+    bool ok = !(::memcmp(pkt1,pkt2,sizeof(pkt1)) || ::memcmp(tag1,tag2,sizeof(tag1)));
+    Debug("srtp",ok ? DebugNote : DebugWarn,
+	"Protected %u packets of %u bytes: copied state " FMT64U " usec, in place " FMT64U " usec%s",
+	loops,(unsigned int)sizeof(pkt1),tCopy,tInPlace,ok ? "" : ", results differ!");
+    return false;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
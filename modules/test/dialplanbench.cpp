@@ -0,0 +1,142 @@
+/**
+ * dialplanbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Prefix indexed number routing consistency and speed test
+ *
+ * Routes in the [testdialplan] context of regexroute.conf, it must hold:
+ *  ^123=or ^456=tone/or
+ *  ^55=or ^66=if ^6611=tone/chain
+ *  ^789=tone/plain
+ *  ^7=tone/seven
+ *  .*=tone/any
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+using namespace TelEngine;
+
+// Called numbers and the route expected for them
+static const struct {
+    const char* called;
+    const char* route;
+} s_routes[] = {
+    { "1234", "tone/or" },
+    { "4567", "tone/or" },
+    { "456", "tone/or" },
+    { "5521", "tone/chain" },
+    { "6611", "tone/chain" },
+    { "6601", "tone/any" },
+    { "7890", "tone/plain" },
+    { "7000", "tone/seven" },
+    { "9999", "tone/any" },
+    { "12", "tone/any" },
+    { 0, 0 }
+};
+
+// Routing is provided by another module, run when all are initialized
+class StartHandler : public MessageHandler
+{
+public:
+    inline StartHandler()
+	: MessageHandler("engine.start",150,"testdialplan")
+	{ }
+    virtual bool received(Message& msg);
+private:
+    unsigned int checkRoutes();
+    void bench(unsigned int loops);
+};
+
+class TestDialPlan : public Plugin
+{
+public:
+    TestDialPlan();
+    virtual void initialize();
+private:
+    bool m_first;
+};
+
+// Route a number in the test context, return the target
+static String route(const char* called)
+{
+    Message m("call.route");
+    m.addParam("context","testdialplan");
+    m.addParam("called",called);
+    if (!Engine::dispatch(m))
+	return "";
+    return m.retValue();
+}
+
+// Indexed routing must return what the rules return when tried in order
+unsigned int StartHandler::checkRoutes()
+{
+    unsigned int errors = 0;
+    for (int i = 0; s_routes[i].called; i++) {
+	String res = route(s_routes[i].called);
+	if (res == s_routes[i].route)
+	    continue;
+	errors++;
+	Debug("testdialplan",DebugWarn,"Number '%s' routed to '%s', expected '%s'",
+	    s_routes[i].called,res.c_str(),s_routes[i].route);
+    }
+    return errors;
+}
+
+void StartHandler::bench(unsigned int loops)
+{
+    unsigned int found = 0;
+    u_int64_t start = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	if (route(s_routes[n % 10].called))
+	    found++;
+    }
+    Debug("testdialplan",DebugNote,"Routed %u of %u numbers in " FMT64U " usec",
+	found,loops,Time::now() - start);
+}
+
+bool StartHandler::received(Message& msg)
+{
+    Configuration cfg(Engine::configFile("regexroute"));
+    if (!(cfg.load(false) && cfg.getSection("testdialplan"))) {
+	Debug("testdialplan",DebugNote,"No [testdialplan] context in regexroute.conf, nothing to check");
+	return false;
+    }
+    unsigned int errors = checkRoutes();
+    Debug("testdialplan",errors ? DebugWarn : DebugNote,"Checked indexed routes, %u errors",errors);
+    bench(Engine::config().getIntValue("testdialplan","loops",10000,1,10000000));
+    return false;
+}
+
+TestDialPlan::TestDialPlan()
+    : Plugin("testdialplan"),
+      m_first(true)
+{
+    Output("Hello, I am module TestDialPlan");
+}
+
+void TestDialPlan::initialize()
+{
+    Output("Initializing module TestDialPlan");
+    if (!m_first)
+	return;
+    m_first = false;
+    Engine::install(new StartHandler);
+}
+
+INIT_PLUGIN(TestDialPlan);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,167 @@
+/**
+ * hashbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Hash implementations consistency and throughput test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+#include <string.h>
+
+using namespace TelEngine;
+
+static const unsigned int s_sizes[] = { 16, 64, 256, 1024, 8192, 65536, 0 };
+
+// Messages hashed at once in the batch test, about the size of a digest A1
+#define BATCH_COUNT 1000
+#define BATCH_LENGTH 48
+
+class TestHash : public Plugin
+{
+public:
+    TestHash();
+    virtual void initialize();
+private:
+    template <class H> unsigned int check(const char* name, const DataBlock& data);
+    template <class H> void bench(const char* name, const DataBlock& data, unsigned int total, bool ext);
+    template <class H> void benchBatch(const char* name, const DataBlock& data, unsigned int loops);
+    bool m_first;
+};
+
+TestHash::TestHash()
+    : Plugin("testhash"),
+      m_first(true)
+{
+    Output("Hello, I am module TestHash");
+}
+
+// Compare accelerated, portable and batch digests of all prefixes of the data
+template <class H> unsigned int TestHash::check(const char* name, const DataBlock& data)
+{
+    bool ext = Hasher::shaExtensions();
+    unsigned int errors = 0;
+    const unsigned char* buf = (const unsigned char*)data.data();
+    for (unsigned int len = 0; len <= 300 && len <= data.length(); len++) {
+	Hasher::shaExtensions(true);
+	H h1(buf,len);
+	Hasher::shaExtensions(false);
+	H h2(buf,len);
+	// split updates exercise the partial block handling
+	Hasher::shaExtensions(ext);
+	H h3;
+	h3.update(buf,len / 3);
+	h3.update(buf + len / 3,len - len / 3);
+	unsigned char out[64];
+	const void* bufs[1] = { buf };
+	H::digestBatch(out,1,bufs,&len);
+	if (h1.hexDigest() == h2.hexDigest() && h1.hexDigest() == h3.hexDigest()
+	    && !::memcmp(out,h1.rawDigest(),h1.hashLength()))
+	    continue;
+	if (errors++ < 10)
+	    Debug("testhash",DebugWarn,"%s length %u: ext %s portable %s split %s",
+		name,len,h1.hexDigest().c_str(),h2.hexDigest().c_str(),h3.hexDigest().c_str());
+    }
+    Hasher::shaExtensions(ext);
+    return errors;
+}
+
+// Hash about total bytes in blocks of each size
+template <class H> void TestHash::bench(const char* name, const DataBlock& data, unsigned int total, bool ext)
+{
+    bool old = Hasher::shaExtensions();
+    for (int i = 0; s_sizes[i]; i++) {
+	unsigned int size = s_sizes[i];
+	unsigned int loops = total / size;
+	u_int64_t t[2] = { 1, 1 };
+	for (int e = 0; e < (ext ? 2 : 1); e++) {
+	    Hasher::shaExtensions(0 != e);
+	    u_int64_t start = Time::now();
+	    for (unsigned int n = 0; n < loops; n++) {
+		H h(data.data(),size);
+		h.rawDigest();
+	    }
+	    t[e] = Time::now() - start;
+	    if (!t[e])
+		t[e] = 1;
+	}
+	u_int64_t bytes = (u_int64_t)loops * size * 1000000 / 1048576;
+	if (ext)
+	    Debug("testhash",DebugNote,"%s %u byte messages: portable " FMT64U " MB/s, extensions " FMT64U " MB/s",
+		name,size,bytes / t[0],bytes / t[1]);
+	else
+	    Debug("testhash",DebugNote,"%s %u byte messages: " FMT64U " MB/s",name,size,bytes / t[0]);
+    }
+    Hasher::shaExtensions(old);
+}
+
+// Hash many short independent messages as objects and as a batch
+template <class H> void TestHash::benchBatch(const char* name, const DataBlock& data, unsigned int loops)
+{
+    const void* bufs[BATCH_COUNT];
+    unsigned int lens[BATCH_COUNT];
+    for (unsigned int i = 0; i < BATCH_COUNT; i++) {
+	bufs[i] = (const unsigned char*)data.data() + (i % 256);
+	lens[i] = BATCH_LENGTH;
+    }
+    unsigned char* out = new unsigned char[BATCH_COUNT * 32];
+    u_int64_t start = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	for (unsigned int i = 0; i < BATCH_COUNT; i++) {
+	    H h(bufs[i],lens[i]);
+	    ::memcpy(out + i * h.hashLength(),h.rawDigest(),h.hashLength());
+	}
+    }
+    u_int64_t tObj = Time::now() - start;
+    start = Time::now();
+    for (unsigned int n = 0; n < loops; n++)
+	H::digestBatch(out,BATCH_COUNT,bufs,lens);
+    u_int64_t tBatch = Time::now() - start;
+    delete[] out;
+    Debug("testhash",DebugNote,"%s %u x %u messages of %u bytes: objects " FMT64U " usec, batch " FMT64U " usec",
+	name,loops,BATCH_COUNT,BATCH_LENGTH,tObj,tBatch);
+}
+
+void TestHash::initialize()
+{
+    Output("Initializing module TestHash");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int total = 1024 * Engine::config().getIntValue("testhash","size",16384,1,1048576);
+    unsigned int loops = Engine::config().getIntValue("testhash","loops",100,1,100000);
+    Debug("testhash",DebugNote,"CPU SHA extensions %s",
+	Hasher::shaExtensions() ? "available" : "not available");
+
+    DataBlock data(0,65536 + 256);
+    unsigned char* d = (unsigned char*)data.data();
+    for (unsigned int i = 0; i < data.length(); i++)
+	d[i] = (unsigned char)Random::random();
+    unsigned int errors = check<MD5>("MD5",data) + check<SHA1>("SHA1",data) + check<SHA256>("SHA256",data);
+    Debug("testhash",errors ? DebugWarn : DebugNote,"Compared implementations, %u errors",errors);
+
+    bench<MD5>("MD5",data,total,false);
+    bench<SHA1>("SHA1",data,total,true);
+    bench<SHA256>("SHA256",data,total,true);
+    benchBatch<MD5>("MD5",data,loops);
+    benchBatch<SHA1>("SHA1",data,loops);
+    benchBatch<SHA256>("SHA256",data,loops);
+}
+
+INIT_PLUGIN(TestHash);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
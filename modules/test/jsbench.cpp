@@ -0,0 +1,310 @@
+/**
+ * jsbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Javascript tagged value and property index consistency test, arithmetic and compare speed test
+ * The property index of an object is also rebuilt while other threads use it
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatescript.h>
+
+using namespace TelEngine;
+
+// Script fragment, variable it sets, expected value and type
+struct ValueCheck
+{
+    const char* script;
+    const char* name;
+    const char* value;
+    const char* type;
+};
+
+static const ValueCheck s_checks[] = {
+    { "var a = 5; var r = a + \"7\";", "r", "57", "string" },
+    { "var a = 5; var r = a * \"7\";", "r", "35", "number" },
+    { "var a = 5; var r = a - \"x\";", "r", "NaN", "number" },
+    { "var r = true + 1;", "r", "2", "number" },
+    { "var c = true; var r = c == \"true\";", "r", "true", "boolean" },
+    { "var b = \"7\"; var r = b === 7;", "r", "false", "boolean" },
+    { "var e; var r = e === undefined;", "r", "true", "boolean" },
+    { "var d = \"abc\"; var r = !d;", "r", "false", "boolean" },
+    { "var r = \"\" + (1 < 2) + (2 < 1);", "r", "truefalse", "string" },
+    { "var h = \"0x10\"; var r = h + 1;", "r", "0x101", "string" },
+    { "var h = \"0x10\"; var r = h * 1;", "r", "16", "number" },
+    { "var w = 1; var r = w + (w = 9);", "r", "18", "number" },
+    { "var w = 1; var r = (w = 4) + w;", "r", "8", "number" },
+    { "var i = 5; var r = i++ + ++i;", "r", "12", "number" },
+    { "var x = 3; x *= 4; x -= 2; x <<= 3; x |= 1; x ^= 2; var r = x;", "r", "83", "number" },
+    { "var r = \"a\"; r += \"b\"; r += 1; r += true;", "r", "ab1true", "string" },
+    { "var o = {v: 2}; o.v += 3; o.v++; var r = o.v * o.v;", "r", "36", "number" },
+    { "function f(p,q) { var l = p + q; l += 1; return l * 2; } var r = f(1,2) + f(\"a\",\"b\");", "r", "NaN", "number" },
+    { "var r = 0; for (var i = 0; i < 50; i++) { if (i % 3 == 0 || i % 5 == 0) r += i; }", "r", "543", "number" },
+    { "var r = \"\"; for (var i = 0; i < 5; i++) r += \"<\" + i + \">\";", "r", "<0><1><2><3><4>", "string" },
+    { "function g(n) { if (n <= 1) return 1; return n * g(n - 1); } var r = g(10);", "r", "3628800", "number" },
+    { "var a = [1,2,3]; var r = a[0] == 1 && a[2] === 3 && a.length * 2 == 6;", "r", "true", "boolean" },
+    { "var o = {a:1,b:2,c:3,d:4,e:5,f:6,g:7,h:8,i:9}; o.j = 10; o.a = 20; var r = o.a + o.j + o.e;", "r", "35", "number" },
+    { "var a = [0,1,2,3,4,5,6,7,8,9]; a.reverse(); a.shift(); a.unshift(7); var r = \"\" + a[0] + a[1] + a[9];", "r", "780", "string" },
+    { "var v1 = 1; var v2 = 2; var v3 = 3; var v4 = 4; var v5 = 5; var v6 = 6; var v7 = 7; var v8 = 8; var r = 0; for (var i = 0; i < 10; i++) { r = r + v1 + v8; v5 = i; var n = v5; } r += n;", "r", "99", "number" },
+    { 0, 0, 0, 0 }
+};
+
+// Per call work of a routing script: number arithmetic and string compares
+static const char* s_bench =
+    "var called = \"0123456789\"; var caller = \"5551234\"; var hits = 0; var sum = 0; var tag = \"\";\n"
+    "for (var i = 0; i < loops; i++) {\n"
+    "    var n = i % 97;\n"
+    "    sum = sum + n * 3 - (n >> 1);\n"
+    "    if (called == \"0123456789\" && caller != \"555\") hits++;\n"
+    "    if (n < 10 || n >= 90)\n"
+    "\ttag = \"p\" + n;\n"
+    "    if (tag === \"p5\")\n"
+    "\tsum += 1;\n"
+    "}\n";
+
+// Scripts run in contexts sharing the same native objects, variable and value expected
+// Prototypes changed by one context, even through objects created before, must not reach the next
+static const ValueCheck s_shared[] = {
+    { "var a = [3,1,2]; Array.prototype.twice = function() { return this.length * 2; }; var c = [4]; var r = a.twice() + c.twice();", "r", "8", "number" },
+    { "var b = [5]; var r = typeof b.twice;", "r", "undefined", "string" },
+    { "var d = []; d.__proto__.tag = \"x\"; var e = []; var r = e.tag + d.tag;", "r", "xx", "string" },
+    { "var d = []; var r = typeof d.tag;", "r", "undefined", "string" },
+    { "Array.answer = 42; var r = Array.answer + Math.abs(-1);", "r", "43", "number" },
+    { "var r = typeof Array.answer;", "r", "undefined", "string" },
+    { 0, 0, 0, 0 }
+};
+
+// Native objects shared by several contexts, like the routing script snapshot
+class SharedNatives : public ScriptContext
+{
+public:
+    SharedNatives();
+    virtual Mutex* mutex()
+	{ return 0; }
+    virtual bool unshareField(const String& name, ScriptContext& context) const;
+};
+
+// Properties of the object read by several threads while its index is rebuilt
+#define SHARED_PROPS 16
+
+// State shared by the threads reading the same object
+struct ReadShared
+{
+    const JsObject* obj;
+    volatile bool go;
+    volatile bool stop;
+    volatile int running;
+    volatile int errors;
+};
+
+// Thread finding the properties of an object shared with other threads
+class ReadThread : public Thread
+{
+public:
+    inline ReadThread(ReadShared* shared)
+	: Thread("JsRead"), m_shared(shared)
+	{ }
+    virtual void run();
+private:
+    ReadShared* m_shared;
+};
+
+class TestJs : public Plugin
+{
+public:
+    TestJs();
+    virtual void initialize();
+private:
+    unsigned int checkValues();
+    unsigned int checkShared();
+    unsigned int checkThreads(unsigned int rounds);
+    void bench(unsigned int loops);
+    bool m_first;
+};
+
+// Parse a script, run it in a new context and return the runner
+static ScriptRun* runScript(const char* script, unsigned int loops = 0)
+{
+    JsParser parser;
+    parser.link();
+    if (!parser.parse(script))
+	return 0;
+    ScriptRun* runner = parser.createRunner();
+    if (!runner)
+	return 0;
+    if (loops)
+	runner->context()->params().setParam(new ExpOperation((int64_t)loops,"loops"));
+    if (runner->run() != ScriptRun::Succeeded)
+	TelEngine::destruct(runner);
+    return runner;
+}
+
+SharedNatives::SharedNatives()
+{
+    JsObject::initialize(this);
+    for (ObjList* l = params().paramList()->skipNull(); l; l = l->skipNext()) {
+	JsObject* jso = YOBJECT(JsObject,l->get());
+	if (!jso)
+	    continue;
+	jso->setSnapshot();
+	JsObject* proto = YOBJECT(JsObject,jso->params().getParam(YSTRING("prototype")));
+	if (proto)
+	    proto->setSnapshot();
+    }
+}
+
+// The standard objects refer to each other so they are created again together
+bool SharedNatives::unshareField(const String& name, ScriptContext& context) const
+{
+    static const char* s_names[] = { "Object", "Function", "Array", "RegExp", "Date", "Math", 0 };
+    for (int i = 0; s_names[i]; i++)
+	context.params().clearParam(s_names[i]);
+    JsObject::initialize(&context);
+    return true;
+}
+
+void ReadThread::run()
+{
+    while (!m_shared->go)
+	Thread::yield();
+    unsigned int errors = 0;
+    JsPropertyCache cache;
+    while (!m_shared->stop) {
+	for (int i = 0; i < SHARED_PROPS; i++) {
+	    String name("p");
+	    name << i;
+	    ObjList* item = m_shared->obj->propertyItem(name,(i & 1) ? &cache : 0);
+	    if (!(item && item->get() && item->get()->toString() == name))
+		errors++;
+	}
+    }
+    if (errors)
+	__sync_add_and_fetch(&m_shared->errors,errors);
+    __sync_sub_and_fetch(&m_shared->running,1);
+}
+
+TestJs::TestJs()
+    : Plugin("testjs"),
+      m_first(true)
+{
+    Output("Hello, I am module TestJs");
+}
+
+// Values computed on the tagged stack must match those of generic operations
+unsigned int TestJs::checkValues()
+{
+    unsigned int errors = 0;
+    for (const ValueCheck* c = s_checks; c->script; c++) {
+	ScriptRun* runner = runScript(c->script);
+	const ExpOperation* op = runner ? YOBJECT(ExpOperation,runner->context()->params().getParam(c->name)) : 0;
+	String type = op ? op->typeOf() : "";
+	if (!(op && *op == c->value && type == c->type)) {
+	    errors++;
+	    Debug("testjs",DebugWarn,"Script '%s' set %s='%s' (%s), expected '%s' (%s)",
+		c->script,c->name,TelEngine::c_safe(op),type.c_str(),c->value,c->type);
+	}
+	TelEngine::destruct(runner);
+    }
+    return errors;
+}
+
+// Changes of shared objects must stay in the context making them
+unsigned int TestJs::checkShared()
+{
+    unsigned int errors = 0;
+    SharedNatives* shared = new SharedNatives;
+    for (const ValueCheck* c = s_shared; c->script; c++) {
+	JsParser parser;
+	parser.link();
+	ScriptContext* ctx = parser.parse(c->script) ? parser.createContext(shared) : 0;
+	ScriptRun* runner = ctx ? parser.createRunner(ctx) : 0;
+	TelEngine::destruct(ctx);
+	if (runner && runner->run() != ScriptRun::Succeeded)
+	    TelEngine::destruct(runner);
+	const ExpOperation* op = runner ? YOBJECT(ExpOperation,runner->context()->params().getParam(c->name)) : 0;
+	String type = op ? op->typeOf() : "";
+	if (!(op && *op == c->value && type == c->type)) {
+	    errors++;
+	    Debug("testjs",DebugWarn,"Shared script '%s' set %s='%s' (%s), expected '%s' (%s)",
+		c->script,c->name,TelEngine::c_safe(op),type.c_str(),c->value,c->type);
+	}
+	TelEngine::destruct(runner);
+    }
+    TelEngine::destruct(shared);
+    return errors;
+}
+
+// Rebuild the index of an object while other threads look up its properties
+unsigned int TestJs::checkThreads(unsigned int rounds)
+{
+    JsObject* obj = new JsObject(0,"[object Object]");
+    for (int i = 0; i < SHARED_PROPS; i++) {
+	String name("p");
+	name << i;
+	obj->params().addParam(new ExpOperation((int64_t)i,name));
+    }
+    ReadShared shared = { obj, false, false, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+	ReadThread* t = new ReadThread(&shared);
+	if (t->startup())
+	    __sync_add_and_fetch(&shared.running,1);
+	else
+	    delete t;
+    }
+    shared.go = true;
+    for (unsigned int r = 0; r < rounds; r++) {
+	// retrieving the list for changes makes the next lookup build a new index
+	obj->params();
+	if (!obj->propertyItem("p0"))
+	    shared.errors++;
+    }
+    shared.stop = true;
+    while (shared.running)
+	Thread::yield();
+    TelEngine::destruct(obj);
+    if (shared.errors)
+	Debug("testjs",DebugWarn,"Concurrent lookups found %d errors",shared.errors);
+    return shared.errors;
+}
+
+void TestJs::bench(unsigned int loops)
+{
+    u_int64_t start = Time::now();
+    ScriptRun* runner = runScript(s_bench,loops);
+    u_int64_t t = Time::now() - start;
+    const NamedString* hits = runner ? runner->context()->params().getParam("hits") : 0;
+    Debug("testjs",DebugNote,"Ran %u loops of arithmetic and compares in " FMT64U " usec, %s hits",
+	loops,t,TelEngine::c_safe(hits));
+    TelEngine::destruct(runner);
+}
+
+void TestJs::initialize()
+{
+    Output("Initializing module TestJs");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int errors = checkValues();
+    errors += checkShared();
+    errors += checkThreads(2000);
+    Debug("testjs",errors ? DebugWarn : DebugNote,"Checked script values, %u errors",errors);
+    bench(Engine::config().getIntValue("testjs","loops",200000,1,100000000));
+}
+
+INIT_PLUGIN(TestJs);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,302 @@
+/**
+ * mimebench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * MIME lazy parsing consistency test, body and header parsing speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatemime.h>
+
+using namespace TelEngine;
+
+// SIP-I like body: SDP, ISUP and a text part
+static const char* s_type = "multipart/mixed; boundary=unique-boundary-1; charset=\"utf-8\"";
+static const char* s_body =
+    "--unique-boundary-1\r\n"
+    "Content-Type: application/sdp\r\n"
+    "\r\n"
+    "v=0\r\n"
+    "o=yate 1418640000 1418640000 IN IP4 192.168.1.10\r\n"
+    "s=SIP Call\r\n"
+    "c=IN IP4 192.168.1.10\r\n"
+    "t=0 0\r\n"
+    "m=audio 20000 RTP/AVP 0 8 101\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=fmtp:101 0-16\r\n"
+    "a=ptime:20\r\n"
+    "\r\n"
+    "--unique-boundary-1\r\n"
+    "Content-Type: application/isup; version=itu-t92+; base=itu-t92+\r\n"
+    "Content-Disposition: signal; handling=optional\r\n"
+    "\r\n"
+    "\x01\x11\x60\x01\x0a\x03\x02\x0a\x08\x83\x90\x89\x41\x02\x13\x14\x0f\x0a\x07\x03\x13\x09\x32\x54\x76\x04"
+    "\r\n"
+    "--unique-boundary-1\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "Some text\r\nin two lines"
+    "\r\n"
+    "--unique-boundary-1--\r\n";
+
+// State shared by the threads reading the same header and body
+struct ReadShared
+{
+    const MimeHeaderLine* hdr;
+    const MimeBody* body;
+    volatile bool go;
+    volatile int running;
+    volatile int errors;
+};
+
+// Thread reading the same objects as other threads, all parse on first access
+class ReadThread : public Thread
+{
+public:
+    inline ReadThread(ReadShared* shared)
+	: Thread("MimeRead"), m_shared(shared)
+	{ }
+    virtual void run();
+private:
+    unsigned int check();
+    ReadShared* m_shared;
+};
+
+class TestMime : public Plugin
+{
+public:
+    TestMime();
+    virtual void initialize();
+private:
+    unsigned int checkHeader();
+    unsigned int checkBody(const String& data, const MimeHeaderLine& type);
+    unsigned int checkThreads(const String& data, const MimeHeaderLine& type, unsigned int rounds);
+    void bench(const String& data, const MimeHeaderLine& type, unsigned int loops);
+    bool m_first;
+};
+
+void ReadThread::run()
+{
+    while (!m_shared->go)
+	Thread::yield();
+    unsigned int errors = check();
+    if (errors)
+	__sync_add_and_fetch(&m_shared->errors,errors);
+    __sync_sub_and_fetch(&m_shared->running,1);
+}
+
+unsigned int ReadThread::check()
+{
+    unsigned int errors = 0;
+    const MimeHeaderLine* hdr = m_shared->hdr;
+    const NamedString* b = hdr->getParam("boundary");
+    if (!(b && *b == "unique-boundary-1" && hdr->params().count() == 2))
+	errors++;
+    MimeHeaderLine copy(*hdr);
+    if (copy.params().count() != 2)
+	errors++;
+    const MimeSdpBody* sdp = YOBJECT(MimeSdpBody,m_shared->body->getFirst("application/sdp"));
+    MimeBody* clone = sdp ? sdp->clone() : 0;
+    if (!(sdp && sdp->lines().count() == 11 && sdp->getLine("c")))
+	errors++;
+    const MimeSdpBody* sdpClone = YOBJECT(MimeSdpBody,clone);
+    if (!(sdpClone && sdpClone->lines().count() == 11))
+	errors++;
+    TelEngine::destruct(clone);
+    return errors;
+}
+
+TestMime::TestMime()
+    : Plugin("testmime"),
+      m_first(true)
+{
+    Output("Hello, I am module TestMime");
+}
+
+// Parameters split when first used must match the text
+unsigned int TestMime::checkHeader()
+{
+    unsigned int errors = 0;
+    MimeHeaderLine hdr("Content-Type",s_type,';');
+    MimeHeaderLine copy(hdr);
+    String line;
+    hdr.buildLine(line);
+    if (line != "Content-Type: multipart/mixed;boundary=unique-boundary-1;charset=\"utf-8\"") {
+	errors++;
+	Debug("testmime",DebugWarn,"Built header line '%s'",line.c_str());
+    }
+    const NamedString* b = copy.getParam("boundary");
+    if (!(b && *b == "unique-boundary-1" && copy.params().count() == 2 && hdr == "multipart/mixed")) {
+	errors++;
+	Debug("testmime",DebugWarn,"Copied header '%s' boundary '%s' %u params",
+	    copy.c_str(),TelEngine::c_safe(b),copy.params().count());
+    }
+    // Changes made before the parameters are parsed must not be lost
+    MimeHeaderLine set("Content-Type",s_type,';');
+    set.setParam("charset","ascii");
+    set.delParam("boundary");
+    set.setParam("x","1");
+    line.clear();
+    set.buildLine(line,false);
+    if (line != "multipart/mixed;charset=ascii;x=1") {
+	errors++;
+	Debug("testmime",DebugWarn,"Changed header line '%s'",line.c_str());
+    }
+    return errors;
+}
+
+// Compare bodies built and cloned at different moments of parsing
+unsigned int TestMime::checkBody(const String& data, const MimeHeaderLine& type)
+{
+    unsigned int errors = 0;
+    MimeBody* ref = MimeBody::build(data.c_str(),data.length(),type);
+    if (!(ref && ref->isMultipart())) {
+	Debug("testmime",DebugWarn,"Failed to build multipart body");
+	TelEngine::destruct(ref);
+	return 1;
+    }
+    // Clones keep only the content type of the parts, compare with a clone of a parsed body
+    ref->getBody();
+    MimeBody* refClone = ref->clone();
+    String refBody((const char*)refClone->getBody().data(),refClone->getBody().length());
+    TelEngine::destruct(refClone);
+
+    // Clone before anything is parsed then release the original
+    MimeBody* body = MimeBody::build(data.c_str(),data.length(),type);
+    MimeBody* clone = body->clone();
+    MimeBody* sdpClone = body->getFirst("application/sdp");
+    sdpClone = sdpClone ? sdpClone->clone() : 0;
+    TelEngine::destruct(body);
+    String cloneBody((const char*)clone->getBody().data(),clone->getBody().length());
+    if (cloneBody != refBody) {
+	errors++;
+	Debug("testmime",DebugWarn,"Clone body differs:\r\n%s\r\nexpected:\r\n%s",
+	    cloneBody.c_str(),refBody.c_str());
+    }
+
+    MimeSdpBody* sdp = YOBJECT(MimeSdpBody,sdpClone);
+    const NamedString* c = sdp ? sdp->getLine("c") : 0;
+    if (!(c && *c == "IN IP4 192.168.1.10" && sdp->lines().count() == 11)) {
+	errors++;
+	Debug("testmime",DebugWarn,"SDP part line c='%s' %u lines",
+	    TelEngine::c_safe(c),sdp ? sdp->lines().count() : 0);
+    }
+    TelEngine::destruct(sdpClone);
+
+    MimeBinaryBody* isup = YOBJECT(MimeBinaryBody,clone->getFirst("application/isup"));
+    if (!(isup && isup->body().length() == 26 && ((const unsigned char*)isup->body().data())[0] == 0x01)) {
+	errors++;
+	Debug("testmime",DebugWarn,"ISUP part has %u bytes",isup ? isup->body().length() : 0);
+    }
+    MimeStringBody* text = YOBJECT(MimeStringBody,clone->getFirst("text/plain"));
+    if (!(text && text->text() == "\r\nSome text\r\nin two lines")) {
+	errors++;
+	Debug("testmime",DebugWarn,"Text part '%s'",text ? text->text().c_str() : "");
+    }
+    const NamedString* ver = isup ? isup->getType().getParam("version") : 0;
+    if (!(ver && *ver == "itu-t92+")) {
+	errors++;
+	Debug("testmime",DebugWarn,"ISUP version '%s'",TelEngine::c_safe(ver));
+    }
+    TelEngine::destruct(clone);
+    TelEngine::destruct(ref);
+    return errors;
+}
+
+// Let several threads parse the same objects at once
+unsigned int TestMime::checkThreads(const String& data, const MimeHeaderLine& type, unsigned int rounds)
+{
+    unsigned int errors = 0;
+    for (unsigned int r = 0; r < rounds; r++) {
+	MimeHeaderLine hdr("Content-Type",s_type,';');
+	MimeBody* body = MimeBody::build(data.c_str(),data.length(),type);
+	if (!body)
+	    return errors + 1;
+	ReadShared shared = { &hdr, body, false, 0, 0 };
+	for (int i = 0; i < 4; i++) {
+	    ReadThread* t = new ReadThread(&shared);
+	    if (t->startup())
+		__sync_add_and_fetch(&shared.running,1);
+	    else
+		delete t;
+	}
+	shared.go = true;
+	while (shared.running)
+	    Thread::yield();
+	errors += shared.errors;
+	TelEngine::destruct(body);
+    }
+    if (errors)
+	Debug("testmime",DebugWarn,"Concurrent parsing found %u errors",errors);
+    return errors;
+}
+
+// Build bodies and use nothing as when forwarding, only the SDP connection line, then all parts
+void TestMime::bench(const String& data, const MimeHeaderLine& type, unsigned int loops)
+{
+    u_int64_t t[3];
+    unsigned int found[3] = { 0, 0, 0 };
+    for (int mode = 0; mode < 3; mode++) {
+	u_int64_t start = Time::now();
+	for (unsigned int n = 0; n < loops; n++) {
+	    MimeBody* body = MimeBody::build(data.c_str(),data.length(),type);
+	    if (body)
+		found[mode]++;
+	    MimeSdpBody* sdp = mode ? YOBJECT(MimeSdpBody,body ? body->getFirst("application/sdp") : 0) : 0;
+	    if (sdp && !sdp->getLine("c"))
+		found[mode]--;
+	    if (mode > 1 && body)
+		body->getBody();
+	    TelEngine::destruct(body);
+	}
+	t[mode] = Time::now() - start;
+    }
+    Debug("testmime",DebugNote,"Parsed %u bodies of %u bytes: unused " FMT64U " usec (%u), SDP only " FMT64U
+	" usec (%u), all parts " FMT64U " usec (%u)",
+	loops,data.length(),t[0],found[0],t[1],found[1],t[2],found[2]);
+
+    u_int64_t start = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	MimeHeaderLine hdr("Content-Type",s_type,';');
+	if (hdr != "multipart/mixed")
+	    break;
+    }
+    Debug("testmime",DebugNote,"Built %u header lines without reading parameters in " FMT64U " usec",
+	loops,Time::now() - start);
+}
+
+void TestMime::initialize()
+{
+    Output("Initializing module TestMime");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int loops = Engine::config().getIntValue("testmime","loops",20000,1,10000000);
+
+    String data(s_body);
+    MimeHeaderLine type("Content-Type",s_type,';');
+    unsigned int errors = checkHeader() + checkBody(data,type);
+    errors += checkThreads(data,type,Engine::config().getIntValue("testmime","rounds",200,0,100000));
+    Debug("testmime",errors ? DebugWarn : DebugNote,"Checked lazy parsing, %u errors",errors);
+    bench(data,type,loops);
+}
+
+INIT_PLUGIN(TestMime);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
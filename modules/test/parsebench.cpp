@@ -0,0 +1,240 @@
+/**
+ * parsebench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * URI and SIP start line parsers consistency and speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatesip.h>
+
+using namespace TelEngine;
+
+static const char* s_uris[] = {
+    "sip:alice@example.com",
+    "<sip:bob@example.org;transport=tcp>;tag=1928301774",
+    "\"Alice Liddell\" <sip:alice@atlanta.example.com:5061;lr>;tag=9fxced76sl",
+    "Bob <sips:bob%20smith@[2001:db8::10]:5061>",
+    "sip:+40213456789@10.0.0.1;user=phone",
+    "tel:+1-201-555-0123;phone-context=example.com",
+    "<sip:proxy.example.com;lr>",
+    "sip:10.20.30.40:5060",
+    "xmpp:user@jabber.example.net/resource",
+    "http://www.example.com/path?query=1&x=2",
+    "  \"Anonymous\"   <sip:anonymous@anonymous.invalid>",
+    "not an uri",
+    0
+};
+
+static const char* s_lines[] = {
+    "INVITE sip:bob@biloxi.example.com SIP/2.0",
+    "ACK sip:bob@192.0.2.4 SIP/2.0",
+    "REGISTER sip:registrar.example.com SIP/2.0",
+    "SIP/2.0 180 Ringing",
+    "SIP/2.0 200 OK",
+    "SIP/2.0 407 Proxy Authentication Required",
+    "sip/2.0 100 trying",
+    "OPTIONS * SIP/2.0",
+    0
+};
+
+// Pieces used to build random URIs and start lines
+static const char* s_pieces[] = {
+    "sip", "sips", "tel", "xmpp", "jabber", "SIP", "http", "a", "1", "+40", "9",
+    ":", "//", "/", "@", "<", ">", "\"", " ", "\t", "\n", "[", "]", "::1", "2001:db8::", ".",
+    "_", "+", "-", ";", "?", "&", "=", "%20", "%4", "%", "example.com", "user",
+    "5060", "lr", "tag=x", "\001", "\377", "SIP/2.0", "SIP/1.10", "INVITE", "200", "99",
+    "1000", "OK", "Ringing", "ACK"
+};
+
+class TestParse : public Plugin
+{
+public:
+    TestParse();
+    virtual void initialize();
+private:
+    unsigned int fuzzUri(unsigned int count);
+    unsigned int fuzzLine(unsigned int count);
+    void benchUri(unsigned int loops);
+    void benchLine(unsigned int loops);
+    bool m_first;
+};
+
+static void randomText(String& str)
+{
+    str.clear();
+    unsigned int n = Random::random() % 12;
+    for (unsigned int i = 0; i < n; i++)
+	str << s_pieces[Random::random() % (sizeof(s_pieces) / sizeof(s_pieces[0]))];
+}
+
+static String dumpUri(const URI& uri)
+{
+    String tmp;
+    tmp << "desc='" << uri.getDescription() << "' proto='" << uri.getProtocol()
+	<< "' user='" << uri.getUser() << "' host='" << uri.getHost()
+	<< "' port=" << uri.getPort() << " extra='" << uri.getExtra()
+	<< "' value='" << uri << "'";
+    return tmp;
+}
+
+static String dumpLine(const char* line)
+{
+    String buf(line);
+    buf << "\r\n\r\n";
+    SIPMessage* msg = SIPMessage::fromParsing(0,buf.c_str(),buf.length());
+    if (!msg)
+	return "invalid";
+    String tmp;
+    if (msg->isAnswer())
+	tmp << "answer version='" << msg->version << "' code=" << msg->code
+	    << " reason='" << msg->reason << "'";
+    else
+	tmp << "request method='" << msg->method << "' uri='" << msg->uri
+	    << "' version='" << msg->version << "' ack=" << msg->isACK();
+    TelEngine::destruct(msg);
+    return tmp;
+}
+
+TestParse::TestParse()
+    : Plugin("testparse"),
+      m_first(true)
+{
+    Output("Hello, I am module TestParse");
+}
+
+// Compare the results of the two URI parsers on random input
+unsigned int TestParse::fuzzUri(unsigned int count)
+{
+    unsigned int errors = 0;
+    String str;
+    for (unsigned int i = 0; i < count; i++) {
+	randomText(str);
+	URI::fastParse(true);
+	String r1 = dumpUri(URI(str));
+	URI::fastParse(false);
+	String r2 = dumpUri(URI(str));
+	if (r1 == r2)
+	    continue;
+	if (errors++ < 20)
+	    Debug("testparse",DebugWarn,"URI '%s'\r\n fast: %s\r\n  regexp: %s",
+		str.c_str(),r1.c_str(),r2.c_str());
+    }
+    URI::fastParse(true);
+    return errors;
+}
+
+// Compare the results of the two SIP start line parsers on random input
+unsigned int TestParse::fuzzLine(unsigned int count)
+{
+    unsigned int errors = 0;
+    String str;
+    for (unsigned int i = 0; i < count; i++) {
+	randomText(str);
+	// line breaks would start the headers, skip them
+	if (str.find('\r') >= 0 || str.find('\n') >= 0)
+	    continue;
+	URI::fastParse(true);
+	String r1 = dumpLine(str);
+	URI::fastParse(false);
+	String r2 = dumpLine(str);
+	if (r1 == r2)
+	    continue;
+	if (errors++ < 20)
+	    Debug("testparse",DebugWarn,"Line '%s'\r\n fast: %s\r\n  regexp: %s",
+		str.c_str(),r1.c_str(),r2.c_str());
+    }
+    URI::fastParse(true);
+    return errors;
+}
+
+void TestParse::benchUri(unsigned int loops)
+{
+    u_int64_t t[2];
+    for (int fast = 0; fast < 2; fast++) {
+	URI::fastParse(0 != fast);
+	u_int64_t start = Time::now();
+	for (unsigned int n = 0; n < loops; n++) {
+	    for (int i = 0; s_uris[i]; i++) {
+		URI uri(s_uris[i]);
+		uri.parse();
+	    }
+	}
+	t[fast] = Time::now() - start;
+    }
+    URI::fastParse(true);
+    Debug("testparse",DebugNote,"URI parsing %u loops: fast " FMT64U " usec, regexp " FMT64U " usec",
+	loops,t[1],t[0]);
+}
+
+void TestParse::benchLine(unsigned int loops)
+{
+    u_int64_t t[2];
+    for (int fast = 0; fast < 2; fast++) {
+	URI::fastParse(0 != fast);
+	u_int64_t start = Time::now();
+	for (unsigned int n = 0; n < loops; n++) {
+	    for (int i = 0; s_lines[i]; i++) {
+		String buf(s_lines[i]);
+		buf << "\r\n\r\n";
+		SIPMessage* msg = SIPMessage::fromParsing(0,buf.c_str(),buf.length());
+		TelEngine::destruct(msg);
+	    }
+	}
+	t[fast] = Time::now() - start;
+    }
+    URI::fastParse(true);
+    Debug("testparse",DebugNote,"SIP start line parsing %u loops: fast " FMT64U " usec, regexp " FMT64U " usec",
+	loops,t[1],t[0]);
+}
+
+void TestParse::initialize()
+{
+    Output("Initializing module TestParse");
+    if (!m_first)
+	return;
+    m_first = false;
+    // the parser selection is global, run on an engine that handles no traffic
+    unsigned int fuzz = Engine::config().getIntValue("testparse","fuzz",100000,0);
+    unsigned int loops = Engine::config().getIntValue("testparse","loops",10000,1);
+
+    unsigned int errors = 0;
+    for (int i = 0; s_uris[i]; i++) {
+	URI::fastParse(true);
+	String r1 = dumpUri(URI(s_uris[i]));
+	URI::fastParse(false);
+	String r2 = dumpUri(URI(s_uris[i]));
+	if (r1 == r2)
+	    Debug("testparse",DebugInfo,"URI '%s': %s",s_uris[i],r1.c_str());
+	else {
+	    Debug("testparse",DebugWarn,"URI '%s'\r\n fast: %s\r\n  regexp: %s",
+		s_uris[i],r1.c_str(),r2.c_str());
+	    errors++;
+	}
+    }
+    URI::fastParse(true);
+    errors += fuzzUri(fuzz);
+    errors += fuzzLine(fuzz);
+    Debug("testparse",errors ? DebugWarn : DebugNote,"Compared parsers on %u random inputs, %u errors",
+	fuzz,errors);
+    benchUri(loops);
+    benchLine(loops);
+}
+
+INIT_PLUGIN(TestParse);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,215 @@
+/**
+ * regexbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Regular expression matcher consistency and speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+using namespace TelEngine;
+
+// Patterns as found in regexroute.conf and in the SIP parser
+static const struct {
+    const char* pattern;
+    bool extended;
+    bool insensitive;
+} s_patterns[] = {
+    { "^99991001$", false, false },
+    { "^0040\\(.*\\)$", false, false },
+    { "^\\+\\?[0-9]\\{6,15\\}$", false, false },
+    { "^\\(00\\|+\\)\\(1\\|7\\|2[07]\\|3[0-469]\\|4[013-9]\\)", false, false },
+    { "^\\(0[1-9][0-9]\\{7,8\\}\\|1[0-9]\\{2,3\\}\\|112\\)$", false, false },
+    { "^[0-9]*[#*]\\?$", false, false },
+    { "^\\([a-z0-9._-]\\+\\)@\\(.*\\)$", false, true },
+    { "^sips\\?:\\([^@;>]*@\\)\\?\\([^:;>]\\+\\)", false, true },
+    { "^\\([[:alpha:]]\\+\\) \\([^ ]\\+\\) SIP/\\([0-9]\\+\\.[0-9]\\+\\)$", false, false },
+    { "^SIP/[0-9]\\+\\.[0-9]\\+ [0-9][0-9][0-9]", false, false },
+    { "^(INVITE|ACK|BYE|CANCEL|OPTIONS|REGISTER|SUBSCRIBE|NOTIFY|INFO|REFER|MESSAGE)$", true, false },
+    { "^(tel|sips?):\\+?[0-9]+(;[a-z-]+(=[^;]*)?)*$", true, true },
+    { "(voicemail|vm|mailbox)[0-9]*", true, true },
+    { 0, false, false }
+};
+
+static const char* s_subjects[] = {
+    "99991001",
+    "99991002",
+    "0040213456789",
+    "+40213456789",
+    "40213456789",
+    "0017035551234",
+    "+4930123456",
+    "021345678",
+    "112",
+    "1234#",
+    "*99",
+    "john.doe@example.com",
+    "Alice-99@sip.example.org",
+    "sip:alice@example.com;transport=tcp",
+    "SIPS:bob@[2001:db8::1]:5061",
+    "sip:10.0.0.1:5060",
+    "tel:+40213456789;phone-context=example.com",
+    "INVITE sip:bob@example.com SIP/2.0",
+    "REGISTER sip:example.com SIP/2.0",
+    "SIP/2.0 180 Ringing",
+    "SIP/2.0 200 OK",
+    "OPTIONS",
+    "SUBSCRIBE",
+    "VoiceMail123",
+    "my-mailbox",
+    "a rather long string that does not look like any number or uri at all",
+    "",
+    0
+};
+
+// Case insensitive bracket ranges with non letter ends, glibc compares upper case
+static const struct {
+    const char* pattern;
+    bool extended;
+    const char* subject;
+} s_icase[] = {
+    { "[.-\\{b[[:digit:]]", false, "a" },
+    { ".[\\-}]1", false, ".A1a" },
+    { "[\\|.-\\{]", true, "x," },
+    { "^[Z-a]$", false, "_" },
+    { "^[Z-a]$", false, "z" },
+    { "^[^A-Z]$", false, "q" },
+    { "^[[:lower:]]\\+$", false, "AbC" },
+    { 0, false, 0 }
+};
+
+// Characters random bracket expressions are made of
+static const char s_bracketChars[] = ".-\\{}|[]bAZaz09_^:";
+
+class TestRegex : public Plugin
+{
+public:
+    TestRegex();
+    virtual void initialize();
+private:
+    unsigned int check(const char* pattern, bool extended, bool insensitive, const char* subject);
+    unsigned int checkBrackets(unsigned int count);
+    bool m_first;
+};
+
+TestRegex::TestRegex()
+    : Plugin("testregex"),
+      m_first(true)
+{
+    Output("Hello, I am module TestRegex");
+}
+
+// Compare the fast matcher with regexec for one subject
+unsigned int TestRegex::check(const char* pattern, bool extended, bool insensitive, const char* subject)
+{
+    Regexp r(pattern,extended,insensitive);
+    if (!r.compile())
+	return 0;
+    String subj(subject);
+    bool dfa = r.matches(subject);
+    bool nfa = subj.matches(r);
+    if (dfa == nfa)
+	return 0;
+    Debug("testregex",DebugWarn,"Pattern '%s'%s%s subject '%s': fast=%s regexec=%s",
+	pattern,(extended ? " extended" : ""),(insensitive ? " insensitive" : ""),
+	subject,String::boolText(dfa),String::boolText(nfa));
+    return 1;
+}
+
+// Compare random bracket expressions with and without case
+unsigned int TestRegex::checkBrackets(unsigned int count)
+{
+    unsigned int errors = 0;
+    for (unsigned int i = 0; i < count && errors < 20; i++) {
+	String pattern("[");
+	unsigned int len = 1 + Random::random() % 6;
+	for (unsigned int j = 0; j < len; j++)
+	    pattern += s_bracketChars[Random::random() % (sizeof(s_bracketChars) - 1)];
+	pattern += "]";
+	char subject[2] = { (char)(0x20 + Random::random() % 0x5f), 0 };
+	unsigned int flags = Random::random() % 4;
+	errors += check(pattern,0 != (flags & 1),0 != (flags & 2),subject);
+    }
+    return errors;
+}
+
+void TestRegex::initialize()
+{
+    Output("Initializing module TestRegex");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int loops = Engine::config().getIntValue("testregex","loops",10000,1,10000000);
+
+    int count = 0;
+    while (s_subjects[count])
+	count++;
+    String* subj = new String[count];
+    for (int j = 0; j < count; j++)
+	subj[j] = s_subjects[j];
+
+    unsigned int errors = 0;
+    for (int i = 0; s_icase[i].pattern; i++)
+	errors += check(s_icase[i].pattern,s_icase[i].extended,true,s_icase[i].subject);
+    errors += checkBrackets(Engine::config().getIntValue("testregex","brackets",100000,0,10000000));
+    Debug("testregex",errors ? DebugWarn : DebugNote,"Checked bracket expressions, %u errors",errors);
+    u_int64_t totalDfa = 0;
+    u_int64_t totalNfa = 0;
+    for (int i = 0; s_patterns[i].pattern; i++) {
+	Regexp r(s_patterns[i].pattern,s_patterns[i].extended,s_patterns[i].insensitive);
+	if (!r.compile()) {
+	    Debug("testregex",DebugWarn,"Pattern '%s' failed to compile",r.c_str());
+	    errors++;
+	    continue;
+	}
+	// a String match requests subexpressions so it always uses regexec
+	for (int j = 0; s_subjects[j]; j++) {
+	    bool dfa = r.matches(s_subjects[j]);
+	    bool nfa = subj[j].matches(r);
+	    if (dfa == nfa)
+		continue;
+	    Debug("testregex",DebugWarn,"Pattern '%s' subject '%s': fast=%s regexec=%s",
+		r.c_str(),s_subjects[j],String::boolText(dfa),String::boolText(nfa));
+	    errors++;
+	}
+	unsigned int hits = 0;
+	u_int64_t t = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    for (int j = 0; s_subjects[j]; j++)
+		if (r.matches(s_subjects[j]))
+		    hits++;
+	u_int64_t dfa = Time::now() - t;
+	t = Time::now();
+	for (unsigned int n = 0; n < loops; n++)
+	    for (int j = 0; s_subjects[j]; j++)
+		if (subj[j].matches(r))
+		    hits--;
+	u_int64_t nfa = Time::now() - t;
+	totalDfa += dfa;
+	totalNfa += nfa;
+	Debug("testregex",hits ? DebugWarn : DebugInfo,"Pattern '%s': fast " FMT64U " usec, regexec " FMT64U " usec",
+	    r.c_str(),dfa,nfa);
+    }
+    Debug("testregex",errors ? DebugWarn : DebugNote,
+	"Finished %u loops with %u errors: fast " FMT64U " usec, regexec " FMT64U " usec",
+	loops,errors,totalDfa,totalNfa);
+    delete[] subj;
+}
+
+INIT_PLUGIN(TestRegex);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,210 @@
+/**
+ * routebench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * SS7 route index consistency test under concurrent changes, lookup speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatesig.h>
+
+using namespace TelEngine;
+
+// Network layer that only holds a routing table
+class BenchLayer3 : public SS7Layer3
+{
+public:
+    inline BenchLayer3()
+	: SignallingComponent("routebench")
+	{ }
+    virtual int transmitMSU(const SS7MSU& msu, const SS7Label& label, int sls = -1)
+	{ return -1; }
+    virtual bool operational(int sls = -1) const
+	{ return true; }
+    inline RefPointer<SS7Route> lookup(unsigned int packed)
+	{ return findRoute(SS7PointCode::ITU,packed); }
+    unsigned int rebuild(unsigned int count, bool oddOnly);
+};
+
+// State shared by the threads looking up routes while the table changes
+struct LookupShared
+{
+    BenchLayer3* network;
+    unsigned int routes;
+    volatile bool stop;
+    volatile int running;
+    volatile int errors;
+    volatile int lookups;
+};
+
+class LookupThread : public Thread
+{
+public:
+    inline LookupThread(LookupShared* shared)
+	: Thread("RouteLookup"), m_shared(shared)
+	{ }
+    virtual void run();
+private:
+    LookupShared* m_shared;
+};
+
+class TestRoute : public Plugin
+{
+public:
+    TestRoute();
+    virtual void initialize();
+private:
+    unsigned int checkIndex(BenchLayer3* network, unsigned int routes);
+    unsigned int checkThreads(BenchLayer3* network, unsigned int routes, unsigned int rebuilds);
+    void bench(BenchLayer3* network, unsigned int routes, unsigned int loops);
+    bool m_first;
+};
+
+// Replace the routes with new ones to point codes 1 to count, only the odd ones if requested
+unsigned int BenchLayer3::rebuild(unsigned int count, bool oddOnly)
+{
+    Lock lock(m_routeMutex);
+    ObjList& table = m_route[SS7PointCode::ITU - 1];
+    while (GenObject* route = table.remove(false))
+	retireRoute(static_cast<SS7Route*>(route));
+    for (unsigned int packed = 1; packed <= count; packed++) {
+	if (oddOnly && !(packed & 1))
+	    continue;
+	table.append(new SS7Route(packed,SS7PointCode::ITU,100));
+    }
+    return updateRouteIndex();
+}
+
+void LookupThread::run()
+{
+    unsigned int errors = 0;
+    unsigned int lookups = 0;
+    while (!m_shared->stop) {
+	unsigned int packed = 1 + Random::random() % m_shared->routes;
+	RefPointer<SS7Route> route = m_shared->network->lookup(packed);
+	if (route && route->packed() != packed)
+	    errors++;
+	// keep some routes while the table is rebuilt
+	if (!(++lookups & 0xff)) {
+	    Thread::yield();
+	    if (route && route->packed() != packed)
+		errors++;
+	}
+    }
+    if (errors)
+	__sync_add_and_fetch(&m_shared->errors,errors);
+    __sync_add_and_fetch(&m_shared->lookups,lookups);
+    __sync_sub_and_fetch(&m_shared->running,1);
+}
+
+TestRoute::TestRoute()
+    : Plugin("testroute"),
+      m_first(true)
+{
+    Output("Hello, I am module TestRoute");
+}
+
+// Every configured point code must be found, others not
+unsigned int TestRoute::checkIndex(BenchLayer3* network, unsigned int routes)
+{
+    unsigned int errors = 0;
+    if (network->rebuild(routes,false) != routes)
+	return 1;
+    for (unsigned int packed = 1; packed <= routes; packed++) {
+	RefPointer<SS7Route> route = network->lookup(packed);
+	if (!(route && route->packed() == packed)) {
+	    errors++;
+	    Debug("testroute",DebugWarn,"Route to %u not found",packed);
+	}
+	if (network->getRouteState(SS7PointCode::ITU,packed) != (route ? route->state() : SS7Route::Unknown))
+	    errors++;
+    }
+    if (network->lookup(routes + 1)) {
+	errors++;
+	Debug("testroute",DebugWarn,"Found route to unknown %u",routes + 1);
+    }
+    // a removed route must be released as soon as the table is rebuilt
+    RefPointer<SS7Route> removed = network->lookup(2);
+    network->rebuild(routes,true);
+    if (network->lookup(2) || !removed || removed->refcount() != 1) {
+	errors++;
+	Debug("testroute",DebugWarn,"Removed route still referenced by the table: %d",
+	    removed ? removed->refcount() : 0);
+    }
+    return errors;
+}
+
+// Look up routes from several threads while the table is rebuilt
+unsigned int TestRoute::checkThreads(BenchLayer3* network, unsigned int routes, unsigned int rebuilds)
+{
+    LookupShared shared = { network, routes, false, 0, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+	LookupThread* t = new LookupThread(&shared);
+	if (t->startup())
+	    __sync_add_and_fetch(&shared.running,1);
+	else
+	    delete t;
+    }
+    u_int64_t start = Time::now();
+    for (unsigned int n = 0; n < rebuilds; n++)
+	network->rebuild(routes,(n & 1) != 0);
+    u_int64_t t = Time::now() - start;
+    shared.stop = true;
+    while (shared.running)
+	Thread::yield();
+    Debug("testroute",shared.errors ? DebugWarn : DebugNote,
+	"Rebuilt %u routes %u times in " FMT64U " usec during %d lookups, %d errors",
+	routes,rebuilds,t,shared.lookups,shared.errors);
+    return shared.errors;
+}
+
+void TestRoute::bench(BenchLayer3* network, unsigned int routes, unsigned int loops)
+{
+    network->rebuild(routes,false);
+    unsigned int found = 0;
+    u_int64_t start = Time::now();
+    for (unsigned int n = 0; n < loops; n++) {
+	if (network->lookup(1 + (n % routes)))
+	    found++;
+    }
+    u_int64_t t = Time::now() - start;
+    Debug("testroute",DebugNote,"Looked up %u of %u routes in " FMT64U " usec",found,loops,t);
+}
+
+void TestRoute::initialize()
+{
+    Output("Initializing module TestRoute");
+    if (!m_first)
+	return;
+    m_first = false;
+    const Configuration& cfg = Engine::config();
+    unsigned int routes = cfg.getIntValue("testroute","routes",2000,2,16383);
+    unsigned int rebuilds = cfg.getIntValue("testroute","rebuilds",200,0,100000);
+    unsigned int loops = cfg.getIntValue("testroute","loops",1000000,1,100000000);
+
+    BenchLayer3* network = new BenchLayer3;
+    network->debugLevel(DebugMild);
+    unsigned int errors = checkIndex(network,routes);
+    errors += checkThreads(network,routes,rebuilds);
+    Debug("testroute",errors ? DebugWarn : DebugNote,"Checked route index, %u errors",errors);
+    bench(network,routes,loops);
+    TelEngine::destruct(network);
+}
+
+INIT_PLUGIN(TestRoute);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
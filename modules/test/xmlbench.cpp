@@ -0,0 +1,300 @@
+/**
+ * xmlbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * XML SAX parser consistency and throughput test, XML serializer speed test,
+ *  unparsed element content consistency and speed test
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatexml.h>
+
+using namespace TelEngine;
+
+// Document exercising all object types, with multibyte characters to be split
+static const char* s_doc =
+    "<?xml version='1.0' encoding='UTF-8'?>\n"
+    "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' to='example.com'>"
+    "<!-- a comment - with a dash -->"
+    "<message from='alice@example.com/a' to='bob@example.org' type='chat'>"
+    "<body>Hello &amp; w\xc3\xb6rld \xe2\x82\xac \xf0\x9f\x98\x80</body>"
+    "<x><![CDATA[raw <data> ] ]] here]]></x><empty/><e2 a=\"1\" b='&lt;2&gt;'/></message>"
+    "<iq type='get' id='1'><query xmlns='jabber:iq:roster'/></iq>"
+    "text after &#x41;&#66;"
+    "</stream:stream>";
+
+// Stanza repeated to build the throughput test stream
+static const char* s_stanza =
+    "<message from='alice@example.com/resource' to='bob@example.org' type='chat' id='m1'>"
+    "<body>Hello there, this is a test message \xc3\xa9\xc3\xa8</body><thread>abc</thread></message>";
+
+// Stanza using a namespace prefix declared on the stream root
+static const char* s_prefixed =
+    "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' xmlns:x='urn:x'>"
+    "<message to='bob@example.org'><x:data x:a='1'>v</x:data></message>";
+
+// SAX parser that only counts the elements it receives
+class CountParser : public XmlSaxParser
+{
+public:
+    inline CountParser()
+	: XmlSaxParser("xmlbench"), m_elements(0)
+	{ }
+    virtual void gotElement(const NamedList& element, bool empty)
+	{ m_elements++; }
+    unsigned int m_elements;
+};
+
+// DOM parser keeping unparsed the content of the root's children
+class KeepParser : public XmlDomParser
+{
+public:
+    inline KeepParser()
+	: XmlDomParser("xmlbench"), m_depth(0)
+	{ }
+protected:
+    virtual void gotElement(const NamedList& element, bool empty);
+    virtual void endElement(const String& name);
+private:
+    unsigned int m_depth;
+};
+
+class TestXml : public Plugin
+{
+public:
+    TestXml();
+    virtual void initialize();
+private:
+    unsigned int checkChunks(unsigned int maxChunk);
+    unsigned int checkKeep(unsigned int maxChunk);
+    void bench(const String& data, unsigned int chunk);
+    void benchKeep(const String& data, bool keep);
+    void benchDump(unsigned int loops);
+    bool m_first;
+};
+
+void KeepParser::gotElement(const NamedList& element, bool empty)
+{
+    if (m_depth == 1 && !empty && keepContent(element,4096)) {
+	if (!error())
+	    m_depth++;
+	return;
+    }
+    XmlDomParser::gotElement(element,empty);
+    if (!(empty || error()))
+	m_depth++;
+}
+
+void KeepParser::endElement(const String& name)
+{
+    XmlDomParser::endElement(name);
+    if (m_depth && !error())
+	m_depth--;
+}
+
+// Parse a document split in chunks of given size
+// Return the serialized result, the content of the root's children is parsed first
+static String parseDoc(const String& doc, unsigned int chunk, XmlDomParser* parser = 0,
+    unsigned int* kept = 0)
+{
+    XmlDomParser dom("xmlbench");
+    if (!parser)
+	parser = &dom;
+    String res;
+    for (unsigned int i = 0; i < doc.length(); i += chunk) {
+	if (parser->parse(doc.substr(i,chunk)) || parser->error() == XmlSaxParser::Incomplete)
+	    continue;
+	res << "error '" << parser->getError() << "' at " << i;
+	return res;
+    }
+    parser->completeText();
+    XmlElement* root = parser->document()->root();
+    for (ObjList* o = root ? root->getChildren().skipNull() : 0; o; o = o->skipNext()) {
+	XmlElement* xml = static_cast<XmlChild*>(o->get())->xmlElement();
+	if (!(xml && xml->rawContent()))
+	    continue;
+	// The content must be kept exactly as received
+	if (kept && doc.find(*xml->rawContent()) > 0)
+	    (*kept)++;
+	xml->getChildren();
+    }
+    parser->document()->toString(res);
+    res << " error=" << parser->error() << " buffer='" << parser->buffer() << "'";
+    return res;
+}
+
+TestXml::TestXml()
+    : Plugin("testxml"),
+      m_first(true)
+{
+    Output("Hello, I am module TestXml");
+}
+
+// Compare the result of parsing in small chunks with parsing at once
+unsigned int TestXml::checkChunks(unsigned int maxChunk)
+{
+    String doc(s_doc);
+    String ref = parseDoc(doc,doc.length());
+    Debug("testxml",DebugInfo,"Parsed reference document: %s",ref.c_str());
+    unsigned int errors = 0;
+    for (unsigned int chunk = 1; chunk <= maxChunk; chunk++) {
+	String res = parseDoc(doc,chunk);
+	if (res == ref)
+	    continue;
+	if (errors++ < 20)
+	    Debug("testxml",DebugWarn,"Chunk size %u\r\n got: %s\r\n expected: %s",
+		chunk,res.c_str(),ref.c_str());
+    }
+    return errors;
+}
+
+// Compare the elements built from content kept unparsed with those parsed at once
+unsigned int TestXml::checkKeep(unsigned int maxChunk)
+{
+    String doc(s_doc);
+    String ref = parseDoc(doc,doc.length());
+    unsigned int errors = 0;
+    for (unsigned int chunk = 1; chunk <= maxChunk; chunk++) {
+	KeepParser parser;
+	unsigned int kept = 0;
+	String res = parseDoc(doc,chunk,&parser,&kept);
+	// The 'message' and 'iq' children are kept
+	if (res == ref && kept == 2)
+	    continue;
+	if (errors++ < 20)
+	    Debug("testxml",DebugWarn,"Kept content chunk size %u, %u kept\r\n got: %s\r\n expected: %s",
+		chunk,kept,res.c_str(),ref.c_str());
+    }
+    // Prefixes declared on the root must be declared on the element sent alone
+    KeepParser parser;
+    parser.parse(s_prefixed);
+    XmlElement* root = parser.document()->root();
+    XmlElement* xml = root ? root->pop() : 0;
+    String sent;
+    if (xml && xml->rawContent())
+	xml->toString(sent);
+    XmlDomParser check("xmlbench");
+    check.parse(sent);
+    XmlElement* data = check.document()->root();
+    data = data ? data->findFirstChild() : 0;
+    const String* ns = data ? data->xmlns() : 0;
+    if (!(ns && *ns == "urn:x")) {
+	errors++;
+	Debug("testxml",DebugWarn,"Element with root prefix sent as '%s'",sent.c_str());
+    }
+    TelEngine::destruct(xml);
+    return errors;
+}
+
+void TestXml::bench(const String& data, unsigned int chunk)
+{
+    CountParser parser;
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < data.length(); i += chunk) {
+	if (!parser.parse(data.substr(i,chunk)) && parser.error() != XmlSaxParser::Incomplete)
+	    break;
+    }
+    t = Time::now() - t;
+    if (!t)
+	t = 1;
+    bool ok = parser.error() == XmlSaxParser::NoError || parser.error() == XmlSaxParser::Incomplete;
+    Debug("testxml",ok ? DebugNote : DebugWarn,
+	"Parsed %u bytes in %u byte chunks: " FMT64U " usec, %u KB/s, %u elements, error '%s'",
+	data.length(),chunk,t,(unsigned int)((u_int64_t)data.length() * 1000 / t),
+	parser.m_elements,parser.getError());
+}
+
+// Parse a stream and extract the stanzas, build them or keep their content unparsed
+void TestXml::benchKeep(const String& data, bool keep)
+{
+    XmlDomParser* parser = keep ? new KeepParser : new XmlDomParser("xmlbench");
+    unsigned int stanzas = 0;
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < data.length(); i += 4096) {
+	if (!parser->parse(data.substr(i,4096)) && parser->error() != XmlSaxParser::Incomplete)
+	    break;
+	XmlElement* root = parser->document()->root();
+	while (XmlElement* xml = root ? root->pop() : 0) {
+	    stanzas++;
+	    TelEngine::destruct(xml);
+	}
+    }
+    t = Time::now() - t;
+    Debug("testxml",DebugNote,"Extracted %u stanzas %s: " FMT64U " usec, error '%s'",
+	stanzas,keep ? "keeping their content" : "fully parsed",t,parser->getError());
+    delete parser;
+}
+
+// Build the string representation of a parsed stanza
+void TestXml::benchDump(unsigned int loops)
+{
+    XmlDomParser parser("xmlbench");
+    parser.parse(s_doc);
+    XmlElement* xml = parser.document()->root();
+    xml = xml ? xml->findFirstChild() : 0;
+    if (!xml) {
+	Debug("testxml",DebugWarn,"No element to serialize, error '%s'",parser.getError());
+	return;
+    }
+    unsigned int len = 0;
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < loops; i++) {
+	String buf;
+	xml->toString(buf);
+	len += buf.length();
+    }
+    t = Time::now() - t;
+    Debug("testxml",DebugNote,"Serialized '%s' %u times: " FMT64U " usec, %u bytes",
+	xml->tag(),loops,t,len);
+}
+
+void TestXml::initialize()
+{
+    Output("Initializing module TestXml");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int maxChunk = Engine::config().getIntValue("testxml","maxchunk",64,1,4096);
+    unsigned int size = Engine::config().getIntValue("testxml","size",4096,1,65536);
+    unsigned int loops = Engine::config().getIntValue("testxml","loops",100000,1,10000000);
+
+    unsigned int errors = checkChunks(maxChunk);
+    Debug("testxml",errors ? DebugWarn : DebugNote,"Compared chunked parsing for sizes 1-%u, %u errors",
+	maxChunk,errors);
+    errors = checkKeep(maxChunk);
+    Debug("testxml",errors ? DebugWarn : DebugNote,"Compared kept content for sizes 1-%u, %u errors",
+	maxChunk,errors);
+
+    // double the stanzas instead of appending one at a time, String has no spare capacity
+    String stanzas(s_stanza);
+    size *= 1024;
+    while (stanzas.length() < size)
+	stanzas << stanzas;
+    // the stream is never closed so the parser ends waiting for more data
+    String data("<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>");
+    data << stanzas;
+    static const unsigned int s_chunks[] = { 16, 64, 512, 4096, 65536, 0 };
+    for (int i = 0; s_chunks[i]; i++)
+	bench(data,s_chunks[i]);
+    benchKeep(data,false);
+    benchKeep(data,true);
+    benchDump(loops);
+}
+
+INIT_PLUGIN(TestXml);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
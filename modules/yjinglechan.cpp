@@ -491,6 +491,9 @@ public:
     bool handleJabberIq(Message& msg);
     // Handle resource.notify messages
     bool handleResNotify(Message& msg);
+    // Update pending connections on remote party online/offline notification
+    void handleResNotify(bool online, const JabberID& local, const JabberID& remote,
+	Message& msg);
     // Handle resource.subscribe messages
     bool handleResSubscribe(Message& msg);
     // Handle user.notify messages
@@ -4391,6 +4394,46 @@ bool YJGDriver::handleJabberIq(Message& msg)
     return false;
 }
 
+// Update pending connections on remote party online/offline notification
+void YJGDriver::handleResNotify(bool online, const JabberID& local, const JabberID& remote,
+    Message& msg)
+{
+    DDebug(this,DebugAll,"handleResNotify(%u) from=%s to=%s",
+	online,remote.c_str(),local.c_str());
+    if (!remote)
+	return;
+    if (online) {
+	if (!remote.resource())
+	    return;
+	Lock lock(this);
+	for (ObjList* o = channels().skipNull(); o; o = o->skipNext()) {
+	    YJGConnection* conn = static_cast<YJGConnection*>(o->get());
+	    if (conn->state() != YJGConnection::Pending)
+		continue;
+	    if (remote.bare() != conn->remote().bare())
+		continue;
+	    if (!local || conn->local().match(local)) {
+		conn->updateResource(remote.resource());
+		if (conn->presenceChanged(true,&msg))
+		    conn->disconnect(0);
+	    }
+	}
+	return;
+    }
+    // Offline
+    // Remote user is unavailable: notify all connections
+    // Remote has no resource: match connections by bare jid
+    Lock lock(this);
+    for (ObjList* o = channels().skipNull(); o; o = o->skipNext()) {
+	YJGConnection* conn = static_cast<YJGConnection*>(o->get());
+	if (conn->remote().match(remote) && (!local ||
+	    local.bare() != conn->local().bare())) {
+	    if (conn->presenceChanged(false))
+		conn->disconnect(0);
+	}
+    }
+}
+
 // Handle resource.notify messages
 bool YJGDriver::handleResNotify(Message& msg)
 {
@@ -4423,54 +4466,31 @@ bool YJGDriver::handleResNotify(Message& msg)
 		TelEngine::destruct(dataXml);
 	    }
 	}
-	JabberID local;
-	if (remote)
+	if (remote) {
 	    remote.resource(msg.getValue("instance"));
-	else {
-	    local.set(msg.getValue("to"));
+	    handleResNotify(online,JabberID::empty(),remote,msg);
+	    return false;
+	}
+	remote.set(msg.getValue("from"));
+	if (!remote.resource())
+	    remote.resource(msg.getValue("from_instance"));
+	// Destinations are given in 'to' or in a 'to.N' parameters list
+	unsigned int n = msg.getParam("to") ? 0 : msg.getIntValue("to.count");
+	for (unsigned int i = 0; i <= n; i++) {
+	    String to("to");
+	    String inst("to_instance");
+	    if (i) {
+		to << "." << i;
+		inst << "." << i;
+	    }
+	    JabberID local(msg.getValue(to));
 	    Lock lock(this);
 	    if (!handleDomain(local.domain()))
-		return false;
+		continue;
 	    lock.drop();
 	    if (!local.resource())
-		local.resource(msg.getValue("to_instance"));
-	    remote.set(msg.getValue("from"));
-	    if (!remote.resource())
-		remote.resource(msg.getValue("from_instance"));
-	}
-	DDebug(this,DebugAll,"handleResNotify(%u) from=%s to=%s",
-	    online,remote.c_str(),local.c_str());
-	if (!remote)
-	    return false;
-	if (online) {
-	    if (!remote.resource())
-		return false;
-	    Lock lock(this);
-	    for (ObjList* o = channels().skipNull(); o; o = o->skipNext()) {
-		YJGConnection* conn = static_cast<YJGConnection*>(o->get());
-		if (conn->state() != YJGConnection::Pending)
-		    continue;
-		if (remote.bare() != conn->remote().bare())
-		    continue;
-		if (!local || conn->local().match(local)) {
-		    conn->updateResource(remote.resource());
-		    if (conn->presenceChanged(true,&msg))
-			conn->disconnect(0);
-		}
-	    }
-	    return false;
-	}
-	// Offline
-	// Remote user is unavailable: notify all connections
-	// Remote has no resource: match connections by bare jid
-	Lock lock(this);
-	for (ObjList* o = channels().skipNull(); o; o = o->skipNext()) {
-	    YJGConnection* conn = static_cast<YJGConnection*>(o->get());
-	    if (conn->remote().match(remote) && (!local ||
-		local.bare() != conn->local().bare())) {
-		if (conn->presenceChanged(false))
-		    conn->disconnect(0);
-	    }
+		local.resource(msg.getValue(inst));
+	    handleResNotify(online,local,remote,msg);
 	}
 	return false;
     }
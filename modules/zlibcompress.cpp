@@ -21,6 +21,7 @@
 
 #include <yatephone.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include <zlib.h>
 
@@ -31,6 +32,7 @@
 using namespace TelEngine;
 namespace { // anonymous
 
+class ZLibPool;                          // Cache of released zlib memory blocks
 class ZLibStream;                        // zlib stream wrapper along with output buffer
 class ZLibComp;                          // ZLib (de)compressor
 class ZLibModule;                        // The module
@@ -41,6 +43,38 @@ class ZLibModule;                        // The module
 #define COMP_DEF_VAL 256
 #define DECOMP_MIN_VAL 256
 #define DECOMP_DEF_VAL 1024
+// Distinct block sizes kept in the pool, zlib uses only a few
+#define POOL_SIZES 16
+
+
+/*
+ * Cache of memory blocks released by zlib streams.
+ * Each stream allocates the same few block sizes for its state, window and
+ *  hash tables so blocks of streams that ended are given to new streams
+ */
+class ZLibPool : public Mutex
+{
+public:
+    ZLibPool();
+    ~ZLibPool();
+    // Set the maximum amount of memory kept for reuse
+    void setMax(unsigned int bytes);
+    // zlib memory allocation callbacks
+    static voidpf alloc(voidpf opaque, uInt items, uInt size);
+    static void release(voidpf opaque, voidpf address);
+private:
+    struct Block {
+	Block* next;
+	unsigned int size;
+    };
+    void* get(unsigned int size);
+    void put(void* ptr);
+    void purge(unsigned int keep);
+    Block* m_free[POOL_SIZES];
+    unsigned int m_size[POOL_SIZES];
+    unsigned int m_cached;
+    unsigned int m_max;
+};
 
 
 /*
@@ -64,7 +98,11 @@ public:
     int write(const void* buf, unsigned int len, bool flush);
     // Read data
     int read(DataBlock& buf, bool flush);
+    // Process data directly into a caller buffer
+    int process(const void* buf, unsigned int& len, void* dest, unsigned int destLen);
 private:
+    // Allocate the output buffer when first needed
+    bool outBuf();
     // Check an error code. Show a debug message if not ok.
     // Return true if code is Z_OK
     bool checkError(int code, const char* text);
@@ -75,6 +113,7 @@ private:
     bool m_comp;                         // (de)compressor flag
     z_stream_s m_zlib;                   // zlib library structure
     bool m_finalize;                     // Finalize flag
+    unsigned int m_outLen;               // Output buffer length
 };
 
 /*
@@ -111,6 +150,12 @@ public:
     // Read data from decompressor
     virtual int readDecomp(DataBlock& buf, bool flush)
 	{ return m_decomp ? m_decomp->read(buf,flush) : -1; }
+    // Compress directly into a caller buffer
+    virtual int compressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen)
+	{ return m_comp ? m_comp->process(buf,len,dest,destLen) : (len = 0, -1); }
+    // Decompress directly into a caller buffer
+    virtual int decompressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen)
+	{ return m_decomp ? m_decomp->process(buf,len,dest,destLen) : (len = 0, -1); }
 protected:
     ZLibStream* m_comp;
     ZLibStream* m_decomp;
@@ -133,10 +178,15 @@ protected:
 };
 
 
+// The pool must outlive the module as streams may be released from its destructor
+static ZLibPool s_pool;                                 // Released zlib memory
 INIT_PLUGIN(ZLibModule);
 static unsigned int s_compOutBuflen = COMP_DEF_VAL;     // Compressor output buffer length
 static unsigned int s_decompOutBuflen = DECOMP_DEF_VAL; // Decompressor output buffer length
 static int s_level = Z_DEFAULT_COMPRESSION;             // Default compression level
+static int s_compWindow = 15;                           // Compressor window bits
+static int s_memLevel = 8;                              // Compressor memory level
+static int s_decompWindow = 15;                         // Decompressor window bits
 
 // Compression level dictionary
 static const TokenDict s_compressionLevel[] = {
@@ -161,26 +211,125 @@ static unsigned int outBufLenParam(const NamedList& params, bool comp,
 }
 
 
+/*
+ * ZLibPool
+ */
+ZLibPool::ZLibPool()
+    : Mutex(false,"ZLibPool"),
+    m_cached(0), m_max(0)
+{
+    for (int i = 0; i < POOL_SIZES; i++) {
+	m_free[i] = 0;
+	m_size[i] = 0;
+    }
+}
+
+ZLibPool::~ZLibPool()
+{
+    purge(0);
+}
+
+void ZLibPool::setMax(unsigned int bytes)
+{
+    Lock lck(this);
+    m_max = bytes;
+    purge(m_max);
+}
+
+voidpf ZLibPool::alloc(voidpf opaque, uInt items, uInt size)
+{
+    return static_cast<ZLibPool*>(opaque)->get(items * size);
+}
+
+void ZLibPool::release(voidpf opaque, voidpf address)
+{
+    static_cast<ZLibPool*>(opaque)->put(address);
+}
+
+// Retrieve a cached block of the requested size or allocate a new one.
+// The block size is stored in front of the returned memory
+void* ZLibPool::get(unsigned int size)
+{
+    Lock lck(this);
+    for (int i = 0; i < POOL_SIZES; i++) {
+	if (m_size[i] != size || !m_free[i])
+	    continue;
+	Block* b = m_free[i];
+	m_free[i] = b->next;
+	m_cached -= size;
+	return b + 1;
+    }
+    lck.drop();
+    Block* b = (Block*)::malloc(sizeof(Block) + size);
+    if (!b)
+	return 0;
+    b->next = 0;
+    b->size = size;
+    return b + 1;
+}
+
+// Keep a released block for reuse if there is room, free it otherwise
+void ZLibPool::put(void* ptr)
+{
+    if (!ptr)
+	return;
+    Block* b = static_cast<Block*>(ptr) - 1;
+    Lock lck(this);
+    if (m_cached + b->size <= m_max) {
+	int empty = -1;
+	for (int i = 0; i < POOL_SIZES; i++) {
+	    if (m_size[i] == b->size) {
+		b->next = m_free[i];
+		m_free[i] = b;
+		m_cached += b->size;
+		return;
+	    }
+	    if (empty < 0 && !m_free[i])
+		empty = i;
+	}
+	if (empty >= 0) {
+	    m_size[empty] = b->size;
+	    b->next = 0;
+	    m_free[empty] = b;
+	    m_cached += b->size;
+	    return;
+	}
+    }
+    lck.drop();
+    ::free(b);
+}
+
+// Free cached blocks until at most keep bytes are left, the mutex must be locked
+void ZLibPool::purge(unsigned int keep)
+{
+    for (int i = 0; i < POOL_SIZES && m_cached > keep; i++) {
+	while (m_free[i] && m_cached > keep) {
+	    Block* b = m_free[i];
+	    m_free[i] = b->next;
+	    m_cached -= b->size;
+	    ::free(b);
+	}
+    }
+}
+
+
 /*
  * ZLibStream
  */
 // Constructor
 ZLibStream::ZLibStream(ZLibComp* owner, bool comp, const NamedList& params)
-    : m_owner(owner), m_comp(comp), m_finalize(false)
+    : m_owner(owner), m_comp(comp), m_finalize(false), m_outLen(0)
 {
     if (!m_owner)
 	return;
-    // Set output buffer length
+    // Set output buffer length, it is allocated only if the DataBlock interface is used
     unsigned int defVal = comp ? s_compOutBuflen : s_decompOutBuflen;
-    unsigned int n = outBufLenParam(params,comp,defVal);
-    assign(0,n);
+    m_outLen = outBufLenParam(params,comp,defVal);
     // Init zlib structure
     ::memset(&m_zlib,0,sizeof(z_stream_s));
-    m_zlib.next_out = (Bytef*)data();
-    m_zlib.avail_out = length();
-    m_zlib.zalloc = Z_NULL;
-    m_zlib.zfree = Z_NULL;
-    m_zlib.opaque = Z_NULL;
+    m_zlib.zalloc = ZLibPool::alloc;
+    m_zlib.zfree = ZLibPool::release;
+    m_zlib.opaque = &s_pool;
     int code = Z_OK;
     if (comp) {
 	m_zlib.data_type = Z_UNKNOWN;
@@ -193,13 +342,13 @@ ZLibStream::ZLibStream(ZLibComp* owner, bool comp, const NamedList& params)
 	code = deflateInit2(&m_zlib,
 	    params.getIntValue("compress_level",s_compressionLevel,s_level),
 	    Z_DEFLATED,                  // single supported compression method
-	    15,                          // default windowBits
-	    8,                           // default memLevel
+	    params.getIntValue("compress_window",s_compWindow,9,15),
+	    params.getIntValue("compress_memlevel",s_memLevel,1,9),
 	    Z_DEFAULT_STRATEGY);         // default strategy
     }
     else {
 	code = inflateInit2(&m_zlib,
-	    15);           // default windowBits
+	    params.getIntValue("decompress_window",s_decompWindow,9,15));
     }
     if (!checkError(code,"failed to initialize"))
 	m_owner = 0;
@@ -237,6 +386,8 @@ int ZLibStream::write(const void* buf, unsigned int len, bool flush)
     }
     XDebug(&__plugin,DebugAll,"ZLibComp(%s,%u)::write(%p,%u,%u) avail out %u [%p]",
 	m_owner->toString().c_str(),m_comp,buf,len,flush,m_zlib.avail_out,this);
+    if (!outBuf())
+	return -1;
     m_zlib.next_in = (Bytef*)buf;
     m_zlib.avail_in = len;
     int fl = m_finalize ? Z_FINISH : (flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
@@ -290,6 +441,66 @@ int ZLibStream::read(DataBlock& buf, bool flush)
     return ret;
 }
 
+// Process data directly into a caller buffer, flush all output that fits
+int ZLibStream::process(const void* buf, unsigned int& len, void* dest, unsigned int destLen)
+{
+    if (!(buf && len)) {
+	buf = 0;
+	len = 0;
+    }
+    if (!(dest && destLen)) {
+	len = 0;
+	return -1;
+    }
+    XDebug(&__plugin,DebugAll,"ZLibComp(%s,%u)::process(%p,%u,%p,%u) [%p]",
+	m_owner->toString().c_str(),m_comp,buf,len,dest,destLen,this);
+    // Output left in our buffer by the DataBlock interface goes first
+    int pending = outBufLen();
+    if (pending < 0) {
+	len = 0;
+	return -1;
+    }
+    if (pending) {
+	unsigned int n = (unsigned int)pending;
+	if (n > destLen)
+	    n = destLen;
+	::memcpy(dest,data(),n);
+	::memmove(data(),(char*)data() + n,pending - n);
+	m_zlib.next_out -= n;
+	m_zlib.avail_out += n;
+	len = 0;
+	return n;
+    }
+    m_zlib.next_in = (Bytef*)buf;
+    m_zlib.avail_in = len;
+    m_zlib.next_out = (Bytef*)dest;
+    m_zlib.avail_out = destLen;
+    int fl = m_finalize ? Z_FINISH : Z_SYNC_FLUSH;
+    int code = m_comp ? deflate(&m_zlib,fl) : inflate(&m_zlib,fl);
+    int ret = destLen - m_zlib.avail_out;
+    len -= m_zlib.avail_in;
+    // Point the library back to our own buffer
+    m_zlib.next_in = 0;
+    m_zlib.avail_in = 0;
+    m_zlib.next_out = (Bytef*)data();
+    m_zlib.avail_out = length();
+    if (code == Z_OK || code == Z_BUF_ERROR)
+	return ret;
+    checkError(code,"process failed");
+    return -1;
+}
+
+// Allocate the output buffer when first needed
+bool ZLibStream::outBuf()
+{
+    if (length())
+	return true;
+    assign(0,m_outLen);
+    m_zlib.next_out = (Bytef*)data();
+    m_zlib.avail_out = length();
+    return 0 != length();
+}
+
 // Check an error code. Show a debug message if not ok.
 // Return true if code is Z_OK
 bool ZLibStream::checkError(int code, const char* text)
@@ -422,12 +633,21 @@ void ZLibModule::initialize()
     s_compOutBuflen = outBufLenParam(*gen,true,COMP_DEF_VAL);
     s_decompOutBuflen = outBufLenParam(*gen,false,DECOMP_DEF_VAL);
     s_level = gen->getIntValue("compress_level",s_compressionLevel,Z_DEFAULT_COMPRESSION);
+    s_compWindow = gen->getIntValue("compress_window",15,9,15);
+    s_memLevel = gen->getIntValue("compress_memlevel",8,1,9);
+    s_decompWindow = gen->getIntValue("decompress_window",15,9,15);
+    unsigned int pool = gen->getIntValue("pool_size",4096,0,1048576);
+    s_pool.setMax(1024 * pool);
 
     if (debugAt(DebugAll)) {
 	String s;
 	s << " compressor_buflen=" << s_compOutBuflen;
 	s << " decompressor_buflen=" << s_decompOutBuflen;
 	s << " compress_level=" << ::lookup(s_level,s_compressionLevel);
+	s << " compress_window=" << s_compWindow;
+	s << " compress_memlevel=" << s_memLevel;
+	s << " decompress_window=" << s_decompWindow;
+	s << " pool_size=" << pool;
 	Debug(this,DebugAll,"Initialized%s",s.c_str());
     }
 }
@@ -2896,6 +2896,9 @@ YATE_API bool controlReturn(NamedList* params, bool ret, const char* retVal = 0)
 
 /**
  * A regular expression matching class.
+ * Checking if a string matches is done by a lazily built DFA whenever the
+ *  expression allows it, matching with subexpressions, back references and
+ *  GNU extension operators are handled by the POSIX regex library.
  * @short A regexp matching class
  */
 class YATE_API Regexp : public String
@@ -2989,10 +2992,148 @@ private:
     void cleanup();
     bool matches(const char* value, StringMatchPrivate* matchlist) const;
     mutable void* m_regexp;
+    mutable void* m_dfa;
     mutable bool m_compile;
     int m_flags;
 };
 
+/**
+ * A table of patterns anchored at the start of a string, typically telephone
+ *  number prefixes used in routing and least cost routing tables.
+ * Patterns made of literal characters and simple character classes are
+ *  expanded in a prefix trie so a lookup walks the string only once no matter
+ *  how many entries the table holds. Patterns that cannot be fully expanded
+ *  are indexed by their literal prefix and confirmed by a Regexp, patterns
+ *  with no usable prefix are always tried with their Regexp.
+ * Entries are identified by their insertion index, lookups return the lowest
+ *  or the longest matching entry.
+ * The table is not locked, adding entries concurrently with lookups must be
+ *  protected by the caller. Lookups don't modify the table so they may run
+ *  concurrently with each other.
+ * @short Fast prefix matching table
+ */
+class YATE_API PrefixTable : public GenObject
+{
+    YNOCOPY(PrefixTable); // no automatic copies please
+public:
+    /**
+     * Constructor
+     * @param extended True to use POSIX Extended Regular Expression syntax for patterns
+     * @param insensitive True to not differentiate case
+     */
+    explicit PrefixTable(bool extended = false, bool insensitive = false);
+
+    /**
+     * Destructor, releases all entries and their data
+     */
+    virtual ~PrefixTable();
+
+    /**
+     * Add a regular expression pattern to the table
+     * @param pattern Regular expression, only patterns anchored with '^' can be indexed
+     * @param data Optional object to associate with the entry, will be owned by the table
+     * @return Index of the new entry
+     */
+    unsigned int add(const char* pattern, GenObject* data = 0);
+
+    /**
+     * Add a literal prefix to the table
+     * @param prefix Literal string to match at the start of the looked up strings
+     * @param data Optional object to associate with the entry, will be owned by the table
+     * @param exact True to match only the whole string, false to match a prefix
+     * @return Index of the new entry
+     */
+    unsigned int addPrefix(const char* prefix, GenObject* data = 0, bool exact = false);
+
+    /**
+     * Remove all entries from the table
+     */
+    void clear();
+
+    /**
+     * Get the number of entries in the table
+     * @return Number of entries
+     */
+    inline unsigned int count() const
+	{ return m_count; }
+
+    /**
+     * Get the number of entries that are always checked by their Regexp
+     * @return Number of entries that could not be indexed
+     */
+    inline unsigned int unindexed() const
+	{ return m_otherCount; }
+
+    /**
+     * Get the pattern of an entry
+     * @param index Index of the entry
+     * @return The pattern or prefix the entry was created from
+     */
+    const String& pattern(unsigned int index) const;
+
+    /**
+     * Get the object associated with an entry
+     * @param index Index of the entry
+     * @return Pointer to the data object, NULL if none or index is invalid
+     */
+    GenObject* data(unsigned int index) const;
+
+    /**
+     * Check if an entry matches a string
+     * @param index Index of the entry
+     * @param str String to match
+     * @return True if the entry matches
+     */
+    bool matches(unsigned int index, const char* str) const;
+
+    /**
+     * Find the next entry that could match a string without confirming it.
+     * Indexed entries are returned only if their prefix matches, entries that
+     *  could not be indexed are always returned.
+     * @param str String to look up
+     * @param after Return only entries with an index greater than this
+     * @return Index of the candidate entry, negative if there is none
+     */
+    int candidate(const char* str, int after = -1) const;
+
+    /**
+     * Find the first entry that matches a string
+     * @param str String to look up
+     * @param after Return only entries with an index greater than this
+     * @return Index of the matching entry, negative if there is none
+     */
+    int find(const char* str, int after = -1) const;
+
+    /**
+     * Find the indexed entry with the longest prefix that matches a string.
+     * Among entries with the same prefix length the one with the lowest index wins.
+     * Entries that could not be indexed are considered to have a zero length prefix.
+     * @param str String to look up
+     * @return Index of the matching entry, negative if there is none
+     */
+    int longest(const char* str) const;
+
+private:
+    unsigned int append(GenObject* entry);
+    void insert(const char* prefix, unsigned int len, unsigned int index, bool exact);
+    unsigned int newNode(unsigned char chr);
+    bool check(unsigned int index, const char* str) const;
+    bool m_extended;
+    bool m_insensitive;
+    GenObject** m_entries;
+    unsigned int m_count;
+    unsigned int m_alloc;
+    void* m_nodes;
+    unsigned int m_nodeCount;
+    unsigned int m_nodeAlloc;
+    void* m_terms;
+    unsigned int m_termCount;
+    unsigned int m_termAlloc;
+    unsigned int* m_others;
+    unsigned int m_otherCount;
+    unsigned int m_otherAlloc;
+};
+
 /**
  * Indirected shared string offering access to atom strings
  * @short Atom string holder
@@ -4185,6 +4326,22 @@ public:
      */
     virtual unsigned int hmacBlockSize() const;
 
+    /**
+     * Check if the SHA1 and SHA256 hashers use the CPU SHA extensions
+     * @return True if the extensions are supported by the CPU and enabled
+     */
+    static inline bool shaExtensions()
+	{ return s_shaExtensions; }
+
+    /**
+     * Enable or disable the use of the CPU SHA extensions.
+     * Both implementations produce the same results, the portable one is
+     *  kept for CPUs without extensions and for testing and comparison
+     * @param enable True to use the extensions if the CPU supports them
+     * @return True if the extensions are used from now on
+     */
+    static bool shaExtensions(bool enable);
+
 protected:
     /**
      * Default constructor
@@ -4203,6 +4360,9 @@ protected:
 
     void* m_private;
     String m_hex;
+
+private:
+    static bool s_shaExtensions;
 };
 
 /**
@@ -4284,6 +4444,18 @@ public:
     virtual unsigned int hashLength() const
 	{ return 16; }
 
+    /**
+     * Compute the raw digests of many independent messages in one call.
+     * No object is built and no memory is allocated for each message
+     * @param out Buffer receiving count digests of rawLength() octets, one after another
+     * @param count Number of messages to hash
+     * @param bufs Array of count pointers to the messages
+     * @param lens Array of count message lengths
+     * @return True on success, false if a message pointer is missing
+     */
+    static bool digestBatch(unsigned char* out, unsigned int count,
+	const void* const* bufs, const unsigned int* lens);
+
 protected:
     bool updateInternal(const void* buf, unsigned int len);
 
@@ -4371,6 +4543,32 @@ public:
     virtual unsigned int hashLength() const
 	{ return 20; }
 
+    /**
+     * Compute the raw digests of many independent messages in one call.
+     * No object is built and no memory is allocated for each message
+     * @param out Buffer receiving count digests of rawLength() octets, one after another
+     * @param count Number of messages to hash
+     * @param bufs Array of count pointers to the messages
+     * @param lens Array of count message lengths
+     * @return True on success, false if a message pointer is missing
+     */
+    static bool digestBatch(unsigned char* out, unsigned int count,
+	const void* const* bufs, const unsigned int* lens);
+
+    /**
+     * Compute the raw digest of the data hashed so far followed by more data.
+     * This object is left unchanged and no memory is allocated so a state
+     * preloaded with a HMAC padded key can be reused for many messages
+     * @param out Buffer of at least rawLength() octets to receive the digest
+     * @param buf Pointer to the data to hash after the current state
+     * @param len Length of data in the buffer
+     * @param buf2 Optional pointer to more data to hash after the first buffer
+     * @param len2 Length of data in the second buffer
+     * @return True on success, false if this digest was already finalized
+     */
+    bool rawDigestWith(unsigned char* out, const void* buf, unsigned int len,
+	const void* buf2 = 0, unsigned int len2 = 0) const;
+
     /**
      * NIST FIPS 186-2 change notice 1 Pseudo Random Function.
      * Uses a b=160 bits SHA1 based G(t,c) function with no XSEEDj
@@ -4468,6 +4666,18 @@ public:
     virtual unsigned int hashLength() const
 	{ return 32; }
 
+    /**
+     * Compute the raw digests of many independent messages in one call.
+     * No object is built and no memory is allocated for each message
+     * @param out Buffer receiving count digests of rawLength() octets, one after another
+     * @param count Number of messages to hash
+     * @param bufs Array of count pointers to the messages
+     * @param lens Array of count message lengths
+     * @return True on success, false if a message pointer is missing
+     */
+    static bool digestBatch(unsigned char* out, unsigned int count,
+	const void* const* bufs, const unsigned int* lens);
+
 protected:
     bool updateInternal(const void* buf, unsigned int len);
 
@@ -4524,6 +4734,77 @@ public:
      */
     bool decode(DataBlock& dest, bool liberal = true);
 
+    /**
+     * Encode a chunk of data, appending the Base64 text to a destination string.
+     * Up to 2 bytes not making a full group are kept in this buffer and are
+     *  encoded with the next chunk. Line breaks are not supported
+     * @param dest Destination string, encoded text is appended to it
+     * @param buf Data to encode
+     * @param len Length of data
+     * @param final True if this is the last chunk, kept bytes are encoded with padding
+     */
+    void encodeChunk(String& dest, const void* buf, unsigned int len, bool final = false);
+
+    /**
+     * Decode a chunk of Base64 text, appending the data to a destination buffer.
+     * Up to 3 characters not making a full group are kept in this buffer and
+     *  are decoded with the next chunk
+     * @param dest Destination data buffer, decoded data is appended to it
+     * @param buf Text to decode
+     * @param len Length of text
+     * @param final True if this is the last chunk, kept characters are decoded
+     * @param liberal True to accept and ignore CR, LF, TAB, SPACE and padding
+     *  anywhere, false to accept padding only at the end
+     * @return True on success, false if an invalid character was found or the
+     *  final number of characters or padding is incorrect
+     */
+    bool decodeChunk(DataBlock& dest, const void* buf, unsigned int len,
+	bool final = false, bool liberal = true);
+
+    /**
+     * Encode binary data to hexadecimal digits, without separators
+     * @param dest Destination buffer, must have room for 2 * len characters.
+     *  It is not null terminated
+     * @param src Data to encode
+     * @param len Length of data
+     * @param upCase True to use uppercase letters
+     */
+    static void hexEncode(char* dest, const void* src, unsigned int len, bool upCase = false);
+
+    /**
+     * Decode hexadecimal digits without separators to binary data
+     * @param dest Destination buffer, must have room for len / 2 bytes
+     * @param src Digits to decode
+     * @param len Number of digits, an odd last digit is ignored
+     * @return Number of bytes decoded before the first pair holding an invalid digit
+     */
+    static unsigned int hexDecode(void* dest, const char* src, unsigned int len);
+
+    /**
+     * Vector instruction sets used by the Base64 and hexadecimal codecs
+     */
+    enum Simd {
+	SimdNone = 0,
+	SimdSsse3 = 1,
+	SimdAvx2 = 2
+    };
+
+    /**
+     * Retrieve the vector instruction set used by the codecs
+     * @return Best instruction set supported by the CPU unless limited
+     */
+    static inline int simd()
+	{ return s_simd; }
+
+    /**
+     * Limit the vector instruction set used by the codecs.
+     * All implementations produce the same results, the portable one is
+     *  kept for other CPUs and for testing and comparison
+     * @param level Highest instruction set to use, SimdNone for portable code
+     * @return Instruction set used from now on
+     */
+    static int simd(int level);
+
     /**
      * Base64 append operator for Strings
      */
@@ -4541,6 +4822,9 @@ public:
      */
     inline Base64& operator<<(const char* value)
 	{ return operator<<(String(value)); }
+
+private:
+    static int s_simd;
 };
 
 class NamedIterator;
@@ -5020,6 +5304,21 @@ public:
     inline const String& getExtra() const
 	{ parse(); return m_extra; }
 
+    /**
+     * Check if URIs are parsed by the hand written scanner
+     * @return True if the scanner is used, false if regular expressions are used
+     */
+    static inline bool fastParse()
+	{ return s_fastParse; }
+
+    /**
+     * Select the URI parser, both produce the same results.
+     * The regular expression parser is kept for testing and comparison
+     * @param fast True to use the hand written scanner, false to use regular expressions
+     */
+    static inline void fastParse(bool fast)
+	{ s_fastParse = fast; }
+
 protected:
     /**
      * Notification method called whenever the string URI has changed.
@@ -5034,11 +5333,22 @@ protected:
     mutable String m_host;
     mutable String m_extra;
     mutable int m_port;
+
+private:
+    void parseFast() const;
+    void parseRegexp() const;
+    bool setParts(const String& proto, const String& user, const String& host,
+	const String& port, const String& extra) const;
+    void clearParts() const;
+    static bool s_fastParse;
 };
 
 class MutexPrivate;
 class SemaphorePrivate;
+class RWLockPrivate;
 class ThreadPrivate;
+class LockProfile;
+class Thread;
 
 /**
  * An abstract base class for implementing lockable objects
@@ -5046,6 +5356,7 @@ class ThreadPrivate;
  */
 class YATE_API Lockable
 {
+    friend class Thread;
 public:
     /**
      * Destructor
@@ -5121,6 +5432,39 @@ public:
      * @return Locking safety measures flag value
      */
     static bool safety();
+
+    /**
+     * Enable or disable lock contention profiling of named mutexes and semaphores.
+     * Counters are kept per thread and per lockable name, they are merged only
+     *  when statistics are requested
+     * @param enable True to start collecting lock statistics, false to stop
+     */
+    static void enableProfiling(bool enable = true);
+
+    /**
+     * Check if lock contention profiling is enabled
+     * @return True if lock statistics are being collected
+     */
+    static bool profiling();
+
+    /**
+     * Retrieve the lock profiling statistics merged from all threads.
+     * One NamedList is appended for each lockable name, holding the parameters:
+     *  type (mutex, semaphore or rwlock), locks, contended, failed, wait, maxwait and,
+     *  for mutexes and read-write locks, hold and maxhold (write locks only for the latter).
+     *  Times are in microseconds
+     * @param dest List to append the statistics to
+     * @return Number of lockable names appended to the list
+     */
+    static unsigned int profilingStats(ObjList& dest);
+
+    /**
+     * Clear all collected lock profiling statistics
+     */
+    static void resetProfiling();
+
+private:
+    static void profilingDone(Thread* thread);
 };
 
 /**
@@ -5348,6 +5692,94 @@ private:
     SemaphorePrivate* m_private;
 };
 
+/**
+ * A read-write lock allows any number of threads to hold it for reading or
+ *  a single thread to hold it for writing.
+ * Waiting writers take precedence over new readers. The thread holding the
+ *  write lock may lock again for either reading or writing. A thread that
+ *  already holds a read lock is never blocked by waiting writers so nested
+ *  read locking is safe. Upgrading a read lock to a write lock deadlocks.
+ * The inherited lock() method acquires the write lock
+ * @short Reader-writer lock support
+ */
+class YATE_API RWLock : public Lockable
+{
+    friend class RWLockPrivate;
+public:
+    /**
+     * Construct a new unlocked read-write lock
+     * @param name Static name of the lock (for debugging purpose only)
+     */
+    explicit RWLock(const char* name = 0);
+
+    /**
+     * Copy constructor, creates a shared read-write lock
+     * @param original Reference of the lock to share
+     */
+    RWLock(const RWLock& original);
+
+    /**
+     * Destroy the read-write lock
+     */
+    ~RWLock();
+
+    /**
+     * Assignment operator makes the lock shared with the original
+     * @param original Reference of the lock to share
+     */
+    RWLock& operator=(const RWLock& original);
+
+    /**
+     * Attempt to lock the object for writing and eventually wait for it
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     * @return True if successfully locked, false on failure
+     */
+    virtual bool lock(long maxwait = -1);
+
+    /**
+     * Attempt to lock the object for reading and eventually wait for it
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     * @return True if successfully locked, false on failure
+     */
+    bool readLock(long maxwait = -1);
+
+    /**
+     * Attempt to lock the object for exclusive writing and eventually wait for it
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     * @return True if successfully locked, false on failure
+     */
+    bool writeLock(long maxwait = -1);
+
+    /**
+     * Release one read or write lock held by the current thread, does never wait
+     * @return True if successfully unlocked
+     */
+    virtual bool unlock();
+
+    /**
+     * Check if the object is currently locked for reading or writing - as it's
+     *  asynchronous it guarantees nothing if other thread changes the status
+     * @return True if the lock was held when the function was called
+     */
+    virtual bool locked() const;
+
+    /**
+     * Check if the object is currently locked for writing
+     * @return True if a writer was holding the lock when the function was called
+     */
+    bool writeLocked() const;
+
+    /**
+     * Get the number of read-write locks counting the shared ones only once
+     * @return Count of individual read-write locks
+     */
+    static int count();
+
+private:
+    RWLockPrivate* privDataCopy() const;
+    RWLockPrivate* m_private;
+};
+
 /**
  * A lock is a stack allocated (automatic) object that locks a lockable object
  *  on creation and unlocks it on destruction - typically when exiting a block
@@ -5499,6 +5931,114 @@ private:
     inline void* operator new[](size_t);
 };
 
+/**
+ * A read lock is a stack allocated (automatic) object that locks a read-write
+ *  lock for reading on creation and unlocks it on destruction
+ * @short Ephemeral shared read locking object
+ */
+class YATE_API RLock
+{
+    YNOCOPY(RLock); // no automatic copies please
+public:
+    /**
+     * Create the lock, try to lock the object for reading
+     * @param lck Reference to the object to lock
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     */
+    inline RLock(RWLock& lck, long maxwait = -1)
+	{ m_lock = lck.readLock(maxwait) ? &lck : 0; }
+
+    /**
+     * Create the lock, try to lock the object for reading
+     * @param lck Pointer to the object to lock
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     */
+    inline RLock(RWLock* lck, long maxwait = -1)
+	{ m_lock = (lck && lck->readLock(maxwait)) ? lck : 0; }
+
+    /**
+     * Destroy the lock, unlock the object if it was locked
+     */
+    inline ~RLock()
+	{ if (m_lock) m_lock->unlock(); }
+
+    /**
+     * Return a pointer to the object this lock holds
+     * @return A pointer to a RWLock or NULL if locking failed
+     */
+    inline RWLock* locked() const
+	{ return m_lock; }
+
+    /**
+     * Unlock the object if it was locked and drop the reference to it
+     */
+    inline void drop()
+	{ if (m_lock) m_lock->unlock(); m_lock = 0; }
+
+private:
+    RWLock* m_lock;
+
+    /** Make sure no RLock is ever created on heap */
+    inline void* operator new(size_t);
+
+    /** Never allocate an array of this class */
+    inline void* operator new[](size_t);
+};
+
+/**
+ * A write lock is a stack allocated (automatic) object that locks a read-write
+ *  lock for exclusive writing on creation and unlocks it on destruction
+ * @short Ephemeral exclusive write locking object
+ */
+class YATE_API WLock
+{
+    YNOCOPY(WLock); // no automatic copies please
+public:
+    /**
+     * Create the lock, try to lock the object for writing
+     * @param lck Reference to the object to lock
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     */
+    inline WLock(RWLock& lck, long maxwait = -1)
+	{ m_lock = lck.writeLock(maxwait) ? &lck : 0; }
+
+    /**
+     * Create the lock, try to lock the object for writing
+     * @param lck Pointer to the object to lock
+     * @param maxwait Time in microseconds to wait, -1 wait forever
+     */
+    inline WLock(RWLock* lck, long maxwait = -1)
+	{ m_lock = (lck && lck->writeLock(maxwait)) ? lck : 0; }
+
+    /**
+     * Destroy the lock, unlock the object if it was locked
+     */
+    inline ~WLock()
+	{ if (m_lock) m_lock->unlock(); }
+
+    /**
+     * Return a pointer to the object this lock holds
+     * @return A pointer to a RWLock or NULL if locking failed
+     */
+    inline RWLock* locked() const
+	{ return m_lock; }
+
+    /**
+     * Unlock the object if it was locked and drop the reference to it
+     */
+    inline void drop()
+	{ if (m_lock) m_lock->unlock(); m_lock = 0; }
+
+private:
+    RWLock* m_lock;
+
+    /** Make sure no WLock is ever created on heap */
+    inline void* operator new(size_t);
+
+    /** Never allocate an array of this class */
+    inline void* operator new[](size_t);
+};
+
 /**
  * This class holds the action to execute a certain task, usually in a
  *  different execution thread.
@@ -5530,6 +6070,8 @@ class YATE_API Thread : public Runnable
     friend class ThreadPrivate;
     friend class MutexPrivate;
     friend class SemaphorePrivate;
+    friend class RWLockPrivate;
+    friend class LockProfile;
     YNOCOPY(Thread); // no automatic copies please
 public:
     /**
@@ -5790,6 +6332,7 @@ private:
     ThreadPrivate* m_private;
     int m_locks;
     bool m_locking;
+    LockProfile* m_lockProfile;
 };
 
 /**
@@ -8044,6 +8587,30 @@ public:
      */
     virtual int decompress(const void* buf, unsigned int len, DataBlock& dest);
 
+    /**
+     * Compress the input buffer into a caller provided buffer, flush all pending data.
+     * Output that does not fit is kept and returned by the next calls
+     * @param buf Pointer to input data, may be NULL to retrieve pending output only
+     * @param len Length of input in bytes, set on return to the number of bytes consumed
+     * @param dest Destination buffer
+     * @param destLen Length of the destination buffer
+     * @return The number of bytes stored in destination, negative on error.
+     *  More output may be pending if the destination buffer was filled
+     */
+    virtual int compressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen);
+
+    /**
+     * Decompress the input buffer into a caller provided buffer, flush all pending data.
+     * Output that does not fit is kept and returned by the next calls
+     * @param buf Pointer to input data, may be NULL to retrieve pending output only
+     * @param len Length of input in bytes, set on return to the number of bytes consumed
+     * @param dest Destination buffer
+     * @param destLen Length of the destination buffer
+     * @return The number of bytes stored in destination, negative on error.
+     *  More output may be pending if the destination buffer was filled
+     */
+    virtual int decompressTo(const void* buf, unsigned int& len, void* dest, unsigned int destLen);
+
     /**
      * Push data to compressor. Flush compressor input if input buffer is NULL
      *  or the length is 0 and flush is true
@@ -8126,6 +8693,8 @@ public:
 
 protected:
     String m_format;
+    DataBlock m_compPending;
+    DataBlock m_decompPending;
 };
 
 /**
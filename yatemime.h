@@ -33,6 +33,8 @@
  */
 namespace TelEngine {
 
+class MimeData;
+
 /**
  * A MIME header line.
  * The NamedString's value contain the first parameter after the header name
@@ -44,7 +46,7 @@ public:
     /**
      * Constructor.
      * Builds a MIME header line from a string buffer.
-     * Splits the value into header parameters
+     * Splits the value into header parameters, they are parsed when first used
      * @param name The header name
      * @param value The header value
      * @param sep Optional parameter separator. If 0, the default ';' will be used
@@ -97,7 +99,7 @@ public:
      * @return This header's list of parameters
      */
     inline const ObjList& params() const
-	{ return m_params; }
+	{ if (m_lazy) parseParams(); return m_params; }
 
     /**
      * Get the character used as separator in header line
@@ -174,10 +176,13 @@ public:
     static void buildHeaders(String& buf, const ObjList& headers);
 
 protected:
-    ObjList m_params;                    // Header list of parameters
+    mutable ObjList m_params;            // Header list of parameters, use params() to access
     char m_separator;                    // Parameter separator
 private:
     void operator=(const MimeHeaderLine&); // no assignment
+    void parseParams() const;            // Split the parameters text into the list
+    mutable String m_rawParams;          // Parameters text not parsed yet
+    mutable volatile int m_lazy;         // Parameters text state: parsed, not parsed or in use
 };
 
 /**
@@ -371,7 +376,9 @@ public:
     /**
      * Method to build a MIME body from a type and data buffer.
      * Unknown body types are built into a binary body. Exactly 1 leading CRLF
-     * is removed from the beginning of the buffer if found before building it
+     * is removed from the beginning of the buffer if found before building it.
+     * Except for binary bodies the data is copied once and the content of the
+     * body (and of multipart components) is parsed when first accessed
      * @param buf Pointer to buffer of data just after the body headers
      * @param len Length of data in buffer
      * @param type The header line declaring the body's content.
@@ -409,6 +416,38 @@ protected:
      */
     virtual void buildBody() const = 0;
 
+    /**
+     * Method that is called internally to build the content of this body from
+     *  data kept unparsed when the body was built. Does nothing by default
+     * @param buf Pointer to buffer of data
+     * @param len Length of data in buffer
+     */
+    virtual void parseContent(const char* buf, int len);
+
+    /**
+     * Parse the data kept when this body was built, if not already done.
+     * Derived classes must call it before accessing their content
+     */
+    inline void checkContent() const
+	{ if (m_raw) parseRaw(); }
+
+    /**
+     * Share the data not parsed yet of another body instead of copying its content
+     * @param original Body whose data is shared
+     * @return True if the original body holds data not parsed yet
+     */
+    bool shareContent(const MimeBody& original);
+
+    /**
+     * Build a MIME body keeping a view into a shared block of data
+     * @param data Shared block holding the buffer
+     * @param buf Pointer to buffer of data inside the shared block
+     * @param len Length of data in buffer
+     * @param type The header line declaring the body's content
+     * @return Newly allocated MIME body or NULL if the buffer is empty
+     */
+    static MimeBody* build(MimeData* data, const char* buf, int len, const MimeHeaderLine& type);
+
     /**
      * Block of binary data that @ref buildBody() must fill
      */
@@ -420,7 +459,14 @@ protected:
     ObjList m_headers;
 
 private:
+    void parseRaw() const;               // Parse and release the kept data
+    void setContent(MimeData* data, const char* buf, int len);
     MimeHeaderLine m_type;               // Content type header line
+    mutable MimeData* volatile m_raw;    // Shared data holding the unparsed content
+    mutable const char* m_rawBuf;        // Start of unparsed content
+    mutable int m_rawLen;                // Length of unparsed content
+    Mutex* m_rawLock;                    // Serializes parsing of this body, set with the data
+    mutable bool m_parsing;              // Content is being parsed by the locking thread
 };
 
 /**
@@ -429,6 +475,7 @@ private:
  */
 class YATE_API MimeMultipartBody : public MimeBody
 {
+    friend class MimeBody;
 public:
     /**
      * Constructor to build an empty multipart body
@@ -544,7 +591,8 @@ private:
     // @param boundary Destination string
     // @return False if the parameter is missing or the boundary is empty
     bool getBoundary(String& boundary) const;
-
+    // Split shared data in enclosed bodies keeping views into it
+    void parse(MimeData* data, const char* buf, int len);
 
     ObjList m_bodies;                    // The list of bodies contained in this multipart
 };
@@ -608,7 +656,7 @@ public:
      * @return List of NamedStrings
      */
     inline const ObjList& lines() const
-	{ return m_lines; }
+	{ checkContent(); return m_lines; }
 
     /**
      * Retrieve the hash of body lines
@@ -650,6 +698,13 @@ protected:
      */
     virtual void buildBody() const;
 
+    /**
+     * Override that is called internally to build the lines from kept data
+     * @param buf Pointer to buffer of data
+     * @param len Length of data in buffer
+     */
+    virtual void parseContent(const char* buf, int len);
+
 private:
     // Build the lines from a data buffer
     void buildLines(const char* buf, int len);
@@ -759,7 +814,7 @@ public:
      * @return String holding the data text
      */
     inline const String& text() const
-	{ return m_text; }
+	{ checkContent(); return m_text; }
 
 protected:
     /**
@@ -772,6 +827,13 @@ protected:
      */
     virtual void buildBody() const;
 
+    /**
+     * Override that is called internally to build the text from kept data
+     * @param buf Pointer to buffer of data
+     * @param len Length of data in buffer
+     */
+    virtual void parseContent(const char* buf, int len);
+
 private:
     String m_text;
 };
@@ -822,14 +884,14 @@ public:
      * @return List of Strings
      */
     inline const ObjList& lines() const
-	{ return m_lines; }
+	{ checkContent(); return m_lines; }
 
     /**
      * Append a line of text to the data
      * @param line Text to append
      */
     inline void addLine(const char* line)
-	{ m_lines.append(new String(line)); }
+	{ checkContent(); m_lines.append(new String(line)); }
 
 protected:
     /**
@@ -842,6 +904,13 @@ protected:
      */
     virtual void buildBody() const;
 
+    /**
+     * Override that is called internally to build the lines from kept data
+     * @param buf Pointer to buffer of data
+     * @param len Length of data in buffer
+     */
+    virtual void parseContent(const char* buf, int len);
+
 private:
     ObjList m_lines;
 };
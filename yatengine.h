@@ -236,14 +236,14 @@ private:
  * Class that implements atomic / locked access and operations to its shared variables
  * @short Atomic access and operations to shared variables
  */
-class YATE_API SharedVars : public Mutex
+class YATE_API SharedVars : public RWLock
 {
 public:
     /**
      * Constructor
      */
     inline SharedVars()
-	: Mutex(false,"SharedVars"), m_vars("")
+	: RWLock("SharedVars"), m_vars("")
 	{ }
 
     /**
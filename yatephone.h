@@ -825,7 +825,7 @@ private:
     static void compose(TranslatorFactory* factory);
     static bool canConvert(const FormatInfo* fmt1, const FormatInfo* fmt2);
     DataSource* m_tsource;
-    static Mutex s_mutex;
+    static RWLock s_mutex;
     static ObjList s_factories;
     static unsigned int s_maxChain;
 };
@@ -2178,6 +2178,7 @@ private:
     bool m_varchan;
     String m_prefix;
     ObjList m_chans;
+    RWLock m_chanLock;
     int m_routing;
     int m_routed;
     int m_total;
@@ -2212,7 +2213,10 @@ public:
 	{ return m_varchan; }
 
     /**
-     * Get the list of channels of this driver
+     * Get the list of channels of this driver.
+     * The driver must be locked while using the list, changes to the list are
+     *  additionally protected by an internal read-write lock so lookups from
+     *  received messages don't have to serialize on the driver mutex
      * @return A reference to the channel list
      */
     inline ObjList& channels()
@@ -104,11 +104,13 @@ public:
     virtual ~XmlSaxParser();
 
     /**
-     * Get the number of bytes successfully parsed
+     * Get the number of bytes successfully parsed.
+     * When called from a parser callback this is the stream offset of the
+     *  first character not yet consumed
      * @return The number of bytes successfully parsed
      */
     inline unsigned int offset() const
-	{ return m_offset; }
+	{ return m_offset - bufLength(); }
 
     /**
      * Get the row where the parser has found an error
@@ -340,6 +342,52 @@ protected:
      */
     void skipBlanks();
 
+    /**
+     * Retrieve a character from the unparsed part of the buffer
+     * @param offs Offset of the character from the parser's current position
+     * @return The character, 0 if offs is past the end of the buffer
+     */
+    inline char bufAt(unsigned int offs) const
+	{ return m_buf.at(m_bufPos + offs); }
+
+    /**
+     * Retrieve the length of the unparsed part of the buffer
+     * @return Number of characters not yet consumed by the parser
+     */
+    inline unsigned int bufLength() const
+	{ return m_buf.length() - m_bufPos; }
+
+    /**
+     * Retrieve the unparsed part of the buffer
+     * @return Pointer to the first character not yet consumed by the parser
+     */
+    inline const char* bufData() const
+	{ return m_buf.c_str() ? m_buf.c_str() + m_bufPos : ""; }
+
+    /**
+     * Consume characters from the beginning of the unparsed buffer.
+     * Data is not moved, the buffer is compacted once at the end of parse()
+     * @param len Number of characters to skip
+     */
+    inline void bufSkip(unsigned int len)
+	{ m_bufPos = (len < bufLength()) ? m_bufPos + len : m_buf.length(); }
+
+    /**
+     * Extract a substring from the unparsed part of the buffer
+     * @param offs Offset of the substring from the parser's current position
+     * @param len Length of the substring, negative to extract till the end
+     * @return A copy of the requested substring
+     */
+    inline String bufSubstr(unsigned int offs, int len = -1) const
+	{ return m_buf.substr(m_bufPos + offs,len); }
+
+    /**
+     * Replace the unparsed part of the buffer with new content
+     * @param data New unparsed data
+     */
+    inline void bufSet(const String& data)
+	{ m_buf = data; m_bufPos = 0; }
+
     /**
      * Check if a character is an angle bracket
      * @param c The character to verify
@@ -372,6 +420,13 @@ protected:
      */
     NamedString* getAttribute();
 
+    /**
+     * Parse the data accumulated in the buffer, consuming it by moving
+     *  the current position instead of copying the remaining data
+     * @return True if all data was successfully parsed
+     */
+    bool parseBuffer();
+
     /**
      * Callback method. Is called when a comment was successfully parsed.
      * Default implementation does nothing
@@ -414,6 +469,8 @@ protected:
 
     /**
      * Callback method. Is called when an element was successfully parsed.
+     * The element start tag is already consumed: the unparsed part of the buffer
+     *  starts with element content.
      * Default implementation does nothing
      * @param element The element content
      * @param empty True if the element does not have attributes
@@ -453,6 +510,16 @@ protected:
      */
     bool processElement(NamedList& list, bool empty);
 
+    /**
+     * Consume the end of an element start tag then call gotElement().
+     * The tag end is restored in buffer if the element is not processed
+     * @param list The list element and its attributes
+     * @param empty True if the element does not have attributes
+     * @param tagEnd Length of the start tag end in buffer
+     * @return True if there is no error
+     */
+    bool processElement(NamedList& list, bool empty, unsigned int tagEnd);
+
     /**
      * Unescape text, call gotText() and reset parsed on success
      * @param text The text to process
@@ -461,7 +528,7 @@ protected:
     bool processText(String& text);
 
     /**
-     * The offset where the parser was stop
+     * The number of bytes received by the parser
      */
     unsigned int m_offset;
 
@@ -485,6 +552,16 @@ protected:
      */
     String m_buf;
 
+    /**
+     * Offset in the main buffer of the first character not yet parsed
+     */
+    unsigned int m_bufPos;
+
+    /**
+     * Length of the main buffer data already checked to be valid UTF-8
+     */
+    unsigned int m_bufChecked;
+
     /**
      * The parser data holder.
      * Keeps the parsed data when an incomplete xml object is found
@@ -709,6 +786,21 @@ protected:
     virtual bool completed()
 	{ return m_current == 0; }
 
+    /**
+     * Append a non empty xml element keeping its content as received (see
+     *  XmlElement::rawContent()) instead of parsing it into children.
+     * This method may be called from gotElement() instead of the default handler.
+     * The content is checked to be well formed. Namespace prefixes it uses are
+     *  declared in the element if they were declared by its parents.
+     * The parser waits until the whole content is received
+     * @param element The element content
+     * @param maxWait Maximum content length to wait for
+     * @return False if the content must be parsed as usual: it was not completely
+     *  received within given length, it's not well formed or it contains
+     *  constructs left to the parser (processing instructions, deep nesting)
+     */
+    bool keepContent(const NamedList& element, unsigned int maxWait);
+
 private:
     XmlElement* m_current;                   // The current xml element
     XmlParent* m_data;                       // Main xml fragment
@@ -1250,17 +1342,39 @@ public:
 	{ return m_element; }
 
     /**
-     * Helper method to obtain the children list
+     * Helper method to obtain the children list.
+     * Content kept as received is parsed into children on first request
      * @return The children list
      */
-    inline const ObjList& getChildren() const
-	{ return m_children.getChildren(); }
+    inline const ObjList& getChildren() const {
+	    if (m_content)
+		parseContent();
+	    return m_children.getChildren();
+	}
 
     /**
      * Helper method to clear the children list
      */
-    inline void clearChildren()
-	{ return m_children.clearChildren(); }
+    inline void clearChildren() {
+	    TelEngine::destruct(m_content);
+	    m_children.clearChildren();
+	}
+
+    /**
+     * Retrieve the content of this element kept as received, not parsed into children yet
+     * @return Pointer to element content, 0 if not kept or already parsed
+     */
+    inline const String* rawContent() const
+	{ return m_content; }
+
+    /**
+     * Keep the content of this element as received instead of building its children.
+     * The content is parsed when children are first requested or changed.
+     * It is written unchanged when the element is serialized before that
+     * @param data Well formed element content
+     * @param len Content length
+     */
+    void setRawContent(const char* data, unsigned int len);
 
     /**
      * Retrieve the list of inherited namespaces
@@ -1602,6 +1716,9 @@ private:
 		m_prefixed = new NamedString(m_element.substr(pos + 1),m_element.substr(0,pos));
 	}
 
+    // Build children from the content kept as received
+    void parseContent() const;
+
     XmlFragment m_children;                      // Children of this element
     NamedList m_element;                         // The element
     NamedString* m_prefixed;                     // Splitted prefixed tag (the value is the namespace prefix)
@@ -1609,6 +1726,7 @@ private:
     NamedList* m_inheritedNs;                    // Inherited namespaces (if parent is 0)
     bool m_empty;                                // True if this element does not have any children
     bool m_complete;                             // True if the end element tag war reported
+    mutable String* m_content;                   // Content kept as received, not parsed yet
 };
 
 /**